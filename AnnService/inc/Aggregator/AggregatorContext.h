@@ -11,6 +11,7 @@
 #include <memory>
 #include <vector>
 #include <atomic>
+#include <mutex>
 
 namespace SPTAG
 {
@@ -31,13 +32,35 @@ struct RemoteMachine
 {
     RemoteMachine();
 
+    void RecordLatency(float p_milliseconds, float p_decay);
+
+    // Lower is better: the smoothed latency scaled by the requests already waiting on this replica.
+    float LoadScore() const;
+
+    void CopyLatencySamples(std::vector<float>& p_samples);
+
     std::string m_address;
 
     std::string m_port;
 
+    std::uint32_t m_group;
+
     Socket::ConnectionID m_connectionID;
 
     std::atomic<RemoteMachineStatus> m_status;
+
+    std::atomic<std::uint32_t> m_outstanding;
+
+    std::atomic<float> m_latencyEWMA;
+
+private:
+    static constexpr std::size_t c_latencySampleNum = 256;
+
+    std::mutex m_latencyLock;
+
+    std::vector<float> m_latencySamples;
+
+    std::size_t m_nextLatencySample;
 };
 
 class AggregatorContext
@@ -51,12 +74,22 @@ public:
 
     const std::vector<std::shared_ptr<RemoteMachine>>& GetRemoteServers() const;
 
+    // Servers with the same Group hold replicas of one shard. Shards are ordered by group id.
+    const std::vector<std::vector<std::shared_ptr<RemoteMachine>>>& GetShards() const;
+
+    std::shared_ptr<RemoteMachine> PickReplica(std::size_t p_shard,
+                                               const std::vector<std::shared_ptr<RemoteMachine>>& p_excluded) const;
+
+    std::uint32_t GetHedgeDelay(std::size_t p_shard) const;
+
     const std::shared_ptr<AggregatorSettings>& GetSettings() const;
 
 	const std::shared_ptr<VectorSet>& GetCenters() const;
 
 private:
     std::vector<std::shared_ptr<RemoteMachine>> m_remoteServers;
+
+    std::vector<std::vector<std::shared_ptr<RemoteMachine>>> m_shards;
 	
 	std::shared_ptr<VectorSet> m_centers;
 
@@ -6,9 +6,14 @@
 
 #include "inc/Socket/RemoteSearchQuery.h"
 #include "inc/Socket/Packet.h"
+#include "AggregatorContext.h"
+
+#include <boost/asio/deadline_timer.hpp>
 
 #include <memory>
 #include <atomic>
+#include <mutex>
+#include <vector>
 
 namespace SPTAG
 {
@@ -17,11 +22,34 @@ namespace Aggregator
 
 typedef std::shared_ptr<Socket::RemoteSearchResult> AggregatorResult;
 
+// Attempts sent to the replicas of one shard. The first successful answer wins.
+struct ShardRequest
+{
+    ShardRequest();
+
+    std::size_t m_shard;
+
+    std::mutex m_lock;
+
+    bool m_finished;
+
+    bool m_hedged;
+
+    std::uint32_t m_inflight;
+
+    std::vector<std::shared_ptr<RemoteMachine>> m_tried;
+
+    std::vector<std::pair<Socket::ResourceID, std::shared_ptr<RemoteMachine>>> m_attempts;
+
+    std::shared_ptr<boost::asio::deadline_timer> m_hedgeTimer;
+};
+
 class AggregatorExecutionContext
 {
 public:
     AggregatorExecutionContext(std::size_t p_totalServerNumber,
-                               Socket::PacketHeader p_requestHeader);
+                               Socket::PacketHeader p_requestHeader,
+                               Socket::Packet p_requestPacket);
 
     ~AggregatorExecutionContext();
 
@@ -29,8 +57,12 @@ public:
 
     AggregatorResult& GetResult(std::size_t p_num);
 
+    ShardRequest& GetShardRequest(std::size_t p_num);
+
     const Socket::PacketHeader& GetRequestHeader() const;
 
+    const Socket::Packet& GetRequestPacket() const;
+
     bool IsCompletedAfterFinsh(std::uint32_t p_finishedCount);
 
 private:
@@ -38,8 +70,11 @@ private:
 
     std::vector<AggregatorResult> m_results;
 
+    std::vector<std::unique_ptr<ShardRequest>> m_shardRequests;
+
     Socket::PacketHeader m_requestHeader;
 
+    Socket::Packet m_requestPacket;
 };
 
 
@@ -15,6 +15,7 @@
 #include <memory>
 #include <vector>
 #include <thread>
+#include <chrono>
 #include <condition_variable>
 
 namespace SPTAG
@@ -49,6 +50,24 @@ private:
 
     void SearchResponseHanlder(Socket::ConnectionID p_localConnectionID, Socket::Packet p_packet);
 
+    void SendToReplica(std::shared_ptr<AggregatorExecutionContext> p_exectionContext,
+                       std::size_t p_num,
+                       std::shared_ptr<RemoteMachine> p_server);
+
+    void ScheduleHedge(std::shared_ptr<AggregatorExecutionContext> p_exectionContext, std::size_t p_num);
+
+    void SendHedge(std::shared_ptr<AggregatorExecutionContext> p_exectionContext, std::size_t p_num);
+
+    void HandleReplicaResult(std::shared_ptr<AggregatorExecutionContext> p_exectionContext,
+                             std::size_t p_num,
+                             std::shared_ptr<RemoteMachine> p_server,
+                             std::chrono::steady_clock::time_point p_sendTime,
+                             Socket::RemoteSearchResult p_result);
+
+    void FinishShard(std::shared_ptr<AggregatorExecutionContext> p_exectionContext,
+                     std::size_t p_num,
+                     Socket::RemoteSearchResult p_result);
+
     void AggregateResults(std::shared_ptr<AggregatorExecutionContext> p_exectionContext);
 
     std::shared_ptr<AggregatorContext> GetContext();
@@ -34,6 +34,13 @@ struct AggregatorSettings
 	SizeType m_topK;
 
 	DistCalcMethod m_distMethod;
+
+    // Percentile of recent shard latency after which a duplicate request goes to another replica, 0 disables hedging.
+    float m_hedgePercentile;
+
+    std::uint32_t m_hedgeMinDelay;
+
+    float m_latencyDecay;
 };
 
 
@@ -28,6 +28,8 @@ class ClientWrapper
 public:
     typedef std::function<void(Socket::RemoteSearchResult)> Callback;
 
+    typedef std::function<void(Socket::RemoteBatchSearchResult)> BatchCallback;
+
     ClientWrapper(const ClientOptions& p_options);
 
     ~ClientWrapper();
@@ -36,6 +38,10 @@ public:
                         Callback p_callback,
                         const ClientOptions& p_options);
 
+    void SendBatchQueryAsync(const Socket::RemoteBatchQuery& p_query,
+                             BatchCallback p_callback,
+                             const ClientOptions& p_options);
+
     void WaitAllFinished();
 
     bool IsAvailable() const;
@@ -51,6 +57,8 @@ private:
 
     void SearchResponseHanlder(Socket::ConnectionID p_localConnectionID, Socket::Packet p_packet);
 
+    void BatchSearchResponseHandler(Socket::ConnectionID p_localConnectionID, Socket::Packet p_packet);
+
     void HandleDeadConnection(Socket::ConnectionID p_cid);
 
 private:
@@ -71,6 +79,8 @@ private:
     std::atomic<std::uint32_t> m_spinCountOfConnection;
 
     Socket::ResourceManager<Callback> m_callbackManager;
+
+    Socket::ResourceManager<BatchCallback> m_batchCallbackManager;
 };
 
 
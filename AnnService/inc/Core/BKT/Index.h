@@ -36,6 +36,8 @@ namespace SPTAG
         template<typename T>
         class Index : public VectorIndex
         {
+            template <typename> friend class Index;
+
             class RebuildJob : public Helper::ThreadPool::Job {
             public:
                 RebuildJob(COMMON::Dataset<T>* p_data, COMMON::BKTree* p_tree, COMMON::RelativeNeighborhoodGraph* p_graph, 
@@ -152,11 +154,13 @@ namespace SPTAG
 
             ErrorCode BuildIndex(const void* p_data, SizeType p_vectorNum, DimensionType p_dimension, bool p_normalized = false);
             ErrorCode SearchIndex(QueryResult &p_query, bool p_searchDeleted = false) const;
+            ErrorCode SearchIndexWithProgress(QueryResult& p_query, int p_interval, const std::function<void(QueryResult&)>& p_progress, bool p_searchDeleted = false) const;
             ErrorCode RefineSearchIndex(QueryResult &p_query, bool p_searchDeleted = false) const;
             ErrorCode SearchTree(QueryResult &p_query) const;
             ErrorCode AddIndex(const void* p_data, SizeType p_vectorNum, DimensionType p_dimension, std::shared_ptr<MetadataSet> p_metadataSet, bool p_withMetaIndex = false, bool p_normalized = false);
             ErrorCode AddIndexId(const void* p_data, SizeType p_vectorNum, DimensionType p_dimension, int& beginHead, int& endHead);
             ErrorCode AddIndexIdx(SizeType begin, SizeType end);
+            ErrorCode AddIndexIdxBatch(const std::vector<SizeType>& p_ids);
             ErrorCode DeleteIndex(const void* p_vectors, SizeType p_vectorNum);
             ErrorCode DeleteIndex(const SizeType& p_id);
 
@@ -166,6 +170,9 @@ namespace SPTAG
 
             ErrorCode RefineIndex(const std::vector<std::shared_ptr<Helper::DiskPriorityIO>>& p_indexStreams, IAbortOperation* p_abort);
             ErrorCode RefineIndex(std::shared_ptr<VectorIndex>& p_newIndex);
+            ErrorCode CompactIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::vector<SizeType>& p_newToOld);
+            ErrorCode ReorderIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::vector<SizeType>& p_newToOld);
+            ErrorCode QuantizeIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::function<void(const void*, std::int8_t*)> p_quantize);
 
             ErrorCode Append(SizeType headID, int appendNum, std::string& appendPosting) { return ErrorCode::Undefined; }
             ErrorCode Split(SizeType headID) { return ErrorCode::Undefined; }
@@ -173,6 +180,9 @@ namespace SPTAG
 
         private:
             void SearchIndex(COMMON::QueryResultSet<T> &p_query, COMMON::WorkSpace &p_space, bool p_searchDeleted, bool p_searchDuplicated) const;
+
+            template <typename U>
+            ErrorCode CopyIndexStructures(Index<U>* p_copy, std::vector<SizeType>& p_newToOld, const std::vector<SizeType>& p_oldToNew);
         };
     } // namespace BKT
 } // namespace SPTAG
@@ -24,6 +24,7 @@ DefineBKTParameter(m_pGraph.m_iNeighborhoodSize, DimensionType, 32L, "Neighborho
 DefineBKTParameter(m_pGraph.m_fNeighborhoodScale, float, 2.0F, "GraphNeighborhoodScale")
 DefineBKTParameter(m_pGraph.m_fCEFScale, float, 2.0F, "GraphCEFScale")
 DefineBKTParameter(m_pGraph.m_iRefineIter, int, 2L, "RefineIterations")
+DefineBKTParameter(m_pGraph.m_iNNDescentIter, int, 0L, "NNDescentIterations")
 DefineBKTParameter(m_pGraph.m_rebuild, int, 0L, "EnableRebuild")
 DefineBKTParameter(m_pGraph.m_iCEF, int, 1000L, "CEF")
 DefineBKTParameter(m_pGraph.m_iAddCEF, int, 500L, "AddCEF")
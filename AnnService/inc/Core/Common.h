@@ -56,6 +56,8 @@ inline T max(T a, T b) {
 #define mkdir(a) mkdir(a, ACCESSPERMS)
 #define InterlockedCompareExchange(a,b,c) __sync_val_compare_and_swap(a, c, b)
 #define InterlockedExchange8(a,b) __sync_lock_test_and_set(a, b)
+#define InterlockedAnd8(a,b) __sync_fetch_and_and(a, b)
+#define InterlockedOr8(a,b) __sync_fetch_and_or(a, b)
 #define Sleep(a) usleep(a * 1000)
 #define strtok_s(a, b, c) strtok_r(a, b, c)
 
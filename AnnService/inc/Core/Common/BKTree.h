@@ -16,6 +16,8 @@
 #include "WorkSpace.h"
 #include "Dataset.h"
 #include "DistanceUtils.h"
+#include "GemmKernel.h"
+#include "inc/Helper/WorkStealingPool.h"
 
 namespace SPTAG
 {
@@ -43,11 +45,13 @@ namespace SPTAG
             SizeType* counts;
             float* newCenters;
             SizeType* newCounts;
-            int* label;
+            int* label; // cluster of indices[first + i], so datasize only needs to cover the largest range clustered
             SizeType* clusterIdx;
             float* clusterDist;
             float* weightedCounts;
             float* newWeightedCounts;
+            float* centerPanels;
+            float* centerNorms;
             float(*fComputeDistance)(const T* pX, const T* pY, DimensionType length);
 
             KmeansArgs(int k, DimensionType dim, SizeType datasize, int threadnum, DistCalcMethod distMethod) : _K(k), _DK(k), _D(dim), _T(threadnum), _M(distMethod) {
@@ -61,6 +65,9 @@ namespace SPTAG
                 clusterDist = new float[threadnum * k];
                 weightedCounts = new float[k];
                 newWeightedCounts = new float[threadnum * k];
+                SizeType panelCount = (k + GemmKernel::c_panelWidth - 1) / GemmKernel::c_panelWidth * GemmKernel::c_panelWidth;
+                centerPanels = (float*)_mm_malloc(sizeof(float) * panelCount * dim, ALIGN_SPTAG);
+                centerNorms = new float[panelCount];
                 fComputeDistance = COMMON::DistanceCalcSelector<T>(distMethod);
             }
 
@@ -75,6 +82,8 @@ namespace SPTAG
                 delete[] clusterDist;
                 delete[] weightedCounts;
                 delete[] newWeightedCounts;
+                _mm_free(centerPanels);
+                delete[] centerNorms;
             }
 
             inline void ClearCounts() {
@@ -102,10 +111,11 @@ namespace SPTAG
                     if (counts[k] == 0) continue;
                     SizeType i = pos[k];
                     while (newCounts[k] > 0) {
-                        SizeType swapid = pos[label[i]] + newCounts[label[i]] - 1;
-                        newCounts[label[i]]--;
+                        int clusterid = label[i - first];
+                        SizeType swapid = pos[clusterid] + newCounts[clusterid] - 1;
+                        newCounts[clusterid]--;
                         std::swap(indices[i], indices[swapid]);
-                        std::swap(label[i], label[swapid]);
+                        std::swap(label[i - first], label[swapid - first]);
                     }
                     while (indices[i] != clusterIdx[k]) i++;
                     std::swap(indices[i], indices[pos[k] + counts[k] - 1]);
@@ -198,6 +208,61 @@ namespace SPTAG
 
 #else
 
+        // Picks the center of every point in [p_first, p_last) minimizing distance + lambda * count and
+        // returns its exact distance in p_dists. The centers are packed into panels once, and blocks of
+        // points are ranked against them with |x|^2 + |c|^2 - 2 x.c (L2) or base^2 - x.c (cosine), so
+        // only the distance to the chosen center is computed with fComputeDistance.
+        template <typename T>
+        void KmeansNearestCenters(const Dataset<T>& data, std::vector<SizeType>& indices, const SizeType p_first, const SizeType p_last,
+            KmeansArgs<T>& args, float lambda, float* p_rows, int* p_labels, float* p_dists) {
+            bool cosine = (args._M != DistCalcMethod::L2);
+            float base = (float)COMMON::Utils::GetBase<T>();
+            for (SizeType i = p_first; i < p_last; i += GemmKernel::c_rowBlock) {
+                float rowNorms[GemmKernel::c_rowBlock] = { 0 }, bestScores[GemmKernel::c_rowBlock];
+                for (int r = 0; r < GemmKernel::c_rowBlock; r++) {
+                    float* row = p_rows + (size_t)r * args._D;
+                    bestScores[r] = MaxDist;
+                    p_labels[r] = 0;
+                    if (i + r >= p_last) {
+                        memset(row, 0, sizeof(float) * args._D);
+                        continue;
+                    }
+
+                    const T* v = (const T*)data[indices[i + r]];
+                    float norm = 0;
+#pragma omp simd reduction(+:norm)
+                    for (DimensionType j = 0; j < args._D; j++) {
+                        row[j] = (float)v[j];
+                        norm += row[j] * row[j];
+                    }
+                    rowNorms[r] = norm;
+                }
+
+                for (int panel = 0; panel < args._DK; panel += GemmKernel::c_panelWidth) {
+                    float dots[GemmKernel::c_rowBlock][GemmKernel::c_panelWidth];
+                    GemmKernel::MultiplyBlock(p_rows, args.centerPanels + (size_t)panel * args._D, args._D, dots);
+
+                    int width = min(GemmKernel::c_panelWidth, args._DK - panel);
+                    for (int r = 0; r < GemmKernel::c_rowBlock; r++) {
+                        for (int c = 0; c < width; c++) {
+                            float score = (cosine ? base * base - dots[r][c] : rowNorms[r] + args.centerNorms[panel + c] - 2 * dots[r][c]) + lambda * args.counts[panel + c];
+                            if (score < bestScores[r]) {
+                                bestScores[r] = score;
+                                p_labels[r] = panel + c;
+                            }
+                        }
+                    }
+                }
+
+                for (int r = 0; r < GemmKernel::c_rowBlock && i + r < p_last; r++) {
+                    int clusterid = p_labels[r];
+                    p_dists[r] = args.fComputeDistance(data[indices[i + r]], args.centers + clusterid * args._D, args._D) + lambda * args.counts[clusterid];
+                }
+                p_labels += GemmKernel::c_rowBlock;
+                p_dists += GemmKernel::c_rowBlock;
+            }
+        }
+
         template <typename T>
         inline float KmeansAssign(const Dataset<T>& data,
             std::vector<SizeType>& indices,
@@ -206,6 +271,13 @@ namespace SPTAG
             float currDist = 0;
             SizeType subsize = (last - first - 1) / args._T + 1;
 
+            // Points are ranked a batch at a time so the chosen centers fit on the stack.
+            const int c_kmeansBatch = 64 * GemmKernel::c_rowBlock;
+
+            // Quantized codes only have ADC distances, so they keep the pairwise loop.
+            bool blocked = !DistanceUtils::Quantizer;
+            if (blocked) GemmKernel::PackPanels<T>([&](SizeType k) { return (const T*)(args.centers + k * args._D); }, args._DK, args._D, args.centerPanels, args.centerNorms);
+
 #pragma omp parallel for num_threads(args._T) shared(data, indices) reduction(+:currDist)
             for (int tid = 0; tid < args._T; tid++)
             {
@@ -217,32 +289,46 @@ namespace SPTAG
                 float * iclusterDist = args.clusterDist + tid * args._K;
                 float * iweightedCounts = args.newWeightedCounts + tid * args._K;
                 float idist = 0;
-                for (SizeType i = istart; i < iend; i++) {
-                    int clusterid = 0;
-                    float smallestDist = MaxDist;
-                    for (int k = 0; k < args._DK; k++) {
-                        float dist = args.fComputeDistance(data[indices[i]], args.centers + k*args._D, args._D) + lambda*args.counts[k];
-                        if (dist > -MaxDist && dist < smallestDist) {
-                            clusterid = k; smallestDist = dist;
+                std::vector<float> rows(blocked ? (size_t)GemmKernel::c_rowBlock * args._D : 0);
+                int labels[c_kmeansBatch];
+                float dists[c_kmeansBatch];
+                for (SizeType batch = istart; batch < iend; batch += c_kmeansBatch) {
+                    SizeType batchEnd = min(batch + c_kmeansBatch, iend);
+                    if (blocked) KmeansNearestCenters(data, indices, batch, batchEnd, args, lambda, rows.data(), labels, dists);
+
+                    for (SizeType i = batch; i < batchEnd; i++) {
+                        int clusterid = 0;
+                        float smallestDist = MaxDist;
+                        if (blocked) {
+                            clusterid = labels[i - batch];
+                            smallestDist = dists[i - batch];
                         }
-                    }
-                    args.label[i] = clusterid;
-                    inewCounts[clusterid]++;
-                    iweightedCounts[clusterid] += smallestDist;
-                    idist += smallestDist;
-                    if (updateCenters) {
-                        const T* v = (const T*)data[indices[i]];
-                        float* center = inewCenters + clusterid*args._D;
-                        for (DimensionType j = 0; j < args._D; j++) center[j] += v[j];
-                        if (smallestDist > iclusterDist[clusterid]) {
-                            iclusterDist[clusterid] = smallestDist;
-                            iclusterIdx[clusterid] = indices[i];
+                        else {
+                            for (int k = 0; k < args._DK; k++) {
+                                float dist = args.fComputeDistance(data[indices[i]], args.centers + k*args._D, args._D) + lambda*args.counts[k];
+                                if (dist > -MaxDist && dist < smallestDist) {
+                                    clusterid = k; smallestDist = dist;
+                                }
+                            }
                         }
-                    }
-                    else {
-                        if (smallestDist <= iclusterDist[clusterid]) {
-                            iclusterDist[clusterid] = smallestDist;
-                            iclusterIdx[clusterid] = indices[i];
+                        args.label[i - first] = clusterid;
+                        inewCounts[clusterid]++;
+                        iweightedCounts[clusterid] += smallestDist;
+                        idist += smallestDist;
+                        if (updateCenters) {
+                            const T* v = (const T*)data[indices[i]];
+                            float* center = inewCenters + clusterid*args._D;
+                            for (DimensionType j = 0; j < args._D; j++) center[j] += v[j];
+                            if (smallestDist > iclusterDist[clusterid]) {
+                                iclusterDist[clusterid] = smallestDist;
+                                iclusterIdx[clusterid] = indices[i];
+                            }
+                        }
+                        else {
+                            if (smallestDist <= iclusterDist[clusterid]) {
+                                iclusterDist[clusterid] = smallestDist;
+                                iclusterIdx[clusterid] = indices[i];
+                            }
                         }
                     }
                 }
@@ -479,18 +565,66 @@ namespace SPTAG
                 m_pSampleCenterMap.swap(newTrees.m_pSampleCenterMap);
             }
 
+            // Sample ids in depth-first order of the first tree, so the members of a cluster come one after
+            // another and nearby clusters stay close; samples the tree does not reach follow in id order.
+            void GetDFSOrder(SizeType p_samples, std::vector<SizeType>& p_order) const
+            {
+                std::vector<bool> visited(p_samples, false);
+                p_order.clear();
+                p_order.reserve(p_samples);
+
+                std::vector<SizeType> stack;
+                if (!m_pTreeStart.empty()) stack.push_back(m_pTreeStart[0]);
+                while (!stack.empty())
+                {
+                    const BKTNode& node = m_pTreeRoots[stack.back()];
+                    stack.pop_back();
+                    if (node.centerid >= 0 && node.centerid < p_samples && !visited[node.centerid])
+                    {
+                        visited[node.centerid] = true;
+                        p_order.push_back(node.centerid);
+                    }
+                    if (node.childEnd == -1) continue;
+
+                    SizeType childStart = (node.childStart < 0) ? -node.childStart : node.childStart;
+                    for (SizeType child = node.childEnd - 1; child >= childStart; child--) stack.push_back(child);
+                }
+
+                for (SizeType i = 0; i < p_samples; i++)
+                {
+                    if (!visited[i]) p_order.push_back(i);
+                }
+            }
+
+            // Copies the trees of p_other with every sample id x renumbered to p_oldToNew[x].
+            void Remap(const BKTree& p_other, const std::vector<SizeType>& p_oldToNew)
+            {
+                SizeType samples = (SizeType)p_oldToNew.size();
+                std::unique_lock<std::shared_timed_mutex> lock(*m_lock);
+                m_pTreeStart = p_other.m_pTreeStart;
+                m_pTreeRoots = p_other.m_pTreeRoots;
+                for (BKTNode& node : m_pTreeRoots)
+                {
+                    if (node.centerid >= 0 && node.centerid < samples) node.centerid = p_oldToNew[node.centerid];
+                }
+
+                m_pSampleCenterMap.clear();
+                for (const auto& sample : p_other.m_pSampleCenterMap)
+                {
+                    if (sample.first < 0) m_pSampleCenterMap[-1 - p_oldToNew[-1 - sample.first]] = sample.second;
+                    else m_pSampleCenterMap[p_oldToNew[sample.first]] = p_oldToNew[sample.second];
+                }
+            }
+
+            // Nodes larger than data.R() / (4 * numOfThreads) are clustered one at a time with all threads.
+            // The smaller subtrees below them are built concurrently on a work-stealing pool, each one
+            // into its own node array, and spliced into m_pTreeRoots in the order they were spawned,
+            // so the node numbering does not depend on how the subtrees were scheduled.
             template <typename T>
             void BuildTrees(const Dataset<T>& data, DistCalcMethod distMethod, int numOfThreads, 
                 std::vector<SizeType>* indices = nullptr, std::vector<SizeType>* reverseIndices = nullptr, 
                 bool dynamicK = false, IAbortOperation* abort = nullptr)
             {
-                struct  BKTStackItem {
-                    SizeType index, first, last;
-                    bool debug;
-                    BKTStackItem(SizeType index_, SizeType first_, SizeType last_, bool debug_ = false) : index(index_), first(first_), last(last_), debug(debug_) {}
-                };
-                std::stack<BKTStackItem> ss;
-
                 std::vector<SizeType> localindices;
                 if (indices == nullptr) {
                     localindices.resize(data.R());
@@ -503,6 +637,9 @@ namespace SPTAG
 
                 if (m_fBalanceFactor < 0) m_fBalanceFactor = DynamicFactorSelect(data, localindices, 0, (SizeType)localindices.size(), args, m_iSamples);
 
+                SizeType taskSize = max((SizeType)m_iBKTLeafSize, (SizeType)(localindices.size() / (4 * max(numOfThreads, 1))));
+                std::vector<std::unique_ptr<KmeansArgs<T>>> workerArgs(max(numOfThreads, 1));
+
                 m_pSampleCenterMap.clear();
                 for (char i = 0; i < m_iTreeNumber; i++)
                 {
@@ -512,52 +649,21 @@ namespace SPTAG
                     m_pTreeRoots.emplace_back((SizeType)localindices.size());
                     LOG(Helper::LogLevel::LL_Info, "Start to build BKTree %d\n", i + 1);
 
-                    ss.push(BKTStackItem(m_pTreeStart[i], 0, (SizeType)localindices.size(), true));
-                    while (!ss.empty()) {
-                        if (abort && abort->ShouldAbort()) return;
-
-                        BKTStackItem item = ss.top(); ss.pop();
-                        SizeType newBKTid = (SizeType)m_pTreeRoots.size();
-                        m_pTreeRoots[item.index].childStart = newBKTid;
-                        if (item.last - item.first <= m_iBKTLeafSize) {
-                            for (SizeType j = item.first; j < item.last; j++) {
-                                SizeType cid = (reverseIndices == nullptr)? localindices[j]: reverseIndices->at(localindices[j]);
-                                m_pTreeRoots.emplace_back(cid);
-                            }
-                        }
-                        else { // clustering the data into BKTKmeansK clusters
-                            if (dynamicK) {
-                                args._DK = std::min<int>((item.last - item.first) / m_iBKTLeafSize + 1, m_iBKTKmeansK);
-                                args._DK = std::max<int>(args._DK, 2);
-                            }
+                    BuildTask root(0, (SizeType)localindices.size(), true, m_pTreeRoots.back());
+                    std::vector<BuildTask*> subtrees;
+                    BuildSubtree(data, localindices, reverseIndices, dynamicK, args, root, m_iBKTLeafSize, taskSize,
+                        [&subtrees](BuildTask* p_task) { subtrees.push_back(p_task); }, abort);
+                    if (abort && abort->ShouldAbort()) return;
 
-                            int numClusters = KmeansClustering(data, localindices, item.first, item.last, args, m_iSamples, m_fBalanceFactor, item.debug, abort);
-                            if (numClusters <= 1) {
-                                SizeType end = min(item.last + 1, (SizeType)localindices.size());
-                                std::sort(localindices.begin() + item.first, localindices.begin() + end);
-                                m_pTreeRoots[item.index].centerid = (reverseIndices == nullptr) ? localindices[item.first] : reverseIndices->at(localindices[item.first]);
-                                m_pTreeRoots[item.index].childStart = -m_pTreeRoots[item.index].childStart;
-                                for (SizeType j = item.first + 1; j < end; j++) {
-                                    SizeType cid = (reverseIndices == nullptr) ? localindices[j] : reverseIndices->at(localindices[j]);
-                                    m_pTreeRoots.emplace_back(cid);
-                                    m_pSampleCenterMap[cid] = m_pTreeRoots[item.index].centerid;
-                                }
-                                m_pSampleCenterMap[-1 - m_pTreeRoots[item.index].centerid] = item.index;
-                            }
-                            else {
-                                SizeType maxCount = 0;
-                                for (int k = 0; k < m_iBKTKmeansK; k++) if (args.counts[k] > maxCount) maxCount = args.counts[k];
-                                for (int k = 0; k < m_iBKTKmeansK; k++) {
-                                    if (args.counts[k] == 0) continue;
-                                    SizeType cid = (reverseIndices == nullptr) ? localindices[item.first + args.counts[k] - 1] : reverseIndices->at(localindices[item.first + args.counts[k] - 1]);
-                                    m_pTreeRoots.emplace_back(cid);
-                                    if (args.counts[k] > 1) ss.push(BKTStackItem(newBKTid++, item.first, item.first + args.counts[k] - 1, item.debug && (args.counts[k] == maxCount)));
-                                    item.first += args.counts[k];
-                                }
-                            }
-                        }
-                        m_pTreeRoots[item.index].childEnd = (SizeType)m_pTreeRoots.size();
+                    Helper::WorkStealingPool pool(numOfThreads);
+                    for (size_t j = 0; j < subtrees.size(); j++)
+                    {
+                        pool.Spawn((int)j, [&, j](int p_worker) { BuildSubtreeTask(data, localindices, reverseIndices, dynamicK, distMethod, taskSize, workerArgs, pool, subtrees[j], p_worker, abort); });
                     }
+                    pool.Run();
+                    if (abort && abort->ShouldAbort()) return;
+
+                    Splice(root, m_pTreeStart[i]);
                     m_pTreeRoots.emplace_back(-1);
                     LOG(Helper::LogLevel::LL_Info, "%d BKTree built, %zu %zu\n", i + 1, m_pTreeRoots.size() - m_pTreeStart[i], localindices.size());
                 }
@@ -723,6 +829,135 @@ namespace SPTAG
             }
 
         private:
+            // A subtree built apart from m_pTreeRoots. nodes[0] is its root, and child and sample map
+            // indices refer to positions in nodes until the subtree is spliced.
+            struct BuildTask
+            {
+                SizeType first, last;
+                bool debug;
+                std::vector<BKTNode> nodes;
+                std::vector<std::pair<SizeType, SizeType>> sampleCenters;
+                std::vector<std::pair<SizeType, std::unique_ptr<BuildTask>>> subtasks;
+
+                BuildTask(SizeType first_, SizeType last_, bool debug_, const BKTNode& root) : first(first_), last(last_), debug(debug_), nodes(1, root) {}
+            };
+
+            // Children with more than p_spawnMin and at most p_spawnMax vectors are handed to p_spawn
+            // as new tasks; the others are built here.
+            template <typename T>
+            void BuildSubtree(const Dataset<T>& data, std::vector<SizeType>& localindices, std::vector<SizeType>* reverseIndices, bool dynamicK,
+                KmeansArgs<T>& args, BuildTask& task, SizeType p_spawnMin, SizeType p_spawnMax, const std::function<void(BuildTask*)>& p_spawn, IAbortOperation* abort)
+            {
+                struct  BKTStackItem {
+                    SizeType index, first, last;
+                    bool debug;
+                    BKTStackItem(SizeType index_, SizeType first_, SizeType last_, bool debug_ = false) : index(index_), first(first_), last(last_), debug(debug_) {}
+                };
+                std::stack<BKTStackItem> ss;
+                std::vector<BKTNode>& nodes = task.nodes;
+
+                ss.push(BKTStackItem(0, task.first, task.last, task.debug));
+                while (!ss.empty()) {
+                    if (abort && abort->ShouldAbort()) return;
+
+                    BKTStackItem item = ss.top(); ss.pop();
+                    SizeType newBKTid = (SizeType)nodes.size();
+                    nodes[item.index].childStart = newBKTid;
+                    if (item.last - item.first <= m_iBKTLeafSize) {
+                        for (SizeType j = item.first; j < item.last; j++) {
+                            SizeType cid = (reverseIndices == nullptr)? localindices[j]: reverseIndices->at(localindices[j]);
+                            nodes.emplace_back(cid);
+                        }
+                    }
+                    else { // clustering the data into BKTKmeansK clusters
+                        if (dynamicK) {
+                            args._DK = std::min<int>((item.last - item.first) / m_iBKTLeafSize + 1, m_iBKTKmeansK);
+                            args._DK = std::max<int>(args._DK, 2);
+                        }
+
+                        int numClusters = KmeansClustering(data, localindices, item.first, item.last, args, m_iSamples, m_fBalanceFactor, item.debug, abort);
+                        if (numClusters <= 1) {
+                            SizeType end = min(item.last + 1, (SizeType)localindices.size());
+                            std::sort(localindices.begin() + item.first, localindices.begin() + end);
+                            nodes[item.index].centerid = (reverseIndices == nullptr) ? localindices[item.first] : reverseIndices->at(localindices[item.first]);
+                            nodes[item.index].childStart = -nodes[item.index].childStart;
+                            for (SizeType j = item.first + 1; j < end; j++) {
+                                SizeType cid = (reverseIndices == nullptr) ? localindices[j] : reverseIndices->at(localindices[j]);
+                                nodes.emplace_back(cid);
+                                task.sampleCenters.emplace_back(cid, nodes[item.index].centerid);
+                            }
+                            task.sampleCenters.emplace_back(-1 - nodes[item.index].centerid, item.index);
+                        }
+                        else {
+                            SizeType maxCount = 0;
+                            for (int k = 0; k < m_iBKTKmeansK; k++) if (args.counts[k] > maxCount) maxCount = args.counts[k];
+                            for (int k = 0; k < m_iBKTKmeansK; k++) {
+                                if (args.counts[k] == 0) continue;
+                                SizeType cid = (reverseIndices == nullptr) ? localindices[item.first + args.counts[k] - 1] : reverseIndices->at(localindices[item.first + args.counts[k] - 1]);
+                                nodes.emplace_back(cid);
+                                SizeType child = (SizeType)nodes.size() - 1, childSize = args.counts[k] - 1;
+                                bool childDebug = item.debug && (args.counts[k] == maxCount);
+                                if (childSize > p_spawnMin && childSize <= p_spawnMax) {
+                                    task.subtasks.emplace_back(child, std::unique_ptr<BuildTask>(new BuildTask(item.first, item.first + childSize, childDebug, nodes.back())));
+                                    p_spawn(task.subtasks.back().second.get());
+                                }
+                                else if (childSize > 0) {
+                                    ss.push(BKTStackItem(child, item.first, item.first + childSize, childDebug));
+                                }
+                                item.first += args.counts[k];
+                            }
+                        }
+                    }
+                    nodes[item.index].childEnd = (SizeType)nodes.size();
+                }
+            }
+
+            // Subtrees smaller than the k-means sample are cheap, so they are not split into further tasks.
+            template <typename T>
+            void BuildSubtreeTask(const Dataset<T>& data, std::vector<SizeType>& localindices, std::vector<SizeType>* reverseIndices, bool dynamicK,
+                DistCalcMethod distMethod, SizeType taskSize, std::vector<std::unique_ptr<KmeansArgs<T>>>& workerArgs,
+                Helper::WorkStealingPool& pool, BuildTask* task, int p_worker, IAbortOperation* abort)
+            {
+                if (abort && abort->ShouldAbort()) return;
+
+                if (workerArgs[p_worker] == nullptr) workerArgs[p_worker].reset(new KmeansArgs<T>(m_iBKTKmeansK, data.C(), taskSize, 1, distMethod));
+                BuildSubtree(data, localindices, reverseIndices, dynamicK, *workerArgs[p_worker], *task, max((SizeType)m_iSamples, (SizeType)m_iBKTLeafSize), taskSize,
+                    [&](BuildTask* p_task) {
+                        pool.Spawn(p_worker, [this, &data, &localindices, reverseIndices, dynamicK, distMethod, taskSize, &workerArgs, &pool, p_task, abort](int p_nextWorker) {
+                            BuildSubtreeTask(data, localindices, reverseIndices, dynamicK, distMethod, taskSize, workerArgs, pool, p_task, p_nextWorker, abort);
+                        });
+                    }, abort);
+            }
+
+            // Moves the root of p_task to p_rootIndex and appends the rest of its nodes, then its subtasks in spawn order.
+            void Splice(BuildTask& p_task, SizeType p_rootIndex)
+            {
+                SizeType offset = (SizeType)m_pTreeRoots.size() - 1;
+                auto position = [&](SizeType p_local) { return (p_local == 0) ? p_rootIndex : p_local + offset; };
+
+                for (SizeType i = 0; i < (SizeType)p_task.nodes.size(); i++)
+                {
+                    BKTNode node = p_task.nodes[i];
+                    if (node.childEnd != -1)
+                    {
+                        node.childStart = (node.childStart >= 0) ? node.childStart + offset : node.childStart - offset;
+                        node.childEnd += offset;
+                    }
+                    if (i == 0) m_pTreeRoots[p_rootIndex] = node;
+                    else m_pTreeRoots.push_back(node);
+                }
+
+                for (auto& sample : p_task.sampleCenters)
+                {
+                    m_pSampleCenterMap[sample.first] = (sample.first < 0) ? position(sample.second) : sample.second;
+                }
+
+                for (auto& subtask : p_task.subtasks)
+                {
+                    Splice(*subtask.second, position(subtask.first));
+                }
+            }
+
             std::vector<SizeType> m_pTreeStart;
             std::vector<BKTNode> m_pTreeRoots;
             std::unordered_map<SizeType, SizeType> m_pSampleCenterMap;
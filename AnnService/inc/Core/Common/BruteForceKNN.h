@@ -0,0 +1,170 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef _SPTAG_COMMON_BRUTEFORCEKNN_H_
+#define _SPTAG_COMMON_BRUTEFORCEKNN_H_
+
+#include "../VectorSet.h"
+#include "DistanceUtils.h"
+#include "GemmKernel.h"
+#include "QueryResultSet.h"
+
+#include <omp.h>
+#include <vector>
+
+namespace SPTAG
+{
+    namespace COMMON
+    {
+        // Exact k nearest neighbors laid out like a blocked GEMM. Tiles of base vectors are packed
+        // into dimension-major float panels and multiplied against blocks of queries, so each
+        // panel stays in cache while it is reused by a whole query tile. L2 is ranked through
+        // |q|^2 + |x|^2 - 2 q.x and cosine through -q.x; every query keeps a few spare candidates
+        // which are then re-ranked with DistanceUtils, so the returned distances are exact.
+        class BruteForceKNN
+        {
+        public:
+            template <typename T>
+            static void Search(std::shared_ptr<VectorSet> p_querySet, std::shared_ptr<VectorSet> p_vectorSet, DistCalcMethod p_distMethod, int p_K,
+                std::vector<std::vector<SizeType>>& p_ids, std::vector<std::vector<float>>& p_dists)
+            {
+                SizeType queryCount = p_querySet->Count(), vectorCount = p_vectorSet->Count();
+                DimensionType dim = p_vectorSet->Dimension();
+                p_ids.assign(queryCount, std::vector<SizeType>(p_K, -1));
+                p_dists.assign(queryCount, std::vector<float>(p_K, MaxDist));
+                if (queryCount == 0 || vectorCount == 0 || p_K <= 0) return;
+
+                // Quantized codes only have ADC distances, and for a handful of queries packing the
+                // base set costs more than it saves.
+                if (DistanceUtils::Quantizer || queryCount < 2 * c_queryBlock)
+                {
+                    SearchByPair<T>(p_querySet, p_vectorSet, p_distMethod, p_K, p_ids, p_dists);
+                    return;
+                }
+
+                bool cosine = (p_distMethod == DistCalcMethod::Cosine);
+                int candidateNum = p_K + max(p_K, 16);
+                SizeType queryTiles = (queryCount + c_queryTile - 1) / c_queryTile;
+                SizeType vectorTiles = (vectorCount + c_vectorTile - 1) / c_vectorTile;
+
+                // Split the base set as well when there are too few query tiles to keep every thread busy.
+                SizeType segments = min(vectorTiles, max((SizeType)1, (SizeType)(2 * omp_get_max_threads() + queryTiles - 1) / queryTiles));
+                SizeType segmentSize = ((vectorTiles + segments - 1) / segments) * c_vectorTile;
+                segments = (vectorCount + segmentSize - 1) / segmentSize;
+
+                SizeType paddedQueryCount = queryTiles * c_queryTile;
+                std::vector<float> queries((size_t)paddedQueryCount * dim, 0), queryNorms(paddedQueryCount, 0);
+#pragma omp parallel for
+                for (SizeType i = 0; i < queryCount; i++)
+                {
+                    const T* query = (const T*)p_querySet->GetVector(i);
+                    float* packed = queries.data() + (size_t)i * dim;
+                    for (DimensionType d = 0; d < dim; d++)
+                    {
+                        packed[d] = (float)query[d];
+                        queryNorms[i] += packed[d] * packed[d];
+                    }
+                }
+
+                std::vector<QueryResultSet<T>> candidates;
+                candidates.reserve((size_t)segments * queryCount);
+                for (size_t i = 0; i < (size_t)segments * queryCount; i++) candidates.emplace_back(nullptr, candidateNum);
+
+#pragma omp parallel
+                {
+                    std::vector<float> panels((size_t)c_vectorTile * dim), vectorNorms(c_vectorTile);
+
+#pragma omp for schedule(dynamic)
+                    for (SizeType item = 0; item < queryTiles * segments; item++)
+                    {
+                        SizeType queryBegin = (item / segments) * c_queryTile;
+                        SizeType segment = item % segments;
+                        SizeType segmentEnd = min(vectorCount, (segment + 1) * segmentSize);
+                        QueryResultSet<T>* results = candidates.data() + (size_t)segment * queryCount;
+
+                        for (SizeType tileBegin = segment * segmentSize; tileBegin < segmentEnd; tileBegin += c_vectorTile)
+                        {
+                            SizeType tileCount = min(c_vectorTile, segmentEnd - tileBegin);
+                            GemmKernel::PackPanels<T>([&](SizeType i) { return (const T*)p_vectorSet->GetVector(tileBegin + i); }, tileCount, dim, panels.data(), vectorNorms.data());
+
+                            for (SizeType q = queryBegin; q < min(queryBegin + c_queryTile, queryCount); q += c_queryBlock)
+                            {
+                                for (SizeType panel = 0; panel < tileCount; panel += c_vectorBlock)
+                                {
+                                    float dots[c_queryBlock][c_vectorBlock];
+                                    GemmKernel::MultiplyBlock(queries.data() + (size_t)q * dim, panels.data() + (size_t)panel * dim, dim, dots);
+
+                                    for (int r = 0; r < c_queryBlock && q + r < queryCount; r++)
+                                    {
+                                        for (int c = 0; c < c_vectorBlock && panel + c < tileCount; c++)
+                                        {
+                                            float score = cosine ? -dots[r][c] : queryNorms[q + r] + vectorNorms[panel + c] - 2 * dots[r][c];
+                                            results[q + r].AddPoint(tileBegin + panel + c, score);
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+
+#pragma omp parallel for schedule(dynamic)
+                for (SizeType i = 0; i < queryCount; i++)
+                {
+                    QueryResultSet<T> query((const T*)p_querySet->GetVector(i), p_K);
+                    for (SizeType segment = 0; segment < segments; segment++)
+                    {
+                        QueryResultSet<T>& segmentResults = candidates[(size_t)segment * queryCount + i];
+                        for (int j = 0; j < candidateNum; j++)
+                        {
+                            SizeType vid = segmentResults.GetResult(j)->VID;
+                            if (vid < 0) continue;
+                            query.AddPoint(vid, DistanceUtils::ComputeDistance(query.GetTarget(), (const T*)p_vectorSet->GetVector(vid), dim, p_distMethod));
+                        }
+                    }
+                    query.SortResult();
+
+                    for (int k = 0; k < p_K; k++)
+                    {
+                        p_ids[i][k] = query.GetResult(k)->VID;
+                        p_dists[i][k] = query.GetResult(k)->Dist;
+                    }
+                }
+            }
+
+        private:
+            static const int c_queryBlock = GemmKernel::c_rowBlock;
+
+            static const int c_vectorBlock = GemmKernel::c_panelWidth;
+
+            static const SizeType c_queryTile = 64;
+
+            static const SizeType c_vectorTile = 2048;
+
+            template <typename T>
+            static void SearchByPair(std::shared_ptr<VectorSet>& p_querySet, std::shared_ptr<VectorSet>& p_vectorSet, DistCalcMethod p_distMethod, int p_K,
+                std::vector<std::vector<SizeType>>& p_ids, std::vector<std::vector<float>>& p_dists)
+            {
+#pragma omp parallel for
+                for (SizeType i = 0; i < p_querySet->Count(); ++i)
+                {
+                    QueryResultSet<T> query((const T*)(p_querySet->GetVector(i)), p_K);
+                    for (SizeType j = 0; j < p_vectorSet->Count(); j++)
+                    {
+                        float dist = DistanceUtils::ComputeDistance(query.GetQuantizedTarget(), reinterpret_cast<T*>(p_vectorSet->GetVector(j)), p_vectorSet->Dimension(), p_distMethod);
+                        query.AddPoint(j, dist);
+                    }
+                    query.SortResult();
+
+                    for (int k = 0; k < p_K; k++)
+                    {
+                        p_ids[i][k] = (query.GetResult(k))->VID;
+                        p_dists[i][k] = (query.GetResult(k))->Dist;
+                    }
+                }
+            }
+        };
+    }
+}
+
+#endif // _SPTAG_COMMON_BRUTEFORCEKNN_H_
@@ -4,11 +4,16 @@
 #ifndef _SPTAG_COMMON_DATASET_H_
 #define _SPTAG_COMMON_DATASET_H_
 
+#include <atomic>
+
 namespace SPTAG
 {
     namespace COMMON
     {
         // structure to save Data and Graph
+        // Rows added after Initialize live in fixed size blocks found through a two-level directory.
+        // The top level is sized for the capacity up front, the second level and the blocks are only
+        // allocated as rows are added, so readers can keep indexing without locks while the data grows.
         template <typename T>
         class Dataset
         {
@@ -18,11 +23,45 @@ namespace SPTAG
             DimensionType cols = 1;
             T* data = nullptr;
             bool ownData = false;
-            SizeType incRows = 0;
+            std::atomic<SizeType> incRows{0};
             SizeType maxRows;
             SizeType rowsInBlock;
             SizeType rowsInBlockEx;
-            std::vector<T*> incBlocks;
+            SizeType blocksInDirEx = 0;
+            SizeType incBlockCount = 0;
+            std::vector<std::atomic<T**>> incDirs;
+
+            inline T* IncBlock(SizeType blockIdx) const
+            {
+                return incDirs[blockIdx >> blocksInDirEx].load(std::memory_order_acquire)[blockIdx & ((1 << blocksInDirEx) - 1)];
+            }
+
+            ErrorCode EnsureBlocks(SizeType blockNum)
+            {
+                while (incBlockCount < blockNum) {
+                    SizeType dirIdx = incBlockCount >> blocksInDirEx;
+                    if (dirIdx >= (SizeType)incDirs.size()) return ErrorCode::MemoryOverFlow;
+                    T** dir = incDirs[dirIdx].load(std::memory_order_relaxed);
+                    if (dir == nullptr) {
+                        dir = new (std::nothrow) T*[((size_t)1) << blocksInDirEx]();
+                        if (dir == nullptr) return ErrorCode::MemoryOverFlow;
+                        incDirs[dirIdx].store(dir, std::memory_order_release);
+                    }
+                    T* newBlock = (T*)_mm_malloc(sizeof(T) * (rowsInBlock + 1) * cols, ALIGN_SPTAG);
+                    if (newBlock == nullptr) return ErrorCode::MemoryOverFlow;
+                    dir[incBlockCount & ((1 << blocksInDirEx) - 1)] = newBlock;
+                    incBlockCount++;
+                }
+                return ErrorCode::Success;
+            }
+
+            void ReleaseBlocks()
+            {
+                for (SizeType i = 0; i < incBlockCount; i++) _mm_free(IncBlock(i));
+                for (auto& dir : incDirs) delete[] dir.load();
+                incDirs.clear();
+                incBlockCount = 0;
+            }
 
         public:
             Dataset() {}
@@ -34,14 +73,15 @@ namespace SPTAG
             ~Dataset()
             {
                 if (ownData) _mm_free(data);
-                for (T* ptr : incBlocks) _mm_free(ptr);
-                incBlocks.clear();
+                ReleaseBlocks();
             }
             void Initialize(SizeType rows_, DimensionType cols_, SizeType rowsInBlock_, SizeType capacity_, T* data_ = nullptr, bool transferOnwership_ = true)
             {
+                ReleaseBlocks();
                 rows = rows_;
                 cols = cols_;
                 data = data_;
+                incRows = 0;
                 if (data_ == nullptr || !transferOnwership_)
                 {
                     ownData = true;
@@ -52,7 +92,10 @@ namespace SPTAG
                 maxRows = capacity_;
                 rowsInBlockEx = static_cast<SizeType>(ceil(log2(rowsInBlock_)));
                 rowsInBlock = (1 << rowsInBlockEx) - 1;
-                incBlocks.reserve((static_cast<std::int64_t>(capacity_) + rowsInBlock) >> rowsInBlockEx);
+
+                std::int64_t maxBlocks = max((static_cast<std::int64_t>(capacity_) + rowsInBlock) >> rowsInBlockEx, (std::int64_t)1);
+                blocksInDirEx = (static_cast<SizeType>(ceil(log2(maxBlocks))) + 1) / 2;
+                incDirs = std::vector<std::atomic<T**>>((size_t)((maxBlocks + (1 << blocksInDirEx) - 1) >> blocksInDirEx));
             }
             void SetName(const std::string& name_) { name = name_; }
             const std::string& Name() const { return name; }
@@ -67,7 +110,7 @@ namespace SPTAG
                     incRows = 0;
                 }
             }
-            inline SizeType R() const { return rows + incRows; }
+            inline SizeType R() const { return rows + incRows.load(std::memory_order_acquire); }
             inline DimensionType C() const { return cols; }
             inline std::uint64_t BufferSize() const { return sizeof(SizeType) + sizeof(DimensionType) + sizeof(T) * R() * C(); }
 
@@ -75,7 +118,7 @@ namespace SPTAG
             {
                 if (index >= rows) {
                     SizeType incIndex = index - rows;
-                    return incBlocks[incIndex >> rowsInBlockEx] + ((size_t)(incIndex & rowsInBlock)) * cols;
+                    return IncBlock(incIndex >> rowsInBlockEx) + ((size_t)(incIndex & rowsInBlock)) * cols;
                 }
                 return data + ((size_t)index) * cols;
             }
@@ -94,20 +137,19 @@ namespace SPTAG
             {
                 if (R() > maxRows - num) return ErrorCode::MemoryOverFlow;
 
+                SizeType curRows = incRows.load(std::memory_order_relaxed);
+                ErrorCode ret = EnsureBlocks((curRows + num + rowsInBlock) >> rowsInBlockEx);
+                if (ret != ErrorCode::Success) return ret;
+
                 SizeType written = 0;
                 while (written < num) {
-                    SizeType curBlockIdx = ((incRows + written) >> rowsInBlockEx);
-                    if (curBlockIdx >= (SizeType)incBlocks.size()) {
-                        T* newBlock = (T*)_mm_malloc(((size_t)rowsInBlock + 1) * cols * sizeof(T), ALIGN_SPTAG);
-                        if (newBlock == nullptr) return ErrorCode::MemoryOverFlow;
-                        incBlocks.push_back(newBlock);
-                    }
-                    SizeType curBlockPos = ((incRows + written) & rowsInBlock);
+                    SizeType curBlockIdx = ((curRows + written) >> rowsInBlockEx);
+                    SizeType curBlockPos = ((curRows + written) & rowsInBlock);
                     SizeType toWrite = min(rowsInBlock + 1 - curBlockPos, num - written);
-                    std::memcpy(incBlocks[curBlockIdx] + ((size_t)curBlockPos) * cols, pData + ((size_t)written) * cols, ((size_t)toWrite) * cols * sizeof(T));
+                    std::memcpy(IncBlock(curBlockIdx) + ((size_t)curBlockPos) * cols, pData + ((size_t)written) * cols, ((size_t)toWrite) * cols * sizeof(T));
                     written += toWrite;
                 }
-                incRows += written;
+                incRows.store(curRows + written, std::memory_order_release);
                 return ErrorCode::Success;
             }
 
@@ -115,18 +157,20 @@ namespace SPTAG
             {
                 if (R() > maxRows - num) return ErrorCode::MemoryOverFlow;
 
+                SizeType curRows = incRows.load(std::memory_order_relaxed);
+                ErrorCode ret = EnsureBlocks((curRows + num + rowsInBlock) >> rowsInBlockEx);
+                if (ret != ErrorCode::Success) return ret;
+
+                // the current block may hold rows dropped by SetR or never written, so reset them as well
                 SizeType written = 0;
                 while (written < num) {
-                    SizeType curBlockIdx = (incRows + written) >> rowsInBlockEx;
-                    if (curBlockIdx >= (SizeType)incBlocks.size()) {
-                        T* newBlock = (T*)_mm_malloc(sizeof(T) * (rowsInBlock + 1) * cols, ALIGN_SPTAG);
-                        if (newBlock == nullptr) return ErrorCode::MemoryOverFlow;
-                        std::memset(newBlock, -1, sizeof(T) * (rowsInBlock + 1) * cols);
-                        incBlocks.push_back(newBlock);
-                    }
-                    written += min(rowsInBlock + 1 - ((incRows + written) & rowsInBlock), num - written);
+                    SizeType curBlockIdx = ((curRows + written) >> rowsInBlockEx);
+                    SizeType curBlockPos = ((curRows + written) & rowsInBlock);
+                    SizeType toWrite = min(rowsInBlock + 1 - curBlockPos, num - written);
+                    std::memset(IncBlock(curBlockIdx) + ((size_t)curBlockPos) * cols, -1, ((size_t)toWrite) * cols * sizeof(T));
+                    written += toWrite;
                 }
-                incRows += written;
+                incRows.store(curRows + num, std::memory_order_release);
                 return ErrorCode::Success;
             }
 
@@ -137,12 +181,13 @@ namespace SPTAG
                 IOBINARY(p_out, WriteBinary, sizeof(DimensionType), (char*)&cols);
                 IOBINARY(p_out, WriteBinary, sizeof(T) * cols * rows, (char*)data);
 
-                SizeType blocks = (incRows >> rowsInBlockEx);
+                SizeType curIncRows = incRows.load();
+                SizeType blocks = (curIncRows >> rowsInBlockEx);
                 for (int i = 0; i < blocks; i++)
-                    IOBINARY(p_out, WriteBinary, sizeof(T) * cols * (rowsInBlock + 1), (char*)incBlocks[i]);
+                    IOBINARY(p_out, WriteBinary, sizeof(T) * cols * (rowsInBlock + 1), (char*)IncBlock(i));
 
-                SizeType remain = (incRows & rowsInBlock);
-                if (remain > 0) IOBINARY(p_out, WriteBinary, sizeof(T) * cols * remain, (char*)incBlocks[blocks]);
+                SizeType remain = (curIncRows & rowsInBlock);
+                if (remain > 0) IOBINARY(p_out, WriteBinary, sizeof(T) * cols * remain, (char*)IncBlock(blocks));
                 LOG(Helper::LogLevel::LL_Info, "Save %s (%d,%d) Finish!\n", name.c_str(), CR, cols);
                 return ErrorCode::Success;
             }
@@ -193,7 +238,7 @@ namespace SPTAG
             ErrorCode Refine(const std::vector<SizeType>& indices, Dataset<T>& data) const
             {
                 SizeType R = (SizeType)(indices.size());
-                data.Initialize(R, cols, rowsInBlock + 1, static_cast<SizeType>(incBlocks.capacity() * (rowsInBlock + 1)));
+                data.Initialize(R, cols, rowsInBlock + 1, maxRows);
                 for (SizeType i = 0; i < R; i++) {
                     std::memcpy((void*)data.At(i), (void*)this->At(indices[i]), sizeof(T) * cols);
                 }
@@ -0,0 +1,79 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef _SPTAG_COMMON_GEMMKERNEL_H_
+#define _SPTAG_COMMON_GEMMKERNEL_H_
+
+#include "../Common.h"
+
+namespace SPTAG
+{
+    namespace COMMON
+    {
+        // Blocked dot products between row vectors and panels of packed vectors, the building block of
+        // the GEMM-style distance computations. A panel holds c_panelWidth vectors stored dimension-major,
+        // so one pass over the dimension updates a c_rowBlock x c_panelWidth block of dot products that
+        // stays in registers.
+        class GemmKernel
+        {
+        public:
+            static const int c_rowBlock = 4;
+
+            static const int c_panelWidth = 16;
+
+            // Packs p_count vectors, returned by p_vector(i), into ceil(p_count / c_panelWidth) zero padded
+            // panels and stores their squared norms.
+            template <typename T, typename Getter>
+            static void PackPanels(Getter p_vector, SizeType p_count, DimensionType p_dim, float* p_panels, float* p_norms)
+            {
+                for (SizeType panel = 0; panel < p_count; panel += c_panelWidth)
+                {
+                    float* packed = p_panels + (size_t)panel * p_dim;
+                    for (int c = 0; c < c_panelWidth; c++)
+                    {
+                        if (panel + c >= p_count)
+                        {
+                            for (DimensionType d = 0; d < p_dim; d++) packed[d * c_panelWidth + c] = 0;
+                            continue;
+                        }
+
+                        const T* vector = p_vector(panel + c);
+                        float norm = 0;
+#pragma omp simd reduction(+:norm)
+                        for (DimensionType d = 0; d < p_dim; d++)
+                        {
+                            float value = (float)vector[d];
+                            packed[d * c_panelWidth + c] = value;
+                            norm += value * value;
+                        }
+                        p_norms[panel + c] = norm;
+                    }
+                }
+            }
+
+            // p_rows holds c_rowBlock row vectors of p_dim floats one after another. The sums are kept in a
+            // local block, which the compiler can hold in registers since it cannot alias the inputs.
+            static inline void MultiplyBlock(const float* p_rows, const float* p_panel, DimensionType p_dim, float p_dots[c_rowBlock][c_panelWidth])
+            {
+                float sums[c_rowBlock][c_panelWidth] = { { 0 } };
+                for (DimensionType d = 0; d < p_dim; d++)
+                {
+                    const float* column = p_panel + d * c_panelWidth;
+                    for (int r = 0; r < c_rowBlock; r++)
+                    {
+                        float value = p_rows[(size_t)r * p_dim + d];
+#pragma omp simd
+                        for (int c = 0; c < c_panelWidth; c++) sums[r][c] += value * column[c];
+                    }
+                }
+
+                for (int r = 0; r < c_rowBlock; r++)
+                {
+                    for (int c = 0; c < c_panelWidth; c++) p_dots[r][c] = sums[r][c];
+                }
+            }
+        };
+    }
+}
+
+#endif // _SPTAG_COMMON_GEMMKERNEL_H_
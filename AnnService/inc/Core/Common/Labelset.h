@@ -11,35 +11,55 @@ namespace SPTAG
 {
     namespace COMMON
     {
+        // One bit per id. A set bit marks a live id so that blocks added with the
+        // default -1 fill start out live; inserting a label clears the bit.
+        // On disk every id still takes one byte (1 for labeled) to keep the index format unchanged.
         class Labelset
         {
         private:
             std::atomic<SizeType> m_inserted;
-            Dataset<std::int8_t> m_data;
-            
+            std::atomic<SizeType> m_size;
+            Dataset<std::uint8_t> m_data;
+
+            static inline SizeType Bytes(SizeType num) { return (SizeType)((static_cast<std::int64_t>(num) + 7) >> 3); }
+
+            inline ErrorCode LoadBytes(const std::uint8_t* labels, SizeType begin, SizeType num)
+            {
+                for (SizeType i = 0; i < num; i++) {
+                    if (labels[i] == 1) {
+                        SizeType key = begin + i;
+                        *m_data[key >> 3] &= (std::uint8_t)~(1 << (key & 7));
+                    }
+                }
+                return ErrorCode::Success;
+            }
+
         public:
-            Labelset() 
+            Labelset()
             {
                 m_inserted = 0;
+                m_size = 0;
                 m_data.SetName("DeleteID");
             }
 
             void Initialize(SizeType size, SizeType blockSize, SizeType capacity)
             {
-                m_data.Initialize(size, 1, blockSize, capacity);
+                m_size = size;
+                m_data.Initialize(Bytes(size), 1, max(Bytes(blockSize), 1), Bytes(capacity));
             }
 
             inline size_t Count() const { return m_inserted.load(); }
 
             inline bool Contains(const SizeType& key) const
             {
-                return *m_data[key] == 1;
+                return ((*m_data[key >> 3] >> (key & 7)) & 1) == 0;
             }
 
             inline bool Insert(const SizeType& key)
             {
-                char oldvalue = InterlockedExchange8((char*)m_data[key], 1);
-                if (oldvalue == 1) return false;
+                std::uint8_t bit = (std::uint8_t)(1 << (key & 7));
+                std::uint8_t oldvalue = InterlockedAnd8((char*)m_data[key >> 3], (char)~bit);
+                if ((oldvalue & bit) == 0) return false;
                 m_inserted++;
                 return true;
             }
@@ -47,8 +67,21 @@ namespace SPTAG
             inline ErrorCode Save(std::shared_ptr<Helper::DiskPriorityIO> output)
             {
                 SizeType deleted = m_inserted.load();
+                SizeType R = m_size.load();
+                DimensionType C = 1;
                 IOBINARY(output, WriteBinary, sizeof(SizeType), (char*)&deleted);
-                return m_data.Save(output);
+                IOBINARY(output, WriteBinary, sizeof(SizeType), (char*)&R);
+                IOBINARY(output, WriteBinary, sizeof(DimensionType), (char*)&C);
+
+                const SizeType batch = 1 << 20;
+                std::vector<std::int8_t> labels(min(R, batch));
+                for (SizeType begin = 0; begin < R; begin += batch) {
+                    SizeType num = min(batch, R - begin);
+                    for (SizeType i = 0; i < num; i++) labels[i] = Contains(begin + i) ? 1 : -1;
+                    IOBINARY(output, WriteBinary, num, (char*)labels.data());
+                }
+                LOG(Helper::LogLevel::LL_Info, "Save %s (%d,%d) Finish!\n", m_data.Name().c_str(), R, C);
+                return ErrorCode::Success;
             }
 
             inline ErrorCode Save(const std::string& filename)
@@ -61,10 +94,23 @@ namespace SPTAG
 
             inline ErrorCode Load(std::shared_ptr<Helper::DiskPriorityIO> input, SizeType blockSize, SizeType capacity)
             {
-                SizeType deleted;
+                SizeType deleted, R;
+                DimensionType C;
                 IOBINARY(input, ReadBinary, sizeof(SizeType), (char*)&deleted);
+                IOBINARY(input, ReadBinary, sizeof(SizeType), (char*)&R);
+                IOBINARY(input, ReadBinary, sizeof(DimensionType), (char*)&C);
                 m_inserted = deleted;
-                return m_data.Load(input, blockSize, capacity);
+                Initialize(R, blockSize, capacity);
+
+                const SizeType batch = 1 << 20;
+                std::vector<std::uint8_t> labels(min(R, batch));
+                for (SizeType begin = 0; begin < R; begin += batch) {
+                    SizeType num = min(batch, R - begin);
+                    IOBINARY(input, ReadBinary, num, (char*)labels.data());
+                    LoadBytes(labels.data(), begin, num);
+                }
+                LOG(Helper::LogLevel::LL_Info, "Load %s (%d,%d) Finish!\n", m_data.Name().c_str(), R, C);
+                return ErrorCode::Success;
             }
 
             inline ErrorCode Load(const std::string& filename, SizeType blockSize, SizeType capacity)
@@ -78,22 +124,36 @@ namespace SPTAG
             inline ErrorCode Load(char* pmemoryFile, SizeType blockSize, SizeType capacity)
             {
                 m_inserted = *((SizeType*)pmemoryFile);
-                return m_data.Load(pmemoryFile + sizeof(SizeType), blockSize, capacity);
+                pmemoryFile += sizeof(SizeType);
+                SizeType R = *((SizeType*)pmemoryFile);
+                pmemoryFile += sizeof(SizeType) + sizeof(DimensionType);
+
+                Initialize(R, blockSize, capacity);
+                LoadBytes((const std::uint8_t*)pmemoryFile, 0, R);
+                LOG(Helper::LogLevel::LL_Info, "Load %s (%d,%d) Finish!\n", m_data.Name().c_str(), R, 1);
+                return ErrorCode::Success;
             }
 
             inline ErrorCode AddBatch(SizeType num)
             {
-                return m_data.AddBatch(num);
+                SizeType size = m_size.load();
+                ErrorCode ret = m_data.AddBatch(Bytes(size + num) - Bytes(size));
+                if (ret != ErrorCode::Success) return ret;
+                // the last byte may still carry labels of ids dropped by SetR
+                if ((size & 7) != 0) InterlockedOr8((char*)m_data[size >> 3], (char)(0xff << (size & 7)));
+                m_size = size + num;
+                return ErrorCode::Success;
             }
 
-            inline std::uint64_t BufferSize() const 
+            inline std::uint64_t BufferSize() const
             {
-                return m_data.BufferSize() + sizeof(SizeType);
+                return sizeof(SizeType) + sizeof(SizeType) + sizeof(DimensionType) + m_size.load();
             }
 
             inline void SetR(SizeType num)
             {
-                m_data.SetR(num);
+                m_data.SetR(Bytes(num));
+                m_size = num;
             }
         };
     }
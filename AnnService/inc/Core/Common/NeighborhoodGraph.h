@@ -9,11 +9,14 @@
 #include "CommonUtils.h"
 #include "Dataset.h"
 #include "FineGrainedLock.h"
+#include "GemmKernel.h"
 #include "QueryResultSet.h"
+#include "inc/Helper/WorkStealingPool.h"
 
 #include <chrono>
 #include <queue>
 #include <atomic>
+#include <unordered_set>
 
 #if defined(GPU)
 #include <cuda.h>
@@ -52,13 +55,19 @@ namespace SPTAG
                 m_iGPULeafSize(500),
                 m_iheadNumGPUs(1),
                 m_iTPTBalanceFactor(2),
-                m_rebuild(0)
+                m_rebuild(0),
+                m_iNNDescentIter(0)
             {}
 
             ~NeighborhoodGraph() {}
 
             virtual void InsertNeighbors(VectorIndex* index, const SizeType node, SizeType insertNode, float insertDist) = 0;
 
+            virtual void InsertNeighborsBatch(VectorIndex* index, const SizeType node, const Edge* inserts, int num)
+            {
+                for (int i = 0; i < num; i++) InsertNeighbors(index, node, inserts[i].tonode, inserts[i].distance);
+            }
+
             virtual void RebuildNeighbors(VectorIndex* index, const SizeType node, SizeType* nodes, const BasicResult* queryResults, const int numResults) = 0;
 
             virtual float GraphAccuracyEstimation(VectorIndex* index, const SizeType samples, const std::unordered_map<SizeType, SizeType>* idmap = nullptr)
@@ -124,8 +133,7 @@ namespace SPTAG
             }
 #else
             template <typename T>
-            void PartitionByTptree(VectorIndex* index, std::vector<SizeType>& indices, const SizeType first, const SizeType last,
-                std::vector<std::pair<SizeType, SizeType>>& leaves)
+            SizeType SplitByTptree(VectorIndex* index, std::vector<SizeType>& indices, const SizeType first, const SizeType last)
             {
                 if (COMMON::DistanceUtils::Quantizer)
                 {
@@ -133,202 +141,273 @@ namespace SPTAG
                     {
 #define DefineVectorValueType(Name, Type) \
 case VectorValueType::Name: \
-PartitionByTptreeCore<T, Type>(index, indices, first, last, leaves); \
-break;
+return SplitByTptreeCore<T, Type>(index, indices, first, last);
 
 #include "inc/Core/DefinitionList.h"
 #undef DefineVectorValueType
 
                     default: break;
                     }
+                    return (first + last + 1) / 2;
                 }
-                else
-                {
-                    PartitionByTptreeCore<T, T>(index, indices, first, last, leaves);
-                }
+                return SplitByTptreeCore<T, T>(index, indices, first, last);
             }
 
+            // Splits indices[first..last] by a random projection on the dimensions of highest variance and
+            // returns the first position of the right part.
             template <typename T, typename R>
-            void PartitionByTptreeCore(VectorIndex* index, std::vector<SizeType>& indices, const SizeType first, const SizeType last,
-                std::vector<std::pair<SizeType, SizeType>>& leaves)
+            SizeType SplitByTptreeCore(VectorIndex* index, std::vector<SizeType>& indices, const SizeType first, const SizeType last)
             {
-                if (last - first <= m_iTPTLeafSize)
-                {
-                    leaves.emplace_back(first, last);
+                SizeType cols = index->GetFeatureDim();
+                bool quantizer_exists = (bool)COMMON::DistanceUtils::Quantizer;
+                R* v_holder = nullptr;
+                if (quantizer_exists) {
+                    cols = COMMON::DistanceUtils::Quantizer->ReconstructDim();
+                    v_holder = (R*)_mm_malloc(COMMON::DistanceUtils::Quantizer->ReconstructSize(), ALIGN_SPTAG);
                 }
-                else
+                std::vector<float> Mean(cols, 0);
+
+                int iIteration = 100;
+                SizeType end = min(first + m_iSamples, last);
+                SizeType count = end - first + 1;
+                // calculate the mean of each dimension
+                for (SizeType j = first; j <= end; j++)
                 {
-                    SizeType cols = index->GetFeatureDim();
-                    bool quantizer_exists = (bool)COMMON::DistanceUtils::Quantizer;
-                    R* v_holder = nullptr;
-                    if (quantizer_exists) {
-                        cols = COMMON::DistanceUtils::Quantizer->ReconstructDim();
-                        v_holder = (R*)_mm_malloc(COMMON::DistanceUtils::Quantizer->ReconstructSize(), ALIGN_SPTAG);
+                    R* v;
+                    if (quantizer_exists)
+                    {
+                        COMMON::DistanceUtils::Quantizer->ReconstructVector((uint8_t*)index->GetSample(indices[j]), v_holder);
+                        v = v_holder;
                     }
-                    std::vector<float> Mean(cols, 0);
-
-                    int iIteration = 100;
-                    SizeType end = min(first + m_iSamples, last);
-                    SizeType count = end - first + 1;
-                    // calculate the mean of each dimension
-                    for (SizeType j = first; j <= end; j++)
+                    else
                     {
-                        R* v;
-                        if (quantizer_exists)
-                        {
-                            COMMON::DistanceUtils::Quantizer->ReconstructVector((uint8_t*)index->GetSample(indices[j]), v_holder);
-                            v = v_holder;
-                        }
-                        else
-                        {
-                            v = (R*)index->GetSample(indices[j]);
-                        }
+                        v = (R*)index->GetSample(indices[j]);
+                    }
 
-                        for (DimensionType k = 0; k < cols; k++)
-                        {
-                            Mean[k] += v[k];
-                        }
+                    for (DimensionType k = 0; k < cols; k++)
+                    {
+                        Mean[k] += v[k];
+                    }
+                }
+                for (DimensionType k = 0; k < cols; k++)
+                {
+                    Mean[k] /= count;
+                }
+                std::vector<BasicResult> Variance;
+                Variance.reserve(cols);
+                for (DimensionType j = 0; j < cols; j++)
+                {
+                    Variance.emplace_back(j, 0.0f);
+                }
+                // calculate the variance of each dimension
+                for (SizeType j = first; j <= end; j++)
+                {
+                    R* v;
+                    if (quantizer_exists)
+                    {
+                        COMMON::DistanceUtils::Quantizer->ReconstructVector((uint8_t*)index->GetSample(indices[j]), v_holder);
+                        v = v_holder;
+                    }
+                    else
+                    {
+                        v = (R*)index->GetSample(indices[j]);
                     }
+
                     for (DimensionType k = 0; k < cols; k++)
                     {
-                        Mean[k] /= count;
+                        float dist = v[k] - Mean[k];
+                        Variance[k].Dist += dist * dist;
+                    }
+                }
+                std::sort(Variance.begin(), Variance.end(), COMMON::Compare);
+                std::vector<SizeType> indexs(m_numTopDimensionTPTSplit);
+                std::vector<float> weight(m_numTopDimensionTPTSplit), bestweight(m_numTopDimensionTPTSplit);
+                float bestvariance = Variance[cols - 1].Dist;
+                for (int i = 0; i < m_numTopDimensionTPTSplit; i++)
+                {
+                    indexs[i] = Variance[cols - 1 - i].VID;
+                    bestweight[i] = 0;
+                }
+                bestweight[0] = 1;
+                float bestmean = Mean[indexs[0]];
+
+                std::vector<float> Val(count);
+                for (int i = 0; i < iIteration; i++)
+                {
+                    float sumweight = 0;
+                    for (int j = 0; j < m_numTopDimensionTPTSplit; j++)
+                    {
+                        weight[j] = float(rand() % 10000) / 5000.0f - 1.0f;
+                        sumweight += weight[j] * weight[j];
                     }
-                    std::vector<BasicResult> Variance;
-                    Variance.reserve(cols);
-                    for (DimensionType j = 0; j < cols; j++)
+                    sumweight = sqrt(sumweight);
+                    for (int j = 0; j < m_numTopDimensionTPTSplit; j++)
                     {
-                        Variance.emplace_back(j, 0.0f);
+                        weight[j] /= sumweight;
                     }
-                    // calculate the variance of each dimension
-                    for (SizeType j = first; j <= end; j++)
+                    float mean = 0;
+                    for (SizeType j = 0; j < count; j++)
                     {
+                        Val[j] = 0;
                         R* v;
                         if (quantizer_exists)
                         {
-                            COMMON::DistanceUtils::Quantizer->ReconstructVector((uint8_t*)index->GetSample(indices[j]), v_holder);
+                            COMMON::DistanceUtils::Quantizer->ReconstructVector((uint8_t*)index->GetSample(indices[first + j]), v_holder);
                             v = v_holder;
                         }
                         else
                         {
-                            v = (R*)index->GetSample(indices[j]);
+                            v = (R*)index->GetSample(indices[first + j]);
                         }
-
-                        for (DimensionType k = 0; k < cols; k++)
+                        for (int k = 0; k < m_numTopDimensionTPTSplit; k++)
                         {
-                            float dist = v[k] - Mean[k];
-                            Variance[k].Dist += dist * dist;
+                            Val[j] += weight[k] * v[indexs[k]];
                         }
+                        mean += Val[j];
                     }
-                    std::sort(Variance.begin(), Variance.end(), COMMON::Compare);
-                    std::vector<SizeType> indexs(m_numTopDimensionTPTSplit);
-                    std::vector<float> weight(m_numTopDimensionTPTSplit), bestweight(m_numTopDimensionTPTSplit);
-                    float bestvariance = Variance[cols - 1].Dist;
-                    for (int i = 0; i < m_numTopDimensionTPTSplit; i++)
+                    mean /= count;
+                    float var = 0;
+                    for (SizeType j = 0; j < count; j++)
                     {
-                        indexs[i] = Variance[cols - 1 - i].VID;
-                        bestweight[i] = 0;
+                        float dist = Val[j] - mean;
+                        var += dist * dist;
                     }
-                    bestweight[0] = 1;
-                    float bestmean = Mean[indexs[0]];
-
-                    std::vector<float> Val(count);
-                    for (int i = 0; i < iIteration; i++)
+                    if (var > bestvariance)
                     {
-                        float sumweight = 0;
-                        for (int j = 0; j < m_numTopDimensionTPTSplit; j++)
-                        {
-                            weight[j] = float(rand() % 10000) / 5000.0f - 1.0f;
-                            sumweight += weight[j] * weight[j];
-                        }
-                        sumweight = sqrt(sumweight);
+                        bestvariance = var;
+                        bestmean = mean;
                         for (int j = 0; j < m_numTopDimensionTPTSplit; j++)
                         {
-                            weight[j] /= sumweight;
-                        }
-                        float mean = 0;
-                        for (SizeType j = 0; j < count; j++)
-                        {
-                            Val[j] = 0;
-                            R* v;
-                            if (quantizer_exists)
-                            {
-                                COMMON::DistanceUtils::Quantizer->ReconstructVector((uint8_t*)index->GetSample(indices[first + j]), v_holder);
-                                v = v_holder;
-                            }
-                            else
-                            {
-                                v = (R*)index->GetSample(indices[first + j]);
-                            }
-                            for (int k = 0; k < m_numTopDimensionTPTSplit; k++)
-                            {
-                                Val[j] += weight[k] * v[indexs[k]];
-                            }
-                            mean += Val[j];
-                        }
-                        mean /= count;
-                        float var = 0;
-                        for (SizeType j = 0; j < count; j++)
-                        {
-                            float dist = Val[j] - mean;
-                            var += dist * dist;
-                        }
-                        if (var > bestvariance)
-                        {
-                            bestvariance = var;
-                            bestmean = mean;
-                            for (int j = 0; j < m_numTopDimensionTPTSplit; j++)
-                            {
-                                bestweight[j] = weight[j];
-                            }
+                            bestweight[j] = weight[j];
                         }
                     }
-                    SizeType i = first;
-                    SizeType j = last;
-                    // decide which child one point belongs
-                    while (i <= j)
+                }
+                SizeType i = first;
+                SizeType j = last;
+                // decide which child one point belongs
+                while (i <= j)
+                {
+                    float val = 0;
+                    R* v;
+                    if (quantizer_exists)
                     {
-                        float val = 0;
-                        R* v;
-                        if (quantizer_exists)
-                        {
-                            COMMON::DistanceUtils::Quantizer->ReconstructVector((uint8_t*)index->GetSample(indices[i]), v_holder);
-                            v = v_holder;
-                        }
-                        else
-                        {
-                            v = (R*)index->GetSample(indices[i]);
-                        }
+                        COMMON::DistanceUtils::Quantizer->ReconstructVector((uint8_t*)index->GetSample(indices[i]), v_holder);
+                        v = v_holder;
+                    }
+                    else
+                    {
+                        v = (R*)index->GetSample(indices[i]);
+                    }
 
-                        for (int k = 0; k < m_numTopDimensionTPTSplit; k++)
-                        {
-                            val += bestweight[k] * v[indexs[k]];
-                        }
-                        if (val < bestmean)
-                        {
-                            i++;
-                        }
-                        else
-                        {
-                            std::swap(indices[i], indices[j]);
-                            j--;
-                        }
+                    for (int k = 0; k < m_numTopDimensionTPTSplit; k++)
+                    {
+                        val += bestweight[k] * v[indexs[k]];
+                    }
+                    if (val < bestmean)
+                    {
+                        i++;
                     }
-                    // if all the points in the node are equal,equally split the node into 2
-                    if ((i == first) || (i == last + 1))
+                    else
                     {
-                        i = (first + last + 1) / 2;
+                        std::swap(indices[i], indices[j]);
+                        j--;
                     }
+                }
+                // if all the points in the node are equal,equally split the node into 2
+                if ((i == first) || (i == last + 1))
+                {
+                    i = (first + last + 1) / 2;
+                }
 
-                    Mean.clear();
-                    Variance.clear();
-                    Val.clear();
-                    indexs.clear();
-                    weight.clear();
-                    bestweight.clear();
-                    if (v_holder) _mm_free(v_holder);
+                Mean.clear();
+                Variance.clear();
+                Val.clear();
+                indexs.clear();
+                weight.clear();
+                bestweight.clear();
+                if (v_holder) _mm_free(v_holder);
+                return i;
+            }
 
-                    PartitionByTptreeCore<T, R>(index, indices, first, i - 1, leaves);
-                    PartitionByTptreeCore<T, R>(index, indices, i, last, leaves);
+            // Splits indices[first..last] of one tree down to leaves. The right part of every split becomes a
+            // new task of the pool while the current task goes on with the left part.
+            template <typename T>
+            void PartitionByTptree(VectorIndex* index, std::vector<SizeType>& indices, const SizeType first, SizeType last,
+                std::vector<std::pair<SizeType, SizeType>>& leaves, std::mutex& leavesLock, Helper::WorkStealingPool& pool, int worker)
+            {
+                while (last - first > m_iTPTLeafSize)
+                {
+                    SizeType i = SplitByTptree<T>(index, indices, first, last);
+                    pool.Spawn(worker, [this, index, &indices, i, last, &leaves, &leavesLock, &pool](int w) {
+                        PartitionByTptree<T>(index, indices, i, last, leaves, leavesLock, pool, w);
+                    });
+                    last = i - 1;
+                }
+
+                std::lock_guard<std::mutex> lock(leavesLock);
+                leaves.emplace_back(first, last);
+            }
+
+            // Adds all pairs of one leaf to the KNN lists. Dot products come from the blocked kernel and only
+            // the pairs which may enter one of the two lists get their exact distance, so the lists end up the
+            // same as with the pairwise loop.
+            template <typename T>
+            void AddLeafNeighbors(VectorIndex* index, const SizeType* ids, SizeType count, COMMON::Dataset<float>& dists,
+                const std::unordered_map<SizeType, SizeType>* idmap, std::vector<float>& rows, std::vector<float>& panels, std::vector<float>& norms)
+            {
+                DimensionType dim = index->GetFeatureDim();
+                SizeType panelCount = (count + GemmKernel::c_panelWidth - 1) / GemmKernel::c_panelWidth;
+                SizeType rowCount = (count + GemmKernel::c_rowBlock - 1) / GemmKernel::c_rowBlock * GemmKernel::c_rowBlock;
+                if (panels.size() < (size_t)panelCount * GemmKernel::c_panelWidth * dim) panels.resize((size_t)panelCount * GemmKernel::c_panelWidth * dim);
+                if (norms.size() < (size_t)panelCount * GemmKernel::c_panelWidth) norms.resize((size_t)panelCount * GemmKernel::c_panelWidth);
+                if (rows.size() < (size_t)rowCount * dim) rows.resize((size_t)rowCount * dim);
+
+                GemmKernel::PackPanels<T>([index, ids](SizeType j) { return (const T*)index->GetSample(ids[j]); }, count, dim, panels.data(), norms.data());
+                for (SizeType x = 0; x < rowCount; x++)
+                {
+                    float* row = rows.data() + (size_t)x * dim;
+                    if (x >= count)
+                    {
+                        for (DimensionType d = 0; d < dim; d++) row[d] = 0;
+                        continue;
+                    }
+                    const T* v = (const T*)index->GetSample(ids[x]);
+                    for (DimensionType d = 0; d < dim; d++) row[d] = (float)v[d];
+                }
+
+                bool cosine = (index->GetDistCalcMethod() != DistCalcMethod::L2);
+                float base = (float)COMMON::Utils::GetBase<T>();
+                // bound of the rounding error of a float dot product relative to the squared norms
+                float errorScale = dim * 4e-7f;
+                float dots[GemmKernel::c_rowBlock][GemmKernel::c_panelWidth];
+                for (SizeType block = 0; block < count; block += GemmKernel::c_rowBlock)
+                {
+                    for (SizeType panel = (block + 1) / GemmKernel::c_panelWidth * GemmKernel::c_panelWidth; panel < count; panel += GemmKernel::c_panelWidth)
+                    {
+                        GemmKernel::MultiplyBlock(rows.data() + (size_t)block * dim, panels.data() + (size_t)panel * dim, dim, dots);
+                        for (int r = 0; r < GemmKernel::c_rowBlock && block + r < count; r++)
+                        {
+                            SizeType x = block + r;
+                            for (int c = 0; c < GemmKernel::c_panelWidth && panel + c < count; c++)
+                            {
+                                SizeType y = panel + c;
+                                if (y <= x) continue;
+
+                                float approx = cosine ? base * base - dots[r][c] : norms[x] + norms[y] - 2 * dots[r][c];
+                                approx -= (norms[x] + norms[y]) * errorScale;
+                                SizeType p1 = ids[x], p2 = ids[y];
+                                if (idmap != nullptr) {
+                                    p1 = (idmap->find(p1) == idmap->end()) ? p1 : idmap->at(p1);
+                                    p2 = (idmap->find(p2) == idmap->end()) ? p2 : idmap->at(p2);
+                                }
+                                if (approx > dists[p1][m_iNeighborhoodSize - 1] && approx > dists[p2][m_iNeighborhoodSize - 1]) continue;
+
+                                float dist = index->ComputeDistance(index->GetSample(ids[x]), index->GetSample(ids[y]));
+                                COMMON::Utils::AddNeighbor(p2, dist, (m_pNeighborhoodGraph)[p1], dists[p1], m_iNeighborhoodSize);
+                                COMMON::Utils::AddNeighbor(p1, dist, (m_pNeighborhoodGraph)[p2], dists[p2], m_iNeighborhoodSize);
+                            }
+                        }
+                    }
                 }
             }
 
@@ -338,6 +417,7 @@ break;
                 COMMON::Dataset<float> NeighborhoodDists(m_iGraphSize, m_iNeighborhoodSize, index->m_iDataBlockSize, index->m_iDataCapacity);
                 std::vector<std::vector<SizeType>> TptreeDataIndices(m_iTPTNumber, std::vector<SizeType>(m_iGraphSize));
                 std::vector<std::vector<std::pair<SizeType, SizeType>>> TptreeLeafNodes(m_iTPTNumber, std::vector<std::pair<SizeType, SizeType>>());
+                std::vector<std::mutex> TptreeLeafLocks(m_iTPTNumber);
 
                 for (SizeType i = 0; i < m_iGraphSize; i++)
                     for (DimensionType j = 0; j < m_iNeighborhoodSize; j++)
@@ -345,40 +425,53 @@ break;
 
                 auto t1 = std::chrono::high_resolution_clock::now();
                 LOG(Helper::LogLevel::LL_Info, "Parallel TpTree Partition begin\n");
-#pragma omp parallel for schedule(dynamic)
+                Helper::WorkStealingPool pool(omp_get_max_threads());
                 for (int i = 0; i < m_iTPTNumber; i++)
                 {
-                    Sleep(i * 100); std::srand(clock());
-                    for (SizeType j = 0; j < m_iGraphSize; j++) TptreeDataIndices[i][j] = j;
-                    std::random_shuffle(TptreeDataIndices[i].begin(), TptreeDataIndices[i].end());
-                    PartitionByTptree<T>(index, TptreeDataIndices[i], 0, m_iGraphSize - 1, TptreeLeafNodes[i]);
-                    LOG(Helper::LogLevel::LL_Info, "Finish Getting Leaves for Tree %d\n", i);
+                    pool.Spawn(i, [this, index, i, &TptreeDataIndices, &TptreeLeafNodes, &TptreeLeafLocks, &pool](int worker) {
+                        for (SizeType j = 0; j < m_iGraphSize; j++) TptreeDataIndices[i][j] = j;
+                        std::random_shuffle(TptreeDataIndices[i].begin(), TptreeDataIndices[i].end());
+                        PartitionByTptree<T>(index, TptreeDataIndices[i], 0, m_iGraphSize - 1, TptreeLeafNodes[i], TptreeLeafLocks[i], pool, worker);
+                    });
                 }
+                pool.Run();
                 LOG(Helper::LogLevel::LL_Info, "Parallel TpTree Partition done\n");
                 auto t2 = std::chrono::high_resolution_clock::now();
                 LOG(Helper::LogLevel::LL_Info, "Build TPTree time (s): %lld\n", std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count());
 
+                // A node is in exactly one leaf of a tree, so the leaves of a tree update disjoint lists.
+                bool blocked = !COMMON::DistanceUtils::Quantizer;
                 for (int i = 0; i < m_iTPTNumber; i++)
                 {
-#pragma omp parallel for schedule(dynamic)
-                    for (SizeType j = 0; j < (SizeType)TptreeLeafNodes[i].size(); j++)
+#pragma omp parallel
                     {
-                        SizeType start_index = TptreeLeafNodes[i][j].first;
-                        SizeType end_index = TptreeLeafNodes[i][j].second;
-                        if ((j * 5) % TptreeLeafNodes[i].size() == 0) LOG(Helper::LogLevel::LL_Info, "Processing Tree %d %d%%\n", i, static_cast<int>(j * 1.0 / TptreeLeafNodes[i].size() * 100));
-                        for (SizeType x = start_index; x < end_index; x++)
+                        std::vector<float> rows, panels, norms;
+#pragma omp for schedule(dynamic)
+                        for (SizeType j = 0; j < (SizeType)TptreeLeafNodes[i].size(); j++)
                         {
-                            for (SizeType y = x + 1; y <= end_index; y++)
+                            SizeType start_index = TptreeLeafNodes[i][j].first;
+                            SizeType end_index = TptreeLeafNodes[i][j].second;
+                            if ((j * 5) % TptreeLeafNodes[i].size() == 0) LOG(Helper::LogLevel::LL_Info, "Processing Tree %d %d%%\n", i, static_cast<int>(j * 1.0 / TptreeLeafNodes[i].size() * 100));
+                            if (blocked)
                             {
-                                SizeType p1 = TptreeDataIndices[i][x];
-                                SizeType p2 = TptreeDataIndices[i][y];
-                                float dist = index->ComputeDistance(index->GetSample(p1), index->GetSample(p2));
-                                if (idmap != nullptr) {
-                                    p1 = (idmap->find(p1) == idmap->end()) ? p1 : idmap->at(p1);
-                                    p2 = (idmap->find(p2) == idmap->end()) ? p2 : idmap->at(p2);
+                                AddLeafNeighbors<T>(index, TptreeDataIndices[i].data() + start_index, end_index - start_index + 1, NeighborhoodDists, idmap, rows, panels, norms);
+                                continue;
+                            }
+
+                            for (SizeType x = start_index; x < end_index; x++)
+                            {
+                                for (SizeType y = x + 1; y <= end_index; y++)
+                                {
+                                    SizeType p1 = TptreeDataIndices[i][x];
+                                    SizeType p2 = TptreeDataIndices[i][y];
+                                    float dist = index->ComputeDistance(index->GetSample(p1), index->GetSample(p2));
+                                    if (idmap != nullptr) {
+                                        p1 = (idmap->find(p1) == idmap->end()) ? p1 : idmap->at(p1);
+                                        p2 = (idmap->find(p2) == idmap->end()) ? p2 : idmap->at(p2);
+                                    }
+                                    COMMON::Utils::AddNeighbor(p2, dist, (m_pNeighborhoodGraph)[p1], (NeighborhoodDists)[p1], m_iNeighborhoodSize);
+                                    COMMON::Utils::AddNeighbor(p1, dist, (m_pNeighborhoodGraph)[p2], (NeighborhoodDists)[p2], m_iNeighborhoodSize);
                                 }
-                                COMMON::Utils::AddNeighbor(p2, dist, (m_pNeighborhoodGraph)[p1], (NeighborhoodDists)[p1], m_iNeighborhoodSize);
-                                COMMON::Utils::AddNeighbor(p1, dist, (m_pNeighborhoodGraph)[p2], (NeighborhoodDists)[p2], m_iNeighborhoodSize);
                             }
                         }
                     }
@@ -413,7 +506,8 @@ break;
                 auto t2 = std::chrono::high_resolution_clock::now();
                 LOG(Helper::LogLevel::LL_Info, "BuildInitKNNGraph time (s): %lld\n", std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count());
 
-                RefineGraph<T>(index, idmap);
+                if (m_iNNDescentIter > 0) RefineGraphByNNDescent<T>(index, idmap);
+                else RefineGraph<T>(index, idmap);
 
                 auto t3 = std::chrono::high_resolution_clock::now();
                 LOG(Helper::LogLevel::LL_Info, "BuildGraph time (s): %lld\n", std::chrono::duration_cast<std::chrono::seconds>(t3 - t1).count());
@@ -524,6 +618,147 @@ break;
                 }
             }
 
+            // Refines the KNN lists with NN-descent instead of searching the graph for every node: each round a
+            // node pulls the sampled neighbors and reverse neighbors of its sampled neighbors as candidates.
+            // The lists are double buffered, so a node only writes its own row of the next buffer and no locks
+            // are taken, and nodes whose neighborhood did not change in the last round are not joined again.
+            // The final lists are pruned to RNG edges from their KNN candidates.
+            template <typename T>
+            void RefineGraphByNNDescent(VectorIndex* index, const std::unordered_map<SizeType, SizeType>* idmap = nullptr)
+            {
+                DimensionType K = m_iNeighborhoodSize;
+                DimensionType sample = max(K / 4, 1);
+                std::vector<SizeType> ids[2] = { std::vector<SizeType>((size_t)m_iGraphSize * K), std::vector<SizeType>((size_t)m_iGraphSize * K) };
+                std::vector<float> dists[2] = { std::vector<float>((size_t)m_iGraphSize * K), std::vector<float>((size_t)m_iGraphSize * K) };
+                std::vector<char> changed[2] = { std::vector<char>(m_iGraphSize, 1), std::vector<char>(m_iGraphSize, 0) };
+                std::vector<SizeType> reverse((size_t)m_iGraphSize * sample);
+                std::vector<std::atomic<DimensionType>> reverseCount(m_iGraphSize);
+
+#pragma omp parallel for schedule(dynamic)
+                for (SizeType i = 0; i < m_iGraphSize; i++)
+                {
+                    SizeType* row = ids[0].data() + (size_t)i * K;
+                    float* rowDists = dists[0].data() + (size_t)i * K;
+                    for (DimensionType j = 0; j < K; j++)
+                    {
+                        row[j] = -1;
+                        rowDists[j] = MaxDist;
+                    }
+                    for (DimensionType j = 0; j < K; j++)
+                    {
+                        SizeType nn = m_pNeighborhoodGraph[i][j];
+                        if (nn < 0 || nn == i) continue;
+                        COMMON::Utils::AddNeighbor(nn, index->ComputeDistance(index->GetSample(i), index->GetSample(nn)), row, rowDists, K);
+                    }
+                }
+
+                int cur = 0;
+                for (int iter = 0; iter < m_iNNDescentIter; iter++)
+                {
+                    auto t1 = std::chrono::high_resolution_clock::now();
+                    int next = 1 - cur;
+
+#pragma omp parallel for
+                    for (SizeType i = 0; i < m_iGraphSize; i++) reverseCount[i].store(0, std::memory_order_relaxed);
+
+#pragma omp parallel for schedule(dynamic, 1024)
+                    for (SizeType i = 0; i < m_iGraphSize; i++)
+                    {
+                        if (idmap != nullptr && idmap->find(i) != idmap->end()) continue;
+                        const SizeType* row = ids[cur].data() + (size_t)i * K;
+                        for (DimensionType j = 0; j < sample && row[j] >= 0; j++)
+                        {
+                            DimensionType pos = reverseCount[row[j]].fetch_add(1, std::memory_order_relaxed);
+                            if (pos < sample) reverse[(size_t)row[j] * sample + pos] = i;
+                        }
+                    }
+
+                    std::atomic<SizeType> updated(0);
+#pragma omp parallel
+                    {
+                        std::vector<SizeType> neighbors, candidates, known;
+#pragma omp for schedule(dynamic, 64)
+                        for (SizeType i = 0; i < m_iGraphSize; i++)
+                        {
+                            const SizeType* row = ids[cur].data() + (size_t)i * K;
+                            SizeType* nextRow = ids[next].data() + (size_t)i * K;
+                            float* nextDists = dists[next].data() + (size_t)i * K;
+                            memcpy(nextRow, row, sizeof(SizeType) * K);
+                            memcpy(nextDists, dists[cur].data() + (size_t)i * K, sizeof(float) * K);
+                            changed[next][i] = 0;
+
+                            neighbors.clear();
+                            GetSampledNeighbors(ids[cur].data(), reverse.data(), reverseCount.data(), i, K, sample, neighbors);
+                            candidates.clear();
+                            for (SizeType nn : neighbors)
+                            {
+                                if (!changed[cur][i] && !changed[cur][nn]) continue;
+                                GetSampledNeighbors(ids[cur].data(), reverse.data(), reverseCount.data(), nn, K, sample, candidates);
+                            }
+                            if (candidates.empty()) continue;
+
+                            known.assign(row, row + K);
+                            known.push_back(i);
+                            std::sort(known.begin(), known.end());
+                            std::sort(candidates.begin(), candidates.end());
+                            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+                            const void* vector = index->GetSample(i);
+                            for (SizeType candidate : candidates)
+                            {
+                                if (std::binary_search(known.begin(), known.end(), candidate)) continue;
+                                float dist = index->ComputeDistance(vector, index->GetSample(candidate));
+                                if (dist > nextDists[K - 1]) continue;
+                                COMMON::Utils::AddNeighbor(candidate, dist, nextRow, nextDists, K);
+                            }
+
+                            if (memcmp(nextRow, row, sizeof(SizeType) * K) != 0)
+                            {
+                                changed[next][i] = 1;
+                                ++updated;
+                            }
+                        }
+                    }
+                    cur = next;
+
+                    auto t2 = std::chrono::high_resolution_clock::now();
+                    LOG(Helper::LogLevel::LL_Info, "NNDescent %d: %d nodes updated, time (s): %lld\n", iter, updated.load(), std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count());
+                    if (updated.load() <= m_iGraphSize / 1000) break;
+                }
+
+                m_iNeighborhoodSize = (DimensionType)(m_iNeighborhoodSize / m_fNeighborhoodScale);
+
+                auto t1 = std::chrono::high_resolution_clock::now();
+#pragma omp parallel
+                {
+                    std::vector<BasicResult> results(K);
+#pragma omp for schedule(dynamic)
+                    for (SizeType i = 0; i < m_iGraphSize; i++)
+                    {
+                        for (DimensionType j = 0; j < K; j++)
+                        {
+                            results[j].VID = ids[cur][(size_t)i * K + j];
+                            results[j].Dist = dists[cur][(size_t)i * K + j];
+                        }
+                        RebuildNeighbors(index, i, m_pNeighborhoodGraph[i], results.data(), K);
+                    }
+                }
+                auto t2 = std::chrono::high_resolution_clock::now();
+                LOG(Helper::LogLevel::LL_Info, "Prune RNG time (s): %lld Graph Acc: %f\n", std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count(), GraphAccuracyEstimation(index, 100, idmap));
+            }
+
+            // Appends the first p_sample neighbors of p_node and the reverse neighbors collected for it.
+            static void GetSampledNeighbors(const SizeType* p_ids, const SizeType* p_reverse, const std::atomic<DimensionType>* p_reverseCount,
+                SizeType p_node, DimensionType p_K, DimensionType p_sample, std::vector<SizeType>& p_out)
+            {
+                const SizeType* row = p_ids + (size_t)p_node * p_K;
+                for (DimensionType j = 0; j < p_sample && row[j] >= 0; j++) p_out.push_back(row[j]);
+
+                DimensionType count = min(p_reverseCount[p_node].load(std::memory_order_relaxed), p_sample);
+                const SizeType* reverse = p_reverse + (size_t)p_node * p_sample;
+                for (DimensionType j = 0; j < count; j++) p_out.push_back(reverse[j]);
+            }
+
             template <typename T>
             ErrorCode RefineGraph(VectorIndex* index, std::vector<SizeType>& indices, std::vector<SizeType>& reverseIndices,
                 std::shared_ptr<Helper::DiskPriorityIO> output, NeighborhoodGraph* newGraph, const std::unordered_map<SizeType, SizeType>* idmap = nullptr)
@@ -564,6 +799,91 @@ break;
                 return ErrorCode::Success;
             }
 
+            // Compact the graph onto the live nodes listed in indices (new id -> old id). Neighbor lists are
+            // remapped through reverseIndices (old id -> new id, -1 for dropped nodes); only the nodes that
+            // lost a neighbor are searched again, the others keep their edges.
+            template <typename T>
+            ErrorCode CompactGraph(VectorIndex* index, const std::vector<SizeType>& indices, const std::vector<SizeType>& reverseIndices,
+                NeighborhoodGraph* newGraph, const std::unordered_map<SizeType, SizeType>* idmap = nullptr)
+            {
+                SizeType R = (SizeType)indices.size();
+                newGraph->m_pNeighborhoodGraph.Initialize(R, m_iNeighborhoodSize, index->m_iDataBlockSize, index->m_iDataCapacity);
+                newGraph->m_iGraphSize = R;
+                newGraph->m_iNeighborhoodSize = m_iNeighborhoodSize;
+
+                std::atomic<SizeType> affected(0);
+#pragma omp parallel for schedule(dynamic)
+                for (SizeType i = 0; i < R; i++)
+                {
+                    SizeType* outnodes = newGraph->m_pNeighborhoodGraph[i];
+                    bool lost = false;
+                    {
+                        std::lock_guard<std::mutex> lock(m_dataUpdateLock[indices[i]]);
+                        const SizeType* oldnodes = m_pNeighborhoodGraph[indices[i]];
+                        DimensionType count = 0;
+                        for (DimensionType j = 0; j < m_iNeighborhoodSize; j++)
+                        {
+                            SizeType nn = oldnodes[j];
+                            if (nn < 0) break;
+                            if (nn >= (SizeType)reverseIndices.size() || reverseIndices[nn] < 0) {
+                                lost = true;
+                                continue;
+                            }
+                            outnodes[count++] = reverseIndices[nn];
+                        }
+                        for (DimensionType j = count; j < m_iNeighborhoodSize; j++) outnodes[j] = -1;
+                    }
+
+                    if (lost) {
+                        ++affected;
+                        COMMON::QueryResultSet<T> query((const T*)index->GetSample(indices[i]), m_iCEF + 1);
+                        index->RefineSearchIndex(query, false);
+                        RebuildNeighbors(index, indices[i], outnodes, query.GetResults(), m_iCEF + 1);
+                        for (DimensionType j = 0; j < m_iNeighborhoodSize; j++)
+                        {
+                            if (outnodes[j] >= 0 && outnodes[j] < (SizeType)reverseIndices.size()) outnodes[j] = reverseIndices[outnodes[j]];
+                        }
+                    }
+
+                    std::unordered_map<SizeType, SizeType>::const_iterator iter;
+                    if (idmap != nullptr)
+                    {
+                        for (DimensionType j = 0; j < m_iNeighborhoodSize; j++)
+                        {
+                            if (outnodes[j] >= 0 && (iter = idmap->find(outnodes[j])) != idmap->end()) outnodes[j] = iter->second;
+                        }
+                        if ((iter = idmap->find(-1 - i)) != idmap->end())
+                            outnodes[m_iNeighborhoodSize - 1] = -2 - iter->second;
+                    }
+                }
+                LOG(Helper::LogLevel::LL_Info, "Compact %s from %d to %d nodes, %d nodes re-linked\n", m_pNeighborhoodGraph.Name().c_str(), m_iGraphSize, R, affected.load());
+                return ErrorCode::Success;
+            }
+
+            // Copies the graph with the nodes renumbered: row i of newGraph is row newToOld[i] of this graph
+            // with every neighbor x, and every -2 - x link to a duplicate center, renumbered to oldToNew[x].
+            void ReorderGraph(VectorIndex* index, const std::vector<SizeType>& newToOld, const std::vector<SizeType>& oldToNew, NeighborhoodGraph* newGraph) const
+            {
+                SizeType R = (SizeType)newToOld.size();
+                newGraph->m_pNeighborhoodGraph.Initialize(R, m_iNeighborhoodSize, index->m_iDataBlockSize, index->m_iDataCapacity);
+                newGraph->m_iGraphSize = R;
+                newGraph->m_iNeighborhoodSize = m_iNeighborhoodSize;
+
+#pragma omp parallel for schedule(dynamic, 1024)
+                for (SizeType i = 0; i < R; i++)
+                {
+                    const SizeType* oldnodes = m_pNeighborhoodGraph[newToOld[i]];
+                    SizeType* outnodes = newGraph->m_pNeighborhoodGraph[i];
+                    for (DimensionType j = 0; j < m_iNeighborhoodSize; j++)
+                    {
+                        SizeType nn = oldnodes[j];
+                        if (nn >= 0) outnodes[j] = oldToNew[nn];
+                        else if (nn < -1) outnodes[j] = -2 - oldToNew[-2 - nn];
+                        else outnodes[j] = nn;
+                    }
+                }
+            }
+
             template <typename T>
             void RefineNode(VectorIndex* index, const SizeType node, bool updateNeighbors, bool searchDeleted, int CEF)
             {
@@ -593,6 +913,102 @@ break;
                 }
             }
 
+            // Batched version of RefineNode(..., updateNeighbors=true, ...) for newly added nodes.
+            // Candidate searches run in parallel, the out-edges of a chunk are published before any
+            // reverse edge makes the chunk reachable, and reverse edges are grouped by target so that
+            // every shared neighbor is locked and updated once per chunk.
+            template <typename T>
+            void RefineNodes(VectorIndex* index, const std::vector<SizeType>& nodes, bool searchDeleted, int CEF, int numThreads)
+            {
+                numThreads = max(numThreads, 1);
+                SizeType chunkSize = (SizeType)numThreads * 16;
+                std::vector<std::vector<BasicResult>> candidates;
+                std::vector<SizeType> staged;
+                std::vector<Edge> reverseEdges;
+                std::vector<size_t> groups;
+
+                for (SizeType chunkBegin = 0; chunkBegin < (SizeType)nodes.size(); chunkBegin += chunkSize)
+                {
+                    SizeType batch = min(chunkSize, (SizeType)nodes.size() - chunkBegin);
+                    const SizeType* batchNodes = nodes.data() + chunkBegin;
+                    candidates.clear();
+                    candidates.resize(batch);
+                    staged.resize((size_t)batch * m_iNeighborhoodSize);
+                    std::unordered_set<SizeType> chunkSet(batchNodes, batchNodes + batch);
+
+#pragma omp parallel for schedule(dynamic) num_threads(min(numThreads, (int)batch))
+                    for (SizeType i = 0; i < batch; i++)
+                    {
+                        SizeType node = batchNodes[i];
+                        COMMON::QueryResultSet<T> query((const T*)index->GetSample(node), CEF + 1);
+                        void* rec_query = nullptr;
+                        if (COMMON::DistanceUtils::Quantizer) {
+                            rec_query = _mm_malloc(COMMON::DistanceUtils::Quantizer->ReconstructSize(), ALIGN_SPTAG);
+                            COMMON::DistanceUtils::Quantizer->ReconstructVector((const uint8_t*)query.GetTarget(), rec_query);
+                            query.SetTarget((T*)rec_query);
+                        }
+                        index->RefineSearchIndex(query, searchDeleted);
+                        if (rec_query)
+                        {
+                            _mm_free(rec_query);
+                        }
+
+                        std::vector<BasicResult>& cand = candidates[i];
+                        cand.reserve(CEF + batch);
+                        for (int j = 0; j <= CEF; j++)
+                        {
+                            BasicResult* item = query.GetResult(j);
+                            if (item->VID < 0) break;
+                            if (chunkSet.count(item->VID)) continue;
+                            cand.emplace_back(item->VID, item->Dist);
+                        }
+
+                        // nodes of the same chunk are not linked yet, so pair them up explicitly
+                        for (SizeType j = 0; j < batch; j++)
+                        {
+                            if (j == i) continue;
+                            cand.emplace_back(batchNodes[j], index->ComputeDistance(index->GetSample(node), index->GetSample(batchNodes[j])));
+                        }
+                        std::sort(cand.begin(), cand.end(), [](const BasicResult& a, const BasicResult& b) { return a.Dist < b.Dist || (a.Dist == b.Dist && a.VID < b.VID); });
+                        RebuildNeighbors(index, node, staged.data() + (size_t)i * m_iNeighborhoodSize, cand.data(), (int)cand.size());
+                    }
+
+                    reverseEdges.clear();
+                    for (SizeType i = 0; i < batch; i++)
+                    {
+                        {
+                            std::lock_guard<std::mutex> lock(m_dataUpdateLock[batchNodes[i]]);
+                            memcpy(m_pNeighborhoodGraph[batchNodes[i]], staged.data() + (size_t)i * m_iNeighborhoodSize, sizeof(SizeType) * m_iNeighborhoodSize);
+                        }
+                        for (const BasicResult& item : candidates[i])
+                        {
+                            // chunk members already saw each other as candidates when their own lists were built
+                            if (chunkSet.count(item.VID)) continue;
+                            Edge e;
+                            e.node = item.VID;
+                            e.tonode = batchNodes[i];
+                            e.distance = item.Dist;
+                            reverseEdges.push_back(e);
+                        }
+                    }
+                    if (reverseEdges.empty()) continue;
+
+                    std::sort(reverseEdges.begin(), reverseEdges.end(), EdgeCompare());
+                    groups.clear();
+                    for (size_t i = 0; i < reverseEdges.size(); i++)
+                    {
+                        if (i == 0 || reverseEdges[i].node != reverseEdges[i - 1].node) groups.push_back(i);
+                    }
+                    groups.push_back(reverseEdges.size());
+
+#pragma omp parallel for schedule(dynamic) num_threads(min(numThreads, (int)groups.size() - 1))
+                    for (int g = 0; g < (int)groups.size() - 1; g++)
+                    {
+                        InsertNeighborsBatch(index, reverseEdges[groups[g]].node, reverseEdges.data() + groups[g], (int)(groups[g + 1] - groups[g]));
+                    }
+                }
+            }
+
             inline std::uint64_t BufferSize() const
             {
                 return m_pNeighborhoodGraph.BufferSize();
@@ -685,7 +1101,7 @@ break;
             int m_iTPTNumber, m_iTPTLeafSize, m_iSamples, m_numTopDimensionTPTSplit;
             DimensionType m_iNeighborhoodSize;
             float m_fNeighborhoodScale, m_fCEFScale, m_fRNGFactor;
-            int m_iRefineIter, m_iCEF, m_iAddCEF, m_iMaxCheckForRefineGraph, m_iGPUGraphType, m_iGPURefineSteps, m_iGPURefineDepth, m_iGPULeafSize, m_iheadNumGPUs, m_iTPTBalanceFactor, m_rebuild;
+            int m_iRefineIter, m_iCEF, m_iAddCEF, m_iMaxCheckForRefineGraph, m_iGPUGraphType, m_iGPURefineSteps, m_iGPURefineDepth, m_iGPULeafSize, m_iheadNumGPUs, m_iTPTBalanceFactor, m_rebuild, m_iNNDescentIter;
         };
     }
 }
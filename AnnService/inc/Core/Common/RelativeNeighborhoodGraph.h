@@ -39,17 +39,42 @@ namespace SPTAG
             {                
                 SizeType* nodes = m_pNeighborhoodGraph[node];
                 const void* nodeVec = index->GetSample(node);
-                const void* insertVec = index->GetSample(insertNode);
                 
                 std::lock_guard<std::mutex> lock(m_dataUpdateLock[node]);
 
                 _mm_prefetch((const char*)nodes, _MM_HINT_T0);
                 _mm_prefetch((const char*)(nodeVec), _MM_HINT_T0);
-                _mm_prefetch((const char*)(insertVec), _MM_HINT_T0);
                 for (DimensionType i = 0; i < m_iNeighborhoodSize; i++) {
                     _mm_prefetch((const char*)(index->GetSample(nodes[i])), _MM_HINT_T0);
                 }
 
+                InsertNeighborLocked(index, nodes, nodeVec, insertNode, insertDist);
+            }
+
+            void InsertNeighborsBatch(VectorIndex* index, const SizeType node, const Edge* inserts, int num)
+            {
+                SizeType* nodes = m_pNeighborhoodGraph[node];
+                const void* nodeVec = index->GetSample(node);
+
+                std::lock_guard<std::mutex> lock(m_dataUpdateLock[node]);
+
+                _mm_prefetch((const char*)nodes, _MM_HINT_T0);
+                _mm_prefetch((const char*)(nodeVec), _MM_HINT_T0);
+                for (DimensionType i = 0; i < m_iNeighborhoodSize; i++) {
+                    _mm_prefetch((const char*)(index->GetSample(nodes[i])), _MM_HINT_T0);
+                }
+
+                for (int i = 0; i < num; i++) {
+                    InsertNeighborLocked(index, nodes, nodeVec, inserts[i].tonode, inserts[i].distance);
+                }
+            }
+
+        private:
+            void InsertNeighborLocked(VectorIndex* index, SizeType* nodes, const void* nodeVec, SizeType insertNode, float insertDist)
+            {
+                const void* insertVec = index->GetSample(insertNode);
+                _mm_prefetch((const char*)(insertVec), _MM_HINT_T0);
+
                 SizeType tmpNode;
                 float tmpDist;
                 const void* tmpVec;
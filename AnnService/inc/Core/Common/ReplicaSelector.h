@@ -0,0 +1,126 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef _SPTAG_COMMON_REPLICASELECTOR_H_
+#define _SPTAG_COMMON_REPLICASELECTOR_H_
+
+#include <xmmintrin.h>
+#include "../VectorIndex.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace SPTAG
+{
+    namespace COMMON
+    {
+        // Picks the postings a vector is stored in from its nearest heads with the RNG rule: a head is
+        // kept unless one already kept is closer to it, scaled by the RNG factor, than the vector is.
+        // The head samples are looked up and prefetched once per vector, the distances to the vector
+        // come from the head search, and the head to head distances are remembered in a small direct
+        // mapped cache, since nearby vectors check the same pairs. One selector serves one thread, and
+        // its cache is only valid while the head ids keep their vectors.
+        class ReplicaSelector
+        {
+        public:
+            ReplicaSelector(int p_cacheSize = 0) : m_shift(64), m_rejected(0)
+            {
+                if (p_cacheSize <= 0) return;
+
+                int bits = 0;
+                while ((1 << bits) < p_cacheSize && bits < 30) bits++;
+                m_cache.resize((std::size_t)1 << bits);
+                m_shift = 64 - bits;
+                Clear();
+            }
+
+            ~ReplicaSelector() {}
+
+            void Clear()
+            {
+                for (auto& entry : m_cache) entry.m_key = c_emptyKey;
+            }
+
+            // p_candidates are the head search results of the vector, sorted by distance.
+            int Select(const VectorIndex* p_index, const BasicResult* p_candidates, int p_candidateNum, int p_replicaCount, float p_rngFactor)
+            {
+                m_selected.clear();
+                m_selectedSamples.clear();
+                m_samples.clear();
+                for (int i = 0; i < p_candidateNum && p_candidates[i].VID >= 0; i++)
+                {
+                    m_samples.push_back(p_index->GetSample(p_candidates[i].VID));
+                    _mm_prefetch((const char*)(m_samples.back()), _MM_HINT_T0);
+                }
+
+                for (int i = 0; i < (int)m_samples.size() && (int)m_selected.size() < p_replicaCount; i++)
+                {
+                    const BasicResult& candidate = p_candidates[i];
+                    bool accepted = true;
+                    for (int j = 0; j < (int)m_selected.size(); j++)
+                    {
+                        if (p_rngFactor * Distance(p_index, candidate.VID, m_samples[i], m_selected[j].VID, m_selectedSamples[j]) <= candidate.Dist)
+                        {
+                            accepted = false;
+                            break;
+                        }
+                    }
+
+                    if (!accepted)
+                    {
+                        m_rejected++;
+                        continue;
+                    }
+                    m_selected.push_back(candidate);
+                    m_selectedSamples.push_back(m_samples[i]);
+                }
+                return (int)m_selected.size();
+            }
+
+            inline int Count() const { return (int)m_selected.size(); }
+
+            inline const BasicResult& operator[](int p_index) const { return m_selected[p_index]; }
+
+            // Candidates turned down by the RNG rule since the selector was created.
+            inline std::size_t Rejected() const { return m_rejected; }
+
+        private:
+            struct Entry
+            {
+                std::uint64_t m_key;
+
+                float m_dist;
+            };
+
+            static const std::uint64_t c_emptyKey = ~(std::uint64_t)0;
+
+            float Distance(const VectorIndex* p_index, SizeType p_a, const void* p_sampleA, SizeType p_b, const void* p_sampleB)
+            {
+                if (m_cache.empty()) return p_index->ComputeDistance(p_sampleA, p_sampleB);
+
+                std::uint64_t key = (p_a < p_b) ? (((std::uint64_t)p_a << 32) | (std::uint32_t)p_b) : (((std::uint64_t)p_b << 32) | (std::uint32_t)p_a);
+                Entry& entry = m_cache[(key * 0x9E3779B97F4A7C15ULL) >> m_shift];
+                if (entry.m_key != key)
+                {
+                    entry.m_key = key;
+                    entry.m_dist = p_index->ComputeDistance(p_sampleA, p_sampleB);
+                }
+                return entry.m_dist;
+            }
+
+            std::vector<Entry> m_cache;
+
+            int m_shift;
+
+            std::vector<const void*> m_samples;
+
+            std::vector<BasicResult> m_selected;
+
+            std::vector<const void*> m_selectedSamples;
+
+            std::size_t m_rejected;
+        };
+    }
+}
+
+#endif // _SPTAG_COMMON_REPLICASELECTOR_H_
@@ -0,0 +1,104 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef _SPTAG_COMMON_SCALARQUANTIZER_H_
+#define _SPTAG_COMMON_SCALARQUANTIZER_H_
+
+#include "../Common.h"
+#include "CommonUtils.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace SPTAG
+{
+    namespace COMMON
+    {
+        // Maps vectors to int8 codes with an offset per dimension and one scale shared by all of them,
+        // so L2 distances between codes stay proportional to the original ones. For cosine the offset
+        // is zero and the scale takes the normalization base of the input type to the int8 base, so
+        // the codes are normalized int8 vectors.
+        class ScalarQuantizer
+        {
+        public:
+            ScalarQuantizer() : m_scale(1) {}
+
+            ~ScalarQuantizer() {}
+
+            inline DimensionType GetDim() const { return (DimensionType)m_offset.size(); }
+
+            // Trains on the p_count vectors returned by p_vector(i).
+            template <typename T, typename Getter>
+            void Train(Getter p_vector, SizeType p_count, DimensionType p_dim, DistCalcMethod p_distMethod)
+            {
+                m_offset.assign(p_dim, 0);
+                if (p_distMethod == DistCalcMethod::Cosine)
+                {
+                    m_scale = (float)Utils::GetBase<std::int8_t>() / Utils::GetBase<T>();
+                    return;
+                }
+
+                std::vector<float> low(p_dim, FLT_MAX), high(p_dim, -FLT_MAX);
+                for (SizeType i = 0; i < p_count; i++)
+                {
+                    const T* vector = p_vector(i);
+                    for (DimensionType d = 0; d < p_dim; d++)
+                    {
+                        float value = (float)vector[d];
+                        if (value < low[d]) low[d] = value;
+                        if (value > high[d]) high[d] = value;
+                    }
+                }
+
+                float range = 0;
+                for (DimensionType d = 0; d < p_dim; d++)
+                {
+                    if (low[d] > high[d]) continue;
+                    m_offset[d] = (low[d] + high[d]) / 2;
+                    range = max(range, (high[d] - low[d]) / 2);
+                }
+                m_scale = (range > 0) ? c_maxCode / range : 1;
+            }
+
+            template <typename T>
+            void Quantize(const T* p_vector, std::int8_t* p_code) const
+            {
+                for (DimensionType d = 0; d < GetDim(); d++)
+                {
+                    float code = std::round(((float)p_vector[d] - m_offset[d]) * m_scale);
+                    p_code[d] = (std::int8_t)((code > c_maxCode) ? c_maxCode : ((code < -c_maxCode) ? -c_maxCode : code));
+                }
+            }
+
+            ErrorCode Save(std::shared_ptr<Helper::DiskPriorityIO> p_out) const
+            {
+                DimensionType dim = GetDim();
+                IOBINARY(p_out, WriteBinary, sizeof(dim), (char*)&dim);
+                IOBINARY(p_out, WriteBinary, sizeof(m_scale), (char*)&m_scale);
+                IOBINARY(p_out, WriteBinary, sizeof(float) * dim, (char*)m_offset.data());
+                return ErrorCode::Success;
+            }
+
+            ErrorCode Load(std::shared_ptr<Helper::DiskPriorityIO> p_in)
+            {
+                DimensionType dim;
+                IOBINARY(p_in, ReadBinary, sizeof(dim), (char*)&dim);
+                IOBINARY(p_in, ReadBinary, sizeof(m_scale), (char*)&m_scale);
+                m_offset.resize(dim);
+                IOBINARY(p_in, ReadBinary, sizeof(float) * dim, (char*)m_offset.data());
+                return ErrorCode::Success;
+            }
+
+        private:
+            static constexpr float c_maxCode = 127.0f;
+
+            float m_scale;
+
+            std::vector<float> m_offset;
+        };
+    }
+}
+
+#endif // _SPTAG_COMMON_SCALARQUANTIZER_H_
@@ -6,6 +6,7 @@
 
 #include "../VectorIndex.h"
 #include "QueryResultSet.h"
+#include "BruteForceKNN.h"
 
 namespace SPTAG
 {
@@ -167,26 +168,9 @@ namespace SPTAG
                     exit(-1);
                 }
 
-                std::vector< std::vector<SPTAG::SizeType> > truthset(querySet->Count(), std::vector<SPTAG::SizeType>(K, 0));
-                std::vector< std::vector<float> > distset(querySet->Count(), std::vector<float>(K, 0));
-#pragma omp parallel for
-                for (int i = 0; i < querySet->Count(); ++i)
-                {
-                    SPTAG::COMMON::QueryResultSet<T> query((const T*)(querySet->GetVector(i)), K);
-                    for (SPTAG::SizeType j = 0; j < vectorSet->Count(); j++)
-                    {
-                        float dist = SPTAG::COMMON::DistanceUtils::ComputeDistance(query.GetQuantizedTarget(), reinterpret_cast<T*>(vectorSet->GetVector(j)), vectorSet->Dimension(), distMethod);
-                        query.AddPoint(j, dist);
-                    }
-                    query.SortResult();
-
-                    for (int k = 0; k < K; k++)
-                    {
-                        truthset[i][k] = (query.GetResult(k))->VID;
-                        distset[i][k] = (query.GetResult(k))->Dist;
-                    }
-
-                }
+                std::vector< std::vector<SPTAG::SizeType> > truthset;
+                std::vector< std::vector<float> > distset;
+                BruteForceKNN::Search<T>(querySet, vectorSet, distMethod, K, truthset, distset);
 
                 writeTruthFile(truthFile, querySet->Count(), K, truthset, distset, p_truthFileType);
 
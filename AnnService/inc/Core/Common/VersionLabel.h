@@ -7,6 +7,10 @@
 #include <atomic>
 #include "Dataset.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 namespace SPTAG
 {
     namespace COMMON
@@ -77,6 +81,44 @@ namespace SPTAG
                 }
             }
 
+            // Collects the positions of the entries that are neither deleted nor carry a stale version.
+            // Each entry starts with its int vector id followed by the uint8 version it was written with.
+            inline int FilterValid(const char* p_entries, int p_num, int p_stride, int* p_valid) const
+            {
+                int count = 0;
+                int i = 0;
+#if defined(__AVX2__)
+                const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(p_stride));
+                const __m256i one = _mm256_set1_epi32(1);
+                const __m256i low7 = _mm256_set1_epi32(0x7f);
+                const __m256i high = _mm256_set1_epi32(0x80);
+                const __m256i byteMask = _mm256_set1_epi32(0xff);
+                alignas(32) int ids[8];
+                alignas(32) int labels[8];
+                for (; i + 8 <= p_num; i += 8)
+                {
+                    const char* base = p_entries + ((size_t)i) * p_stride;
+                    __m256i vids = _mm256_i32gather_epi32((const int*)base, offsets, 1);
+                    __m256i versions = _mm256_and_si256(_mm256_i32gather_epi32((const int*)(base + sizeof(int)), offsets, 1), byteMask);
+                    _mm256_store_si256((__m256i*)ids, vids);
+                    for (int j = 0; j < 8; j++) labels[j] = *m_data[ids[j]];
+
+                    // a live vector stores ((version - 1) & 0x7f) | 0x80, a deleted one stores 1
+                    __m256i expected = _mm256_or_si256(_mm256_and_si256(_mm256_sub_epi32(versions, one), low7), high);
+                    __m256i match = _mm256_cmpeq_epi32(_mm256_load_si256((const __m256i*)labels), expected);
+                    int mask = _mm256_movemask_ps(_mm256_castsi256_ps(match));
+                    for (int j = 0; j < 8; j++) if (mask & (1 << j)) p_valid[count++] = i + j;
+                }
+#endif
+                for (; i < p_num; i++)
+                {
+                    const char* entry = p_entries + ((size_t)i) * p_stride;
+                    std::uint8_t version = *((const std::uint8_t*)(entry + sizeof(int)));
+                    if (*m_data[*((const int*)entry)] == ((((std::uint8_t)(version - 1)) & 0x7f) | 0x80)) p_valid[count++] = i;
+                }
+                return count;
+            }
+
             inline SizeType GetVectorNum()
             {
                 return m_data.R();
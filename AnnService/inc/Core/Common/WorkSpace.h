@@ -4,49 +4,65 @@
 #ifndef _SPTAG_COMMON_WORKSPACE_H_
 #define _SPTAG_COMMON_WORKSPACE_H_
 
-#include "../SearchResult.h"
+#include "../SearchQuery.h"
 #include "CommonUtils.h"
 #include "Heap.h"
 
 #include <stdarg.h>
+#include <climits>
+#include <functional>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 namespace SPTAG
 {
     namespace COMMON
     {
+        // Set of visited ids that needs no clearing between searches. Slots are grouped in buckets of
+        // 8 that carry the generation they were last written in: clear() starts a new generation, and a
+        // bucket from an older one reads as empty and is wiped when a search first probes it. The table
+        // doubles once 3/4 of its slots are used, so it ends up sized to the largest search seen.
         class OptHashPosVector
         {
         protected:
-            // Max loop number in one hash block.
-            static const int m_maxLoop = 8;
-
-            // Could we use the second hash block.
-            bool m_secondHash;
+            static const int m_bucketSize = 8;
 
             int m_exp;
 
-            // Max pool size.
+            // Slot mask, the table has m_poolSize + 1 slots.
             int m_poolSize;
 
-            // Record 2 hash tables.
-            // [0~m_poolSize + 1) is the first block.
-            // [m_poolSize + 1, 2*(m_poolSize + 1)) is the second block;
+            // Ids stored in the current generation.
+            int m_count;
+
+            std::uint32_t m_generation;
+
             std::unique_ptr<SizeType[]> m_hashTable;
 
+            std::unique_ptr<std::uint32_t[]> m_bucketGeneration;
 
-            inline unsigned hash_func2(unsigned idx, int poolSize, int loop)
+
+            inline unsigned hash_func(unsigned idx, int poolSize)
             {
-                return (idx + loop) & poolSize;
+                return ((unsigned)(idx * 99991) + _rotl(idx, 2) + 101) & poolSize;
             }
 
+            inline int BucketCount() const { return (m_poolSize + 1) / m_bucketSize; }
 
-            inline unsigned hash_func(unsigned idx, int poolSize)
+            void Allocate(int poolSize)
             {
-                return ((unsigned)(idx * 99991) + _rotl(idx, 2) + 101) & poolSize;
+                m_poolSize = max(poolSize, m_bucketSize - 1);
+                m_hashTable.reset(new SizeType[m_poolSize + 1]);
+                m_bucketGeneration.reset(new std::uint32_t[BucketCount()]);
+                memset(m_bucketGeneration.get(), 0, sizeof(std::uint32_t) * BucketCount());
+                m_generation = 1;
+                m_count = 0;
             }
 
         public:
-            OptHashPosVector(): m_secondHash(false), m_exp(2), m_poolSize(8191) {}
+            OptHashPosVector(): m_exp(2), m_poolSize(8191), m_count(0), m_generation(1) {}
 
             ~OptHashPosVector() {}
 
@@ -58,25 +74,18 @@ namespace SPTAG
                     ex++;
                     size >>= 1;
                 }
-                m_secondHash = true;
                 m_exp = exp;
-                m_poolSize = (1 << (ex + exp)) - 1;
-                m_hashTable.reset(new SizeType[(m_poolSize + 1) * 2]);
-                clear();
+                Allocate((1 << (ex + exp)) - 1);
             }
 
             void clear()
             {
-                if (!m_secondHash)
-                {
-                    // Clear first block.
-                    memset(m_hashTable.get(), 0, sizeof(SizeType) * (m_poolSize + 1));
-                }
-                else
+                m_count = 0;
+                if (++m_generation == 0)
                 {
-                    // Clear all blocks.
-                    m_secondHash = false;
-                    memset(m_hashTable.get(), 0, 2 * sizeof(SizeType) * (m_poolSize + 1));
+                    // Stamps wrapped around, old buckets could look current again.
+                    memset(m_bucketGeneration.get(), 0, sizeof(std::uint32_t) * BucketCount());
+                    m_generation = 1;
                 }
             }
 
@@ -87,54 +96,95 @@ namespace SPTAG
             inline bool CheckAndSet(SizeType idx)
             {
                 // Inner Index is begin from 1
-                return _CheckAndSet(m_hashTable.get(), m_poolSize, true, idx + 1) == 0;
+                return _CheckAndSet(idx + 1) == 0;
             }
 
-            inline void DoubleSize()
+            // Must be called before CheckAndSetConcurrent with the number of ids the threads may add. It grows
+            // the table to hold them and wipes the buckets of older generations, which the threads cannot do.
+            inline void PrepareConcurrent(int p_count)
             {
-                int new_poolSize = ((m_poolSize + 1) << 1) - 1; 
-                SizeType* new_hashTable = new SizeType[(new_poolSize + 1) * 2];
-                memset(new_hashTable, 0, sizeof(SizeType) * (new_poolSize + 1) * 2);
-
-                m_secondHash = false;
-                for (int i = 0; i <= new_poolSize; i++)
-                    if (m_hashTable[i]) _CheckAndSet(new_hashTable, new_poolSize, true, m_hashTable[i]);
-
-                m_exp++;
-                m_poolSize = new_poolSize;
-                m_hashTable.reset(new_hashTable);
+                while (m_count + p_count >= BucketCount() * m_bucketSize / 4 * 3) DoubleSize();
+                for (int b = 0; b < BucketCount(); b++)
+                {
+                    if (m_bucketGeneration[b] == m_generation) continue;
+                    memset(m_hashTable.get() + (size_t)b * m_bucketSize, 0, sizeof(SizeType) * m_bucketSize);
+                    m_bucketGeneration[b] = m_generation;
+                }
+                m_count += p_count;
             }
 
-            inline int _CheckAndSet(SizeType* hashTable, int poolSize, bool isFirstTable, SizeType idx)
+            // CheckAndSet for several threads sharing the table. The table cannot grow while they run, so an
+            // index that finds it full is reported as unseen and callers must tolerate seeing it twice.
+            inline bool CheckAndSetConcurrent(SizeType idx)
             {
-                unsigned index = hash_func((unsigned)idx, poolSize);
-                for (int loop = 0; loop < m_maxLoop; ++loop)
+                idx++;
+                unsigned bucketMask = (unsigned)(BucketCount() - 1);
+                unsigned b = hash_func((unsigned)idx, m_poolSize) / m_bucketSize;
+                for (unsigned i = 0; i <= bucketMask; i++, b = (b + 1) & bucketMask)
                 {
-                    if (!hashTable[index])
+                    SizeType* bucket = m_hashTable.get() + (size_t)b * m_bucketSize;
+                    for (int j = 0; j < m_bucketSize; j++)
                     {
-                        // index first match and record it.
-                        hashTable[index] = idx;
-                        return 1;
-                    }
-                    if (hashTable[index] == idx)
-                    {
-                        // Hit this item in hash table.
-                        return 0;
+                        SizeType old = InterlockedCompareExchange(bucket + j, idx, 0);
+                        if (old == 0) return false;
+                        if (old == idx) return true;
                     }
-                    // Get next hash position.
-                    index = hash_func2(index, poolSize, loop);
                 }
+                return false;
+            }
 
-                if (isFirstTable)
+            inline void DoubleSize()
+            {
+                std::unique_ptr<SizeType[]> oldTable(std::move(m_hashTable));
+                std::unique_ptr<std::uint32_t[]> oldGeneration(std::move(m_bucketGeneration));
+                std::uint32_t generation = m_generation;
+                int oldBuckets = BucketCount();
+
+                m_exp++;
+                Allocate(((m_poolSize + 1) << 1) - 1);
+                for (int b = 0; b < oldBuckets; b++)
                 {
-                    // Use second hash block.
-                    m_secondHash = true;
-                    return _CheckAndSet(hashTable + poolSize + 1, poolSize, false, idx);
+                    if (oldGeneration[b] != generation) continue;
+                    for (int j = 0; j < m_bucketSize && oldTable[(size_t)b * m_bucketSize + j]; j++)
+                        _CheckAndSet(oldTable[(size_t)b * m_bucketSize + j]);
                 }
+            }
 
-                DoubleSize();
-                LOG(Helper::LogLevel::LL_Error, "Hash table is full! Set HashTableExponent to larger value (default is 2). NewHashTableExponent=%d NewPoolSize=%d\n", m_exp, m_poolSize);
-                return _CheckAndSet(m_hashTable.get(), m_poolSize, true, idx);
+            // Returns 0 if idx is already in the table and 1 once it is added. Buckets fill front to back,
+            // so the first empty slot of a bucket ends its ids and a bucket with one ends the probing.
+            inline int _CheckAndSet(SizeType idx)
+            {
+                if (m_count >= BucketCount() * m_bucketSize / 4 * 3) DoubleSize();
+
+                unsigned bucketMask = (unsigned)(BucketCount() - 1);
+                for (unsigned b = hash_func((unsigned)idx, m_poolSize) / m_bucketSize; ; b = (b + 1) & bucketMask)
+                {
+                    SizeType* bucket = m_hashTable.get() + (size_t)b * m_bucketSize;
+                    if (m_bucketGeneration[b] != m_generation)
+                    {
+                        m_bucketGeneration[b] = m_generation;
+                        memset(bucket, 0, sizeof(SizeType) * m_bucketSize);
+                        bucket[0] = idx;
+                        m_count++;
+                        return 1;
+                    }
+#if defined(__AVX2__)
+                    __m256i keys = _mm256_loadu_si256((const __m256i*)bucket);
+                    if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(keys, _mm256_set1_epi32(idx)))) return 0;
+                    int empty = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(keys, _mm256_setzero_si256())));
+                    if (empty == 0) continue;
+                    int j = 0;
+                    while (!(empty & (1 << j))) j++;
+#else
+                    int j = 0;
+                    while (j < m_bucketSize && bucket[j] != 0 && bucket[j] != idx) j++;
+                    if (j == m_bucketSize) continue;
+                    if (bucket[j] == idx) return 0;
+#endif
+                    bucket[j] = idx;
+                    m_count++;
+                    return 1;
+                }
             }
         };
 
@@ -220,6 +270,8 @@ namespace SPTAG
                 m_iNumberOfTreeCheckedLeaves = 0;
                 m_iNumberOfCheckedLeaves = 0;
                 m_iMaxCheck = maxCheck;
+                m_progress = nullptr;
+                m_iNextProgress = INT_MAX;
             }
 
             void Initialize(va_list& arg)
@@ -241,6 +293,8 @@ namespace SPTAG
                 m_iNumberOfTreeCheckedLeaves = 0;
                 m_iNumberOfCheckedLeaves = 0;
                 m_iMaxCheck = maxCheck;
+                m_progress = nullptr;
+                m_iNextProgress = INT_MAX;
             }
 
             inline bool CheckAndSet(SizeType idx)
@@ -264,6 +318,12 @@ namespace SPTAG
             int m_iNumberOfCheckedLeaves;
             int m_iMaxCheck;
 
+            // Called with the partial results once m_iNumberOfCheckedLeaves reaches m_iNextProgress,
+            // then again every m_iProgressInterval checked leaves.
+            const std::function<void(QueryResult&)>* m_progress = nullptr;
+            int m_iProgressInterval = 0;
+            int m_iNextProgress = INT_MAX;
+
             // Prioriy queue used for neighborhood graph
             Heap<NodeDistPair> m_NGQueue;
 
@@ -47,6 +47,12 @@ namespace SPTAG
                 return workSpace;
             }
 
+            // Only hands out an idle workspace, never allocates a new one.
+            bool TryRent(std::shared_ptr<T>& p_workSpace)
+            {
+                return m_workSpacePool.try_pop(p_workSpace);
+            }
+
             void Return(const std::shared_ptr<T>& p_workSpace)
             {
                 m_workSpacePool.push(p_workSpace);
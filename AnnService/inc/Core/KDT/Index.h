@@ -155,6 +155,7 @@ namespace SPTAG
             ErrorCode AddIndex(const void* p_data, SizeType p_vectorNum, DimensionType p_dimension, std::shared_ptr<MetadataSet> p_metadataSet, bool p_withMetaIndex = false, bool p_normalized = false);
             ErrorCode AddIndexId(const void* p_data, SizeType p_vectorNum, DimensionType p_dimension, int& beginHead, int& endHead)  { return ErrorCode::Undefined; }
             ErrorCode AddIndexIdx(SizeType begin, SizeType end) { return ErrorCode::Undefined; }
+            ErrorCode AddIndexIdxBatch(const std::vector<SizeType>& p_ids) { return ErrorCode::Undefined; }
             ErrorCode DeleteIndex(const void* p_vectors, SizeType p_vectorNum);
             ErrorCode DeleteIndex(const SizeType& p_id);
 
@@ -164,6 +165,9 @@ namespace SPTAG
 
             ErrorCode RefineIndex(const std::vector<std::shared_ptr<Helper::DiskPriorityIO>>& p_indexStreams, IAbortOperation* p_abort);
             ErrorCode RefineIndex(std::shared_ptr<VectorIndex>& p_newIndex);
+            ErrorCode CompactIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::vector<SizeType>& p_newToOld) { return ErrorCode::Undefined; }
+            ErrorCode ReorderIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::vector<SizeType>& p_newToOld) { return ErrorCode::Undefined; }
+            ErrorCode QuantizeIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::function<void(const void*, std::int8_t*)> p_quantize) { return ErrorCode::Undefined; }
 
             ErrorCode Append(SizeType headID, int appendNum, std::string& appendPosting) { return ErrorCode::Undefined; }
             ErrorCode Split(SizeType headID) { return ErrorCode::Undefined; }
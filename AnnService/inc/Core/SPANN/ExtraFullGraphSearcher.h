@@ -64,6 +64,56 @@ namespace SPTAG
                 m_end = end;
             }
 
+            // Sort the loaded batch and spill it as a sorted run so that LoadHeads can merge head ranges from disk.
+            void SaveSortedBatch()
+            {
+                VectorIndex::SortSelections(&m_selections);
+                m_runs.emplace_back(m_start, m_end);
+                SaveBatch();
+            }
+
+            // Load the selections of heads [beginHead, endHead) from every sorted run and merge them.
+            void LoadHeads(SizeType beginHead, SizeType endHead)
+            {
+                auto f_in = f_createIO();
+                if (f_in == nullptr || !f_in->Initialize(m_tmpfile.c_str(), std::ios::in | std::ios::binary)) {
+                    LOG(Helper::LogLevel::LL_Error, "Cannot open %s to load selection runs!\n", m_tmpfile.c_str());
+                    exit(1);
+                }
+
+                std::vector<size_t> bounds(1, 0);
+                std::vector<std::pair<size_t, size_t>> slices;
+                for (auto& run : m_runs) {
+                    size_t first = DiskLowerBound(f_in, run.first, run.second, beginHead);
+                    size_t last = DiskLowerBound(f_in, first, run.second, endHead);
+                    slices.emplace_back(first, last);
+                    bounds.push_back(bounds.back() + last - first);
+                }
+
+                m_selections.resize(bounds.back());
+                for (size_t i = 0; i < slices.size(); i++) {
+                    size_t readsize = slices[i].second - slices[i].first;
+                    if (readsize == 0) continue;
+                    if (f_in->ReadBinary(readsize * sizeof(Edge), (char*)(m_selections.data() + bounds[i]), slices[i].first * sizeof(Edge)) != readsize * sizeof(Edge)) {
+                        LOG(Helper::LogLevel::LL_Error, "Cannot read from %s! start:%zu size:%zu\n", m_tmpfile.c_str(), slices[i].first, readsize);
+                        exit(1);
+                    }
+                }
+
+                int runs = (int)slices.size();
+                auto base = m_selections.begin();
+                for (int step = 1; step < runs; step <<= 1) {
+#pragma omp parallel for schedule(dynamic,1)
+                    for (int i = 0; i < runs - step; i += (step << 1)) {
+                        std::inplace_merge(base + bounds[i], base + bounds[i + step], base + bounds[min(i + (step << 1), runs)], g_edgeComparer);
+                    }
+                }
+                m_start = 0;
+                m_end = m_selections.size();
+            }
+
+            bool HasRuns() const { return !m_runs.empty(); }
+
             size_t lower_bound(SizeType node)
             {
                 auto ptr = std::lower_bound(m_selections.begin(), m_selections.end(), node, g_edgeComparer);
@@ -77,6 +127,24 @@ namespace SPTAG
                 }
                 return m_selections[offset - m_start];
             }
+
+        private:
+            std::vector<std::pair<size_t, size_t>> m_runs;
+
+            size_t DiskLowerBound(std::shared_ptr<Helper::DiskPriorityIO>& f_in, size_t first, size_t last, SizeType node)
+            {
+                Edge edge;
+                while (first < last) {
+                    size_t mid = first + ((last - first) >> 1);
+                    if (f_in->ReadBinary(sizeof(Edge), (char*)&edge, mid * sizeof(Edge)) != sizeof(Edge)) {
+                        LOG(Helper::LogLevel::LL_Error, "Cannot read from %s! offset:%zu\n", m_tmpfile.c_str(), mid);
+                        exit(1);
+                    }
+                    if (g_edgeComparer(edge, node)) first = mid + 1;
+                    else last = mid;
+                }
+                return first;
+            }
         };
 
 #define ProcessPosting(vectorInfoSize) \
@@ -106,7 +174,7 @@ namespace SPTAG
                     auto curIndexFile = f_createAsyncIO();
                     if (curIndexFile == nullptr || !curIndexFile->Initialize(curFile.c_str(), std::ios::binary | std::ios::in, 
 #ifdef BATCH_READ
-                        p_opt.m_searchInternalResultNum, 2, 2, p_opt.m_iSSDNumberOfThreads
+                        p_opt.m_searchInternalResultNum, 2, 2, p_opt.GetSearchChannels()
 #else
                         p_opt.m_searchInternalResultNum * p_opt.m_iSSDNumberOfThreads / p_opt.m_ioThreads + 1, 2, 2, p_opt.m_ioThreads
 #endif
@@ -122,21 +190,167 @@ namespace SPTAG
                     curFile = m_extraFullGraphFile + "_" + std::to_string(m_indexFiles.size());
                 } while (fileexists(curFile.c_str()));
                 m_listPerFile = static_cast<int>((m_totalListCount + m_indexFiles.size() - 1) / m_indexFiles.size());
+                m_scanThreads = p_opt.m_searchScanThreads;
 
 #ifndef _MSC_VER
                 Helper::AIOTimeout.tv_nsec = p_opt.m_iotimeout * 1000;
+#endif
+#ifdef BATCH_READ
+                if (p_opt.m_asyncSearchThreads > 0 && !m_asyncDispatcher.Initialize(p_opt.m_asyncSearchThreads, p_opt.m_searchInternalResultNum * p_opt.GetAsyncSearchWorkSpaces())) {
+                    LOG(Helper::LogLevel::LL_Warning, "Cannot start async search threads, async search falls back to synchronous reads.\n");
+                }
 #endif
                 return true;
             }
 
+            virtual void SearchIndexAsync(ExtraWorkSpace* p_exWorkSpace,
+                QueryResult& p_queryResults,
+                const VectorIndex* p_index,
+                const COMMON::VersionLabel& m_versionMap,
+                std::function<void(ErrorCode)> p_callback)
+            {
+#ifdef BATCH_READ
+                if (!m_asyncDispatcher.IsReady())
+                {
+                    IExtraSearcher::SearchIndexAsync(p_exWorkSpace, p_queryResults, p_index, m_versionMap, std::move(p_callback));
+                    return;
+                }
+#endif
+                const uint32_t postingListCount = static_cast<uint32_t>(p_exWorkSpace->m_postingIDs.size());
+
+                p_exWorkSpace->m_deduper.clear();
+                p_exWorkSpace->m_asyncResults = &p_queryResults;
+                p_exWorkSpace->m_asyncIndex = p_index;
+                p_exWorkSpace->m_asyncStatus = ErrorCode::Success;
+                p_exWorkSpace->m_asyncCallback = std::move(p_callback);
+
+                std::vector<Helper::AsyncReadRequest*> requests;
+                requests.reserve(postingListCount);
+
+                bool oneContext = (m_indexFiles.size() == 1);
+                for (uint32_t pi = 0; pi < postingListCount; ++pi)
+                {
+                    auto curPostingID = p_exWorkSpace->m_postingIDs[pi];
+
+                    int fileid = 0;
+                    ListInfo* listInfo;
+                    if (oneContext) {
+                        listInfo = &(m_listInfos[0][curPostingID]);
+                    }
+                    else {
+                        fileid = curPostingID / m_listPerFile;
+                        listInfo = &(m_listInfos[fileid][curPostingID % m_listPerFile]);
+                    }
+
+                    if (listInfo->listEleCount == 0)
+                    {
+                        continue;
+                    }
+
+                    auto& request = p_exWorkSpace->m_asyncRequests[pi];
+                    request.m_offset = listInfo->listOffset;
+                    request.m_readSize = (static_cast<size_t>(listInfo->listPageCount) << PageSizeEx);
+                    request.m_buffer = (char*)((p_exWorkSpace->m_pageBuffers[pi]).GetBuffer());
+                    request.m_status = (fileid << 16) | p_exWorkSpace->m_spaceID;
+                    request.m_payload = (void*)listInfo;
+                    if (!request.m_callback)
+                    {
+                        request.m_callback = [this, p_exWorkSpace](Helper::AsyncReadRequest* request)
+                        {
+                            ScanAsyncPosting(p_exWorkSpace, request);
+                        };
+                    }
+                    requests.push_back(&request);
+                }
+
+                // The extra count is held until every read is submitted so that early completions
+                // cannot finish the query while it is still being issued.
+                int total = static_cast<int>(requests.size());
+                p_exWorkSpace->m_pendingReads = total + 1;
+#ifdef BATCH_READ
+                int submitted = m_asyncDispatcher.Submit(m_indexFiles, requests.data(), total);
+#else
+                int submitted = 0;
+                while (submitted < total && m_indexFiles[requests[submitted]->m_status >> 16]->ReadFileAsync(*(requests[submitted]))) submitted++;
+#endif
+                if (submitted < total)
+                {
+                    LOG(Helper::LogLevel::LL_Error, "Failed to submit %d of %d posting reads!\n", total - submitted, total);
+                    p_exWorkSpace->m_asyncStatus = ErrorCode::DiskIOFail;
+                    p_exWorkSpace->m_pendingReads -= (total - submitted);
+                }
+                FinishAsyncRead(p_exWorkSpace);
+            }
+
+            // The reads go through the aio context of the workspace channel, like the reads of the search
+            // itself, and are only waited for when the search starts.
+            virtual void PrefetchPostings(ExtraWorkSpace* p_exWorkSpace, const std::vector<int>& p_postingIDs)
+            {
+#ifdef BATCH_READ
+                int slots = static_cast<int>(p_exWorkSpace->m_pageBuffers.size());
+                if (p_exWorkSpace->m_prefetchBuffers.size() < slots)
+                {
+                    p_exWorkSpace->m_prefetchBuffers.resize(slots);
+                    for (auto& buffer : p_exWorkSpace->m_prefetchBuffers) buffer.ReservePageBuffer(p_exWorkSpace->m_pageBuffers[0].GetPageSize());
+                    p_exWorkSpace->m_prefetchRequests.resize(slots);
+                }
+                p_exWorkSpace->m_prefetchInFlight.resize(m_indexFiles.size(), 0);
+
+                bool oneContext = (m_indexFiles.size() == 1);
+                for (int postingID : p_postingIDs)
+                {
+                    int slot = static_cast<int>(p_exWorkSpace->m_prefetchIDs.size());
+                    if (slot >= slots) break;
+                    if (std::find(p_exWorkSpace->m_prefetchIDs.begin(), p_exWorkSpace->m_prefetchIDs.end(), postingID) != p_exWorkSpace->m_prefetchIDs.end()) continue;
+
+                    int fileid = 0;
+                    ListInfo* listInfo;
+                    if (oneContext) {
+                        listInfo = &(m_listInfos[0][postingID]);
+                    }
+                    else {
+                        fileid = postingID / m_listPerFile;
+                        listInfo = &(m_listInfos[fileid][postingID % m_listPerFile]);
+                    }
+
+                    if (listInfo->listEleCount == 0)
+                    {
+                        continue;
+                    }
+
+                    auto& request = p_exWorkSpace->m_prefetchRequests[slot];
+                    request.m_offset = listInfo->listOffset;
+                    request.m_readSize = (static_cast<size_t>(listInfo->listPageCount) << PageSizeEx);
+                    request.m_buffer = (char*)((p_exWorkSpace->m_prefetchBuffers[slot]).GetBuffer());
+                    request.m_status = (fileid << 16) | p_exWorkSpace->m_spaceID;
+                    request.m_payload = (void*)listInfo;
+                    if (!m_indexFiles[fileid]->ReadFileAsync(request)) continue;
+
+                    p_exWorkSpace->m_prefetchIDs.push_back(postingID);
+                    p_exWorkSpace->m_prefetchInFlight[fileid]++;
+                }
+#endif
+            }
+
+            virtual void DropPrefetch(ExtraWorkSpace* p_exWorkSpace)
+            {
+#ifdef BATCH_READ
+                int diskRead = 0, diskIO = 0;
+                double readLatency = 0;
+                WaitPrefetch(p_exWorkSpace, diskRead, diskIO, readLatency);
+#endif
+                p_exWorkSpace->m_prefetchIDs.clear();
+            }
+
             virtual void SearchIndex(ExtraWorkSpace* p_exWorkSpace,
                 QueryResult& p_queryResults,
-                std::shared_ptr<VectorIndex> p_index,
+                const VectorIndex* p_index,
                 SearchStats* p_stats, const COMMON::VersionLabel& m_versionMap, std::set<int>* truth, std::map<int, std::set<int>>* found)
             {
+                auto exStart = std::chrono::high_resolution_clock::now();
                 const uint32_t postingListCount = static_cast<uint32_t>(p_exWorkSpace->m_postingIDs.size());
 
-                p_exWorkSpace->m_deduper.clear();
+                if (!p_exWorkSpace->m_resumeSearch) p_exWorkSpace->m_deduper.clear();
 
                 COMMON::QueryResultSet<ValueType>& queryResults = *((COMMON::QueryResultSet<ValueType>*)&p_queryResults);
  
@@ -144,9 +358,20 @@ namespace SPTAG
                 int diskIO = 0;
                 int listElements = 0;
 
+                // Microseconds spent scanning postings and waiting for reads; the rest of the call is submission.
+                double scanLatency = 0;
+                double readLatency = 0;
+
 #if defined(ASYNC_READ) && !defined(BATCH_READ)
                 int unprocessed = 0;
 #endif
+#ifdef BATCH_READ
+                WaitPrefetch(p_exWorkSpace, diskRead, diskIO, readLatency);
+
+                // Postings left to a parallel scan once all of them are read.
+                bool parallelScan = (m_scanThreads > 1 && truth == nullptr);
+                std::vector<Helper::AsyncReadRequest*> scanRequests;
+#endif
 
                 bool oneContext = (m_indexFiles.size() == 1);
                 for (uint32_t pi = 0; pi < postingListCount; ++pi)
@@ -172,6 +397,25 @@ namespace SPTAG
                         continue;
                     }
 
+#ifdef BATCH_READ
+                    int slot = (truth == nullptr) ? FindPrefetch(p_exWorkSpace, curPostingID) : -1;
+                    if (slot >= 0)
+                    {
+                        p_exWorkSpace->m_diskRequests[pi].m_readSize = 0;
+                        listElements += listInfo->listEleCount;
+                        if (parallelScan)
+                        {
+                            scanRequests.push_back(&(p_exWorkSpace->m_prefetchRequests[slot]));
+                            continue;
+                        }
+                        char* buffer = p_exWorkSpace->m_prefetchRequests[slot].m_buffer;
+                        auto scanBegin = std::chrono::high_resolution_clock::now();
+                        ProcessPosting(m_vectorInfoSize)
+                        scanLatency += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - scanBegin).count();
+                        continue;
+                    }
+#endif
+
                     diskRead += listInfo->listPageCount;
                     diskIO += 1;
                     listElements += listInfo->listEleCount;
@@ -188,13 +432,21 @@ namespace SPTAG
                     request.m_payload = (void*)listInfo;
 
 #ifdef BATCH_READ
+                    if (parallelScan)
+                    {
+                        request.m_callback = [](Helper::AsyncReadRequest* request) { request->m_readSize = 0; };
+                        scanRequests.push_back(&request);
+                        continue;
+                    }
                     auto vectorInfoSize = m_vectorInfoSize;
-                    request.m_callback = [&p_exWorkSpace, &queryResults, &p_index, vectorInfoSize](Helper::AsyncReadRequest* request)
+                    request.m_callback = [&p_exWorkSpace, &queryResults, &p_index, &scanLatency, vectorInfoSize](Helper::AsyncReadRequest* request)
                     {
                         request->m_readSize = 0;
                         char* buffer = request->m_buffer;
                         ListInfo* listInfo = (ListInfo*)(request->m_payload);
+                        auto scanBegin = std::chrono::high_resolution_clock::now();
                         ProcessPosting(vectorInfoSize)
+                        scanLatency += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - scanBegin).count();
                     };
 #else
                     request.m_callback = [&p_exWorkSpace](Helper::AsyncReadRequest* request)
@@ -210,16 +462,22 @@ namespace SPTAG
                     }
 #endif
 #else
+                    auto readBegin = std::chrono::high_resolution_clock::now();
                     auto numRead = indexFile->ReadBinary(totalBytes, buffer, listInfo->listOffset);
                     if (numRead != totalBytes) {
                         LOG(Helper::LogLevel::LL_Error, "File %s read bytes, expected: %zu, acutal: %llu.\n", m_extraFullGraphFile.c_str(), totalBytes, numRead);
                         exit(-1);
                     }
+                    auto scanBegin = std::chrono::high_resolution_clock::now();
+                    readLatency += std::chrono::duration<double, std::micro>(scanBegin - readBegin).count();
                     ProcessPosting(m_vectorInfoSize)
+                    scanLatency += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - scanBegin).count();
 #endif
                 }
 
 #ifdef ASYNC_READ
+                auto waitBegin = std::chrono::high_resolution_clock::now();
+                double scanBeforeWait = scanLatency;
 #ifdef BATCH_READ
                 BatchReadFileAsync(m_indexFiles, (p_exWorkSpace->m_diskRequests).data(), postingListCount);
 #else
@@ -231,9 +489,20 @@ namespace SPTAG
                     --unprocessed;
                     char* buffer = request->m_buffer;
                     ListInfo* listInfo = static_cast<ListInfo*>(request->m_payload);
+                    auto scanBegin = std::chrono::high_resolution_clock::now();
                     ProcessPosting(m_vectorInfoSize)
+                    scanLatency += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - scanBegin).count();
                 }
 #endif
+                readLatency += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - waitBegin).count() - (scanLatency - scanBeforeWait);
+#endif
+#ifdef BATCH_READ
+                if (!scanRequests.empty())
+                {
+                    auto scanBegin = std::chrono::high_resolution_clock::now();
+                    ParallelScan(p_exWorkSpace, queryResults, p_index, scanRequests);
+                    scanLatency += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - scanBegin).count();
+                }
 #endif
                 if (truth) {
                     for (uint32_t pi = 0; pi < postingListCount; ++pi)
@@ -253,9 +522,13 @@ namespace SPTAG
 
                 if (p_stats) 
                 {
+                    double totalLatency = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - exStart).count();
                     p_stats->m_totalListElementsCount = listElements;
                     p_stats->m_diskIOCount = diskIO;
                     p_stats->m_diskAccessCount = diskRead;
+                    p_stats->m_compLatency = scanLatency / 1000;
+                    p_stats->m_diskReadLatency = readLatency / 1000;
+                    p_stats->m_exSetUpLatency = max(totalLatency - scanLatency - readLatency, 0.0) / 1000;
                 }
             }
 
@@ -294,10 +567,12 @@ namespace SPTAG
 
                 SizeType fullCount = 0;
                 size_t vectorInfoSize = 0;
+                DimensionType dimension = 0;
                 {
-                    auto fullVectors = p_reader->GetVectorSet();
-                    fullCount = fullVectors->Count();
-                    vectorInfoSize = fullVectors->PerVectorDataSize() + sizeof(int);
+                    auto firstVector = p_reader->GetVectorSet(0, 1);
+                    fullCount = p_reader->GetVectorCount();
+                    dimension = firstVector->Dimension();
+                    vectorInfoSize = firstVector->PerVectorDataSize() + sizeof(int);
                 }
 
                 Selection selections(static_cast<size_t>(fullCount) * p_opt.m_replicaCount, p_opt.m_tmpdir);
@@ -346,7 +621,7 @@ namespace SPTAG
                         acc = acc / sampleNum;
                         LOG(Helper::LogLevel::LL_Info, "Batch %d vector(%d,%d) loaded with %d vectors (%zu) HeadIndex acc @%d:%f.\n", i, start, end, fullVectors->Count(), selections.m_selections.size(), candidateNum, acc);
 
-                        p_headIndex->ApproximateRNG(fullVectors, emptySet, candidateNum, selections.m_selections.data(), p_opt.m_replicaCount, numThreads, p_opt.m_gpuSSDNumTrees, p_opt.m_gpuSSDLeafSize, p_opt.m_rngFactor, p_opt.m_numGPUs);
+                        p_headIndex->ApproximateRNG(fullVectors, emptySet, candidateNum, selections.m_selections.data(), p_opt.m_replicaCount, numThreads, p_opt.m_gpuSSDNumTrees, p_opt.m_gpuSSDLeafSize, p_opt.m_rngFactor, p_opt.m_numGPUs, p_opt.m_rngPairCacheSize);
 
                         for (SizeType j = start; j < end; j++) {
                             replicaCount[j] = 0;
@@ -360,16 +635,18 @@ namespace SPTAG
                             }
                         }
 
-                        if (p_opt.m_batches > 1) selections.SaveBatch();
+                        if (p_opt.m_batches > 1) selections.SaveSortedBatch();
                     }
                 }
                 auto t2 = std::chrono::high_resolution_clock::now();
                 LOG(Helper::LogLevel::LL_Info, "Searching replicas ended. Search Time: %.2lf mins\n", ((double)std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count()) / 60.0);
 
-                if (p_opt.m_batches > 1) selections.LoadBatch(0, static_cast<size_t>(fullCount) * p_opt.m_replicaCount);
-
-                // Sort results either in CPU or GPU
-                VectorIndex::SortSelections(&selections.m_selections);
+                // Sort results either in CPU or GPU. Batched builds already spilled every batch as a sorted run,
+                // and those runs are merged one posting file at a time below.
+                if (p_opt.m_batches == 1) {
+                    if (p_opt.m_ssdIndexFileNum > 1) selections.SaveSortedBatch();
+                    else VectorIndex::SortSelections(&selections.m_selections);
+                }
 
                 auto t3 = std::chrono::high_resolution_clock::now();
                 LOG(Helper::LogLevel::LL_Info, "Time to sort selections:%.2lf sec.\n", ((double)std::chrono::duration_cast<std::chrono::seconds>(t3 - t2).count()) + ((double)std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count()) / 1000);
@@ -397,19 +674,50 @@ namespace SPTAG
                     }
                 }
 
-#pragma omp parallel for schedule(dynamic)
-                for (int i = 0; i < postingListSize.size(); ++i)
-                {
-                    if (postingListSize[i] <= postingSizeLimit) continue;
+                size_t postingFileSize = (postingListSize.size() + p_opt.m_ssdIndexFileNum - 1) / p_opt.m_ssdIndexFileNum;
+                for (int i = 0; i < p_opt.m_ssdIndexFileNum; i++) {
+                    size_t curPostingListOffSet = i * postingFileSize;
+                    size_t curPostingListEnd = min(postingListSize.size(), (i + 1) * postingFileSize);
 
-                    std::size_t selectIdx = std::lower_bound(selections.m_selections.begin(), selections.m_selections.end(), i, Selection::g_edgeComparer) - selections.m_selections.begin();
+                    if (selections.HasRuns()) selections.LoadHeads((SizeType)curPostingListOffSet, (SizeType)curPostingListEnd);
 
-                    for (size_t dropID = postingSizeLimit; dropID < postingListSize[i]; ++dropID)
+#pragma omp parallel for schedule(dynamic)
+                    for (int j = (int)curPostingListOffSet; j < (int)curPostingListEnd; ++j)
                     {
-                        int tonode = selections.m_selections[selectIdx + dropID].tonode;
-                        --replicaCount[tonode];
+                        if (postingListSize[j] <= postingSizeLimit) continue;
+
+                        std::size_t selectIdx = std::lower_bound(selections.m_selections.begin(), selections.m_selections.end(), j, Selection::g_edgeComparer) - selections.m_selections.begin();
+
+                        for (size_t dropID = postingSizeLimit; dropID < postingListSize[j]; ++dropID)
+                        {
+                            int tonode = selections.m_selections[selectIdx + dropID].tonode;
+                            --replicaCount[tonode];
+                        }
+                        postingListSize[j] = postingSizeLimit;
                     }
-                    postingListSize[i] = postingSizeLimit;
+
+                    std::vector<int> curPostingListSizes(
+                        postingListSize.begin() + curPostingListOffSet,
+                        postingListSize.begin() + curPostingListEnd);
+
+                    std::unique_ptr<int[]> postPageNum;
+                    std::unique_ptr<std::uint16_t[]> postPageOffset;
+                    std::vector<int> postingOrderInIndex;
+                    SelectPostingOffset(vectorInfoSize, curPostingListSizes, postPageNum, postPageOffset, postingOrderInIndex);
+
+                    OutputSSDIndexFile((i == 0) ? outputFile : outputFile + "_" + std::to_string(i),
+                        vectorInfoSize,
+                        curPostingListSizes,
+                        selections,
+                        postPageNum,
+                        postPageOffset,
+                        postingOrderInIndex,
+                        p_reader,
+                        p_opt,
+                        fullCount,
+                        dimension,
+                        batchSize,
+                        curPostingListOffSet);
                 }
 
                 if (p_opt.m_outputEmptyReplicaID)
@@ -443,46 +751,6 @@ namespace SPTAG
                     }
                 }
 
-                auto t4 = std::chrono::high_resolution_clock::now();
-                LOG(SPTAG::Helper::LogLevel::LL_Info, "Time to perform posting cut:%.2lf sec.\n", ((double)std::chrono::duration_cast<std::chrono::seconds>(t4 - t3).count()) + ((double)std::chrono::duration_cast<std::chrono::milliseconds>(t4 - t3).count()) / 1000);
-
-                size_t postingFileSize = (postingListSize.size() + p_opt.m_ssdIndexFileNum - 1) / p_opt.m_ssdIndexFileNum;
-                std::vector<size_t> selectionsBatchOffset(p_opt.m_ssdIndexFileNum + 1, 0);
-                for (int i = 0; i < p_opt.m_ssdIndexFileNum; i++) {
-                    size_t curPostingListEnd = min(postingListSize.size(), (i + 1) * postingFileSize);
-                    selectionsBatchOffset[i + 1] = std::lower_bound(selections.m_selections.begin(), selections.m_selections.end(), (SizeType)curPostingListEnd, Selection::g_edgeComparer) - selections.m_selections.begin();
-                }
-
-                if (p_opt.m_ssdIndexFileNum > 1) selections.SaveBatch();
-
-                auto fullVectors = p_reader->GetVectorSet();
-                if (p_opt.m_distCalcMethod == DistCalcMethod::Cosine && !p_reader->IsNormalized()) fullVectors->Normalize(p_opt.m_iSSDNumberOfThreads);
-
-                for (int i = 0; i < p_opt.m_ssdIndexFileNum; i++) {
-                    size_t curPostingListOffSet = i * postingFileSize;
-                    size_t curPostingListEnd = min(postingListSize.size(), (i + 1) * postingFileSize);
-                    std::vector<int> curPostingListSizes(
-                        postingListSize.begin() + curPostingListOffSet,
-                        postingListSize.begin() + curPostingListEnd);
-
-                    std::unique_ptr<int[]> postPageNum;
-                    std::unique_ptr<std::uint16_t[]> postPageOffset;
-                    std::vector<int> postingOrderInIndex;
-                    SelectPostingOffset(vectorInfoSize, curPostingListSizes, postPageNum, postPageOffset, postingOrderInIndex);
-
-                    if (p_opt.m_ssdIndexFileNum > 1) selections.LoadBatch(selectionsBatchOffset[i], selectionsBatchOffset[i + 1]);
-
-                    OutputSSDIndexFile((i == 0) ? outputFile : outputFile + "_" + std::to_string(i),
-                        vectorInfoSize,
-                        curPostingListSizes,
-                        selections,
-                        postPageNum,
-                        postPageOffset,
-                        postingOrderInIndex,
-                        fullVectors,
-                        curPostingListOffSet);
-                }
-
                 auto t5 = std::chrono::high_resolution_clock::now();
                 double elapsedSeconds = std::chrono::duration_cast<std::chrono::seconds>(t5 - t1).count();
                 LOG(Helper::LogLevel::LL_Info, "Total used time: %.2lf minutes (about %.2lf hours).\n", elapsedSeconds / 60.0, elapsedSeconds / 3600.0);
@@ -716,7 +984,11 @@ namespace SPTAG
                 const std::unique_ptr<int[]>& p_postPageNum,
                 const std::unique_ptr<std::uint16_t[]>& p_postPageOffset,
                 const std::vector<int>& p_postingOrderInIndex,
-                std::shared_ptr<VectorSet> p_fullVectors,
+                std::shared_ptr<Helper::VectorSetReader>& p_reader,
+                Options& p_opt,
+                SizeType p_fullCount,
+                DimensionType p_dimension,
+                SizeType p_windowSize,
                 size_t p_postingListOffset)
             {
                 LOG(Helper::LogLevel::LL_Info, "Start output...\n");
@@ -760,14 +1032,14 @@ namespace SPTAG
                 }
 
                 // Number of all documents.
-                i32Val = static_cast<int>(p_fullVectors->Count());
+                i32Val = static_cast<int>(p_fullCount);
                 if (ptr->WriteBinary(sizeof(i32Val), reinterpret_cast<char*>(&i32Val)) != sizeof(i32Val)) {
                     LOG(Helper::LogLevel::LL_Error, "Failed to write SSDIndex File!");
                     exit(1);
                 }
 
                 // Bytes of each vector.
-                i32Val = static_cast<int>(p_fullVectors->Dimension());
+                i32Val = static_cast<int>(p_dimension);
                 if (ptr->WriteBinary(sizeof(i32Val), reinterpret_cast<char*>(&i32Val)) != sizeof(i32Val)) {
                     LOG(Helper::LogLevel::LL_Error, "Failed to write SSDIndex File!");
                     exit(1);
@@ -834,54 +1106,83 @@ namespace SPTAG
 
                 listOffset = 0;
 
+                // Postings are written in windows so only the vectors one window references are held in memory;
+                // each window reads its vectors from the source file in ascending id order.
                 std::uint64_t paddedSize = 0;
-                for (auto id : p_postingOrderInIndex)
+                std::vector<SizeType> windowIDs;
+                for (size_t windowBegin = 0; windowBegin < p_postingOrderInIndex.size();)
                 {
-                    std::uint64_t targetOffset = static_cast<uint64_t>(p_postPageNum[id]) * PageSize + p_postPageOffset[id];
-                    if (targetOffset < listOffset)
+                    size_t windowEnd = windowBegin;
+                    SizeType windowCount = 0;
+                    do {
+                        windowCount += p_postingListSizes[p_postingOrderInIndex[windowEnd++]];
+                    } while (windowEnd < p_postingOrderInIndex.size() && windowCount + p_postingListSizes[p_postingOrderInIndex[windowEnd]] <= p_windowSize);
+
+                    windowIDs.clear();
+                    for (size_t w = windowBegin; w < windowEnd; w++)
                     {
-                        LOG(Helper::LogLevel::LL_Info, "List offset not match, targetOffset < listOffset!\n");
-                        exit(1);
+                        int id = p_postingOrderInIndex[w];
+                        std::size_t selectIdx = p_postingSelections.lower_bound(id + (int)p_postingListOffset);
+                        for (int j = 0; j < p_postingListSizes[id]; ++j) windowIDs.push_back(p_postingSelections[selectIdx + j].tonode);
                     }
+                    std::sort(windowIDs.begin(), windowIDs.end());
+                    windowIDs.erase(std::unique(windowIDs.begin(), windowIDs.end()), windowIDs.end());
 
-                    if (targetOffset > listOffset)
+                    auto windowVectors = p_reader->GetVectorSubset(windowIDs);
+                    if (p_opt.m_distCalcMethod == DistCalcMethod::Cosine && !p_reader->IsNormalized()) windowVectors->Normalize(p_opt.m_iSSDNumberOfThreads);
+
+                    for (size_t w = windowBegin; w < windowEnd; w++)
                     {
-                        if (targetOffset - listOffset > PageSize)
+                        int id = p_postingOrderInIndex[w];
+
+                        std::uint64_t targetOffset = static_cast<uint64_t>(p_postPageNum[id]) * PageSize + p_postPageOffset[id];
+                        if (targetOffset < listOffset)
                         {
-                            LOG(Helper::LogLevel::LL_Error, "Padding size greater than page size!\n");
+                            LOG(Helper::LogLevel::LL_Info, "List offset not match, targetOffset < listOffset!\n");
                             exit(1);
                         }
 
-                        if (ptr->WriteBinary(targetOffset - listOffset, reinterpret_cast<char*>(paddingVals.get())) != targetOffset - listOffset) {
-                            LOG(Helper::LogLevel::LL_Error, "Failed to write SSDIndex File!");
-                            exit(1);
-                        }
+                        if (targetOffset > listOffset)
+                        {
+                            if (targetOffset - listOffset > PageSize)
+                            {
+                                LOG(Helper::LogLevel::LL_Error, "Padding size greater than page size!\n");
+                                exit(1);
+                            }
 
-                        paddedSize += targetOffset - listOffset;
+                            if (ptr->WriteBinary(targetOffset - listOffset, reinterpret_cast<char*>(paddingVals.get())) != targetOffset - listOffset) {
+                                LOG(Helper::LogLevel::LL_Error, "Failed to write SSDIndex File!");
+                                exit(1);
+                            }
 
-                        listOffset = targetOffset;
-                    }
+                            paddedSize += targetOffset - listOffset;
 
-                    std::size_t selectIdx = p_postingSelections.lower_bound(id + (int)p_postingListOffset);
-                    for (int j = 0; j < p_postingListSizes[id]; ++j)
-                    {
-                        if (p_postingSelections[selectIdx].node != id + (int)p_postingListOffset)
-                        {
-                            LOG(Helper::LogLevel::LL_Error, "Selection ID NOT MATCH! node:%d offset:%zu\n", id + (int)p_postingListOffset, selectIdx);
-                            exit(1);
+                            listOffset = targetOffset;
                         }
 
-                        i32Val = p_postingSelections[selectIdx++].tonode;
-                        if (ptr->WriteBinary(sizeof(i32Val), reinterpret_cast<char*>(&i32Val)) != sizeof(i32Val)) {
-                            LOG(Helper::LogLevel::LL_Error, "Failed to write SSDIndex File!");
-                            exit(1);
-                        }
-                        if (ptr->WriteBinary(p_fullVectors->PerVectorDataSize(), reinterpret_cast<char*>(p_fullVectors->GetVector(i32Val))) != p_fullVectors->PerVectorDataSize()) {
-                            LOG(Helper::LogLevel::LL_Error, "Failed to write SSDIndex File!");
-                            exit(1);
+                        std::size_t selectIdx = p_postingSelections.lower_bound(id + (int)p_postingListOffset);
+                        for (int j = 0; j < p_postingListSizes[id]; ++j)
+                        {
+                            if (p_postingSelections[selectIdx].node != id + (int)p_postingListOffset)
+                            {
+                                LOG(Helper::LogLevel::LL_Error, "Selection ID NOT MATCH! node:%d offset:%zu\n", id + (int)p_postingListOffset, selectIdx);
+                                exit(1);
+                            }
+
+                            i32Val = p_postingSelections[selectIdx++].tonode;
+                            if (ptr->WriteBinary(sizeof(i32Val), reinterpret_cast<char*>(&i32Val)) != sizeof(i32Val)) {
+                                LOG(Helper::LogLevel::LL_Error, "Failed to write SSDIndex File!");
+                                exit(1);
+                            }
+                            SizeType vectorIdx = (SizeType)(std::lower_bound(windowIDs.begin(), windowIDs.end(), i32Val) - windowIDs.begin());
+                            if (ptr->WriteBinary(windowVectors->PerVectorDataSize(), reinterpret_cast<char*>(windowVectors->GetVector(vectorIdx))) != windowVectors->PerVectorDataSize()) {
+                                LOG(Helper::LogLevel::LL_Error, "Failed to write SSDIndex File!");
+                                exit(1);
+                            }
+                            listOffset += p_spacePerVector;
                         }
-                        listOffset += p_spacePerVector;
                     }
+                    windowBegin = windowEnd;
                 }
 
                 paddingSize = PageSize - (listOffset % PageSize);
@@ -911,7 +1212,117 @@ namespace SPTAG
             }
 
         private:
-            
+#ifdef BATCH_READ
+            // Waits for the postings read ahead for the query and counts their pages, used or not. Reads
+            // that failed are dropped so that the search reads their postings again.
+            void WaitPrefetch(ExtraWorkSpace* p_exWorkSpace, int& p_diskRead, int& p_diskIO, double& p_readLatency)
+            {
+                auto waitBegin = std::chrono::high_resolution_clock::now();
+                bool waited = false;
+                std::vector<struct io_event> events;
+                for (int fileid = 0; fileid < (int)p_exWorkSpace->m_prefetchInFlight.size(); fileid++)
+                {
+                    int& inFlight = p_exWorkSpace->m_prefetchInFlight[fileid];
+                    if (inFlight == 0) continue;
+
+                    waited = true;
+                    events.resize(inFlight);
+                    auto* handler = (Helper::AsyncFileIO*)(m_indexFiles[fileid].get());
+                    while (inFlight > 0)
+                    {
+                        auto done = syscall(__NR_io_getevents, handler->GetIOCP(p_exWorkSpace->m_spaceID), inFlight, inFlight, events.data(), &Helper::AIOTimeout);
+                        if (done < 0)
+                        {
+                            if (errno == EINTR) continue;
+                            LOG(Helper::LogLevel::LL_Error, "Failed to wait for %d posting prefetches: %s\n", inFlight, strerror(errno));
+                            for (auto& request : p_exWorkSpace->m_prefetchRequests) request.m_payload = nullptr;
+                            inFlight = 0;
+                            break;
+                        }
+                        for (int i = 0; i < done; i++)
+                        {
+                            auto* request = reinterpret_cast<Helper::AsyncReadRequest*>(events[i].data);
+                            if (events[i].res != (std::int64_t)(request->m_readSize)) request->m_payload = nullptr;
+                        }
+                        inFlight -= (int)done;
+                    }
+                }
+                if (!waited) return;
+
+                for (int slot = 0; slot < (int)p_exWorkSpace->m_prefetchIDs.size(); slot++)
+                {
+                    p_diskRead += (int)(p_exWorkSpace->m_prefetchRequests[slot].m_readSize >> PageSizeEx);
+                    p_diskIO += 1;
+                }
+                p_readLatency += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - waitBegin).count();
+            }
+
+            static int FindPrefetch(ExtraWorkSpace* p_exWorkSpace, int p_postingID)
+            {
+                for (int slot = 0; slot < (int)p_exWorkSpace->m_prefetchIDs.size(); slot++)
+                {
+                    if (p_exWorkSpace->m_prefetchIDs[slot] == p_postingID && p_exWorkSpace->m_prefetchRequests[slot].m_payload != nullptr) return slot;
+                }
+                return -1;
+            }
+
+            // Scans postings that have been read into p_requests on up to SearchScanThreads threads, each
+            // adding to its own heap, and merges the heaps into the query results.
+            void ParallelScan(ExtraWorkSpace* p_exWorkSpace, COMMON::QueryResultSet<ValueType>& queryResults, const VectorIndex* p_index, std::vector<Helper::AsyncReadRequest*>& p_requests)
+            {
+                int threads = min(m_scanThreads, (int)p_requests.size());
+                std::vector<COMMON::QueryResultSet<ValueType>> heaps(threads, COMMON::QueryResultSet<ValueType>(queryResults.GetTarget(), queryResults.GetResultNum()));
+                for (auto& heap : heaps) heap.Reset();
+
+                const ValueType* target = queryResults.GetQuantizedTarget();
+                int listElements = 0;
+                for (auto* request : p_requests) listElements += static_cast<ListInfo*>(request->m_payload)->listEleCount;
+                p_exWorkSpace->m_deduper.PrepareConcurrent(listElements);
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 1)
+                for (int i = 0; i < (int)p_requests.size(); i++)
+                {
+                    auto& heap = heaps[omp_get_thread_num()];
+                    char* buffer = p_requests[i]->m_buffer;
+                    ListInfo* listInfo = static_cast<ListInfo*>(p_requests[i]->m_payload);
+                    for (char* vectorInfo = buffer + listInfo->pageOffset, *vectorInfoEnd = vectorInfo + listInfo->listEleCount * m_vectorInfoSize; vectorInfo < vectorInfoEnd; vectorInfo += m_vectorInfoSize)
+                    {
+                        int vectorID = *(reinterpret_cast<int*>(vectorInfo));
+                        if (p_exWorkSpace->m_deduper.CheckAndSetConcurrent(vectorID)) continue;
+                        heap.AddPoint(vectorID, p_index->ComputeDistance(target, vectorInfo + sizeof(int)));
+                    }
+                }
+                MergeScanResults(heaps, queryResults);
+            }
+#endif
+
+            void ScanAsyncPosting(ExtraWorkSpace* p_exWorkSpace, Helper::AsyncReadRequest* request)
+            {
+                if (!request->m_success)
+                {
+                    LOG(Helper::LogLevel::LL_Error, "Posting read at offset %llu came back short, dropping it.\n", (unsigned long long)request->m_offset);
+                }
+                else
+                {
+                    std::lock_guard<std::mutex> guard(p_exWorkSpace->m_scanLock);
+                    COMMON::QueryResultSet<ValueType>& queryResults = *((COMMON::QueryResultSet<ValueType>*)p_exWorkSpace->m_asyncResults);
+                    const VectorIndex* p_index = p_exWorkSpace->m_asyncIndex;
+                    char* buffer = request->m_buffer;
+                    ListInfo* listInfo = static_cast<ListInfo*>(request->m_payload);
+                    ProcessPosting(m_vectorInfoSize)
+                }
+                FinishAsyncRead(p_exWorkSpace);
+            }
+
+            static void FinishAsyncRead(ExtraWorkSpace* p_exWorkSpace)
+            {
+                if (--(p_exWorkSpace->m_pendingReads) == 0)
+                {
+                    std::function<void(ErrorCode)> callback;
+                    callback.swap(p_exWorkSpace->m_asyncCallback);
+                    callback(p_exWorkSpace->m_asyncStatus);
+                }
+            }
+
             std::string m_extraFullGraphFile;
 
             std::vector<std::vector<ListInfo>> m_listInfos;
@@ -923,6 +1334,10 @@ namespace SPTAG
             int m_totalListCount = 0;
 
             int m_listPerFile = 0;
+
+#ifdef BATCH_READ
+            Helper::AsyncReadDispatcher m_asyncDispatcher;
+#endif
         };
     } // namespace SPANN
 } // namespace SPTAG
@@ -297,23 +297,26 @@ namespace SPTAG::SPANN
         ~ExtraRocksDBController() override = default;
 
         bool LoadIndex(Options& p_opt) override {
+            m_scanThreads = p_opt.m_searchScanThreads;
+            m_hardLatencyLimit = p_opt.m_latencyLimit;
             return true;
         }
 
         virtual void SearchIndex(ExtraWorkSpace* p_exWorkSpace,
                 QueryResult& p_queryResults,
-                std::shared_ptr<VectorIndex> p_index,
+                const VectorIndex* p_index,
                 SearchStats* p_stats, const COMMON::VersionLabel& m_versionMap, std::set<int>* truth, std::map<int, std::set<int>>* found) override
             {
             auto exStart = std::chrono::high_resolution_clock::now();
 
             const auto postingListCount = static_cast<uint32_t>(p_exWorkSpace->m_postingIDs.size());
 
-            p_exWorkSpace->m_deduper.clear();
+            if (!p_exWorkSpace->m_resumeSearch) p_exWorkSpace->m_deduper.clear();
 
             auto exSetUpEnd = std::chrono::high_resolution_clock::now();
 
-            p_stats->m_exSetUpLatency = ((double)std::chrono::duration_cast<std::chrono::microseconds>(exSetUpEnd - exStart).count()) / 1000;
+            if (p_stats) p_stats->m_exSetUpLatency = ((double)std::chrono::duration_cast<std::chrono::microseconds>(exSetUpEnd - exStart).count()) / 1000;
+            double spentLatency = p_stats ? p_stats->m_totalLatency : 0;
 
             COMMON::QueryResultSet<ValueType>& queryResults = *((COMMON::QueryResultSet<ValueType>*)&p_queryResults);
 
@@ -334,42 +337,55 @@ namespace SPTAG::SPANN
 
             readLatency += ((double)std::chrono::duration_cast<std::chrono::microseconds>(readEnd - readStart).count());
 
-            for (uint32_t pi = 0; pi < postingListCount; ++pi) {
-                auto curPostingID = p_exWorkSpace->m_postingIDs[pi];
-                std::string &postingList = postingLists[pi];
+            if (m_scanThreads > 1 && truth == nullptr && postingListCount > 1)
+            {
+                for (auto& postingList : postingLists) diskRead += postingList.size();
+                auto compStart = std::chrono::high_resolution_clock::now();
+                listElements = ParallelScan(p_exWorkSpace, queryResults, p_index, m_versionMap, postingLists, exStart, spentLatency);
+                compLatency += ((double)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - compStart).count());
+            }
+            else
+            {
+                for (uint32_t pi = 0; pi < postingListCount; ++pi) {
+                    auto curPostingID = p_exWorkSpace->m_postingIDs[pi];
+                    std::string &postingList = postingLists[pi];
 
-                int vectorNum = postingList.size() / m_vectorInfoSize;
+                    int vectorNum = postingList.size() / m_vectorInfoSize;
 
-                diskRead += postingList.size();
-                listElements += vectorNum;
+                    diskRead += postingList.size();
+                    listElements += vectorNum;
 
-                auto compStart = std::chrono::high_resolution_clock::now();
-                for (int i = 0; i < vectorNum; i++) {
-                    char* vectorInfo = postingList.data() + i * m_vectorInfoSize;
-                    int vectorID = *(reinterpret_cast<int*>(vectorInfo));
-                    if (m_versionMap.Contains(vectorID) || p_exWorkSpace->m_deduper.CheckAndSet(vectorID)) {
-                        listElements--;
-                        continue;
+                    auto compStart = std::chrono::high_resolution_clock::now();
+                    if (p_exWorkSpace->m_validEntries.size() < vectorNum) p_exWorkSpace->m_validEntries.resize(vectorNum);
+                    int validNum = m_versionMap.FilterValid(postingList.data(), vectorNum, m_vectorInfoSize, p_exWorkSpace->m_validEntries.data());
+                    listElements -= vectorNum - validNum;
+                    for (int v = 0; v < validNum; v++) {
+                        char* vectorInfo = postingList.data() + p_exWorkSpace->m_validEntries[v] * m_vectorInfoSize;
+                        int vectorID = *(reinterpret_cast<int*>(vectorInfo));
+                        if (p_exWorkSpace->m_deduper.CheckAndSet(vectorID)) {
+                            listElements--;
+                            continue;
+                        }
+                        auto distance2leaf = p_index->ComputeDistance(queryResults.GetQuantizedTarget(), vectorInfo + m_metaDataSize);
+                        queryResults.AddPoint(vectorID, distance2leaf);
                     }
-                    auto distance2leaf = p_index->ComputeDistance(queryResults.GetQuantizedTarget(), vectorInfo + m_metaDataSize);
-                    queryResults.AddPoint(vectorID, distance2leaf);
-                }
-                auto compEnd = std::chrono::high_resolution_clock::now();
+                    auto compEnd = std::chrono::high_resolution_clock::now();
 
-                compLatency += ((double)std::chrono::duration_cast<std::chrono::microseconds>(compEnd - compStart).count());
+                    compLatency += ((double)std::chrono::duration_cast<std::chrono::microseconds>(compEnd - compStart).count());
 
-                auto exEnd = std::chrono::high_resolution_clock::now();
+                    auto exEnd = std::chrono::high_resolution_clock::now();
 
-                if ((((double)std::chrono::duration_cast<std::chrono::microseconds>(exEnd - exStart).count()) / 1000 + p_stats->m_totalLatency) >= m_hardLatencyLimit) {
-                    break;
-                }
+                    if ((((double)std::chrono::duration_cast<std::chrono::microseconds>(exEnd - exStart).count()) / 1000 + spentLatency) >= m_hardLatencyLimit) {
+                        break;
+                    }
 
-                if (truth) {
-                    for (int i = 0; i < vectorNum; ++i) {
-                        char* vectorInfo = postingList.data() + i * m_vectorInfoSize;
-                        int vectorID = *(reinterpret_cast<int*>(vectorInfo));
-                        if (truth->count(vectorID) != 0)
-                            (*found)[curPostingID].insert(vectorID);
+                    if (truth) {
+                        for (int i = 0; i < vectorNum; ++i) {
+                            char* vectorInfo = postingList.data() + i * m_vectorInfoSize;
+                            int vectorID = *(reinterpret_cast<int*>(vectorInfo));
+                            if (truth->count(vectorID) != 0)
+                                (*found)[curPostingID].insert(vectorID);
+                        }
                     }
                 }
             }
@@ -398,10 +414,10 @@ namespace SPTAG::SPANN
             SizeType fullCount = 0;
             size_t vectorInfoSize = 0;
             {
-                auto fullVectors = p_reader->GetVectorSet();
-                fullCount = fullVectors->Count();
-                // vectorInfoSize = fullVectors->PerVectorDataSize() + sizeof(int);
-                vectorInfoSize = fullVectors->PerVectorDataSize() + sizeof(int) + sizeof(uint8_t);
+                auto firstVector = p_reader->GetVectorSet(0, 1);
+                fullCount = p_reader->GetVectorCount();
+                // vectorInfoSize = firstVector->PerVectorDataSize() + sizeof(int);
+                vectorInfoSize = firstVector->PerVectorDataSize() + sizeof(int) + sizeof(uint8_t);
             }
 
             // m_metaDataSize = sizeof(int) + sizeof(uint8_t) + sizeof(float);
@@ -427,9 +443,10 @@ namespace SPTAG::SPANN
                     auto fullVectors = p_reader->GetVectorSet(start, end);
                     if (p_opt.m_distCalcMethod == DistCalcMethod::Cosine && !p_reader->IsNormalized()) fullVectors->Normalize(p_opt.m_iSSDNumberOfThreads);
 
+                    if (p_opt.m_batches > 1) selections.LoadBatch(static_cast<size_t>(start) * p_opt.m_replicaCount, static_cast<size_t>(end) * p_opt.m_replicaCount);
                     emptySet.clear();
 
-                    p_headIndex->ApproximateRNG(fullVectors, emptySet, candidateNum, selections.m_selections.data(), p_opt.m_replicaCount, numThreads, p_opt.m_gpuSSDNumTrees, p_opt.m_gpuSSDLeafSize, p_opt.m_rngFactor, p_opt.m_numGPUs);
+                    p_headIndex->ApproximateRNG(fullVectors, emptySet, candidateNum, selections.m_selections.data(), p_opt.m_replicaCount, numThreads, p_opt.m_gpuSSDNumTrees, p_opt.m_gpuSSDLeafSize, p_opt.m_rngFactor, p_opt.m_numGPUs, p_opt.m_rngPairCacheSize);
 
                     for (SizeType j = start; j < end; j++) {
                         replicaCount[j] = 0;
@@ -441,16 +458,15 @@ namespace SPTAG::SPANN
                         }
                     }
 
-                    if (p_opt.m_batches > 1) selections.SaveBatch();
+                    if (p_opt.m_batches > 1) selections.SaveSortedBatch();
                 }
             }
             auto t2 = std::chrono::high_resolution_clock::now();
             LOG(Helper::LogLevel::LL_Info, "Searching replicas ended. Search Time: %.2lf mins\n", ((double)std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count()) / 60.0);
 
-            if (p_opt.m_batches > 1) selections.LoadBatch(0, static_cast<size_t>(fullCount) * p_opt.m_replicaCount);
-
-            // Sort results either in CPU or GPU
-            VectorIndex::SortSelections(&selections.m_selections);
+            // Sort results either in CPU or GPU. Batched builds already spilled every batch as a sorted run,
+            // and those runs are merged one head range at a time below.
+            if (p_opt.m_batches == 1) VectorIndex::SortSelections(&selections.m_selections);
 
             auto t3 = std::chrono::high_resolution_clock::now();
             LOG(Helper::LogLevel::LL_Info, "Time to sort selections:%.2lf sec.\n", ((double)std::chrono::duration_cast<std::chrono::seconds>(t3 - t2).count()) + ((double)std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count()) / 1000);
@@ -464,7 +480,6 @@ namespace SPTAG::SPANN
 
             LOG(Helper::LogLevel::LL_Info, "Posting size limit: %d\n", postingSizeLimit);
 
-
             {
                 std::vector<int> replicaCountDist(p_opt.m_replicaCount + 1, 0);
                 for (int i = 0; i < replicaCount.size(); ++i)
@@ -479,19 +494,48 @@ namespace SPTAG::SPANN
                 }
             }
 
+            LOG(Helper::LogLevel::LL_Info, "SPFresh: initialize versionMap\n");
+            COMMON::VersionLabel m_versionMap;
+            m_versionMap.Initialize(fullCount, p_headIndex->m_iDataBlockSize, p_headIndex->m_iDataCapacity);
+
+            LOG(Helper::LogLevel::LL_Info, "SPFresh: Writing values to DB\n");
+
+            SizeType headCount = (SizeType)postingListSize.size();
+            SizeType headBatchSize = (headCount + p_opt.m_batches - 1) / p_opt.m_batches;
+            std::vector<int> postingListSize_int(headCount);
+            for (SizeType headBegin = 0; headBegin < headCount; headBegin += headBatchSize) {
+                SizeType headEnd = min(headBegin + headBatchSize, headCount);
+                if (selections.HasRuns()) selections.LoadHeads(headBegin, headEnd);
+
 #pragma omp parallel for schedule(dynamic)
-            for (int i = 0; i < postingListSize.size(); ++i)
-            {
-                if (postingListSize[i] <= postingSizeLimit) continue;
+                for (int i = headBegin; i < headEnd; ++i)
+                {
+                    if (postingListSize[i] > postingSizeLimit) {
+                        std::size_t selectIdx = std::lower_bound(selections.m_selections.begin(), selections.m_selections.end(), i, Selection::g_edgeComparer) - selections.m_selections.begin();
 
-                std::size_t selectIdx = std::lower_bound(selections.m_selections.begin(), selections.m_selections.end(), i, Selection::g_edgeComparer) - selections.m_selections.begin();
+                        for (size_t dropID = postingSizeLimit; dropID < postingListSize[i]; ++dropID)
+                        {
+                            int tonode = selections.m_selections[selectIdx + dropID].tonode;
+                            --replicaCount[tonode];
+                        }
+                        postingListSize[i] = postingSizeLimit;
+                    }
+                    postingListSize_int[i] = postingListSize[i];
+                }
 
-                for (size_t dropID = postingSizeLimit; dropID < postingListSize[i]; ++dropID)
+                std::vector<SizeType> batchIDs;
+                for (SizeType i = headBegin; i < headEnd; ++i)
                 {
-                    int tonode = selections.m_selections[selectIdx + dropID].tonode;
-                    --replicaCount[tonode];
+                    std::size_t selectIdx = selections.lower_bound(i);
+                    for (int j = 0; j < postingListSize_int[i]; ++j) batchIDs.push_back(selections[selectIdx + j].tonode);
                 }
-                postingListSize[i] = postingSizeLimit;
+                std::sort(batchIDs.begin(), batchIDs.end());
+                batchIDs.erase(std::unique(batchIDs.begin(), batchIDs.end()), batchIDs.end());
+
+                auto batchVectors = p_reader->GetVectorSubset(batchIDs);
+                if (p_opt.m_distCalcMethod == DistCalcMethod::Cosine && !p_reader->IsNormalized()) batchVectors->Normalize(p_opt.m_iSSDNumberOfThreads);
+
+                WriteDownAllPostingToDB(postingListSize_int, selections, m_versionMap, batchVectors, batchIDs, headBegin, headEnd);
             }
 
             {
@@ -537,24 +581,8 @@ namespace SPTAG::SPANN
                 }
             }
 
-
             auto t4 = std::chrono::high_resolution_clock::now();
-            LOG(SPTAG::Helper::LogLevel::LL_Info, "Time to perform posting cut:%.2lf sec.\n", ((double)std::chrono::duration_cast<std::chrono::seconds>(t4 - t3).count()) + ((double)std::chrono::duration_cast<std::chrono::milliseconds>(t4 - t3).count()) / 1000);
-
-            if (p_opt.m_ssdIndexFileNum > 1) selections.SaveBatch();
-
-            auto fullVectors = p_reader->GetVectorSet();
-            if (p_opt.m_distCalcMethod == DistCalcMethod::Cosine && !p_reader->IsNormalized()) fullVectors->Normalize(p_opt.m_iSSDNumberOfThreads);
-
-            LOG(Helper::LogLevel::LL_Info, "SPFresh: initialize versionMap\n");
-            COMMON::VersionLabel m_versionMap;
-            m_versionMap.Initialize(fullCount, p_headIndex->m_iDataBlockSize, p_headIndex->m_iDataCapacity);
-
-            LOG(Helper::LogLevel::LL_Info, "SPFresh: Writing values to DB\n");
-
-            std::vector<int> postingListSize_int(postingListSize.begin(), postingListSize.end());
-
-            WriteDownAllPostingToDB(postingListSize_int, selections, m_versionMap, fullVectors);
+            LOG(SPTAG::Helper::LogLevel::LL_Info, "Time to perform posting cut and write postings:%.2lf sec.\n", ((double)std::chrono::duration_cast<std::chrono::seconds>(t4 - t3).count()) + ((double)std::chrono::duration_cast<std::chrono::milliseconds>(t4 - t3).count()) / 1000);
 
             COMMON::PostingSizeRecord m_postingSizes;
             m_postingSizes.Initialize(postingListSize.size(), p_headIndex->m_iDataBlockSize, p_headIndex->m_iDataCapacity);
@@ -573,10 +601,10 @@ namespace SPTAG::SPANN
             return true;
         }
 
-        void WriteDownAllPostingToDB(const std::vector<int>& p_postingListSizes, Selection& p_postingSelections, COMMON::VersionLabel& m_versionMap, std::shared_ptr<VectorSet> p_fullVectors) {
-            size_t dim = p_fullVectors->Dimension();
+        void WriteDownAllPostingToDB(const std::vector<int>& p_postingListSizes, Selection& p_postingSelections, COMMON::VersionLabel& m_versionMap, std::shared_ptr<VectorSet> p_batchVectors, const std::vector<SizeType>& p_batchIDs, SizeType p_headBegin, SizeType p_headEnd) {
+            size_t dim = p_batchVectors->Dimension();
             #pragma omp parallel for num_threads(10)
-            for (int id = 0; id < p_postingListSizes.size(); id++)
+            for (int id = p_headBegin; id < p_headEnd; id++)
             {
                 std::string postinglist;
                 std::size_t selectIdx = p_postingSelections.lower_bound(id);
@@ -591,7 +619,8 @@ namespace SPTAG::SPANN
                     // First Vector ID, then version, then Vector
                     postinglist += Helper::Convert::Serialize<int>(&fullID, 1);
                     postinglist += Helper::Convert::Serialize<uint8_t>(&version, 1);
-                    postinglist += Helper::Convert::Serialize<ValueType>(p_fullVectors->GetVector(fullID), dim);
+                    SizeType vectorIdx = (SizeType)(std::lower_bound(p_batchIDs.begin(), p_batchIDs.end(), fullID) - p_batchIDs.begin());
+                    postinglist += Helper::Convert::Serialize<ValueType>(p_batchVectors->GetVector(vectorIdx), dim);
                 }
                 AddIndex(id, postinglist);
             }
@@ -737,7 +766,52 @@ namespace SPTAG::SPANN
         }
 
     private:
+        // Scans the postings of one query on up to SearchScanThreads threads with a heap each, merges the heaps
+        // into the query results and returns the vectors scanned. As in the serial scan, the latency limit is
+        // checked after each posting; once a thread hits it, no thread starts another posting.
+        int ParallelScan(ExtraWorkSpace* p_exWorkSpace, COMMON::QueryResultSet<ValueType>& queryResults, const VectorIndex* p_index, const COMMON::VersionLabel& p_versionMap, std::vector<std::string>& p_postingLists,
+            std::chrono::high_resolution_clock::time_point p_exStart, double p_spentLatency)
+        {
+            int threads = min(m_scanThreads, (int)p_postingLists.size());
+            std::vector<COMMON::QueryResultSet<ValueType>> heaps(threads, COMMON::QueryResultSet<ValueType>(queryResults.GetTarget(), queryResults.GetResultNum()));
+            for (auto& heap : heaps) heap.Reset();
+
+            const ValueType* target = queryResults.GetQuantizedTarget();
+            size_t postingBytes = 0;
+            for (auto& postingList : p_postingLists) postingBytes += postingList.size();
+            p_exWorkSpace->m_deduper.PrepareConcurrent((int)(postingBytes / m_vectorInfoSize));
+
+            int listElements = 0;
+            std::atomic_bool stop(false);
+#pragma omp parallel num_threads(threads) reduction(+:listElements)
+            {
+                auto& heap = heaps[omp_get_thread_num()];
+                std::vector<int> validEntries;
+#pragma omp for schedule(dynamic, 1)
+                for (int pi = 0; pi < (int)p_postingLists.size(); pi++)
+                {
+                    if (stop.load(std::memory_order_relaxed)) continue;
+                    std::string& postingList = p_postingLists[pi];
+                    int vectorNum = (int)(postingList.size() / m_vectorInfoSize);
+                    if ((int)validEntries.size() < vectorNum) validEntries.resize(vectorNum);
+                    int validNum = p_versionMap.FilterValid(postingList.data(), vectorNum, m_vectorInfoSize, validEntries.data());
+                    for (int v = 0; v < validNum; v++) {
+                        char* vectorInfo = postingList.data() + validEntries[v] * m_vectorInfoSize;
+                        int vectorID = *(reinterpret_cast<int*>(vectorInfo));
+                        if (p_exWorkSpace->m_deduper.CheckAndSetConcurrent(vectorID)) continue;
+                        listElements++;
+                        heap.AddPoint(vectorID, p_index->ComputeDistance(target, vectorInfo + m_metaDataSize));
+                    }
 
+                    auto exEnd = std::chrono::high_resolution_clock::now();
+                    if ((((double)std::chrono::duration_cast<std::chrono::microseconds>(exEnd - p_exStart).count()) / 1000 + p_spentLatency) >= m_hardLatencyLimit) {
+                        stop.store(true, std::memory_order_relaxed);
+                    }
+                }
+            }
+            MergeScanResults(heaps, queryResults);
+            return listElements;
+        }
 
         int m_vectorInfoSize = 0;
 
@@ -0,0 +1,122 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef _SPTAG_SPANN_HEADVECTORSTORE_H_
+#define _SPTAG_SPANN_HEADVECTORSTORE_H_
+
+#include "IExtraSearcher.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SPTAG
+{
+    namespace SPANN
+    {
+        extern std::function<std::shared_ptr<Helper::DiskPriorityIO>(void)> f_createAsyncIO;
+
+        // Full precision head vectors left on disk in the head vector file when the head index only
+        // keeps quantized codes. Only the candidate heads of a query are read back, with the same
+        // aligned direct reads as the postings.
+        class HeadVectorStore
+        {
+        public:
+            HeadVectorStore() : m_count(0), m_maxReads(0), m_vectorSize(0), m_slotSize(0) {}
+
+            ~HeadVectorStore() {}
+
+            bool Load(const std::string& p_file, DimensionType p_dim, std::size_t p_valueSize, int p_maxReads, int p_channels)
+            {
+                auto file = f_createAsyncIO();
+                if (file == nullptr || !file->Initialize(p_file.c_str(), std::ios::binary | std::ios::in, p_maxReads, 2, 2, p_channels))
+                {
+                    LOG(Helper::LogLevel::LL_Error, "Cannot open head vector file:%s!\n", p_file.c_str());
+                    return false;
+                }
+
+                PageBuffer<std::uint8_t> header;
+                header.ReservePageBuffer(PageSize);
+                if (file->ReadBinary(PageSize, (char*)header.GetBuffer(), 0) < c_headerSize)
+                {
+                    LOG(Helper::LogLevel::LL_Error, "Cannot read head vector file header:%s!\n", p_file.c_str());
+                    return false;
+                }
+                m_count = *((SizeType*)header.GetBuffer());
+                DimensionType dim = *((DimensionType*)(header.GetBuffer() + sizeof(SizeType)));
+                if (m_count <= 0 || dim != p_dim)
+                {
+                    LOG(Helper::LogLevel::LL_Error, "Head vector file %s holds %d vectors of dimension %d!\n", p_file.c_str(), m_count, dim);
+                    return false;
+                }
+
+                m_vectorSize = p_valueSize * dim;
+                m_slotSize = (((m_vectorSize + PageSize - 1) >> PageSizeEx) + 1) << PageSizeEx;
+                m_maxReads = p_maxReads;
+                m_files.clear();
+                m_files.push_back(file);
+                return true;
+            }
+
+            inline SizeType GetCount() const { return m_count; }
+
+            inline int GetMaxReads() const { return m_maxReads; }
+
+            // Reads heads p_ids[0, p_count) into the workspace; GetVector(i) then returns p_ids[i].
+            bool Read(ExtraWorkSpace* p_exWorkSpace, const SizeType* p_ids, int p_count)
+            {
+                if (p_count > m_maxReads) return false;
+                p_exWorkSpace->m_headVectorBuffer.ReservePageBuffer(m_slotSize * p_count);
+                if ((int)p_exWorkSpace->m_headVectorRequests.size() < p_count) p_exWorkSpace->m_headVectorRequests.resize(p_count);
+                p_exWorkSpace->m_headVectorOffsets.resize(p_count);
+
+                char* buffer = (char*)p_exWorkSpace->m_headVectorBuffer.GetBuffer();
+                for (int i = 0; i < p_count; i++)
+                {
+                    std::uint64_t offset = c_headerSize + (std::uint64_t)p_ids[i] * m_vectorSize;
+                    std::uint64_t begin = offset & ~((std::uint64_t)PageSize - 1);
+
+                    auto& request = p_exWorkSpace->m_headVectorRequests[i];
+                    request.m_offset = begin;
+                    request.m_readSize = ((offset + m_vectorSize - begin + PageSize - 1) >> PageSizeEx) << PageSizeEx;
+                    request.m_buffer = buffer + m_slotSize * i;
+                    request.m_status = p_exWorkSpace->m_spaceID;
+                    if (!request.m_callback) request.m_callback = [](Helper::AsyncReadRequest* request) {};
+                    p_exWorkSpace->m_headVectorOffsets[i] = request.m_buffer + (offset - begin);
+                }
+
+#ifdef BATCH_READ
+                return Helper::BatchReadFileAsync(m_files, p_exWorkSpace->m_headVectorRequests.data(), p_count) == p_count;
+#else
+                for (int i = 0; i < p_count; i++)
+                {
+                    auto& request = p_exWorkSpace->m_headVectorRequests[i];
+                    std::uint64_t needed = (p_exWorkSpace->m_headVectorOffsets[i] - request.m_buffer) + m_vectorSize;
+                    if (m_files[0]->ReadBinary(request.m_readSize, request.m_buffer, request.m_offset) < needed) return false;
+                }
+                return true;
+#endif
+            }
+
+            inline const void* GetVector(ExtraWorkSpace* p_exWorkSpace, int p_index) const
+            {
+                return p_exWorkSpace->m_headVectorOffsets[p_index];
+            }
+
+        private:
+            static const std::uint64_t c_headerSize = sizeof(SizeType) + sizeof(DimensionType);
+
+            std::vector<std::shared_ptr<Helper::DiskPriorityIO>> m_files;
+
+            SizeType m_count;
+
+            int m_maxReads;
+
+            std::size_t m_vectorSize;
+
+            std::size_t m_slotSize;
+        };
+    }
+}
+
+#endif // _SPTAG_SPANN_HEADVECTORSTORE_H_
@@ -10,6 +10,7 @@
 #include "inc/Helper/AsyncFileReader.h"
 #include "inc/Helper/VectorSetReader.h"
 #include "inc/Core/Common/WorkSpace.h"
+#include "inc/Core/Common/QueryResultSet.h"
 
 #if defined(_MSC_VER) || defined(__INTEL_COMPILER)
 #include <malloc.h>
@@ -19,9 +20,12 @@
 
 #include <memory>
 #include <vector>
+#include <algorithm>
 #include <chrono>
 #include <atomic>
 #include <set>
+#include <mutex>
+#include <functional>
 
 namespace SPTAG {
     namespace SPANN {
@@ -41,7 +45,10 @@ namespace SPTAG {
                 m_asyncLatency1(0),
                 m_asyncLatency2(0),
                 m_queueLatency(0),
-                m_sleepLatency(0)
+                m_sleepLatency(0),
+                m_compLatency(0),
+                m_diskReadLatency(0),
+                m_exSetUpLatency(0)
             {
             }
 
@@ -139,6 +146,7 @@ namespace SPTAG {
                     m_pageBuffers[pi].ReservePageBuffer(p_maxPages);
                 }
                 m_diskRequests.resize(p_internalResultNum);
+                m_asyncRequests.resize(p_internalResultNum);
             }
 
             void Initialize(va_list& arg) {
@@ -153,6 +161,8 @@ namespace SPTAG {
 
             std::vector<int> m_postingIDs;
 
+            std::vector<int> m_validEntries;
+
             COMMON::OptHashPosVector m_deduper;
 
             Helper::RequestQueue m_processIocp;
@@ -161,6 +171,63 @@ namespace SPTAG {
 
             std::vector<Helper::AsyncReadRequest> m_diskRequests;
 
+            // Head distances of m_postingIDs, and the postings and result distances of a search that
+            // reads them in rounds. While m_resumeSearch is set, a posting scan continues the previous
+            // one of the same query and skips the vectors it has already seen.
+            std::vector<float> m_postingDists;
+
+            std::vector<int> m_postingQueue;
+
+            std::vector<float> m_resultDists;
+
+            bool m_resumeSearch = false;
+
+            // Postings read ahead while the head search of the current query runs, with the reads still
+            // in flight counted per index file, and the partial head results the search has looked at.
+            std::vector<int> m_prefetchIDs;
+
+            std::vector<PageBuffer<std::uint8_t>> m_prefetchBuffers;
+
+            std::vector<Helper::AsyncReadRequest> m_prefetchRequests;
+
+            std::vector<int> m_prefetchInFlight;
+
+            std::vector<int> m_prefetchQueue;
+
+            std::vector<SizeType> m_lastPartialHeads;
+
+            std::vector<SizeType> m_partialHeads;
+
+            std::vector<BasicResult> m_settledHeads;
+
+            // Query code and full precision candidate heads of a search on a quantized head index.
+            std::vector<std::int8_t> m_headCode;
+
+            std::vector<SizeType> m_headCandidates;
+
+            PageBuffer<std::uint8_t> m_headVectorBuffer;
+
+            std::vector<Helper::AsyncReadRequest> m_headVectorRequests;
+
+            std::vector<char*> m_headVectorOffsets;
+
+            // State of an asynchronous search in flight on this workspace. The async requests keep
+            // their callbacks for the lifetime of the workspace since the last one may still be
+            // running when the workspace is handed to the next query.
+            std::vector<Helper::AsyncReadRequest> m_asyncRequests;
+
+            std::atomic_int m_pendingReads;
+
+            std::mutex m_scanLock;
+
+            QueryResult* m_asyncResults = nullptr;
+
+            const VectorIndex* m_asyncIndex = nullptr;
+
+            ErrorCode m_asyncStatus = ErrorCode::Success;
+
+            std::function<void(ErrorCode)> m_asyncCallback;
+
             int m_spaceID;
 
             static std::atomic_int g_spaceCount;
@@ -182,9 +249,37 @@ namespace SPTAG {
 
             virtual void SearchIndex(ExtraWorkSpace* p_exWorkSpace,
                 QueryResult& p_queryResults,
-                std::shared_ptr<VectorIndex> p_index,
+                const VectorIndex* p_index,
                 SearchStats* p_stats, const COMMON::VersionLabel& m_versionMap, std::set<int>* truth = nullptr, std::map<int, std::set<int>>* found = nullptr) = 0;
 
+            // Issues the posting reads and returns; p_callback runs once every posting has been scanned, with
+            // DiskIOFail if some reads could not be submitted. Searchers without completion-driven reads fall
+            // back to the synchronous search.
+            virtual void SearchIndexAsync(ExtraWorkSpace* p_exWorkSpace,
+                QueryResult& p_queryResults,
+                const VectorIndex* p_index,
+                const COMMON::VersionLabel& m_versionMap,
+                std::function<void(ErrorCode)> p_callback)
+            {
+                SearchIndex(p_exWorkSpace, p_queryResults, p_index, nullptr, m_versionMap);
+                p_callback(ErrorCode::Success);
+            }
+
+            // Starts reading postings the next search on the workspace is likely to scan. That search waits
+            // for the reads, scans the postings it asks for from them and ignores the rest. Searchers that
+            // cannot read ahead do nothing.
+            virtual void PrefetchPostings(ExtraWorkSpace* p_exWorkSpace, const std::vector<int>& p_postingIDs)
+            {
+            }
+
+            // Waits for the postings read ahead on the workspace and forgets them. Called before the workspace
+            // goes back to the pool on paths that may not have searched the postings, so that the next query
+            // does not reuse buffers the reads still write to.
+            virtual void DropPrefetch(ExtraWorkSpace* p_exWorkSpace)
+            {
+                p_exWorkSpace->m_prefetchIDs.clear();
+            }
+
             virtual bool BuildIndex(std::shared_ptr<Helper::VectorSetReader>& p_reader, 
                 std::shared_ptr<VectorIndex> p_index, 
                 Options& p_opt) = 0;
@@ -200,6 +295,34 @@ namespace SPTAG {
             virtual SizeType  GetMetaDataSize() = 0;
             virtual ErrorCode SearchIndexMulti(const std::vector<SizeType>& keys, std::vector<std::string>* values) = 0;
             virtual void GetDBStats() = 0;
+
+        protected:
+            // Adds the results of the per-thread heaps of a parallel posting scan to p_results. A vector the
+            // shared deduper let through twice is added once, with its smaller distance.
+            template <typename T>
+            static void MergeScanResults(std::vector<COMMON::QueryResultSet<T>>& p_heaps, COMMON::QueryResultSet<T>& p_results)
+            {
+                std::vector<BasicResult> merged;
+                for (auto& heap : p_heaps)
+                {
+                    for (int i = 0; i < heap.GetResultNum(); i++)
+                    {
+                        auto res = heap.GetResult(i);
+                        if (res->VID != -1) merged.push_back(*res);
+                    }
+                }
+                std::sort(merged.begin(), merged.end(), [](const BasicResult& a, const BasicResult& b)
+                    {
+                        return a.VID < b.VID || (a.VID == b.VID && a.Dist < b.Dist);
+                    });
+                for (size_t i = 0; i < merged.size(); i++)
+                {
+                    if (i > 0 && merged[i].VID == merged[i - 1].VID) continue;
+                    p_results.AddPoint(merged[i].VID, merged[i].Dist);
+                }
+            }
+
+            int m_scanThreads = 0;
         };
     } // SPANN
 } // SPTAG
@@ -13,6 +13,8 @@
 #include "../Common/BKTree.h"
 #include "../Common/WorkSpacePool.h"
 #include "../Common/FineGrainedLock.h"
+#include "../Common/ScalarQuantizer.h"
+#include "../Common/ReplicaSelector.h"
 
 #include "../Common/VersionLabel.h"
 #include "../Common/PostingSizeRecord.h"
@@ -23,8 +25,11 @@
 #include "inc/Helper/VectorSetReader.h"
 
 #include "IExtraSearcher.h"
+#include "HeadVectorStore.h"
 #include "Options.h"
 #include "PersistentBuffer.h"
+#include "RecallMonitor.h"
+#include "IndexMetrics.h"
 
 #include <functional>
 #include <shared_mutex>
@@ -239,6 +244,9 @@ namespace SPTAG
         private:
             std::shared_ptr<VectorIndex> m_index;
             std::shared_ptr<std::uint64_t> m_vectorTranslateMap;
+            SizeType m_vectorTranslateMapSize = 0;
+            // Head renumbering replaces m_index and m_vectorTranslateMap together under this lock; see LoadHeadIndex.
+            mutable std::mutex m_headPublishLock;
             std::unordered_map<std::string, std::string> m_headParameters;
             //std::unique_ptr<std::shared_timed_mutex[]> m_rwLocks;
             std::vector<std::string> m_postingVecs;
@@ -249,7 +257,14 @@ namespace SPTAG
             std::atomic_uint64_t m_vectorNum{0};
 
             std::shared_ptr<IExtraSearcher> m_extraSearcher;
+
+            // Set when the head index keeps int8 codes; the candidate heads of a query are then
+            // re-scored against the full precision vectors of m_headVectorStore.
+            std::unique_ptr<COMMON::ScalarQuantizer> m_headQuantizer;
+            std::unique_ptr<HeadVectorStore> m_headVectorStore;
             std::unique_ptr<COMMON::WorkSpacePool<ExtraWorkSpace>> m_workSpacePool;
+            // Workspaces of asynchronous searches, never allocated beyond AsyncSearchMaxInFlight.
+            std::unique_ptr<COMMON::WorkSpacePool<ExtraWorkSpace>> m_asyncWorkSpacePool;
 
             Options m_options;
 
@@ -271,33 +286,40 @@ namespace SPTAG
             tbb::concurrent_queue<int> m_assignmentQueue;
 
             std::atomic_uint32_t m_headMiss{0};
-            uint32_t m_appendTaskNum{0};
-            uint32_t m_splitNum{0};
-            uint32_t m_theSameHeadNum{0};
-            uint32_t m_reAssignNum{0};
-            uint32_t m_garbageNum{0};
-            uint64_t m_reAssignScanNum{0};
-
-            //Split
-            double m_splitCost{0};
-            double m_clusteringCost{0};
-            double m_updateHeadCost{0};
-            double m_reassignScanCost{0};
-            double m_reassignScanIOCost{0};
-
-            // Append
-            double m_appendCost{0};
-            double m_appendIOCost{0};
-
-            // reAssign
-            double m_reAssignCost{0};
-            double m_selectCost{0};
-            double m_reAssignAppendCost{0};
-
-            // GC
-            double m_garbageCost{0};
+            std::atomic_uint32_t m_appendTaskNum{0};
+            std::atomic_uint32_t m_splitNum{0};
+            std::atomic_uint32_t m_theSameHeadNum{0};
+            std::atomic_uint32_t m_reAssignNum{0};
+            std::atomic_uint32_t m_garbageNum{0};
+            std::atomic_uint64_t m_reAssignScanNum{0};
+
+            // Search, append, split, reassign and GC latencies, written concurrently by the search and update threads.
+            std::unique_ptr<IndexMetrics> m_metrics{ new IndexMetrics() };
+
             std::mutex m_dataAddLock;
 
+            // Update paths hold this shared; head compaction takes it exclusively.
+            std::shared_timed_mutex m_headCompactLock;
+
+            // Serializes head compaction and reordering.
+            std::mutex m_headRenumberLock;
+
+            // Searches that read postings pass this shared to start and count themselves in m_searchesInFlight.
+            // A head reorder holds it exclusively, so it is refused while any search runs and new ones wait for it.
+            mutable std::shared_timed_mutex m_searchGateLock;
+            mutable std::atomic<int> m_searchesInFlight{ 0 };
+
+            // Head indexes a compaction replaced while searches still held them, and the end of the head ids they
+            // had. The postings above the current head count are dropped once all of them are gone.
+            std::vector<std::weak_ptr<VectorIndex>> m_retiredHeadIndexes;
+            SizeType m_retiredHeadEnd = 0;
+
+            // Head count after the last reorder, 0 until NeedHeadReorder first looks at it.
+            SizeType m_reorderedHeadNum = 0;
+
+            // Declared last so its background thread stops before the rest of the index goes away.
+            std::unique_ptr<RecallMonitor> m_recallMonitor;
+
         public:
             Index()
             {
@@ -309,9 +331,18 @@ namespace SPTAG
 
             ~Index() {}
 
-            inline std::shared_ptr<VectorIndex> GetMemoryIndex() { return m_index; }
+            inline std::shared_ptr<VectorIndex> GetMemoryIndex() { return std::atomic_load(&m_index); }
+            // Searches the head index alone, leaving head ids and distances in p_query.
+            ErrorCode SearchHeadIndex(QueryResult& p_query) const;
             inline std::shared_ptr<IExtraSearcher> GetDiskIndex() { return m_extraSearcher; }
             inline Options* GetOptions() { return &m_options; }
+            inline const IndexMetrics& GetMetrics() const { return *m_metrics; }
+
+            // Recall@RecallMonitorK of the sampled live queries over the last RecallMonitorWindow samples, -1 if there is none yet.
+            inline double GetRollingRecall(std::uint64_t* p_recorded = nullptr, std::uint64_t* p_dropped = nullptr) const
+            {
+                return (m_recallMonitor == nullptr) ? -1 : m_recallMonitor->GetRollingRecall(p_recorded, p_dropped);
+            }
 
             inline SizeType GetNumSamples() const { return m_vectorNum.load(); }
             inline DimensionType GetFeatureDim() const { return m_options.m_dim; }
@@ -364,6 +395,8 @@ namespace SPTAG
             ErrorCode BuildIndex(const void* p_data, SizeType p_vectorNum, DimensionType p_dimension, bool p_normalized = false);
             ErrorCode BuildIndex(bool p_normalized = false);
             ErrorCode SearchIndex(QueryResult &p_query, bool p_searchDeleted = false) const;
+            ErrorCode SearchIndexAsync(QueryResult& p_query, std::function<void(ErrorCode)> p_callback, bool p_searchDeleted = false) const;
+            void CollectMetrics(Helper::MetricsWriter& p_writer) const;
             ErrorCode DebugSearchDiskIndex(QueryResult& p_query, int p_subInternalResultNum, int p_internalResultNum,
                 SearchStats* p_stats = nullptr, std::set<int>* truth = nullptr, std::map<int, std::set<int>>* found = nullptr);
             ErrorCode UpdateIndex();
@@ -382,17 +415,48 @@ namespace SPTAG
             ErrorCode AddIndex(const void* p_data, SizeType p_vectorNum, DimensionType p_dimension, std::shared_ptr<MetadataSet> p_metadataSet, bool p_withMetaIndex = false, bool p_normalized = false);
             ErrorCode AddIndexId(const void* p_data, SizeType p_vectorNum, DimensionType p_dimension, int& beginHead, int& endHead)  { return ErrorCode::Undefined; }
             ErrorCode AddIndexIdx(SizeType begin, SizeType end) { return ErrorCode::Undefined; }
+            ErrorCode AddIndexIdxBatch(const std::vector<SizeType>& p_ids) { return ErrorCode::Undefined; }
             ErrorCode DeleteIndex(const void* p_vectors, SizeType p_vectorNum) { return ErrorCode::Undefined; }
             ErrorCode DeleteIndex(const SizeType& p_id);
             ErrorCode RefineIndex(const std::vector<std::shared_ptr<Helper::DiskPriorityIO>>& p_indexStreams, IAbortOperation* p_abort) { return ErrorCode::Undefined; }
             ErrorCode RefineIndex(std::shared_ptr<VectorIndex>& p_newIndex) { return ErrorCode::Undefined; }
+            ErrorCode CompactIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::vector<SizeType>& p_newToOld) { return ErrorCode::Undefined; }
+            ErrorCode ReorderIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::vector<SizeType>& p_newToOld) { return ErrorCode::Undefined; }
+            ErrorCode QuantizeIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::function<void(const void*, std::int8_t*)> p_quantize) { return ErrorCode::Undefined; }
             
         private:
+            ErrorCode SearchHeadIndex(const std::shared_ptr<VectorIndex>& p_headIndex, QueryResult& p_query, ExtraWorkSpace* p_exWorkSpace, bool p_speculate = false) const;
+            void SpeculatePostings(ExtraWorkSpace* p_exWorkSpace, QueryResult& p_partial) const;
+            const VectorIndex* GetPostingDistanceIndex(const std::shared_ptr<VectorIndex>& p_headIndex) const;
+            std::shared_ptr<VectorIndex> LoadHeadIndex(std::shared_ptr<std::uint64_t>& p_translateMap) const;
+            void PublishHeadIndex(const std::shared_ptr<VectorIndex>& p_index, const std::shared_ptr<std::uint64_t>& p_translateMap, SizeType p_translateMapSize);
+            void PrepareExtraSearch(ExtraWorkSpace* p_exWorkSpace, QueryResult& p_query, const std::uint64_t* p_translateMap) const;
+            inline void BeginPostingSearch() const
+            {
+                std::shared_lock<std::shared_timed_mutex> gate(m_searchGateLock);
+                m_searchesInFlight++;
+            }
+            inline void EndPostingSearch() const { m_searchesInFlight--; }
+            void SearchPostings(ExtraWorkSpace* p_exWorkSpace, QueryResult& p_query, const std::shared_ptr<VectorIndex>& p_headIndex,
+                SearchStats* p_stats, std::chrono::steady_clock::time_point p_searchBegin) const;
+            void InitWorkSpacePools(int p_searchThreads);
+            void FillMetadata(QueryResult& p_query) const;
+            void StartRecallMonitor();
+            void MonitorRecall(QueryResult& p_query) const;
+            bool ReferenceSearch(const T* p_target, int p_K, std::vector<BasicResult>& p_results) const;
             bool CheckHeadIndexType();
             void SelectHeadAdjustOptions(int p_vectorCount);
             int SelectHeadDynamicallyInternal(const std::shared_ptr<COMMON::BKTree> p_tree, int p_nodeID, const Options& p_opts, std::vector<int>& p_selected);
             void SelectHeadDynamically(const std::shared_ptr<COMMON::BKTree> p_tree, int p_vectorCount, std::vector<int>& p_selected);
             bool SelectHead(std::shared_ptr<Helper::VectorSetReader>& p_reader);
+            ErrorCode ReorderHeads();
+            ErrorCode QuantizeHeads();
+            ErrorCode LoadHeadQuantizer();
+            void LockForHeadRenumbering(std::unique_lock<std::shared_timed_mutex>& p_lock);
+            ErrorCode RemapHeadIDs(const std::vector<SizeType>& p_newToOld, std::shared_ptr<std::uint64_t>& p_translateMap);
+            ErrorCode SaveHeadIDs(const std::shared_ptr<std::uint64_t>& p_translateMap, SizeType p_num);
+            void DropRetiredHeadPostings();
+            bool ShiftPostingCycle(const std::vector<SizeType>& p_cycle, size_t p_shift);
 
             ErrorCode BuildIndexInternal(std::shared_ptr<Helper::VectorSetReader>& p_reader);
 
@@ -431,6 +495,27 @@ namespace SPTAG
 
             void ForceCompaction() {if (m_options.m_useKV) m_extraSearcher->ForceCompaction();}
 
+            bool NeedHeadCompaction()
+            {
+                auto headIndex = std::atomic_load(&m_index);
+                return m_options.m_headCompactRatio > 0 && headIndex != nullptr &&
+                    headIndex->GetNumDeleted() > headIndex->GetNumSamples() * m_options.m_headCompactRatio;
+            }
+
+            ErrorCode CompactHeadIndex();
+
+            // The first call only records the head count; heads added later by splits are out of BKTree order.
+            bool NeedHeadReorder()
+            {
+                auto headIndex = std::atomic_load(&m_index);
+                if (m_options.m_headReorderRatio <= 0 || headIndex == nullptr) return false;
+                SizeType num = headIndex->GetNumSamples();
+                if (m_reorderedHeadNum == 0) m_reorderedHeadNum = num;
+                return num > m_reorderedHeadNum * (1 + m_options.m_headReorderRatio);
+            }
+
+            ErrorCode ReorderHeadIndex();
+
             int getSplitTimes() {return m_splitNum;}
 
             int getHeadMiss() {return m_headMiss.load();}
@@ -457,17 +542,14 @@ namespace SPTAG
 
             void PrintUpdateCostStatus()
             {
-                LOG(Helper::LogLevel::LL_Info, "AppendTaskNum: %d, TotalCost: %.3lf us, PerCost: %.3lf us\n", m_appendTaskNum, m_appendCost, m_appendCost/m_appendTaskNum);
-                LOG(Helper::LogLevel::LL_Info, "AppendTaskNum: %d, AppendIO TotalCost: %.3lf us, PerCost: %.3lf us\n", m_appendTaskNum, m_appendIOCost, m_appendIOCost/m_appendTaskNum);
-                LOG(Helper::LogLevel::LL_Info, "SplitNum: %d, TotalCost: %.3lf ms, PerCost: %.3lf ms\n", m_splitNum, m_splitCost, m_splitCost/m_splitNum);
-                LOG(Helper::LogLevel::LL_Info, "SplitNum: %d, Clustering TotalCost: %.3lf us, PerCost: %.3lf us\n", m_splitNum, m_clusteringCost, m_clusteringCost/m_splitNum);
-                LOG(Helper::LogLevel::LL_Info, "SplitNum: %d, UpdateHead TotalCost: %.3lf ms, PerCost: %.3lf ms\n", m_splitNum, m_updateHeadCost, m_updateHeadCost/m_splitNum);
-                LOG(Helper::LogLevel::LL_Info, "SplitNum: %d, ReassignScan TotalCost: %.3lf ms, PerCost: %.3lf ms\n", m_splitNum, m_reassignScanCost, m_reassignScanCost/m_splitNum);
-                LOG(Helper::LogLevel::LL_Info, "SplitNum: %d, ReassignScanIO TotalCost: %.3lf ms, PerCost: %.3lf ms\n", m_splitNum, m_reassignScanIOCost, m_reassignScanIOCost/m_splitNum);
-                LOG(Helper::LogLevel::LL_Info, "GCNum: %d, TotalCost: %.3lf us, PerCost: %.3lf us\n", m_garbageNum, m_garbageCost, m_garbageCost/m_garbageNum);
-                LOG(Helper::LogLevel::LL_Info, "ReassignNum: %d, TotalCost: %.3lf us, PerCost: %.3lf us\n", m_reAssignNum, m_reAssignCost, m_reAssignCost/m_reAssignNum);
-                LOG(Helper::LogLevel::LL_Info, "ReassignNum: %d, Select TotalCost: %.3lf us, PerCost: %.3lf us\n", m_reAssignNum, m_selectCost, m_selectCost/m_reAssignNum);
-                LOG(Helper::LogLevel::LL_Info, "ReassignNum: %d, ReassignAppend TotalCost: %.3lf us, PerCost: %.3lf us\n", m_reAssignNum, m_reAssignAppendCost, m_reAssignAppendCost/m_reAssignNum);
+                for (const auto& entry : IndexMetrics::Entries())
+                {
+                    if (!entry.m_update) continue;
+
+                    auto snapshot = ((*m_metrics).*(entry.m_histogram)).GetSnapshot();
+                    LOG(Helper::LogLevel::LL_Info, "%s: count %llu, TotalCost: %.3lf us, PerCost: %.3lf us, P99: %.3lf us, Max: %.3lf us\n", entry.m_name,
+                        (unsigned long long)snapshot.m_count, (double)snapshot.m_sum, snapshot.Mean(), snapshot.Percentile(99), (double)snapshot.m_max);
+                }
             }
 
             void PrintUpdateStatus(int finishedInsert)
@@ -484,17 +566,7 @@ namespace SPTAG
                 m_reAssignScanNum = 0;
                 m_garbageNum = 0;
                 m_appendTaskNum = 0;
-                m_splitCost = 0;
-                m_clusteringCost = 0;
-                m_garbageCost = 0;
-                m_updateHeadCost = 0;
-                m_reassignScanCost = 0;
-                m_reassignScanIOCost = 0;
-                m_appendCost = 0;
-                m_appendIOCost = 0;
-                m_reAssignCost = 0;
-                m_selectCost = 0;
-                m_reAssignAppendCost = 0;
+                m_metrics->ResetUpdates();
             }
 
             void Rebuild(std::shared_ptr<Helper::VectorSetReader>& p_reader, SizeType upperBound = -1)
@@ -526,8 +598,7 @@ namespace SPTAG
                     threads.emplace_back([&, tid]()
                         {
                             COMMON::QueryResultSet<T> resultSet(NULL, m_options.m_internalResultNum);
-
-                            size_t rngFailedCount = 0;
+                            COMMON::ReplicaSelector selector(m_options.m_rngPairCacheSize);
 
                             while (true)
                             {
@@ -545,60 +616,18 @@ namespace SPTAG
 
                                 size_t selectionOffset = static_cast<size_t>(fullID)* m_options.m_replicaCount;
 
-                                BasicResult* queryResults = resultSet.GetResults();
-                                for (int i = 0; i < m_options.m_internalResultNum && replicaCount[fullID] < m_options.m_replicaCount; ++i)
+                                replicaCount[fullID] = selector.Select(m_index.get(), resultSet.GetResults(), m_options.m_internalResultNum, m_options.m_replicaCount, m_options.m_rngFactor);
+                                for (int i = 0; i < replicaCount[fullID]; ++i)
                                 {
-                                    if (queryResults[i].VID == -1)
-                                    {
-                                        break;
-                                    }
-
-                                    // RNG Check.
-                                    bool rngAccpeted = true;
-                                    for (int j = 0; j < replicaCount[fullID]; ++j)
-                                    {
-                                        // VQANNSearch::QueryResultSet<ValueType> resultSet(NULL, candidateNum);
-
-                                        float nnDist = m_index->ComputeDistance(
-                                            m_index->GetSample(queryResults[i].VID),
-                                            m_index->GetSample(selections[selectionOffset + j].headID));
-
-                                        // LOG(Helper::LogLevel::LL_Info,  "NNDist: %f Original: %f\n", nnDist, queryResults[i].Score);
-                                        if (m_options.m_rngFactor * nnDist <= queryResults[i].Dist)
-                                        {
-                                            rngAccpeted = false;
-                                            break;
-                                        }
-                                    }
-
-                                    if (!rngAccpeted)
-                                    {
-                                        ++rngFailedCount;
-                                        continue;
-                                    }
-
-                                    ++postingListSize[queryResults[i].VID];
-                                    selections[selectionOffset + replicaCount[fullID]].headID = queryResults[i].VID;
-                                    selections[selectionOffset + replicaCount[fullID]].fullID = fullID;
-                                    selections[selectionOffset + replicaCount[fullID]].distance = queryResults[i].Dist;
-                                    selections[selectionOffset + replicaCount[fullID]].order = (char)replicaCount[fullID];
-                                    ++replicaCount[fullID];
+                                    ++postingListSize[selector[i].VID];
+                                    selections[selectionOffset + i].headID = selector[i].VID;
+                                    selections[selectionOffset + i].fullID = fullID;
+                                    selections[selectionOffset + i].distance = selector[i].Dist;
+                                    selections[selectionOffset + i].order = (char)i;
                                 }
-                                // if (replicaCount[fullID] == 1) {
-                                //     for (int i = 0; i < m_options.m_internalResultNum; i++) {
-                                //         for (int j = 0; j < replicaCount[fullID]; ++j)
-                                //         {
-                                //             float nnDist = m_index->ComputeDistance(
-                                //                 m_index->GetSample(queryResults[i].VID),
-                                //                 m_index->GetSample(selections[selectionOffset + j].headID));
-
-                                //             LOG(Helper::LogLevel::LL_Info, "VID: %d, The %d th head dist: %f, rng check %d: %f\n", fullID, i, queryResults[i].Dist, j, nnDist);
-                                //         }
-                                //     }
-                                // }
                             }
 
-                            rngFailedCountTotal += rngFailedCount;
+                            rngFailedCountTotal += selector.Rejected();
                         });
                 }
 
@@ -977,6 +1006,8 @@ namespace SPTAG
                     doneReassign = true;
                     std::vector<std::thread> threads;
                     std::atomic_int nextPostingID(0);
+                    std::mutex newHeadsLock;
+                    std::vector<SizeType> newHeads;
                     int currentPostingNum = m_index->GetNumSamples();
                     int limit = m_extraSearcher->GetPostingSizeLimit() * m_options.m_preReassignRatio;
                     LOG(Helper::LogLevel::LL_Info,"Batch PreReassign, Current PostingNum: %d, Current Limit: %d\n", currentPostingNum, limit);
@@ -1023,17 +1054,24 @@ namespace SPTAG
                                             theSameHead = true;
                                         }
                                         else {
-                                            int begin, end = 0;
-                                            m_index->AddIndexId(args.centers + k * args._D, 1, m_options.m_dim, begin, end);
-                                            m_index->AddIndexIdx(begin, end);
+                                            // reserve the posting size slot before the head exists
                                             {
                                                 std::lock_guard<std::mutex> lock(m_dataAddLock);
                                                 auto ret = m_postingSizes.AddBatch(1);
-                                                if (ret == ErrorCode::MemoryOverFlow) {
-                                                    LOG(Helper::LogLevel::LL_Info, "MemoryOverFlow: newHeadVID: %d, Map Size:%d\n", begin, m_postingSizes.BufferSize());
-                                                    exit(1);
+                                                if (ret != ErrorCode::Success) {
+                                                    LOG(Helper::LogLevel::LL_Error, "MemoryOverFlow: split head %d, Map Size:%d\n", index, m_postingSizes.BufferSize());
+                                                    return;
                                                 }
                                             }
+                                            int begin = 0, end = 0;
+                                            if (m_index->AddIndexId(args.centers + k * args._D, 1, m_options.m_dim, begin, end) != ErrorCode::Success) {
+                                                LOG(Helper::LogLevel::LL_Error, "PreReassign fail to add new head for %d\n", index);
+                                                return;
+                                            }
+                                            {
+                                                std::lock_guard<std::mutex> lock(newHeadsLock);
+                                                newHeads.push_back(begin);
+                                            }
                                         }
                                     }
                                     if (!theSameHead) {
@@ -1049,6 +1087,11 @@ namespace SPTAG
                     };
                     for (int j = 0; j < m_options.m_iSSDNumberOfThreads; j++) { threads.emplace_back(func); }
                     for (auto& thread : threads) { thread.join(); }
+                    // wire all heads created in this round into the head graph in one batch
+                    LOG(Helper::LogLevel::LL_Info, "Link %zu new heads into head graph\n", newHeads.size());
+                    if (m_index->AddIndexIdxBatch(newHeads) != ErrorCode::Success) {
+                        LOG(Helper::LogLevel::LL_Error, "Fail to link new heads into head graph\n");
+                    }
                     auto preReassignTimeEnd = std::chrono::high_resolution_clock::now();
                     double elapsedSeconds = std::chrono::duration_cast<std::chrono::seconds>(preReassignTimeEnd - preReassignTimeBegin).count();
                     LOG(Helper::LogLevel::LL_Info, "rebuild cost: %.2lf s\n", elapsedSeconds);
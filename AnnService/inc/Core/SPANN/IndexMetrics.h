@@ -0,0 +1,110 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef _SPTAG_SPANN_INDEXMETRICS_H_
+#define _SPTAG_SPANN_INDEXMETRICS_H_
+
+#include "inc/Helper/LatencyHistogram.h"
+#include "inc/Helper/MetricsWriter.h"
+
+#include <atomic>
+
+namespace SPTAG
+{
+    namespace SPANN
+    {
+        // Latency histograms of the search stages and of the background update work of one SPANN index.
+        struct IndexMetrics
+        {
+            Helper::LatencyHistogram m_search;
+
+            Helper::LatencyHistogram m_headSearch;
+
+            // Posting stages of a synchronous search: issuing the reads, waiting for them, and scanning.
+            Helper::LatencyHistogram m_postingSubmit;
+
+            Helper::LatencyHistogram m_postingRead;
+
+            Helper::LatencyHistogram m_postingScan;
+
+            Helper::LatencyHistogram m_append;
+
+            Helper::LatencyHistogram m_appendIO;
+
+            Helper::LatencyHistogram m_split;
+
+            Helper::LatencyHistogram m_splitClustering;
+
+            Helper::LatencyHistogram m_splitUpdateHead;
+
+            Helper::LatencyHistogram m_splitReassignScan;
+
+            Helper::LatencyHistogram m_splitReassignScanIO;
+
+            Helper::LatencyHistogram m_garbageCollect;
+
+            Helper::LatencyHistogram m_reassign;
+
+            Helper::LatencyHistogram m_reassignSelect;
+
+            Helper::LatencyHistogram m_reassignAppend;
+
+            // Totals since the index was loaded. ResetUpdateStatus clears the per-phase counters of the index,
+            // so these separate ones are what is exported as Prometheus counters.
+            std::atomic_uint64_t m_splits{ 0 };
+
+            std::atomic_uint64_t m_reassigns{ 0 };
+
+            std::atomic_uint64_t m_headMisses{ 0 };
+
+            struct Entry
+            {
+                Helper::LatencyHistogram IndexMetrics::* m_histogram;
+
+                const char* m_name;
+
+                const char* m_help;
+
+                bool m_update;
+            };
+
+            static const std::vector<Entry>& Entries()
+            {
+                static const std::vector<Entry> entries = {
+                    { &IndexMetrics::m_search, "sptag_spann_search_seconds", "Latency of a SPANN search.", false },
+                    { &IndexMetrics::m_headSearch, "sptag_spann_head_search_seconds", "Latency of the head index search.", false },
+                    { &IndexMetrics::m_postingSubmit, "sptag_spann_posting_submit_seconds", "Time spent issuing posting reads.", false },
+                    { &IndexMetrics::m_postingRead, "sptag_spann_posting_read_seconds", "Time spent waiting for posting reads.", false },
+                    { &IndexMetrics::m_postingScan, "sptag_spann_posting_scan_seconds", "Time spent scanning postings.", false },
+                    { &IndexMetrics::m_append, "sptag_spann_append_seconds", "Latency of an append.", true },
+                    { &IndexMetrics::m_appendIO, "sptag_spann_append_io_seconds", "Posting I/O of an append.", true },
+                    { &IndexMetrics::m_split, "sptag_spann_split_seconds", "Latency of a posting split.", true },
+                    { &IndexMetrics::m_splitClustering, "sptag_spann_split_clustering_seconds", "Clustering of a posting split.", true },
+                    { &IndexMetrics::m_splitUpdateHead, "sptag_spann_split_update_head_seconds", "Head index update of a posting split.", true },
+                    { &IndexMetrics::m_splitReassignScan, "sptag_spann_split_reassign_scan_seconds", "Reassign scan of a posting split.", true },
+                    { &IndexMetrics::m_splitReassignScanIO, "sptag_spann_split_reassign_scan_io_seconds", "Posting I/O of the reassign scan.", true },
+                    { &IndexMetrics::m_garbageCollect, "sptag_spann_garbage_collect_seconds", "Latency of a posting garbage collection.", true },
+                    { &IndexMetrics::m_reassign, "sptag_spann_reassign_seconds", "Latency of a vector reassign.", true },
+                    { &IndexMetrics::m_reassignSelect, "sptag_spann_reassign_select_seconds", "Head selection of a vector reassign.", true },
+                    { &IndexMetrics::m_reassignAppend, "sptag_spann_reassign_append_seconds", "Append of a vector reassign.", true },
+                };
+                return entries;
+            }
+
+            void Write(Helper::MetricsWriter& p_writer) const
+            {
+                for (const auto& entry : Entries()) p_writer.WriteLatency(entry.m_name, entry.m_help, this->*(entry.m_histogram));
+            }
+
+            void ResetUpdates()
+            {
+                for (const auto& entry : Entries())
+                {
+                    if (entry.m_update) (this->*(entry.m_histogram)).Reset();
+                }
+            }
+        };
+    }
+}
+
+#endif // _SPTAG_SPANN_INDEXMETRICS_H_
@@ -41,6 +41,9 @@ namespace SPTAG {
             std::string m_deleteIDFile;
             std::string m_ssdIndex;
             bool m_deleteHeadVectors;
+            bool m_reorderHeads;
+            bool m_quantizeHead;
+            std::string m_headQuantizerFile;
             int m_ssdIndexFileNum;
             std::string m_quantizerFilePath;
 
@@ -68,6 +71,7 @@ namespace SPTAG {
             bool m_recursiveCheckSmallCluster;
             bool m_printSizeCount;
             std::string m_selectType;
+            int m_selectHeadSampleNumber;
             // Dataset constructor args
             int m_datasetRowsInBlock;
             int m_datasetCapacity;
@@ -88,6 +92,7 @@ namespace SPTAG {
             int m_batches;
             std::string m_tmpdir;
             float m_rngFactor;
+            int m_rngPairCacheSize;
             int m_samples;
             std::string m_fullDeletedIDFile;
             bool m_useKV;
@@ -116,10 +121,28 @@ namespace SPTAG {
             int m_searchPostingPageLimit;
             int m_searchInternalResultNum;
             int m_rerank;
+            int m_searchPostingBatch;
+            float m_searchConvergeRatio;
+            int m_searchPageBudget;
+            float m_searchLatencyBudget;
+            float m_searchBudgetTargetRecall;
+            std::string m_searchBudgetTuneQueryPath;
+            std::string m_searchBudgetTuneTruthPath;
+            int m_searchBudgetTuneQueryNum;
+            int m_speculativePrefetchInterval;
+            int m_searchScanThreads;
+            int m_headRerankNum;
             bool m_recall_analysis;
             int m_debugBuildInternalResultNum;
             bool m_enableADC;
             int m_iotimeout;
+            int m_asyncSearchThreads;
+            int m_asyncSearchMaxInFlight;
+            float m_recallMonitorSampleRate;
+            int m_recallMonitorK;
+            int m_recallMonitorInternalResultNum;
+            int m_recallMonitorWindow;
+            int m_recallMonitorMaxPending;
 
             int m_searchThreadNum;
 
@@ -140,6 +163,9 @@ namespace SPTAG {
             int m_reassignK;
             int m_maxHeadNode;
             bool m_virtualHead;
+            float m_headCompactRatio;
+            int m_headCompactWaitMs;
+            float m_headReorderRatio;
 
             // Updating(SPFresh Update Test)
             bool m_update;
@@ -183,6 +209,12 @@ namespace SPTAG {
 
             ~Options() {}
 
+            // Asynchronous searches get workspaces, and I/O channels, after the NumberOfThreads ones of the
+            // synchronous searches.
+            int GetAsyncSearchWorkSpaces() const { return (m_asyncSearchMaxInFlight > 0) ? m_asyncSearchMaxInFlight : max(1, m_iSSDNumberOfThreads); }
+
+            int GetSearchChannels() const { return m_iSSDNumberOfThreads + GetAsyncSearchWorkSpaces(); }
+
             ErrorCode SetParameter(const char* p_section, const char* p_param, const char* p_value)
             {
                 if (nullptr == p_section || nullptr == p_param || nullptr == p_value) return ErrorCode::Fail;
@@ -30,6 +30,9 @@ DefineBasicParameter(m_headVectorFile, std::string, std::string("SPTAGHeadVector
 DefineBasicParameter(m_headIndexFolder, std::string, std::string("HeadIndex"), "HeadIndexFolder")
 DefineBasicParameter(m_ssdIndex, std::string, std::string("SPTAGFullList.bin"), "SSDIndex")
 DefineBasicParameter(m_deleteHeadVectors, bool, false, "DeleteHeadVectors")
+DefineBasicParameter(m_reorderHeads, bool, false, "ReorderHeads")
+DefineBasicParameter(m_quantizeHead, bool, false, "QuantizeHead")
+DefineBasicParameter(m_headQuantizerFile, std::string, std::string("SPTAGHeadQuantizer.bin"), "HeadQuantizer")
 DefineBasicParameter(m_ssdIndexFileNum, int, 1, "SSDIndexFileNum")
 DefineBasicParameter(m_quantizerFilePath, std::string, std::string(), "QuantizerFilePath")
 
@@ -61,6 +64,7 @@ DefineSelectHeadParameter(m_headVectorCount, int, 0, "Count")
 DefineSelectHeadParameter(m_recursiveCheckSmallCluster, bool, true, "RecursiveCheckSmallCluster")
 DefineSelectHeadParameter(m_printSizeCount, bool, true, "PrintSizeCount")
 DefineSelectHeadParameter(m_selectType, std::string, "BKT", "SelectHeadType")
+DefineSelectHeadParameter(m_selectHeadSampleNumber, int, 0, "SelectHeadSampleNumber")
 
 DefineSelectHeadParameter(m_datasetRowsInBlock, int, 1024 * 1024, "DataBlockSize")
 DefineSelectHeadParameter(m_datasetCapacity, int, SPTAG::MaxSize, "DataCapacity")
@@ -86,6 +90,8 @@ DefineSSDParameter(m_outputEmptyReplicaID, bool, false, "OutputEmptyReplicaID")
 DefineSSDParameter(m_batches, int, 1, "Batches")
 DefineSSDParameter(m_tmpdir, std::string, std::string("."), "TmpDir")
 DefineSSDParameter(m_rngFactor, float, 1.0f, "RNGFactor")
+// Head pairs whose distance each replica selection thread remembers, 0 disables the cache
+DefineSSDParameter(m_rngPairCacheSize, int, 0, "RNGPairCacheSize")
 DefineSSDParameter(m_samples, int, 100, "RecallTestSampleNumber")
 DefineSSDParameter(m_fullDeletedIDFile, std::string, std::string("fulldeleted"), "FullDeletedIDFile")
 DefineSSDParameter(m_useKV, bool, false, "UseKV")
@@ -114,10 +120,42 @@ DefineSSDParameter(m_ioThreads, int, 4, "IOThreadsPerHandler")
 DefineSSDParameter(m_searchInternalResultNum, int, 64, "SearchInternalResultNum")
 DefineSSDParameter(m_searchPostingPageLimit, int, (std::numeric_limits<int>::max)() - 1, "SearchPostingPageLimit")
 DefineSSDParameter(m_rerank, int, 0, "Rerank")
+// Postings read per round of a search, 0 reads all of them at once. Between rounds the search stops once
+// the ResultNum-th result is within SearchConvergeRatio of the next head distance, or a budget is spent.
+// Unlike learned early termination, the gap between the head distances of a query is not used as a signal.
+DefineSSDParameter(m_searchPostingBatch, int, 0, "SearchPostingBatch")
+DefineSSDParameter(m_searchConvergeRatio, float, 0.0f, "SearchConvergeRatio")
+DefineSSDParameter(m_searchPageBudget, int, 0, "SearchPageBudget")
+DefineSSDParameter(m_searchLatencyBudget, float, 0.0f, "SearchLatencyBudget")
+// Recall SSDServing tunes SearchConvergeRatio for against the truth file, 0 disables the tuning
+DefineSSDParameter(m_searchBudgetTargetRecall, float, 0.0f, "SearchBudgetTargetRecall")
+// Queries and truth the ratio is tuned on; without them the first SearchBudgetTuneQueryNum queries of QueryPath
+// (a tenth by default) are used and left out of the searched queries
+DefineSSDParameter(m_searchBudgetTuneQueryPath, std::string, std::string(""), "SearchBudgetTuneQueryPath")
+DefineSSDParameter(m_searchBudgetTuneTruthPath, std::string, std::string(""), "SearchBudgetTuneTruthPath")
+DefineSSDParameter(m_searchBudgetTuneQueryNum, int, 0, "SearchBudgetTuneQueryNum")
+// Head vectors checked between looks at the partial head results. Postings of heads that stay in them are
+// read while the head search goes on; 0 reads postings only once the head search is done.
+DefineSSDParameter(m_speculativePrefetchInterval, int, 0, "SpeculativePrefetchInterval")
+// Threads scanning the postings of one query, for few expensive queries on an otherwise idle machine. Each
+// keeps its own results and the query thread merges them; 0 or 1 scans on the query thread only.
+DefineSSDParameter(m_searchScanThreads, int, 0, "SearchScanThreads")
+// Heads of a quantized head index re-scored at full precision, 0 means 2 * SearchInternalResultNum
+DefineSSDParameter(m_headRerankNum, int, 0, "HeadRerankNum")
 DefineSSDParameter(m_enableADC, bool, false, "EnableADC")
 DefineSSDParameter(m_recall_analysis, bool, false, "RecallAnalysis")
 DefineSSDParameter(m_debugBuildInternalResultNum, int, 64, "DebugBuildInternalResultNum")
 DefineSSDParameter(m_iotimeout, int, 30, "IOTimeout")
+DefineSSDParameter(m_asyncSearchThreads, int, 0, "AsyncSearchThreads")
+// Asynchronous searches in flight, each on a workspace of its own, 0 means NumberOfThreads; more are turned away as busy
+DefineSSDParameter(m_asyncSearchMaxInFlight, int, 0, "AsyncSearchMaxInFlight")
+// Fraction of live queries checked against a deeper reference search, 0 disables the recall monitor
+DefineSSDParameter(m_recallMonitorSampleRate, float, 0.0f, "RecallMonitorSampleRate")
+DefineSSDParameter(m_recallMonitorK, int, 10, "RecallMonitorK")
+// Heads probed by the reference search, 0 means 4 * SearchInternalResultNum
+DefineSSDParameter(m_recallMonitorInternalResultNum, int, 0, "RecallMonitorInternalResultNum")
+DefineSSDParameter(m_recallMonitorWindow, int, 1000, "RecallMonitorWindow")
+DefineSSDParameter(m_recallMonitorMaxPending, int, 64, "RecallMonitorMaxPending")
 
 // Calculating
 // TruthFilePrefix
@@ -166,4 +204,10 @@ DefineSSDParameter(m_searchDuringUpdate, bool, false, "SearchDuringUpdate")
 DefineSSDParameter(m_reassignK, int, 0, "ReassignK")
 DefineSSDParameter(m_maxHeadNode, int, 200000000, "MaxHeadNode")
 DefineSSDParameter(m_virtualHead, bool, false, "VirtualHead")
+// Compact the head index once this fraction of heads is deleted, 0 disables it
+DefineSSDParameter(m_headCompactRatio, float, 0.0f, "HeadCompactRatio")
+// How long a head compaction waits for searches to drop the old head index before leaving its tail postings to a later one
+DefineSSDParameter(m_headCompactWaitMs, int, 1000, "HeadCompactWaitMs")
+// Reorder the head index once the heads grow by this fraction since the last reorder, 0 disables it
+DefineSSDParameter(m_headReorderRatio, float, 0.0f, "HeadReorderRatio")
 #endif
@@ -0,0 +1,130 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef _SPTAG_SPANN_RECALLMONITOR_H_
+#define _SPTAG_SPANN_RECALLMONITOR_H_
+
+#include "../Common.h"
+#include "../VectorIndex.h"
+#include "inc/Helper/ThreadPool.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace SPTAG
+{
+    namespace SPANN
+    {
+        // Samples live queries and compares their results with a deeper reference search run on a
+        // single background thread, keeping the recall over the last m_window sampled queries.
+        class RecallMonitor
+        {
+        public:
+            class ReferenceJob : public Helper::ThreadPool::Job
+            {
+            public:
+                ReferenceJob(std::function<void()> p_work) : m_work(std::move(p_work)) {}
+
+                ~ReferenceJob() {}
+
+                void exec(IAbortOperation* p_abort) override
+                {
+                    if (!p_abort->ShouldAbort()) m_work();
+                }
+
+            private:
+                std::function<void()> m_work;
+            };
+
+            RecallMonitor(float p_sampleRate, int p_K, int p_window, int p_maxPending)
+                : m_sampleRate(p_sampleRate), m_K(p_K), m_window(max(p_window, 1)), m_maxPending(max(p_maxPending, 1)), m_samples(m_window)
+            {
+                m_threadPool.init(1);
+            }
+
+            ~RecallMonitor() {}
+
+            // Every query advances the counter, and a query is picked each time count * rate crosses an integer.
+            inline bool ShouldSample()
+            {
+                std::uint64_t query = m_queries.fetch_add(1);
+                return (std::uint64_t)((query + 1) * (double)m_sampleRate) != (std::uint64_t)(query * (double)m_sampleRate);
+            }
+
+            // Samples are dropped instead of queued once the reference searches fall behind.
+            void Submit(std::function<void()> p_work)
+            {
+                if (m_threadPool.jobsize() >= (size_t)m_maxPending)
+                {
+                    m_dropped++;
+                    return;
+                }
+                m_threadPool.add(new ReferenceJob(std::move(p_work)));
+            }
+
+            inline void Drop() { m_dropped++; }
+
+            void Record(int p_hits, int p_total)
+            {
+                if (p_total <= 0) return;
+
+                std::lock_guard<std::mutex> lock(m_lock);
+                auto& slot = m_samples[m_recorded % m_window];
+                if (m_recorded >= (std::uint64_t)m_window)
+                {
+                    m_windowHits -= slot.first;
+                    m_windowTotal -= slot.second;
+                }
+                slot = std::make_pair(p_hits, p_total);
+                m_windowHits += p_hits;
+                m_windowTotal += p_total;
+
+                if (++m_recorded % m_window == 0)
+                {
+                    LOG(Helper::LogLevel::LL_Info, "Recall monitor: recall@%d %.4f over the last %d sampled queries (%llu sampled, %llu dropped)\n",
+                        m_K, m_windowHits / (double)m_windowTotal, m_window, (unsigned long long)m_recorded, (unsigned long long)m_dropped.load());
+                }
+            }
+
+            // Returns the recall over the current window, or -1 before the first sample completes.
+            double GetRollingRecall(std::uint64_t* p_recorded = nullptr, std::uint64_t* p_dropped = nullptr)
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                if (p_recorded != nullptr) *p_recorded = m_recorded;
+                if (p_dropped != nullptr) *p_dropped = m_dropped.load();
+                return (m_windowTotal == 0) ? -1 : m_windowHits / (double)m_windowTotal;
+            }
+
+            inline int GetK() const { return m_K; }
+
+        private:
+            float m_sampleRate;
+
+            int m_K;
+
+            int m_window;
+
+            int m_maxPending;
+
+            std::atomic_uint64_t m_queries{ 0 };
+
+            std::atomic_uint64_t m_dropped{ 0 };
+
+            std::mutex m_lock;
+
+            std::vector<std::pair<int, int>> m_samples;
+
+            std::uint64_t m_recorded = 0;
+
+            std::int64_t m_windowHits = 0;
+
+            std::int64_t m_windowTotal = 0;
+
+            Helper::ThreadPool m_threadPool;
+        };
+    }
+}
+
+#endif // _SPTAG_SPANN_RECALLMONITOR_H_
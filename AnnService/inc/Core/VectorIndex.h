@@ -10,10 +10,16 @@
 #include "MetadataSet.h"
 #include "inc/Helper/SimpleIniReader.h"
 #include <unordered_set>
+#include <functional>
 
 namespace SPTAG
 {
 
+namespace Helper
+{
+    class MetricsWriter;
+}
+
 class IAbortOperation
 {
 public:
@@ -41,6 +47,13 @@ public:
 
     virtual ErrorCode RefineIndex(std::shared_ptr<VectorIndex>& p_newIndex) = 0;
 
+    virtual ErrorCode CompactIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::vector<SizeType>& p_newToOld) = 0;
+
+    virtual ErrorCode ReorderIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::vector<SizeType>& p_newToOld) = 0;
+
+    // Copies the index with every vector replaced by its int8 code, keeping the ids and the search structures.
+    virtual ErrorCode QuantizeIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::function<void(const void*, std::int8_t*)> p_quantize) = 0;
+
     virtual float AccurateDistance(const void* pX, const void* pY) const = 0;
     virtual float ComputeDistance(const void* pX, const void* pY) const = 0;
     virtual const void* GetSample(const SizeType idx) const = 0;
@@ -80,6 +93,8 @@ public:
 
     virtual ErrorCode AddIndexIdx(SizeType begin, SizeType end) = 0;
 
+    virtual ErrorCode AddIndexIdxBatch(const std::vector<SizeType>& p_ids) = 0;
+
     virtual ErrorCode DeleteIndex(ByteArray p_meta);
 
     virtual ErrorCode MergeIndex(VectorIndex* p_addindex, int p_threadnum, IAbortOperation* p_abort);
@@ -88,7 +103,22 @@ public:
 
     virtual ErrorCode SearchIndex(const void* p_vector, int p_vectorCount, int p_neighborCount, bool p_withMeta, BasicResult* p_results) const;
 
-    virtual void ApproximateRNG(std::shared_ptr<VectorSet>& fullVectors, std::unordered_set<SizeType>& exceptIDS, int candidateNum, Edge* selections, int replicaCount, int numThreads, int numTrees, int leafSize, float RNGFactor, int numGPUs);
+    // Starts a search and calls p_callback with its outcome once p_results is final. p_results must stay alive
+    // until then. The callback may run on the calling thread or on an I/O thread. Indexes without an
+    // asynchronous path search synchronously and call back before returning. When the search cannot be started
+    // the error is returned and p_callback is never called; Busy means the index has as many searches in flight
+    // as it takes and the caller may search synchronously instead.
+    virtual ErrorCode SearchIndexAsync(QueryResult& p_results, std::function<void(ErrorCode)> p_callback, bool p_searchDeleted = false) const;
+
+    // Searches like SearchIndex and calls p_progress with the partial results, in heap order, every p_interval
+    // checked vectors, so that a caller can start on likely candidates before the search ends. Indexes
+    // without a progressive search never call p_progress.
+    virtual ErrorCode SearchIndexWithProgress(QueryResult& p_results, int p_interval, const std::function<void(QueryResult&)>& p_progress, bool p_searchDeleted = false) const;
+
+    // Appends the latency histograms and gauges of the index to p_writer; indexes without metrics write nothing.
+    virtual void CollectMetrics(Helper::MetricsWriter& p_writer) const {}
+
+    virtual void ApproximateRNG(std::shared_ptr<VectorSet>& fullVectors, std::unordered_set<SizeType>& exceptIDS, int candidateNum, Edge* selections, int replicaCount, int numThreads, int numTrees, int leafSize, float RNGFactor, int numGPUs, int pairCacheSize = 0);
 
     static void SortSelections(std::vector<Edge>* selections);
 
@@ -8,6 +8,7 @@
 #include "inc/Helper/ConcurrentSet.h"
 #include "inc/Core/Common.h"
 
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <string>
@@ -368,6 +369,7 @@ namespace SPTAG
 
                     if (nullptr != req)
                     {
+                        req->m_success = (cBytes == req->m_readSize);
                         req->m_callback(req);
                     }
                 }
@@ -579,6 +581,7 @@ namespace SPTAG
                         AsyncReadRequest* req = reinterpret_cast<AsyncReadRequest*>((events[r].data));
                         if (nullptr != req)
                         {
+                            req->m_success = (events[r].res == static_cast<std::int64_t>(req->m_readSize));
                             req->m_callback(req);
                         }
                     }
@@ -594,6 +597,120 @@ namespace SPTAG
             std::vector<aio_context_t> m_iocps;
         };
 
+        // Submits reads without waiting for them. Each listener thread owns one aio context and runs
+        // the request callbacks of everything submitted to it, so all reads of one channel complete
+        // on the same thread.
+        class AsyncReadDispatcher
+        {
+        public:
+            AsyncReadDispatcher() : m_shutdown(true) {}
+
+            ~AsyncReadDispatcher() { ShutDown(); }
+
+            bool Initialize(int p_threadNum, int p_maxEvents)
+            {
+                m_iocps.resize(p_threadNum);
+                memset(m_iocps.data(), 0, sizeof(aio_context_t) * p_threadNum);
+                for (int i = 0; i < p_threadNum; i++) {
+                    auto ret = syscall(__NR_io_setup, p_maxEvents, &(m_iocps[i]));
+                    if (ret < 0) {
+                        LOG(LogLevel::LL_Error, "Cannot setup aio: %s\n", strerror(errno));
+                        m_iocps.resize(i);
+                        ShutDown();
+                        return false;
+                    }
+                }
+
+                m_shutdown = false;
+                for (int i = 0; i < p_threadNum; ++i)
+                {
+                    m_listenThreads.emplace_back(std::thread(std::bind(&AsyncReadDispatcher::Listen, this, i)));
+                }
+                return true;
+            }
+
+            bool IsReady() const { return !m_shutdown; }
+
+            // Submits the requests in order through the context of their channel and returns how many
+            // were accepted. Callbacks of accepted requests may run before this returns.
+            int Submit(std::vector<std::shared_ptr<Helper::DiskPriorityIO>>& p_handlers, AsyncReadRequest** p_requests, int p_num)
+            {
+                if (p_num <= 0) return 0;
+
+                std::vector<struct iocb> myiocbs(p_num);
+                std::vector<struct iocb*> iocbs(p_num);
+                memset(myiocbs.data(), 0, p_num * sizeof(struct iocb));
+                for (int i = 0; i < p_num; i++) {
+                    AsyncReadRequest* readRequest = p_requests[i];
+                    struct iocb* myiocb = &(myiocbs[i]);
+                    myiocb->aio_data = reinterpret_cast<uintptr_t>(readRequest);
+                    myiocb->aio_lio_opcode = IOCB_CMD_PREAD;
+                    myiocb->aio_fildes = ((AsyncFileIO*)(p_handlers[readRequest->m_status >> 16].get()))->GetFileHandler();
+                    myiocb->aio_buf = (std::uint64_t)(readRequest->m_buffer);
+                    myiocb->aio_nbytes = readRequest->m_readSize;
+                    myiocb->aio_offset = static_cast<std::int64_t>(readRequest->m_offset);
+                    iocbs[i] = myiocb;
+                }
+
+                aio_context_t iocp = m_iocps[(p_requests[0]->m_status & 0xffff) % m_iocps.size()];
+                int submitted = 0, curTry = 0, maxTry = 10;
+                while (submitted < p_num && curTry < maxTry) {
+                    auto s = syscall(__NR_io_submit, iocp, p_num - submitted, iocbs.data() + submitted);
+                    if (s > 0) {
+                        submitted += (int)s;
+                        curTry = 0;
+                    }
+                    else {
+                        usleep(AIOTimeout.tv_nsec / 1000);
+                        curTry++;
+                    }
+                }
+                return submitted;
+            }
+
+            void ShutDown()
+            {
+                m_shutdown = true;
+                for (auto& th : m_listenThreads)
+                {
+                    if (th.joinable())
+                    {
+                        th.join();
+                    }
+                }
+                m_listenThreads.clear();
+
+                for (int i = 0; i < m_iocps.size(); i++) syscall(__NR_io_destroy, m_iocps[i]);
+                m_iocps.clear();
+            }
+
+        private:
+            void Listen(int i)
+            {
+                int b = 64;
+                std::vector<struct io_event> events(b);
+                while (!m_shutdown)
+                {
+                    int numEvents = syscall(__NR_io_getevents, m_iocps[i], 1, b, events.data(), &AIOTimeout);
+
+                    for (int r = 0; r < numEvents; r++) {
+                        AsyncReadRequest* req = reinterpret_cast<AsyncReadRequest*>((events[r].data));
+                        if (nullptr != req)
+                        {
+                            req->m_success = (events[r].res == static_cast<std::int64_t>(req->m_readSize));
+                            req->m_callback(req);
+                        }
+                    }
+                }
+            }
+
+            std::atomic_bool m_shutdown;
+
+            std::vector<std::thread> m_listenThreads;
+
+            std::vector<aio_context_t> m_iocps;
+        };
+
         int BatchReadFileAsync(std::vector<std::shared_ptr<Helper::DiskPriorityIO>>& handlers, AsyncReadRequest* readRequests, int num);
 #endif
     }
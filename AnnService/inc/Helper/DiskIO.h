@@ -29,10 +29,14 @@ namespace SPTAG
             std::function<void(AsyncReadRequest*)> m_callback;
             int m_status;
 
+            // Set by the completion threads of asynchronous reads before m_callback runs; false when fewer
+            // than m_readSize bytes came back.
+            bool m_success;
+
             // Carry items like counter for callback to process.
             void* m_payload;
             
-            AsyncReadRequest() : m_offset(0), m_readSize(0), m_buffer(nullptr), m_status(0), m_payload(nullptr) {}
+            AsyncReadRequest() : m_offset(0), m_readSize(0), m_buffer(nullptr), m_status(0), m_success(true), m_payload(nullptr) {}
         };
 
         class DiskPriorityIO
@@ -0,0 +1,175 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef _SPTAG_HELPER_LATENCYHISTOGRAM_H_
+#define _SPTAG_HELPER_LATENCYHISTOGRAM_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace SPTAG
+{
+    namespace Helper
+    {
+        // Log-linear histogram of microsecond latencies in the style of HdrHistogram: every power of
+        // two is split into 2^c_subBucketBits buckets, so a recorded value is off by at most 1/16.
+        // Writers only do relaxed atomic increments on one of c_shardCount shards picked by thread,
+        // so concurrent updates neither lock nor share a cache line in the common case.
+        class LatencyHistogram
+        {
+        public:
+            static const int c_subBucketBits = 4;
+
+            static const int c_subBucketCount = 1 << c_subBucketBits;
+
+            static const int c_maxExponent = 40;
+
+            static const int c_bucketCount = (c_maxExponent - c_subBucketBits + 2) * c_subBucketCount;
+
+            static const int c_shardBits = 3;
+
+            static const int c_shardCount = 1 << c_shardBits;
+
+            class Snapshot
+            {
+            public:
+                Snapshot() : m_counts(c_bucketCount, 0), m_count(0), m_sum(0), m_max(0) {}
+
+                // Highest value of the bucket holding the p-th percentile, capped by the largest recorded value.
+                double Percentile(double p_percentile) const
+                {
+                    if (m_count == 0) return 0;
+
+                    std::uint64_t rank = (std::uint64_t)(p_percentile / 100.0 * m_count + 0.5);
+                    if (rank < 1) rank = 1;
+                    if (rank > m_count) rank = m_count;
+
+                    std::uint64_t seen = 0;
+                    for (int i = 0; i < c_bucketCount; i++)
+                    {
+                        seen += m_counts[i];
+                        if (seen >= rank)
+                        {
+                            std::uint64_t value = BucketUpperBound(i);
+                            return (double)((value < m_max) ? value : m_max);
+                        }
+                    }
+                    return (double)m_max;
+                }
+
+                inline double Mean() const { return (m_count == 0) ? 0 : (double)m_sum / m_count; }
+
+                std::vector<std::uint64_t> m_counts;
+
+                std::uint64_t m_count;
+
+                std::uint64_t m_sum;
+
+                std::uint64_t m_max;
+            };
+
+            LatencyHistogram() : m_shards(new Shard[c_shardCount]) {}
+
+            ~LatencyHistogram() {}
+
+            void Record(std::uint64_t p_microseconds)
+            {
+                Shard& shard = m_shards[ShardIndex()];
+                shard.m_counts[BucketIndex(p_microseconds)].fetch_add(1, std::memory_order_relaxed);
+                shard.m_count.fetch_add(1, std::memory_order_relaxed);
+                shard.m_sum.fetch_add(p_microseconds, std::memory_order_relaxed);
+
+                std::uint64_t max = shard.m_max.load(std::memory_order_relaxed);
+                while (p_microseconds > max && !shard.m_max.compare_exchange_weak(max, p_microseconds, std::memory_order_relaxed));
+            }
+
+            template <typename Clock>
+            inline void RecordSince(const std::chrono::time_point<Clock>& p_begin)
+            {
+                Record((std::uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - p_begin).count());
+            }
+
+            // Sums the shards without stopping writers; a snapshot taken under load may miss updates in flight.
+            Snapshot GetSnapshot() const
+            {
+                Snapshot snapshot;
+                for (int s = 0; s < c_shardCount; s++)
+                {
+                    const Shard& shard = m_shards[s];
+                    for (int i = 0; i < c_bucketCount; i++) snapshot.m_counts[i] += shard.m_counts[i].load(std::memory_order_relaxed);
+                    snapshot.m_count += shard.m_count.load(std::memory_order_relaxed);
+                    snapshot.m_sum += shard.m_sum.load(std::memory_order_relaxed);
+                    std::uint64_t max = shard.m_max.load(std::memory_order_relaxed);
+                    if (max > snapshot.m_max) snapshot.m_max = max;
+                }
+                return snapshot;
+            }
+
+            void Reset()
+            {
+                for (int s = 0; s < c_shardCount; s++)
+                {
+                    Shard& shard = m_shards[s];
+                    for (int i = 0; i < c_bucketCount; i++) shard.m_counts[i].store(0, std::memory_order_relaxed);
+                    shard.m_count.store(0, std::memory_order_relaxed);
+                    shard.m_sum.store(0, std::memory_order_relaxed);
+                    shard.m_max.store(0, std::memory_order_relaxed);
+                }
+            }
+
+            static int BucketIndex(std::uint64_t p_value)
+            {
+                if (p_value < (std::uint64_t)c_subBucketCount) return (int)p_value;
+
+                int exponent = c_subBucketBits;
+                while (exponent < c_maxExponent && (p_value >> (exponent + 1)) != 0) exponent++;
+                if ((p_value >> (exponent + 1)) != 0) return c_bucketCount - 1;
+
+                int shift = exponent - c_subBucketBits;
+                return ((shift + 1) << c_subBucketBits) + (int)((p_value >> shift) & (c_subBucketCount - 1));
+            }
+
+            static std::uint64_t BucketUpperBound(int p_index)
+            {
+                if (p_index < c_subBucketCount) return (std::uint64_t)p_index;
+
+                int shift = (p_index >> c_subBucketBits) - 1;
+                std::uint64_t lower = (std::uint64_t)(c_subBucketCount + (p_index & (c_subBucketCount - 1))) << shift;
+                return lower + ((std::uint64_t)1 << shift) - 1;
+            }
+
+        private:
+            // Thread ids are often aligned addresses, so they are mixed before taking the top bits.
+            static inline int ShardIndex()
+            {
+                std::uint64_t id = (std::uint64_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+                return (int)((id * 0x9E3779B97F4A7C15ULL) >> (64 - c_shardBits));
+            }
+
+            struct alignas(64) Shard
+            {
+                Shard() : m_count(0), m_sum(0), m_max(0)
+                {
+                    for (int i = 0; i < c_bucketCount; i++) m_counts[i].store(0, std::memory_order_relaxed);
+                }
+
+                std::atomic<std::uint64_t> m_counts[c_bucketCount];
+
+                std::atomic<std::uint64_t> m_count;
+
+                std::atomic<std::uint64_t> m_sum;
+
+                std::atomic<std::uint64_t> m_max;
+            };
+
+            std::unique_ptr<Shard[]> m_shards;
+        };
+    }
+}
+
+#endif // _SPTAG_HELPER_LATENCYHISTOGRAM_H_
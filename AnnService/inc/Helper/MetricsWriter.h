@@ -0,0 +1,135 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef _SPTAG_HELPER_METRICSWRITER_H_
+#define _SPTAG_HELPER_METRICSWRITER_H_
+
+#include "LatencyHistogram.h"
+
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SPTAG
+{
+    namespace Helper
+    {
+        // Collects metrics in the Prometheus text exposition format. Samples of the same metric name
+        // are grouped together even when several indexes report it under different labels.
+        class MetricsWriter
+        {
+        public:
+            MetricsWriter() {}
+
+            ~MetricsWriter() {}
+
+            // Labels attached to every sample written until the next call, e.g. {"index", "name"}.
+            void SetLabels(const std::vector<std::pair<std::string, std::string>>& p_labels)
+            {
+                m_labels.clear();
+                for (const auto& label : p_labels)
+                {
+                    if (!m_labels.empty()) m_labels += ",";
+                    m_labels += label.first + "=\"" + Escape(label.second) + "\"";
+                }
+            }
+
+            void WriteCounter(const std::string& p_name, const std::string& p_help, double p_value)
+            {
+                Sample(p_name, p_help, "counter", p_name, "", p_value);
+            }
+
+            void WriteGauge(const std::string& p_name, const std::string& p_help, double p_value)
+            {
+                Sample(p_name, p_help, "gauge", p_name, "", p_value);
+            }
+
+            // Latencies are exported as a summary in seconds.
+            void WriteLatency(const std::string& p_name, const std::string& p_help, const LatencyHistogram& p_histogram)
+            {
+                LatencyHistogram::Snapshot snapshot = p_histogram.GetSnapshot();
+                const char* quantiles[] = { "0.5", "0.9", "0.99", "0.999" };
+                const double percentiles[] = { 50, 90, 99, 99.9 };
+                for (int i = 0; i < 4; i++)
+                {
+                    Sample(p_name, p_help, "summary", p_name, std::string("quantile=\"") + quantiles[i] + "\"", snapshot.Percentile(percentiles[i]) / 1e6);
+                }
+                Sample(p_name, p_help, "summary", p_name + "_sum", "", snapshot.m_sum / 1e6);
+                Sample(p_name, p_help, "summary", p_name + "_count", "", (double)snapshot.m_count);
+            }
+
+            std::string GetText() const
+            {
+                std::string text;
+                for (const auto& family : m_families)
+                {
+                    text += "# HELP " + family.m_name + " " + family.m_help + "\n";
+                    text += "# TYPE " + family.m_name + " " + family.m_type + "\n";
+                    text += family.m_samples;
+                }
+                return text;
+            }
+
+        private:
+            struct Family
+            {
+                std::string m_name;
+
+                std::string m_help;
+
+                std::string m_type;
+
+                std::string m_samples;
+            };
+
+            void Sample(const std::string& p_family, const std::string& p_help, const char* p_type,
+                const std::string& p_name, const std::string& p_extraLabel, double p_value)
+            {
+                auto iter = m_familyIndex.find(p_family);
+                if (iter == m_familyIndex.end())
+                {
+                    iter = m_familyIndex.emplace(p_family, m_families.size()).first;
+                    m_families.push_back({ p_family, p_help, p_type, "" });
+                }
+
+                std::string& samples = m_families[iter->second].m_samples;
+                samples += p_name;
+                if (!m_labels.empty() || !p_extraLabel.empty())
+                {
+                    samples += "{" + m_labels;
+                    if (!m_labels.empty() && !p_extraLabel.empty()) samples += ",";
+                    samples += p_extraLabel + "}";
+                }
+
+                char value[64];
+                snprintf(value, sizeof(value), " %.10g\n", p_value);
+                samples += value;
+            }
+
+            static std::string Escape(const std::string& p_value)
+            {
+                std::string escaped;
+                for (char c : p_value)
+                {
+                    if (c == '\\' || c == '"') escaped += '\\';
+                    if (c == '\n')
+                    {
+                        escaped += "\\n";
+                        continue;
+                    }
+                    escaped += c;
+                }
+                return escaped;
+            }
+
+            std::string m_labels;
+
+            std::vector<Family> m_families;
+
+            std::unordered_map<std::string, size_t> m_familyIndex;
+        };
+    }
+}
+
+#endif // _SPTAG_HELPER_METRICSWRITER_H_
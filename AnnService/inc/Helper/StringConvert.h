@@ -13,6 +13,8 @@
 #include <cctype>
 #include <limits>
 #include <cerrno>
+#include <cstdint>
+#include <type_traits>
 
 namespace SPTAG
 {
@@ -503,6 +505,134 @@ inline std::string ConvertToString<TruthFileType>(const TruthFileType& p_value)
     return "Undefined";
 }
 
+
+// Parses the token [p_begin, p_end) in place, without a terminating '\0' or a locale lookup.
+// Plain decimal integers and floats with at most 19 significant digits and a small exponent take
+// the fast path (for floats the Clinger fast path: the mantissa and the power of ten are both
+// exact in the target precision, so one multiply or divide gives the rounded value; float is
+// computed in float since rounding a double result again can be off by one ulp); anything else,
+// such as hex, inf/nan or surrounding spaces, falls back to ConvertStringTo on a copy of the token.
+
+template <typename DataType>
+inline bool ParseIntegerFast(const char* p_begin, const char* p_end, DataType& p_value)
+{
+    const char* p = p_begin;
+    bool negative = false;
+    if (p < p_end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+    if (p == p_end || p_end - p > 19) return false;
+
+    std::uint64_t val = 0;
+    for (; p < p_end; ++p)
+    {
+        unsigned digit = static_cast<unsigned>(*p - '0');
+        if (digit > 9) return false;
+        val = val * 10 + digit;
+    }
+
+    if (negative)
+    {
+        if (val == 0)
+        {
+            p_value = 0;
+            return true;
+        }
+        if (!std::is_signed<DataType>::value || val - 1 > static_cast<std::uint64_t>((std::numeric_limits<DataType>::max)())) return false;
+        p_value = static_cast<DataType>(-static_cast<std::int64_t>(val - 1) - 1);
+        return true;
+    }
+
+    if (val > static_cast<std::uint64_t>((std::numeric_limits<DataType>::max)())) return false;
+    p_value = static_cast<DataType>(val);
+    return true;
+}
+
+
+template <typename DataType>
+inline bool ParseFloatFast(const char* p_begin, const char* p_end, DataType& p_value)
+{
+    static const double c_powersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    const char* p = p_begin;
+    bool negative = false;
+    if (p < p_end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+    std::uint64_t mantissa = 0;
+    int significant = 0, exponent = 0;
+    bool anyDigit = false;
+    for (; p < p_end && static_cast<unsigned>(*p - '0') <= 9; ++p)
+    {
+        anyDigit = true;
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa != 0) ++significant;
+    }
+    if (p < p_end && *p == '.')
+    {
+        for (++p; p < p_end && static_cast<unsigned>(*p - '0') <= 9; ++p)
+        {
+            anyDigit = true;
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa != 0) ++significant;
+            --exponent;
+        }
+    }
+    if (!anyDigit || significant > 19) return false;
+
+    if (p < p_end && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        bool negativeExponent = false;
+        if (p < p_end && (*p == '-' || *p == '+')) negativeExponent = (*p++ == '-');
+        if (p == p_end) return false;
+        int e = 0;
+        for (; p < p_end && static_cast<unsigned>(*p - '0') <= 9; ++p)
+        {
+            if (e < 10000) e = e * 10 + (*p - '0');
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+    if (p != p_end) return false;
+
+    if (std::is_same<DataType, float>::value)
+    {
+        static const float c_floatPowersOfTen[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+        if (mantissa > (1ULL << 24) || exponent < -10 || exponent > 10) return false;
+        float val = static_cast<float>(mantissa);
+        val = (exponent < 0) ? val / c_floatPowersOfTen[-exponent] : val * c_floatPowersOfTen[exponent];
+        p_value = static_cast<DataType>(negative ? -val : val);
+        return true;
+    }
+
+    if (mantissa > (1ULL << 53) || exponent < -22 || exponent > 22) return false;
+
+    double val = static_cast<double>(mantissa);
+    val = (exponent < 0) ? val / c_powersOfTen[-exponent] : val * c_powersOfTen[exponent];
+    p_value = static_cast<DataType>(negative ? -val : val);
+    return true;
+}
+
+
+template <typename DataType>
+inline bool ParseNumber(const char* p_begin, const char* p_end, DataType& p_value)
+{
+    if (std::is_floating_point<DataType>::value)
+    {
+        if (ParseFloatFast(p_begin, p_end, p_value)) return true;
+    }
+    else if (std::is_integral<DataType>::value)
+    {
+        if (ParseIntegerFast(p_begin, p_end, p_value)) return true;
+    }
+
+    // the copy is read as a C string, so a '\0' inside the token would cut it short
+    if (std::memchr(p_begin, '\0', p_end - p_begin) != nullptr) return false;
+
+    std::string token(p_begin, p_end);
+    return ConvertStringTo(token.c_str(), p_value);
+}
+
 } // namespace Convert
 } // namespace Helper
 } // namespace SPTAG
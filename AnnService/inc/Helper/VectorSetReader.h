@@ -10,6 +10,7 @@
 #include "inc/Helper/ArgumentsParser.h"
 
 #include <memory>
+#include <vector>
 
 namespace SPTAG
 {
@@ -49,11 +50,20 @@ public:
 
     virtual std::shared_ptr<MetadataSet> GetMetadataSet() const = 0;
 
+    virtual SizeType GetVectorCount() const;
+
+    // p_ids must be ascending; the returned set keeps their order.
+    virtual std::shared_ptr<VectorSet> GetVectorSubset(const std::vector<SizeType>& p_ids) const;
+
     virtual bool IsNormalized() const { return m_options->m_normalized; }
 
     static std::shared_ptr<VectorSetReader> CreateInstance(std::shared_ptr<ReaderOptions> p_options);
 
 protected:
+    static SizeType ReadVectorCount(const std::string& p_vectorFile);
+
+    std::shared_ptr<VectorSet> ReadVectorSubset(const std::string& p_vectorFile, const std::vector<SizeType>& p_ids) const;
+
     std::shared_ptr<ReaderOptions> m_options;
 };
 
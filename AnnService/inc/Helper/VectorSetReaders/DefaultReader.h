@@ -24,6 +24,10 @@ public:
 
     virtual std::shared_ptr<MetadataSet> GetMetadataSet() const;
 
+    virtual SizeType GetVectorCount() const;
+
+    virtual std::shared_ptr<VectorSet> GetVectorSubset(const std::vector<SizeType>& p_ids) const;
+
 private:
     std::string m_vectorOutput;
 
@@ -5,11 +5,9 @@
 #define _SPTAG_HELPER_VECTORSETREADERS_TXTREADER_H_
 
 #include "../VectorSetReader.h"
-#include "inc/Helper/Concurrent.h"
+#include "inc/Helper/StringConvert.h"
 
-#include <atomic>
-#include <condition_variable>
-#include <mutex>
+#include <cstring>
 
 namespace SPTAG
 {
@@ -29,75 +27,74 @@ public:
 
     virtual std::shared_ptr<MetadataSet> GetMetadataSet() const;
 
+    virtual SizeType GetVectorCount() const;
+
+    virtual std::shared_ptr<VectorSet> GetVectorSubset(const std::vector<SizeType>& p_ids) const;
+
 private:
     typedef std::pair<std::string, std::size_t> FileInfoPair;
 
-    static std::vector<FileInfoPair> GetFileSizes(const std::string& p_filePaths);
+    // Records of one block of the input: a block owns the lines that start inside it.
+    struct ParsedBlock
+    {
+        SizeType m_recordCount = 0;
 
-    void LoadFileInternal(const std::string& p_filePath,
-                          std::uint32_t p_subtaskID,
-                          std::uint32_t p_fileBlockID,
-                          std::size_t p_fileBlockSize);
+        std::vector<std::uint8_t> m_vectors;
+
+        std::string m_metadata;
+
+        std::vector<std::uint64_t> m_metadataOffsets;
+    };
+
+    static std::vector<FileInfoPair> GetFileSizes(const std::string& p_filePaths);
 
-    void MergeData();
+    bool ParseBlock(const std::string& p_filePath,
+                    std::size_t p_fileSize,
+                    std::size_t p_blockBegin,
+                    ParsedBlock& p_block) const;
 
     template<typename DataType>
-    bool TranslateVector(char* p_str, DataType* p_vector)
+    bool TranslateVector(const char* p_begin, const char* p_end, DataType* p_vector) const
     {
         DimensionType eleCount = 0;
-        char* next = p_str;
-        while ((*next) != '\0')
+        const char* delimiters = m_options->m_vectorDelimiter.c_str();
+        std::size_t delimiterCount = m_options->m_vectorDelimiter.size();
+        while (p_begin < p_end)
         {
-            while ((*next) != '\0' && m_options->m_vectorDelimiter.find(*next) == std::string::npos)
+            const char* next = p_begin;
+            // memchr rather than strchr, which would also match the '\0' that ends the delimiters
+            while (next < p_end && std::memchr(delimiters, *next, delimiterCount) == nullptr)
             {
                 ++next;
             }
 
-            bool reachEnd = ('\0' == (*next));
-            *next = '\0';
-            if (p_str != next)
+            if (p_begin != next)
             {
                 if (eleCount >= m_options->m_dimension)
                 {
                     return false;
                 }
 
-                if (!Helper::Convert::ConvertStringTo(p_str, p_vector[eleCount++]))
+                if (!Helper::Convert::ParseNumber(p_begin, next, p_vector[eleCount++]))
                 {
                     return false;
                 }
             }
 
-            if (reachEnd)
-            {
-                break;
-            }
-
-            ++next;
-            p_str = next;
+            p_begin = next + 1;
         }
 
         return eleCount == m_options->m_dimension;
     }
 
 private:
-    std::uint32_t m_subTaskCount;
-
     std::size_t m_subTaskBlocksize;
 
-    std::atomic<SizeType> m_totalRecordCount;
-
-    std::atomic<std::size_t> m_totalRecordVectorBytes;
-
-    std::vector<SizeType> m_subTaskRecordCount;
-
     std::string m_vectorOutput;
 
     std::string m_metadataConentOutput;
 
     std::string m_metadataIndexOutput;
-
-    Helper::Concurrent::WaitSignal m_waitSignal;
 };
 
 
@@ -0,0 +1,179 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef _SPTAG_HELPER_WORKSTEALINGPOOL_H_
+#define _SPTAG_HELPER_WORKSTEALINGPOOL_H_
+
+#include "inc/Core/Common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SPTAG
+{
+    namespace Helper
+    {
+        // Runs a set of tasks which may spawn more tasks, returning once all of them have finished.
+        // Every worker keeps its own deque: it pushes and pops spawned tasks at the back, so a worker
+        // goes depth first through its own work, and idle workers steal from the front of the others,
+        // where the oldest and usually largest tasks are. Workers with nothing to take sleep until a
+        // task is spawned or all work is done. If a task throws, the tasks not yet started are dropped
+        // and Run rethrows the first exception once every worker has stopped.
+        class WorkStealingPool
+        {
+        public:
+            // A task receives the id of the worker running it, in [0, GetThreadNum()).
+            typedef std::function<void(int)> Task;
+
+            WorkStealingPool(int p_threadNum) : m_threadNum((p_threadNum > 1) ? p_threadNum : 1), m_queues(new Queue[m_threadNum]), m_pending(0), m_queued(0), m_failed(false) {}
+
+            ~WorkStealingPool() {}
+
+            inline int GetThreadNum() const { return m_threadNum; }
+
+            // Tasks added before Run are spread over the workers; a running task passes its own worker id.
+            void Spawn(int p_worker, Task p_task)
+            {
+                m_pending++;
+                {
+                    Queue& queue = m_queues[p_worker % m_threadNum];
+                    std::lock_guard<std::mutex> lock(queue.m_lock);
+                    queue.m_tasks.push_back(std::move(p_task));
+                }
+                {
+                    std::lock_guard<std::mutex> lock(m_idleLock);
+                    m_queued++;
+                }
+                m_idleCV.notify_one();
+            }
+
+            void Run()
+            {
+                std::vector<std::thread> threads;
+                for (int i = 1; i < m_threadNum; i++) threads.emplace_back([this, i] { Work(i); });
+                Work(0);
+                for (auto& thread : threads) thread.join();
+
+                if (m_error != nullptr)
+                {
+                    std::exception_ptr error = m_error;
+                    m_error = nullptr;
+                    m_failed = false;
+                    std::rethrow_exception(error);
+                }
+            }
+
+        private:
+            struct Queue
+            {
+                std::mutex m_lock;
+
+                std::deque<Task> m_tasks;
+            };
+
+            void Work(int p_worker)
+            {
+                Task task;
+                while (true)
+                {
+                    if (!Pop(p_worker, task) && !Steal(p_worker, task))
+                    {
+                        // m_queued is raised under m_idleLock after a push, so a spawn cannot slip in between the check and the wait.
+                        std::unique_lock<std::mutex> lock(m_idleLock);
+                        if (m_pending == 0) return;
+                        m_idleCV.wait(lock, [this] { return m_pending == 0 || m_queued > 0; });
+                        continue;
+                    }
+                    m_queued--;
+
+                    if (!m_failed)
+                    {
+                        try
+                        {
+                            task(p_worker);
+                        }
+                        catch (std::exception& e)
+                        {
+                            LOG(Helper::LogLevel::LL_Error, "WorkStealingPool: exception in task %s\n", e.what());
+                            Fail(std::current_exception());
+                        }
+                        catch (...)
+                        {
+                            LOG(Helper::LogLevel::LL_Error, "WorkStealingPool: unknown exception in task\n");
+                            Fail(std::current_exception());
+                        }
+                    }
+                    task = nullptr;
+
+                    if (--m_pending == 0)
+                    {
+                        {
+                            std::lock_guard<std::mutex> lock(m_idleLock);
+                        }
+                        m_idleCV.notify_all();
+                    }
+                }
+            }
+
+            void Fail(std::exception_ptr p_error)
+            {
+                std::lock_guard<std::mutex> lock(m_idleLock);
+                if (!m_failed)
+                {
+                    m_error = p_error;
+                    m_failed = true;
+                }
+            }
+
+            bool Pop(int p_worker, Task& p_task)
+            {
+                Queue& queue = m_queues[p_worker];
+                std::lock_guard<std::mutex> lock(queue.m_lock);
+                if (queue.m_tasks.empty()) return false;
+                p_task = std::move(queue.m_tasks.back());
+                queue.m_tasks.pop_back();
+                return true;
+            }
+
+            bool Steal(int p_worker, Task& p_task)
+            {
+                for (int i = 1; i < m_threadNum; i++)
+                {
+                    Queue& queue = m_queues[(p_worker + i) % m_threadNum];
+                    std::lock_guard<std::mutex> lock(queue.m_lock);
+                    if (queue.m_tasks.empty()) continue;
+                    p_task = std::move(queue.m_tasks.front());
+                    queue.m_tasks.pop_front();
+                    return true;
+                }
+                return false;
+            }
+
+            int m_threadNum;
+
+            std::unique_ptr<Queue[]> m_queues;
+
+            // Spawned tasks not finished yet, and those of them still sitting in a queue.
+            std::atomic<std::size_t> m_pending;
+
+            std::atomic<std::int64_t> m_queued;
+
+            std::mutex m_idleLock;
+
+            std::condition_variable m_idleCV;
+
+            std::atomic<bool> m_failed;
+
+            std::exception_ptr m_error;
+        };
+    }
+}
+
+#endif // _SPTAG_HELPER_WORKSTEALINGPOOL_H_
@@ -129,7 +129,7 @@ namespace SPTAG {
                             }
 
                             double startTime = threadws.getElapsedMs();
-                            p_index->GetMemoryIndex()->SearchIndex(p_results[index]);
+                            p_index->SearchHeadIndex(p_results[index]);
                             double endTime = threadws.getElapsedMs();
                             p_index->DebugSearchDiskIndex(p_results[index], p_internalResultNum, p_internalResultNum, &(p_stats[index]));
                             double exEndTime = threadws.getElapsedMs();
@@ -156,6 +156,99 @@ namespace SPTAG {
                     static_cast<uint32_t>(numQueries));
             }
 
+            // Returns the queries SearchConvergeRatio is tuned on and sets p_truthPath to their truth file. They come
+            // from SearchBudgetTuneQueryPath if it is set; otherwise the first SearchBudgetTuneQueryNum queries (a tenth
+            // by default) are split off p_querySet and p_heldOut is set to their number, so the tuned ratio is not
+            // scored on the queries it was picked on.
+            template <typename ValueType>
+            std::shared_ptr<VectorSet> SplitTuneQueries(SPANN::Options& p_opts, std::shared_ptr<VectorSet>& p_querySet, std::string& p_truthPath, int& p_heldOut)
+            {
+                p_heldOut = 0;
+                if (!p_opts.m_searchBudgetTuneQueryPath.empty())
+                {
+                    std::shared_ptr<Helper::ReaderOptions> queryOptions(new Helper::ReaderOptions(p_opts.m_valueType, p_opts.m_dim, p_opts.m_queryType, p_opts.m_queryDelimiter));
+                    auto queryReader = Helper::VectorSetReader::CreateInstance(queryOptions);
+                    if (ErrorCode::Success != queryReader->LoadFile(p_opts.m_searchBudgetTuneQueryPath) || p_opts.m_searchBudgetTuneTruthPath.empty())
+                    {
+                        LOG(Helper::LogLevel::LL_Error, "Failed to read tuning queries %s with truth %s.\n",
+                            p_opts.m_searchBudgetTuneQueryPath.c_str(), p_opts.m_searchBudgetTuneTruthPath.c_str());
+                        return nullptr;
+                    }
+                    p_truthPath = p_opts.m_searchBudgetTuneTruthPath;
+                    return queryReader->GetVectorSet();
+                }
+
+                SizeType count = p_querySet->Count();
+                p_heldOut = (p_opts.m_searchBudgetTuneQueryNum > 0) ? p_opts.m_searchBudgetTuneQueryNum : count / 10;
+                if (p_heldOut <= 0 || p_heldOut >= count)
+                {
+                    LOG(Helper::LogLevel::LL_Error, "Cannot hold %d of %d queries out for tuning.\n", p_heldOut, count);
+                    p_heldOut = 0;
+                    return nullptr;
+                }
+
+                // both parts point into the loaded queries, which the views keep alive
+                std::shared_ptr<VectorSet> all = p_querySet;
+                SizeType vectorSize = all->PerVectorDataSize();
+                std::shared_ptr<std::uint8_t> data(all, (std::uint8_t*)all->GetData());
+                std::shared_ptr<VectorSet> tuneSet(new BasicVectorSet(ByteArray(data.get(), (size_t)vectorSize * p_heldOut, data),
+                    all->GetValueType(), all->Dimension(), p_heldOut));
+                p_querySet.reset(new BasicVectorSet(ByteArray(data.get() + (size_t)vectorSize * p_heldOut, (size_t)vectorSize * (count - p_heldOut), data),
+                    all->GetValueType(), all->Dimension(), count - p_heldOut));
+                p_truthPath = p_opts.m_truthPath;
+                return tuneSet;
+            }
+
+            // Picks the largest SearchConvergeRatio, i.e. the earliest stop, that still reaches the target recall
+            // on p_querySet, so that the rounded posting search reads as few pages as the target allows.
+            template <typename ValueType>
+            void TuneSearchConvergeRatio(SPANN::Index<ValueType>* p_index, std::shared_ptr<VectorSet> p_querySet, const std::string& p_truthPath,
+                int p_numThreads, int p_K, int p_truthK, int p_internalResultNum)
+            {
+                SPANN::Options& p_opts = *(p_index->GetOptions());
+                SizeType numQueries = p_querySet->Count();
+
+                auto ptr = f_createIO();
+                if (ptr == nullptr || !ptr->Initialize(p_truthPath.c_str(), std::ios::in | std::ios::binary)) {
+                    LOG(Helper::LogLevel::LL_Error, "Failed open truth file: %s\n", p_truthPath.c_str());
+                    return;
+                }
+                std::vector<std::set<SizeType>> truth;
+                int originalK = p_truthK;
+                COMMON::TruthSet::LoadTruth(ptr, truth, numQueries, originalK, p_truthK, p_opts.m_truthType);
+
+                const float ratios[] = { 1.0f, 0.95f, 0.9f, 0.85f, 0.8f, 0.75f, 0.7f, 0.6f, 0.5f };
+                float chosen = 0;
+                for (float ratio : ratios)
+                {
+                    p_opts.m_searchConvergeRatio = ratio;
+
+                    std::vector<QueryResult> results(numQueries, QueryResult(NULL, max(p_K, p_internalResultNum), false));
+                    std::vector<SPANN::SearchStats> stats(numQueries);
+                    for (int i = 0; i < numQueries; ++i)
+                    {
+                        results[i].SetTarget(reinterpret_cast<ValueType*>(p_querySet->GetVector(i)));
+                        results[i].Reset();
+                    }
+                    SearchSequential(p_index, p_numThreads, results, stats, numQueries, p_internalResultNum);
+
+                    float recall = COMMON::TruthSet::CalculateRecall<ValueType>((p_index->GetMemoryIndex()).get(), results, truth, p_K, p_truthK, p_querySet, nullptr, numQueries);
+                    double pages = 0;
+                    for (auto& ss : stats) pages += ss.m_diskAccessCount;
+                    LOG(Helper::LogLevel::LL_Info, "SearchConvergeRatio %.2f: Recall%d@%d %f, %.2f pages per query.\n", ratio, p_truthK, p_K, recall, pages / numQueries);
+
+                    if (recall >= p_opts.m_searchBudgetTargetRecall)
+                    {
+                        chosen = ratio;
+                        break;
+                    }
+                }
+
+                p_opts.m_searchConvergeRatio = chosen;
+                if (chosen > 0) LOG(Helper::LogLevel::LL_Info, "Use SearchConvergeRatio %.2f for target recall %f.\n", chosen, p_opts.m_searchBudgetTargetRecall);
+                else LOG(Helper::LogLevel::LL_Warning, "No SearchConvergeRatio reaches recall %f, search without early stop.\n", p_opts.m_searchBudgetTargetRecall);
+            }
+
             template <typename ValueType>
             void Search(SPANN::Index<ValueType>* p_index)
             {
@@ -213,6 +306,19 @@ namespace SPTAG {
                     exit(1);
                 }
                 auto querySet = queryReader->GetVectorSet();
+
+                int heldOut = 0;
+                if (p_opts.m_searchBudgetTargetRecall > 0 && p_opts.m_searchPostingBatch > 0 && !truthFile.empty())
+                {
+                    std::string tuneTruthFile;
+                    auto tuneSet = SplitTuneQueries<ValueType>(p_opts, querySet, tuneTruthFile, heldOut);
+                    if (tuneSet != nullptr)
+                    {
+                        if (heldOut > 0) LOG(Helper::LogLevel::LL_Info, "Start tuning SearchConvergeRatio on the first %d queries, held out of the %d searched below...\n", heldOut, querySet->Count());
+                        else LOG(Helper::LogLevel::LL_Info, "Start tuning SearchConvergeRatio on the %d queries of %s...\n", tuneSet->Count(), p_opts.m_searchBudgetTuneQueryPath.c_str());
+                        TuneSearchConvergeRatio(p_index, tuneSet, tuneTruthFile, numThreads, K, truthK, internalResultNum);
+                    }
+                }
                 int numQueries = querySet->Count();
 
                 std::vector<QueryResult> results(numQueries, QueryResult(NULL, max(K, internalResultNum), false));
@@ -223,7 +329,6 @@ namespace SPTAG {
                     results[i].Reset();
                 }
 
-
                 LOG(Helper::LogLevel::LL_Info, "Start ANN Search...\n");
 
                 SearchSequential(p_index, numThreads, results, stats, p_opts.m_queryCountLimit, internalResultNum);
@@ -272,7 +377,9 @@ namespace SPTAG {
                         exit(1);
                     }
                     int originalK = truthK;
-                    COMMON::TruthSet::LoadTruth(ptr, truth, numQueries, originalK, truthK, p_opts.m_truthType);
+                    SizeType truthNum = numQueries + heldOut;
+                    COMMON::TruthSet::LoadTruth(ptr, truth, truthNum, originalK, truthK, p_opts.m_truthType);
+                    truth.erase(truth.begin(), truth.begin() + heldOut);
                     char tmp[4];
                     if (ptr->ReadBinary(4, tmp) == 4) {
                         LOG(Helper::LogLevel::LL_Error, "Truth number is larger than query number(%d)!\n", numQueries);
@@ -344,7 +451,10 @@ namespace SPTAG {
 
                 LOG(Helper::LogLevel::LL_Info, "\n");
 
-                if (p_opts.m_recall_analysis) {
+                if (p_opts.m_recall_analysis && p_index->GetMemoryIndex()->GetVectorValueType() != GetEnumValueType<ValueType>()) {
+                    LOG(Helper::LogLevel::LL_Warning, "Recall analysis needs a full precision head index, skip it.\n");
+                }
+                else if (p_opts.m_recall_analysis) {
                     LOG(Helper::LogLevel::LL_Info, "Start recall analysis...\n");
 
                     std::shared_ptr<VectorIndex> headIndex = p_index->GetMemoryIndex();
@@ -53,6 +53,8 @@ public:
 
     const bool GetExtractMetadata() const;
 
+    const bool GetMergeResults() const;
+
 private:
     const std::shared_ptr<const ServiceSettings> c_serviceSettings;
 
@@ -70,6 +72,8 @@ private:
 
     bool m_extractMetadata;
 
+    bool m_mergeResults;
+
     SizeType m_resultNum;
 };
 
@@ -9,6 +9,7 @@
 #include "SearchExecutionContext.h"
 #include "QueryParser.h"
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <vector>
@@ -18,27 +19,46 @@ namespace SPTAG
 namespace Service
 {
 
-class SearchExecutor
+class SearchExecutor : public std::enable_shared_from_this<SearchExecutor>
 {
 public:
     typedef std::function<void(std::shared_ptr<SearchExecutionContext>)> CallBack;
 
+    typedef std::function<void(std::function<void()>)> TaskPoster;
+
     SearchExecutor(std::string p_queryString,
                    std::shared_ptr<ServiceContext> p_serviceContext,
-                   const CallBack& p_callback);
+                   const CallBack& p_callback,
+                   const TaskPoster& p_taskPoster = TaskPoster());
 
     ~SearchExecutor();
 
     void Execute();
 
+    // Returns once every selected index has started its search; the callback runs from whichever
+    // thread finishes the last one. The executor must be owned by a std::shared_ptr.
+    void ExecuteAsync();
+
 private:
     void ExecuteInternal();
 
+    bool PrepareSearch();
+
+    void FinishSearch();
+
+    void FinishAsyncSearch();
+
     void SelectIndex();
 
+    void SearchSelectedIndexes();
+
+    void MergeResults();
+
 private:
     CallBack m_callback;
 
+    TaskPoster m_taskPoster;
+
     const std::shared_ptr<ServiceContext> c_serviceContext;
 
     std::shared_ptr<SearchExecutionContext> m_executionContext;
@@ -46,6 +66,14 @@ private:
     std::string m_queryString;
 
     std::vector<std::shared_ptr<VectorIndex>> m_selectedIndex;
+
+    std::vector<std::shared_ptr<VectorIndex>> m_indexes;
+
+    std::vector<QueryResult> m_results;
+
+    std::vector<ErrorCode> m_errors;
+
+    std::atomic<std::size_t> m_pendingSearches;
 };
 
 
@@ -42,6 +42,16 @@ private:
     void SearchHanlderCallback(std::shared_ptr<SearchExecutionContext> p_exeContext,
                                Socket::Packet p_srcPacket);
 
+    void BatchSearchHandler(Socket::ConnectionID p_localConnectionID, Socket::Packet p_packet);
+
+    void ReloadIndexHandler(Socket::ConnectionID p_localConnectionID, Socket::Packet p_packet);
+
+    void StartMetricsEndpoint();
+
+    void AcceptMetricsConnection();
+
+    std::string CollectMetrics() const;
+
 private:
     enum class ServeMode : std::uint8_t
     {
@@ -60,8 +70,14 @@ private:
 
     std::unique_ptr<boost::asio::thread_pool> m_threadPool;
 
+    // Index reloads run one at a time here so that loading never occupies the search threads.
+    std::unique_ptr<boost::asio::thread_pool> m_reloadPool;
+
     boost::asio::io_context m_ioContext;
 
+    // Serves the index metrics over plain HTTP on m_ioContext when MetricsPort is set.
+    std::unique_ptr<boost::asio::ip::tcp::acceptor> m_metricsAcceptor;
+
     boost::asio::signal_set m_shutdownSignals;
 };
 
@@ -9,6 +9,7 @@
 
 #include <memory>
 #include <map>
+#include <mutex>
 
 namespace SPTAG
 {
@@ -18,22 +19,48 @@ namespace Service
 class ServiceContext
 {
 public:
+    typedef std::map<std::string, std::shared_ptr<VectorIndex>> IndexMap;
+
     ServiceContext(const std::string& p_configFilePath);
 
     ~ServiceContext();
 
-    const std::map<std::string, std::shared_ptr<VectorIndex>>& GetIndexMap() const;
+    // Snapshot of the published indexes. Searches hold the snapshot (or the indexes taken from it)
+    // for their whole lifetime, so a concurrent reload never pulls an index out from under them.
+    std::shared_ptr<const IndexMap> GetIndexMap() const;
 
     const std::shared_ptr<ServiceSettings>& GetServiceSettings() const;
 
     bool IsInitialized() const;
 
+    // Load a new version of an index, warm it up and publish it with a copy-on-write swap of the index map.
+    // An empty folder reloads from the folder the index was configured with.
+    ErrorCode ReloadIndex(const std::string& p_indexName, const std::string& p_indexFolder);
+
+private:
+    ErrorCode LoadIndex(const std::string& p_indexName, const std::string& p_indexFolder, std::shared_ptr<VectorIndex>& p_index) const;
+
+    void WarmupIndex(const std::string& p_indexName, const std::shared_ptr<VectorIndex>& p_index) const;
+
 private:
     bool m_initialized;
 
     std::shared_ptr<ServiceSettings> m_settings;
 
-    std::map<std::string, std::shared_ptr<VectorIndex>> m_fullIndexList;
+    std::shared_ptr<const IndexMap> m_fullIndexList;
+
+    struct IndexConfig
+    {
+        std::string m_indexFolder;
+
+        std::string m_warmupFile;
+
+        VectorFileType m_warmupFileType;
+    };
+
+    std::map<std::string, IndexConfig> m_indexConfigs;
+
+    std::mutex m_reloadLock;
 };
 
 
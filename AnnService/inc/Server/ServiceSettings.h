@@ -25,9 +25,19 @@ struct ServiceSettings
 
     SizeType m_defaultMaxResultNumber;
 
+    // Largest vector count * dimension * result number one batch search request may ask for.
+    std::uint64_t m_maxBatchSearchSize;
+
     SizeType m_threadNum;
 
     SizeType m_socketThreadNum;
+
+    bool m_enableIndexReload;
+
+    bool m_enableAsyncSearch;
+
+    // Port of the Prometheus text endpoint on m_listenAddr, empty to disable it.
+    std::string m_metricsPort;
 };
 
 
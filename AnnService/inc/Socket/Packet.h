@@ -27,13 +27,21 @@ enum class PacketType : std::uint8_t
 
     SearchRequest = 0x03,
 
+    BatchSearchRequest = 0x04,
+
+    ReloadIndexRequest = 0x05,
+
     ResponseMask = 0x80,
 
     HeartbeatResponse = ResponseMask | HeartbeatRequest,
 
     RegisterResponse = ResponseMask | RegisterRequest,
 
-    SearchResponse = ResponseMask | SearchRequest
+    SearchResponse = ResponseMask | SearchRequest,
+
+    BatchSearchResponse = ResponseMask | BatchSearchRequest,
+
+    ReloadIndexResponse = ResponseMask | ReloadIndexRequest
 };
 
 
@@ -92,6 +92,92 @@ struct RemoteSearchResult
 };
 
 
+// Binary batch query: a fixed header followed by m_vectorCount raw vectors in the index value type.
+// The vectors start 16-byte aligned inside the body and are read in place without copying.
+struct RemoteBatchQuery
+{
+    static constexpr std::uint16_t MajorVersion() { return 1; }
+    static constexpr std::uint16_t MirrorVersion() { return 0; }
+
+    static constexpr std::size_t c_vectorAlignment = 16;
+
+    RemoteBatchQuery();
+
+    std::size_t VectorBytes() const;
+
+    std::size_t EstimateBufferSize() const;
+
+    std::uint8_t* Write(std::uint8_t* p_buffer) const;
+
+    const std::uint8_t* Read(const std::uint8_t* p_buffer, std::size_t p_length);
+
+
+    std::string m_indexName;
+
+    VectorValueType m_valueType;
+
+    std::uint32_t m_dimension;
+
+    std::uint32_t m_vectorCount;
+
+    std::uint32_t m_resultNum;
+
+    bool m_extractMetadata;
+
+    // Not owned. Points into the packet body after Read.
+    const std::uint8_t* m_vectors;
+};
+
+
+struct RemoteBatchSearchResult
+{
+    static constexpr std::uint16_t MajorVersion() { return 1; }
+    static constexpr std::uint16_t MirrorVersion() { return 0; }
+
+    RemoteBatchSearchResult();
+
+    std::size_t EstimateBufferSize() const;
+
+    std::uint8_t* Write(std::uint8_t* p_buffer) const;
+
+    // Fails instead of allocating when the counts in the header do not fit in p_length.
+    const std::uint8_t* Read(const std::uint8_t* p_buffer, std::size_t p_length);
+
+
+    RemoteSearchResult::ResultStatus m_status;
+
+    std::uint32_t m_vectorCount;
+
+    std::uint32_t m_resultNum;
+
+    bool m_withMeta;
+
+    // m_vectorCount * m_resultNum results, row major by query.
+    std::vector<BasicResult> m_results;
+};
+
+// Admin request asking the server to load a new version of a configured index.
+struct RemoteIndexReload
+{
+    static constexpr std::uint16_t MajorVersion() { return 1; }
+    static constexpr std::uint16_t MirrorVersion() { return 0; }
+
+    RemoteIndexReload();
+
+    std::size_t EstimateBufferSize() const;
+
+    std::uint8_t* Write(std::uint8_t* p_buffer) const;
+
+    // Fails when a name runs past p_length.
+    const std::uint8_t* Read(const std::uint8_t* p_buffer, std::size_t p_length);
+
+
+    std::string m_indexName;
+
+    // Empty to reload from the folder the index was configured with.
+    std::string m_indexFolder;
+};
+
 
 } // namespace SPTAG
 } // namespace Socket
@@ -5,17 +5,61 @@
 #include "inc/Helper/SimpleIniReader.h"
 
 #include <fstream>
+#include <map>
+#include <algorithm>
 
 using namespace SPTAG;
 using namespace SPTAG::Aggregator;
 
 RemoteMachine::RemoteMachine()
-    : m_connectionID(Socket::c_invalidConnectionID),
-      m_status(RemoteMachineStatus::Disconnected)
+    : m_group(0),
+      m_connectionID(Socket::c_invalidConnectionID),
+      m_status(RemoteMachineStatus::Disconnected),
+      m_outstanding(0),
+      m_latencyEWMA(0),
+      m_nextLatencySample(0)
 {
 }
 
 
+void
+RemoteMachine::RecordLatency(float p_milliseconds, float p_decay)
+{
+    float old = m_latencyEWMA.load();
+    float ewma = (old == 0) ? p_milliseconds : (1 - p_decay) * old + p_decay * p_milliseconds;
+    while (!m_latencyEWMA.compare_exchange_weak(old, ewma))
+    {
+        ewma = (old == 0) ? p_milliseconds : (1 - p_decay) * old + p_decay * p_milliseconds;
+    }
+
+    std::lock_guard<std::mutex> guard(m_latencyLock);
+    if (m_latencySamples.size() < c_latencySampleNum)
+    {
+        m_latencySamples.push_back(p_milliseconds);
+    }
+    else
+    {
+        m_latencySamples[m_nextLatencySample] = p_milliseconds;
+        m_nextLatencySample = (m_nextLatencySample + 1) % c_latencySampleNum;
+    }
+}
+
+
+float
+RemoteMachine::LoadScore() const
+{
+    return (m_latencyEWMA.load() + 1) * (m_outstanding.load() + 1);
+}
+
+
+void
+RemoteMachine::CopyLatencySamples(std::vector<float>& p_samples)
+{
+    std::lock_guard<std::mutex> guard(m_latencyLock);
+    p_samples.insert(p_samples.end(), m_latencySamples.begin(), m_latencySamples.end());
+}
+
+
 AggregatorContext::AggregatorContext(const std::string& p_filePath)
     : m_initialized(false)
 {
@@ -35,6 +79,9 @@ AggregatorContext::AggregatorContext(const std::string& p_filePath)
     m_settings->m_valueType = iniReader.GetParameter("Service", "ValueType", VectorValueType::Float);
     m_settings->m_topK = iniReader.GetParameter("Service", "TopK", static_cast<SizeType>(-1));
     m_settings->m_distMethod = iniReader.GetParameter("Service", "DistCalcMethod", DistCalcMethod::L2);
+    m_settings->m_hedgePercentile = iniReader.GetParameter("Service", "HedgePercentile", m_settings->m_hedgePercentile);
+    m_settings->m_hedgeMinDelay = iniReader.GetParameter("Service", "HedgeMinDelay", m_settings->m_hedgeMinDelay);
+    m_settings->m_latencyDecay = iniReader.GetParameter("Service", "LatencyDecay", m_settings->m_latencyDecay);
     const std::string emptyStr;
 
     SizeType serverNum = iniReader.GetParameter("Servers", "Number", static_cast<SizeType>(0));
@@ -52,6 +99,7 @@ AggregatorContext::AggregatorContext(const std::string& p_filePath)
 
         remoteMachine->m_address = iniReader.GetParameter(sectionName, "Address", emptyStr);
         remoteMachine->m_port = iniReader.GetParameter(sectionName, "Port", emptyStr);
+        remoteMachine->m_group = iniReader.GetParameter(sectionName, "Group", static_cast<std::uint32_t>(i));
 
         if (remoteMachine->m_address.empty() || remoteMachine->m_port.empty())
         {
@@ -61,6 +109,17 @@ AggregatorContext::AggregatorContext(const std::string& p_filePath)
         m_remoteServers.push_back(std::move(remoteMachine));
     }
 
+    std::map<std::uint32_t, std::vector<std::shared_ptr<RemoteMachine>>> groups;
+    for (const auto& server : m_remoteServers)
+    {
+        groups[server->m_group].push_back(server);
+    }
+
+    for (auto& group : groups)
+    {
+        m_shards.emplace_back(std::move(group.second));
+    }
+
     if (m_settings->m_topK > 0) {
         std::ifstream inputStream(m_settings->m_centers, std::ifstream::binary);
         if (!inputStream.is_open()) {
@@ -72,7 +131,7 @@ AggregatorContext::AggregatorContext(const std::string& p_filePath)
         DimensionType col;
         inputStream.read((char*)&row, sizeof(SizeType));
         inputStream.read((char*)&col, sizeof(DimensionType));
-        if (row > serverNum) row = serverNum;
+        if (row > (SizeType)m_shards.size()) row = (SizeType)m_shards.size();
         std::uint64_t totalRecordVectorBytes = ((std::uint64_t)GetValueTypeSize(m_settings->m_valueType)) * row * col;
         ByteArray vectorSet = ByteArray::Alloc(totalRecordVectorBytes);
         char* vecBuf = reinterpret_cast<char*>(vectorSet.Data());
@@ -104,6 +163,59 @@ AggregatorContext::GetRemoteServers() const
 }
 
 
+const std::vector<std::vector<std::shared_ptr<RemoteMachine>>>&
+AggregatorContext::GetShards() const
+{
+    return m_shards;
+}
+
+
+std::shared_ptr<RemoteMachine>
+AggregatorContext::PickReplica(std::size_t p_shard,
+                               const std::vector<std::shared_ptr<RemoteMachine>>& p_excluded) const
+{
+    std::shared_ptr<RemoteMachine> best;
+    float bestScore = 0;
+    for (const auto& server : m_shards[p_shard])
+    {
+        if (RemoteMachineStatus::Connected != server->m_status
+            || std::find(p_excluded.begin(), p_excluded.end(), server) != p_excluded.end())
+        {
+            continue;
+        }
+
+        float score = server->LoadScore();
+        if (nullptr == best || score < bestScore)
+        {
+            best = server;
+            bestScore = score;
+        }
+    }
+
+    return best;
+}
+
+
+std::uint32_t
+AggregatorContext::GetHedgeDelay(std::size_t p_shard) const
+{
+    std::vector<float> samples;
+    for (const auto& server : m_shards[p_shard])
+    {
+        server->CopyLatencySamples(samples);
+    }
+
+    if (samples.empty())
+    {
+        return m_settings->m_hedgeMinDelay;
+    }
+
+    std::size_t pos = min(samples.size() - 1, static_cast<std::size_t>(samples.size() * m_settings->m_hedgePercentile / 100));
+    std::nth_element(samples.begin(), samples.begin() + pos, samples.end());
+    return max(m_settings->m_hedgeMinDelay, static_cast<std::uint32_t>(samples[pos]));
+}
+
+
 const std::shared_ptr<AggregatorSettings>&
 AggregatorContext::GetSettings() const
 {
@@ -6,12 +6,27 @@
 using namespace SPTAG;
 using namespace SPTAG::Aggregator;
 
+ShardRequest::ShardRequest()
+    : m_shard(0),
+      m_finished(false),
+      m_hedged(false),
+      m_inflight(0)
+{
+}
+
+
 AggregatorExecutionContext::AggregatorExecutionContext(std::size_t p_totalServerNumber,
-                                                       Socket::PacketHeader p_requestHeader)
-    : m_requestHeader(std::move(p_requestHeader))
+                                                       Socket::PacketHeader p_requestHeader,
+                                                       Socket::Packet p_requestPacket)
+    : m_requestHeader(std::move(p_requestHeader)),
+      m_requestPacket(std::move(p_requestPacket))
 {
     m_results.clear();
     m_results.resize(p_totalServerNumber);
+    for (std::size_t i = 0; i < p_totalServerNumber; ++i)
+    {
+        m_shardRequests.emplace_back(new ShardRequest);
+    }
 
     m_unfinishedCount = static_cast<std::uint32_t>(p_totalServerNumber);
 }
@@ -36,6 +51,13 @@ AggregatorExecutionContext::GetResult(std::size_t p_num)
 }
 
 
+ShardRequest&
+AggregatorExecutionContext::GetShardRequest(std::size_t p_num)
+{
+    return *m_shardRequests[p_num];
+}
+
+
 const Socket::PacketHeader&
 AggregatorExecutionContext::GetRequestHeader() const
 {
@@ -43,6 +65,13 @@ AggregatorExecutionContext::GetRequestHeader() const
 }
 
 
+const Socket::Packet&
+AggregatorExecutionContext::GetRequestPacket() const
+{
+    return m_requestPacket;
+}
+
+
 bool
 AggregatorExecutionContext::IsCompletedAfterFinsh(std::uint32_t p_finishedCount)
 {
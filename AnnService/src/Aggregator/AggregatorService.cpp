@@ -209,10 +209,11 @@ void
 AggregatorService::SearchRequestHanlder(Socket::ConnectionID p_localConnectionID, Socket::Packet p_packet)
 {
     auto context = GetContext();
-    std::vector<Socket::ConnectionID> remoteServers;
-    remoteServers.reserve(context->GetRemoteServers().size());
+    const auto& shards = context->GetShards();
+    std::vector<std::size_t> selectedShards;
+    selectedShards.reserve(shards.size());
 
-	if (context->GetSettings()->m_topK > 0 && context->GetRemoteServers().size() == context->GetCenters()->Count()) {
+	if (context->GetSettings()->m_topK > 0 && shards.size() == context->GetCenters()->Count()) {
 		Socket::RemoteQuery remoteQuery;
 		remoteQuery.Read(p_packet.Body());
 
@@ -246,26 +247,28 @@ AggregatorService::SearchRequestHanlder(Socket::ConnectionID p_localConnectionID
 			break;
 		}
 		std::sort(servers.begin(), servers.end(), [](const BasicResult& a, const BasicResult& b) { return a.Dist < b.Dist; });
-		for (int i = 0; i < context->GetSettings()->m_topK; i++) {
-			auto& server = context->GetRemoteServers().at(servers[i].VID);
-			if (RemoteMachineStatus::Connected != server->m_status)
-			{
-				continue;
-			}
-			remoteServers.push_back(server->m_connectionID);
+		for (int i = 0; i < context->GetSettings()->m_topK && i < (int)servers.size(); i++) {
+			selectedShards.push_back(servers[i].VID);
 		}
 	}
 	else {
-		for (const auto& server : context->GetRemoteServers())
+		for (std::size_t i = 0; i < shards.size(); ++i)
 		{
-			if (RemoteMachineStatus::Connected != server->m_status)
-			{
-				continue;
-			}
-
-			remoteServers.push_back(server->m_connectionID);
+			selectedShards.push_back(i);
 		}
 	}
+
+    std::vector<std::pair<std::size_t, std::shared_ptr<RemoteMachine>>> targets;
+    targets.reserve(selectedShards.size());
+    for (auto shard : selectedShards)
+    {
+        auto server = context->PickReplica(shard, {});
+        if (nullptr != server)
+        {
+            targets.emplace_back(shard, std::move(server));
+        }
+    }
+
     Socket::PacketHeader requestHeader = p_packet.Header();
     if (Socket::c_invalidConnectionID == requestHeader.m_connectionID)
     {
@@ -273,55 +276,245 @@ AggregatorService::SearchRequestHanlder(Socket::ConnectionID p_localConnectionID
     }
 
     std::shared_ptr<AggregatorExecutionContext> executionContext(
-        new AggregatorExecutionContext(remoteServers.size(), requestHeader));
+        new AggregatorExecutionContext(targets.size(), requestHeader, std::move(p_packet)));
+
+    bool hedging = context->GetSettings()->m_hedgePercentile > 0;
+    for (std::size_t i = 0; i < targets.size(); ++i)
+    {
+        executionContext->GetShardRequest(i).m_shard = targets[i].first;
+        SendToReplica(executionContext, i, targets[i].second);
+        if (hedging && shards[targets[i].first].size() > 1)
+        {
+            ScheduleHedge(executionContext, i);
+        }
+    }
+}
+
+
+void
+AggregatorService::SendToReplica(std::shared_ptr<AggregatorExecutionContext> p_exectionContext,
+                                 std::size_t p_num,
+                                 std::shared_ptr<RemoteMachine> p_server)
+{
+    auto context = GetContext();
+    auto& shardRequest = p_exectionContext->GetShardRequest(p_num);
+    {
+        std::lock_guard<std::mutex> guard(shardRequest.m_lock);
+        shardRequest.m_tried.push_back(p_server);
+        ++shardRequest.m_inflight;
+    }
+    ++p_server->m_outstanding;
+
+    auto sendTime = std::chrono::steady_clock::now();
+    AggregatorCallback callback = [this, p_exectionContext, p_num, p_server, sendTime](Socket::RemoteSearchResult p_result)
+    {
+        this->HandleReplicaResult(p_exectionContext, p_num, p_server, sendTime, std::move(p_result));
+    };
+
+    auto timeoutCallback = [](std::shared_ptr<AggregatorCallback> p_callback)
+    {
+        if (nullptr != p_callback)
+        {
+            Socket::RemoteSearchResult result;
+            result.m_status = Socket::RemoteSearchResult::ResultStatus::Timeout;
+
+            (*p_callback)(std::move(result));
+        }
+    };
+
+    const auto& request = p_exectionContext->GetRequestPacket();
+    Socket::Packet packet;
+    packet.Header().m_packetType = Socket::PacketType::SearchRequest;
+    packet.Header().m_processStatus = Socket::PacketProcessStatus::Ok;
+    packet.Header().m_bodyLength = p_exectionContext->GetRequestHeader().m_bodyLength;
+    packet.Header().m_connectionID = Socket::c_invalidConnectionID;
+    packet.Header().m_resourceID = m_aggregatorCallbackManager.Add(std::make_shared<AggregatorCallback>(std::move(callback)),
+                                                                   context->GetSettings()->m_searchTimeout,
+                                                                   std::move(timeoutCallback));
+    {
+        std::lock_guard<std::mutex> guard(shardRequest.m_lock);
+        shardRequest.m_attempts.emplace_back(packet.Header().m_resourceID, p_server);
+    }
 
-    for (std::uint32_t i = 0; i < remoteServers.size(); ++i)
+    // Take the callback back out of the manager so a failed connect and a later timeout
+    // cannot both report the same attempt.
+    Socket::ResourceID resourceID = packet.Header().m_resourceID;
+    auto connectCallback = [this, resourceID](bool p_connectSucc)
     {
-        AggregatorCallback callback = [this, executionContext, i](Socket::RemoteSearchResult p_result)
+        if (!p_connectSucc)
         {
-            executionContext->GetResult(i).reset(new Socket::RemoteSearchResult(std::move(p_result)));
-            if (executionContext->IsCompletedAfterFinsh(1))
+            auto callback = m_aggregatorCallbackManager.GetAndRemove(resourceID);
+            if (nullptr == callback)
             {
-                this->AggregateResults(std::move(executionContext));
+                return;
             }
-        };
 
-        auto timeoutCallback = [](std::shared_ptr<AggregatorCallback> p_callback)
+            Socket::RemoteSearchResult result;
+            result.m_status = Socket::RemoteSearchResult::ResultStatus::FailedNetwork;
+
+            (*callback)(std::move(result));
+        }
+    };
+
+    packet.AllocateBuffer(packet.Header().m_bodyLength);
+    packet.Header().WriteBuffer(packet.HeaderBuffer());
+    memcpy(packet.Body(), request.Body(), packet.Header().m_bodyLength);
+
+    m_socketClient->SendPacket(p_server->m_connectionID, std::move(packet), connectCallback);
+}
+
+
+void
+AggregatorService::ScheduleHedge(std::shared_ptr<AggregatorExecutionContext> p_exectionContext, std::size_t p_num)
+{
+    auto context = GetContext();
+    auto& shardRequest = p_exectionContext->GetShardRequest(p_num);
+    std::uint32_t delay = context->GetHedgeDelay(shardRequest.m_shard);
+    if (delay >= context->GetSettings()->m_searchTimeout)
+    {
+        return;
+    }
+
+    auto timer = std::make_shared<boost::asio::deadline_timer>(m_ioContext, boost::posix_time::milliseconds(delay));
+    {
+        std::lock_guard<std::mutex> guard(shardRequest.m_lock);
+        if (shardRequest.m_finished)
         {
-            if (nullptr != p_callback)
-            {
-                Socket::RemoteSearchResult result;
-                result.m_status = Socket::RemoteSearchResult::ResultStatus::Timeout;
+            return;
+        }
 
-                (*p_callback)(std::move(result));
-            }
-        };
+        shardRequest.m_hedgeTimer = timer;
+    }
 
-        auto connectCallback = [callback](bool p_connectSucc)
+    timer->async_wait([this, p_exectionContext, p_num](const boost::system::error_code& p_ec)
+                      {
+                          if (boost::asio::error::operation_aborted != p_ec)
+                          {
+                              boost::asio::post(*m_threadPool,
+                                                std::bind(&AggregatorService::SendHedge, this, p_exectionContext, p_num));
+                          }
+                      });
+}
+
+
+void
+AggregatorService::SendHedge(std::shared_ptr<AggregatorExecutionContext> p_exectionContext, std::size_t p_num)
+{
+    auto& shardRequest = p_exectionContext->GetShardRequest(p_num);
+    std::vector<std::shared_ptr<RemoteMachine>> tried;
+    {
+        std::lock_guard<std::mutex> guard(shardRequest.m_lock);
+        if (shardRequest.m_finished || shardRequest.m_hedged)
+        {
+            return;
+        }
+
+        shardRequest.m_hedged = true;
+        tried = shardRequest.m_tried;
+    }
+
+    auto server = GetContext()->PickReplica(shardRequest.m_shard, tried);
+    if (nullptr != server)
+    {
+        SendToReplica(p_exectionContext, p_num, std::move(server));
+    }
+}
+
+
+void
+AggregatorService::HandleReplicaResult(std::shared_ptr<AggregatorExecutionContext> p_exectionContext,
+                                       std::size_t p_num,
+                                       std::shared_ptr<RemoteMachine> p_server,
+                                       std::chrono::steady_clock::time_point p_sendTime,
+                                       Socket::RemoteSearchResult p_result)
+{
+    auto context = GetContext();
+    --p_server->m_outstanding;
+    if (Socket::RemoteSearchResult::ResultStatus::FailedNetwork != p_result.m_status)
+    {
+        float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - p_sendTime).count();
+        p_server->RecordLatency(elapsed, context->GetSettings()->m_latencyDecay);
+    }
+
+    auto& shardRequest = p_exectionContext->GetShardRequest(p_num);
+    std::vector<std::shared_ptr<RemoteMachine>> tried;
+    {
+        std::lock_guard<std::mutex> guard(shardRequest.m_lock);
+        --shardRequest.m_inflight;
+        if (shardRequest.m_finished)
+        {
+            return;
+        }
+
+        // A failed attempt only decides the shard when nothing else is in flight and no
+        // other replica is left to try.
+        if (Socket::RemoteSearchResult::ResultStatus::Success != p_result.m_status)
         {
-            if (!p_connectSucc)
+            if (shardRequest.m_inflight > 0)
             {
-                Socket::RemoteSearchResult result;
-                result.m_status = Socket::RemoteSearchResult::ResultStatus::FailedNetwork;
+                return;
+            }
 
-                callback(std::move(result));
+            if (!shardRequest.m_hedged)
+            {
+                shardRequest.m_hedged = true;
+                tried = shardRequest.m_tried;
             }
-        };
-
-        Socket::Packet packet;
-        packet.Header().m_packetType = Socket::PacketType::SearchRequest;
-        packet.Header().m_processStatus = Socket::PacketProcessStatus::Ok;
-        packet.Header().m_bodyLength = p_packet.Header().m_bodyLength;
-        packet.Header().m_connectionID = Socket::c_invalidConnectionID;
-        packet.Header().m_resourceID = m_aggregatorCallbackManager.Add(std::make_shared<AggregatorCallback>(std::move(callback)),
-                                                                       context->GetSettings()->m_searchTimeout,
-                                                                       std::move(timeoutCallback));
-
-        packet.AllocateBuffer(packet.Header().m_bodyLength);
-        packet.Header().WriteBuffer(packet.HeaderBuffer());
-        memcpy(packet.Body(), p_packet.Body(), packet.Header().m_bodyLength);
-
-        m_socketClient->SendPacket(remoteServers[i], std::move(packet), connectCallback);
+        }
+    }
+
+    if (!tried.empty())
+    {
+        auto server = context->PickReplica(shardRequest.m_shard, tried);
+        if (nullptr != server)
+        {
+            SendToReplica(p_exectionContext, p_num, std::move(server));
+            return;
+        }
+    }
+
+    FinishShard(std::move(p_exectionContext), p_num, std::move(p_result));
+}
+
+
+void
+AggregatorService::FinishShard(std::shared_ptr<AggregatorExecutionContext> p_exectionContext,
+                               std::size_t p_num,
+                               Socket::RemoteSearchResult p_result)
+{
+    auto& shardRequest = p_exectionContext->GetShardRequest(p_num);
+    std::vector<std::pair<Socket::ResourceID, std::shared_ptr<RemoteMachine>>> attempts;
+    std::shared_ptr<boost::asio::deadline_timer> timer;
+    {
+        std::lock_guard<std::mutex> guard(shardRequest.m_lock);
+        if (shardRequest.m_finished)
+        {
+            return;
+        }
+
+        shardRequest.m_finished = true;
+        attempts.swap(shardRequest.m_attempts);
+        timer.swap(shardRequest.m_hedgeTimer);
+    }
+
+    // Drop the callbacks of the losing attempts so their late answers and timeouts are ignored.
+    for (auto& attempt : attempts)
+    {
+        if (nullptr != m_aggregatorCallbackManager.GetAndRemove(attempt.first))
+        {
+            --attempt.second->m_outstanding;
+        }
+    }
+
+    if (nullptr != timer)
+    {
+        boost::asio::post(m_ioContext, [timer]() { timer->cancel(); });
+    }
+
+    p_exectionContext->GetResult(p_num).reset(new Socket::RemoteSearchResult(std::move(p_result)));
+    if (p_exectionContext->IsCompletedAfterFinsh(1))
+    {
+        this->AggregateResults(std::move(p_exectionContext));
     }
 }
 
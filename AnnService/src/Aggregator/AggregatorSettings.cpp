@@ -9,6 +9,9 @@ using namespace SPTAG::Aggregator;
 AggregatorSettings::AggregatorSettings()
     : m_searchTimeout(100),
       m_threadNum(8),
-      m_socketThreadNum(8)
+      m_socketThreadNum(8),
+      m_hedgePercentile(0),
+      m_hedgeMinDelay(5),
+      m_latencyDecay(0.2f)
 {
 }
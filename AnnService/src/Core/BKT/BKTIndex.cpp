@@ -204,6 +204,10 @@ namespace SPTAG
                     p_space.m_NGQueue.insert(NodeDistPair(nn_index, distance2leaf)); \
                 } \
             } \
+            if (p_space.m_iNumberOfCheckedLeaves >= p_space.m_iNextProgress) { \
+                p_space.m_iNextProgress = p_space.m_iNumberOfCheckedLeaves + p_space.m_iProgressInterval; \
+                (*p_space.m_progress)(p_query); \
+            } \
             if (p_space.m_NGQueue.Top().distance > p_space.m_SPTQueue.Top().distance) { \
                 m_pTrees.SearchTrees(m_pSamples, m_fComputeDistance, p_query, p_space, m_iNumberOfOtherDynamicPivots + p_space.m_iNumberOfCheckedLeaves); \
             } \
@@ -261,6 +265,37 @@ namespace SPTAG
             return ErrorCode::Success;
         }
 
+        template<typename T>
+        ErrorCode Index<T>::SearchIndexWithProgress(QueryResult& p_query, int p_interval, const std::function<void(QueryResult&)>& p_progress, bool p_searchDeleted) const
+        {
+            if (!m_bReady) return ErrorCode::EmptyIndex;
+
+            auto workSpace = m_workSpacePool->Rent();
+            workSpace->Reset(m_iMaxCheck, p_query.GetResultNum());
+            if (p_interval > 0 && p_progress)
+            {
+                workSpace->m_progress = &p_progress;
+                workSpace->m_iProgressInterval = p_interval;
+                workSpace->m_iNextProgress = p_interval;
+            }
+
+            SearchIndex(*((COMMON::QueryResultSet<T>*)&p_query), *workSpace, p_searchDeleted, true);
+
+            workSpace->m_progress = nullptr;
+            workSpace->m_iNextProgress = INT_MAX;
+            m_workSpacePool->Return(workSpace);
+
+            if (p_query.WithMeta() && nullptr != m_pMetadata)
+            {
+                for (int i = 0; i < p_query.GetResultNum(); ++i)
+                {
+                    SizeType result = p_query.GetResult(i)->VID;
+                    p_query.SetMetadata(i, (result < 0) ? ByteArray::c_empty : m_pMetadata->GetMetadataCopy(result));
+                }
+            }
+            return ErrorCode::Success;
+        }
+
         template<typename T>
         ErrorCode Index<T>::RefineSearchIndex(QueryResult &p_query, bool p_searchDeleted) const
         {
@@ -342,6 +377,8 @@ namespace SPTAG
 
 #include "inc/Core/BKT/ParameterDefinitionList.h"
 #undef DefineBKTParameter
+            ptr->m_fComputeDistance = m_fComputeDistance;
+            ptr->m_iBaseSquare = m_iBaseSquare;
 
             std::lock_guard<std::mutex> lock(m_dataAddLock);
             std::unique_lock<std::shared_timed_mutex> uniquelock(m_dataDeleteLock);
@@ -434,6 +471,156 @@ namespace SPTAG
             return ret;
         }
 
+        template <typename T>
+        ErrorCode Index<T>::CompactIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::vector<SizeType>& p_newToOld)
+        {
+            p_newIndex.reset(new Index<T>());
+            Index<T>* ptr = (Index<T>*)p_newIndex.get();
+
+#define DefineBKTParameter(VarName, VarType, DefaultValue, RepresentStr) \
+            ptr->VarName =  VarName; \
+
+#include "inc/Core/BKT/ParameterDefinitionList.h"
+#undef DefineBKTParameter
+            ptr->m_fComputeDistance = m_fComputeDistance;
+            ptr->m_iBaseSquare = m_iBaseSquare;
+
+            // Only adds are blocked while compacting; searches keep running on this index.
+            std::lock_guard<std::mutex> lock(m_dataAddLock);
+
+            SizeType R = GetNumSamples();
+            SizeType newR = R;
+            std::vector<SizeType>& indices = p_newToOld;
+            std::vector<SizeType> reverseIndices(R, -1);
+            indices.clear();
+            {
+                std::unique_lock<std::shared_timed_mutex> uniquelock(m_dataDeleteLock);
+                for (SizeType i = 0; i < newR; i++) {
+                    if (!m_deletedID.Contains(i)) {
+                        indices.push_back(i);
+                        reverseIndices[i] = i;
+                    }
+                    else {
+                        while (m_deletedID.Contains(newR - 1) && newR > i) newR--;
+                        if (newR == i) break;
+                        indices.push_back(newR - 1);
+                        reverseIndices[newR - 1] = i;
+                        newR--;
+                    }
+                }
+            }
+
+            LOG(Helper::LogLevel::LL_Info, "Compact... from %d -> %d\n", R, newR);
+            if (newR == 0) return ErrorCode::EmptyIndex;
+
+            ErrorCode ret = ErrorCode::Success;
+            if ((ret = m_pSamples.Refine(indices, ptr->m_pSamples)) != ErrorCode::Success) return ret;
+            if (nullptr != m_pMetadata && (ret = m_pMetadata->RefineMetadata(indices, ptr->m_pMetadata, m_iDataBlockSize, m_iDataCapacity, m_iMetaRecordSize)) != ErrorCode::Success) return ret;
+
+            ptr->m_deletedID.Initialize(newR, m_iDataBlockSize, m_iDataCapacity);
+            ptr->m_pTrees.BuildTrees<T>(ptr->m_pSamples, ptr->m_iDistCalcMethod, m_iNumberOfThreads);
+            if ((ret = m_pGraph.CompactGraph<T>(this, indices, reverseIndices, &(ptr->m_pGraph), &(ptr->m_pTrees.GetSampleMap()))) != ErrorCode::Success) return ret;
+
+            ptr->m_workSpacePool.reset(new COMMON::WorkSpacePool<COMMON::WorkSpace>());
+            ptr->m_workSpacePool->Init(m_iNumberOfThreads, max(m_iMaxCheck, m_pGraph.m_iMaxCheckForRefineGraph), m_iHashTableExp);
+            ptr->m_threadPool.init();
+
+            // carry over deletions that arrived while the new structures were being built
+            {
+                std::unique_lock<std::shared_timed_mutex> uniquelock(m_dataDeleteLock);
+                for (SizeType i = 0; i < newR; i++) {
+                    if (m_deletedID.Contains(indices[i])) ptr->m_deletedID.Insert(i);
+                }
+            }
+            if (HasMetaMapping()) ptr->BuildMetaMapping(false);
+            ptr->m_bReady = true;
+            return ret;
+        }
+
+        // Fills everything but the samples of p_copy from this index, with vector x renumbered to
+        // p_oldToNew[x]. The caller holds m_dataAddLock.
+        template <typename T>
+        template <typename U>
+        ErrorCode Index<T>::CopyIndexStructures(Index<U>* p_copy, std::vector<SizeType>& p_newToOld, const std::vector<SizeType>& p_oldToNew)
+        {
+#define DefineBKTParameter(VarName, VarType, DefaultValue, RepresentStr) \
+            p_copy->VarName =  VarName; \
+
+#include "inc/Core/BKT/ParameterDefinitionList.h"
+#undef DefineBKTParameter
+            p_copy->m_fComputeDistance = COMMON::DistanceCalcSelector<U>(m_iDistCalcMethod);
+            p_copy->m_iBaseSquare = (m_iDistCalcMethod == DistCalcMethod::Cosine) ? COMMON::Utils::GetBase<U>() * COMMON::Utils::GetBase<U>() : 1;
+
+            SizeType R = (SizeType)p_newToOld.size();
+            ErrorCode ret = ErrorCode::Success;
+            if (nullptr != m_pMetadata && (ret = m_pMetadata->RefineMetadata(p_newToOld, p_copy->m_pMetadata, m_iDataBlockSize, m_iDataCapacity, m_iMetaRecordSize)) != ErrorCode::Success) return ret;
+
+            p_copy->m_pTrees.Remap(m_pTrees, p_oldToNew);
+            m_pGraph.ReorderGraph(this, p_newToOld, p_oldToNew, &(p_copy->m_pGraph));
+
+            p_copy->m_workSpacePool.reset(new COMMON::WorkSpacePool<COMMON::WorkSpace>());
+            p_copy->m_workSpacePool->Init(m_iNumberOfThreads, max(m_iMaxCheck, m_pGraph.m_iMaxCheckForRefineGraph), m_iHashTableExp);
+            p_copy->m_threadPool.init();
+
+            p_copy->m_deletedID.Initialize(R, m_iDataBlockSize, m_iDataCapacity);
+            {
+                std::unique_lock<std::shared_timed_mutex> uniquelock(m_dataDeleteLock);
+                for (SizeType i = 0; i < R; i++) {
+                    if (m_deletedID.Contains(p_newToOld[i])) p_copy->m_deletedID.Insert(i);
+                }
+            }
+            if (HasMetaMapping()) p_copy->BuildMetaMapping(false);
+            p_copy->m_bReady = true;
+            return ret;
+        }
+
+        template <typename T>
+        ErrorCode Index<T>::ReorderIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::vector<SizeType>& p_newToOld)
+        {
+            p_newIndex.reset(new Index<T>());
+            Index<T>* ptr = (Index<T>*)p_newIndex.get();
+
+            std::lock_guard<std::mutex> lock(m_dataAddLock);
+
+            SizeType R = GetNumSamples();
+            if (R == 0) return ErrorCode::EmptyIndex;
+
+            // graph neighbors mostly fall into the same or a nearby cluster, so they end up at nearby ids
+            m_pTrees.GetDFSOrder(R, p_newToOld);
+            std::vector<SizeType> oldToNew(R);
+            for (SizeType i = 0; i < R; i++) oldToNew[p_newToOld[i]] = i;
+
+            ErrorCode ret = ErrorCode::Success;
+            if ((ret = m_pSamples.Refine(p_newToOld, ptr->m_pSamples)) != ErrorCode::Success ||
+                (ret = CopyIndexStructures(ptr, p_newToOld, oldToNew)) != ErrorCode::Success) return ret;
+
+            LOG(Helper::LogLevel::LL_Info, "Reorder %d vectors in BKTree order\n", R);
+            return ret;
+        }
+
+        template <typename T>
+        ErrorCode Index<T>::QuantizeIndex(std::shared_ptr<VectorIndex>& p_newIndex, std::function<void(const void*, std::int8_t*)> p_quantize)
+        {
+            p_newIndex.reset(new Index<std::int8_t>());
+            Index<std::int8_t>* ptr = (Index<std::int8_t>*)p_newIndex.get();
+
+            std::lock_guard<std::mutex> lock(m_dataAddLock);
+
+            SizeType R = GetNumSamples();
+            if (R == 0) return ErrorCode::EmptyIndex;
+
+            std::vector<SizeType> identity(R);
+            for (SizeType i = 0; i < R; i++) identity[i] = i;
+
+            ptr->m_pSamples.Initialize(R, GetFeatureDim(), m_iDataBlockSize, m_iDataCapacity);
+#pragma omp parallel for schedule(static)
+            for (SizeType i = 0; i < R; i++) p_quantize(m_pSamples[i], ptr->m_pSamples[i]);
+
+            ErrorCode ret = CopyIndexStructures(ptr, identity, identity);
+            if (ret == ErrorCode::Success) LOG(Helper::LogLevel::LL_Info, "Quantize %d vectors to int8\n", R);
+            return ret;
+        }
+
         template <typename T>
         ErrorCode Index<T>::DeleteIndex(const void* p_vectors, SizeType p_vectorNum) {
             const T* ptr_v = (const T*)p_vectors;
@@ -524,10 +711,9 @@ namespace SPTAG
                 m_threadPool.add(new RebuildJob(&m_pSamples, &m_pTrees, &m_pGraph, m_iDistCalcMethod));
             }
 
-            for (SizeType node = begin; node < end; node++)
-            {
-                m_pGraph.RefineNode<T>(this, node, true, true, m_pGraph.m_iAddCEF);
-            }
+            std::vector<SizeType> nodes(end - begin);
+            for (SizeType node = begin; node < end; node++) nodes[node - begin] = node;
+            m_pGraph.RefineNodes<T>(this, nodes, true, m_pGraph.m_iAddCEF, m_iNumberOfThreads);
             return ErrorCode::Success;
         }
 
@@ -583,11 +769,23 @@ namespace SPTAG
         template <typename T>
         ErrorCode Index<T>::AddIndexIdx(SizeType begin, SizeType end)
         {
+            if (begin >= end) return ErrorCode::Success;
+
+            std::vector<SizeType> nodes(end - begin);
+            for (SizeType node = begin; node < end; node++) nodes[node - begin] = node;
+            return AddIndexIdxBatch(nodes);
+        }
+
+        template <typename T>
+        ErrorCode Index<T>::AddIndexIdxBatch(const std::vector<SizeType>& p_ids)
+        {
+            if (p_ids.empty()) return ErrorCode::Success;
 
-            for (SizeType node = begin; node < end; node++)
+            for (SizeType node : p_ids)
             {
-                m_pGraph.RefineNode<T>(this, node, true, true, m_pGraph.m_iAddCEF);
+                if (node < 0 || node >= m_pGraph.R()) return ErrorCode::Fail;
             }
+            m_pGraph.RefineNodes<T>(this, p_ids, true, m_pGraph.m_iAddCEF, m_iNumberOfThreads);
             return ErrorCode::Success;
         }
 
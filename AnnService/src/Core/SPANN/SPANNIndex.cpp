@@ -8,6 +8,7 @@
 #include <shared_mutex>
 #include <chrono>
 #include <random>
+#include <thread>
 
 #pragma warning(disable:4242)  // '=' : conversion from 'int' to 'short', possible loss of data
 #pragma warning(disable:4244)  // '=' : conversion from 'int' to 'short', possible loss of data
@@ -26,6 +27,8 @@ namespace SPTAG
         bool Index<T>::CheckHeadIndexType() {
             SPTAG::VectorValueType v1 = m_index->GetVectorValueType(), v2 = GetEnumValueType<T>();
             if (v1 != v2) {
+                // postings are always built against the full precision heads
+                if (m_options.m_quantizeHead && v1 == SPTAG::VectorValueType::Int8 && !m_options.m_buildSsdIndex) return true;
                 LOG(Helper::LogLevel::LL_Error, "Head index and vectors don't have the same value types, which are %s %s\n",
                     SPTAG::Helper::Convert::ConvertToString(v1).c_str(),
                     SPTAG::Helper::Convert::ConvertToString(v2).c_str()
@@ -40,6 +43,7 @@ namespace SPTAG
         {
             IndexAlgoType algoType = p_reader.GetParameter("Base", "IndexAlgoType", IndexAlgoType::Undefined);
             VectorValueType valueType = p_reader.GetParameter("Base", "ValueType", VectorValueType::Undefined);
+            if (p_reader.GetParameter("Base", "QuantizeHead", false)) valueType = VectorValueType::Int8;
             if ((m_index = CreateInstance(algoType, valueType)) == nullptr) return ErrorCode::FailedParseValue;
 
             std::string sections[] = { "Base", "SelectHead", "BuildHead", "BuildSSDIndex" };
@@ -65,12 +69,14 @@ namespace SPTAG
 
             m_extraSearcher.reset(new ExtraFullGraphSearcher<T>());
             if (!m_extraSearcher->LoadIndex(m_options)) return ErrorCode::Fail;
+            if (m_options.m_quantizeHead && LoadHeadQuantizer() != ErrorCode::Success) return ErrorCode::Fail;
 
             m_vectorTranslateMap.reset((std::uint64_t*)(p_indexBlobs.back().Data()), [=](std::uint64_t* ptr) {});
+            m_vectorTranslateMapSize = m_index->GetNumSamples();
 
             omp_set_num_threads(m_options.m_iSSDNumberOfThreads);
-            m_workSpacePool.reset(new COMMON::WorkSpacePool<ExtraWorkSpace>());
-            m_workSpacePool->Init(m_options.m_iSSDNumberOfThreads, m_options.m_maxCheck, m_options.m_hashExp, m_options.m_searchInternalResultNum, min(m_options.m_postingPageLimit, m_options.m_searchPostingPageLimit + 1) << PageSizeEx);
+            InitWorkSpacePools(m_options.m_iSSDNumberOfThreads);
+            StartRecallMonitor();
             return ErrorCode::Success;
         }
 
@@ -89,15 +95,17 @@ namespace SPTAG
             // Not Ready
             m_extraSearcher.reset(new ExtraFullGraphSearcher<T>());
             if (!m_extraSearcher->LoadIndex(m_options)) return ErrorCode::Fail;
+            if (m_options.m_quantizeHead && LoadHeadQuantizer() != ErrorCode::Success) return ErrorCode::Fail;
 
             m_vectorTranslateMap.reset(new std::uint64_t[m_index->GetNumSamples()], std::default_delete<std::uint64_t[]>());
             IOBINARY(p_indexStreams.back(), ReadBinary, sizeof(std::uint64_t) * m_index->GetNumSamples(), reinterpret_cast<char*>(m_vectorTranslateMap.get()));
+            m_vectorTranslateMapSize = m_index->GetNumSamples();
 
             omp_set_num_threads(m_options.m_iSSDNumberOfThreads);
-            m_workSpacePool = std::make_unique<COMMON::WorkSpacePool<ExtraWorkSpace>>();
-            m_workSpacePool->Init(m_options.m_iSSDNumberOfThreads, m_options.m_maxCheck, m_options.m_hashExp, m_options.m_searchInternalResultNum, min(m_options.m_postingPageLimit, m_options.m_searchPostingPageLimit + 1) << PageSizeEx);
+            InitWorkSpacePools(m_options.m_iSSDNumberOfThreads);
 
             m_versionMap.Load(m_options.m_fullDeletedIDFile, m_index->m_iDataBlockSize, m_index->m_iDataCapacity);
+            StartRecallMonitor();
 
             return ErrorCode::Success;
         }
@@ -143,12 +151,14 @@ namespace SPTAG
         template<typename T>
         ErrorCode Index<T>::SaveIndexData(const std::vector<std::shared_ptr<Helper::DiskPriorityIO>>& p_indexStreams)
         {
-            if (m_index == nullptr || m_vectorTranslateMap == nullptr) return ErrorCode::EmptyIndex;
+            std::shared_ptr<std::uint64_t> translateMap;
+            auto headIndex = LoadHeadIndex(translateMap);
+            if (headIndex == nullptr || translateMap == nullptr) return ErrorCode::EmptyIndex;
 
             ErrorCode ret;
-            if ((ret = m_index->SaveIndexData(p_indexStreams)) != ErrorCode::Success) return ret;
+            if ((ret = headIndex->SaveIndexData(p_indexStreams)) != ErrorCode::Success) return ret;
 
-            IOBINARY(p_indexStreams.back(), WriteBinary, sizeof(std::uint64_t) * m_index->GetNumSamples(), (char*)(m_vectorTranslateMap.get()));
+            IOBINARY(p_indexStreams.back(), WriteBinary, sizeof(std::uint64_t) * headIndex->GetNumSamples(), (char*)(translateMap.get()));
             m_versionMap.Save(m_options.m_fullDeletedIDFile);
             return ErrorCode::Success;
         }
@@ -156,39 +166,248 @@ namespace SPTAG
 #pragma region K-NN search
 
         template<typename T>
-        ErrorCode Index<T>::SearchIndex(QueryResult &p_query, bool p_searchDeleted) const
+        ErrorCode Index<T>::SearchHeadIndex(const std::shared_ptr<VectorIndex>& p_headIndex, QueryResult& p_query, ExtraWorkSpace* p_exWorkSpace, bool p_speculate) const
+        {
+            std::function<void(QueryResult&)> progress;
+            if (p_speculate && p_exWorkSpace != nullptr && m_options.m_speculativePrefetchInterval > 0)
+            {
+                p_exWorkSpace->m_prefetchIDs.clear();
+                p_exWorkSpace->m_lastPartialHeads.clear();
+                progress = [this, p_exWorkSpace](QueryResult& p_partial) { SpeculatePostings(p_exWorkSpace, p_partial); };
+            }
+
+            if (m_headQuantizer == nullptr)
+            {
+                if (progress) p_headIndex->SearchIndexWithProgress(p_query, m_options.m_speculativePrefetchInterval, progress);
+                else p_headIndex->SearchIndex(p_query);
+                return ErrorCode::Success;
+            }
+            if (p_exWorkSpace == nullptr)
+            {
+                auto workSpace = m_workSpacePool->Rent();
+                ErrorCode ret = SearchHeadIndex(p_headIndex, p_query, workSpace.get());
+                m_workSpacePool->Return(workSpace);
+                return ret;
+            }
+
+            // The graph is walked on int8 codes and the best candidates are re-scored at full precision,
+            // so the head distances, and with them the postings selected, are those of the original heads.
+            auto* p_queryResults = (COMMON::QueryResultSet<T>*) & p_query;
+            int candidateNum = (m_options.m_headRerankNum > 0) ? m_options.m_headRerankNum : 2 * m_options.m_searchInternalResultNum;
+            // the head vector store was opened for at most GetMaxReads reads at a time
+            candidateNum = min(max(candidateNum, p_query.GetResultNum()), m_headVectorStore->GetMaxReads());
+
+            p_exWorkSpace->m_headCode.resize(m_options.m_dim);
+            m_headQuantizer->Quantize(p_queryResults->GetTarget(), p_exWorkSpace->m_headCode.data());
+            COMMON::QueryResultSet<std::int8_t> candidates(p_exWorkSpace->m_headCode.data(), candidateNum);
+            if (progress) p_headIndex->SearchIndexWithProgress(candidates, m_options.m_speculativePrefetchInterval, progress);
+            else p_headIndex->SearchIndex(candidates);
+
+            auto& ids = p_exWorkSpace->m_headCandidates;
+            ids.clear();
+            for (int i = 0; i < candidateNum; i++)
+            {
+                auto res = candidates.GetResult(i);
+                if (res->VID == -1) break;
+                ids.push_back(res->VID);
+            }
+
+            p_query.Reset();
+            if (!m_headVectorStore->Read(p_exWorkSpace, ids.data(), (int)ids.size()))
+            {
+                LOG(Helper::LogLevel::LL_Error, "Failed to read %d head vectors.\n", (int)ids.size());
+                return ErrorCode::DiskIOFail;
+            }
+            for (int i = 0; i < (int)ids.size(); i++)
+            {
+                const T* vector = (const T*)m_headVectorStore->GetVector(p_exWorkSpace, i);
+                p_queryResults->AddPoint(ids[i], m_fComputeDistance(p_queryResults->GetTarget(), vector, m_options.m_dim));
+            }
+            p_queryResults->SortResult();
+            return ErrorCode::Success;
+        }
+
+        template<typename T>
+        void Index<T>::SpeculatePostings(ExtraWorkSpace* p_exWorkSpace, QueryResult& p_partial) const
+        {
+            // A head counts as settled once it is still among the partial results at the next look. The
+            // postings of settled heads within MaxDistRatio of the best partial result are read ahead,
+            // nearest first; the final head results decide which of them the search scans.
+            float limitDist = MaxDist;
+            for (int i = 0; i < p_partial.GetResultNum(); i++)
+            {
+                auto res = p_partial.GetResult(i);
+                if (res->VID != -1) limitDist = min(limitDist, res->Dist);
+            }
+            limitDist *= m_options.m_maxDistRatio;
+
+            auto& last = p_exWorkSpace->m_lastPartialHeads;
+            auto& current = p_exWorkSpace->m_partialHeads;
+            auto& settled = p_exWorkSpace->m_settledHeads;
+            current.clear();
+            settled.clear();
+            for (int i = 0; i < p_partial.GetResultNum(); i++)
+            {
+                auto res = p_partial.GetResult(i);
+                if (res->VID == -1 || (limitDist > 0.1 && res->Dist > limitDist)) continue;
+                current.push_back(res->VID);
+                if (std::binary_search(last.begin(), last.end(), res->VID)) settled.push_back(*res);
+            }
+            std::sort(current.begin(), current.end());
+            last.swap(current);
+            if (settled.empty()) return;
+
+            std::sort(settled.begin(), settled.end(), [](const BasicResult& a, const BasicResult& b) { return a.Dist < b.Dist; });
+            p_exWorkSpace->m_prefetchQueue.clear();
+            for (auto& res : settled) p_exWorkSpace->m_prefetchQueue.push_back(res.VID);
+            m_extraSearcher->PrefetchPostings(p_exWorkSpace, p_exWorkSpace->m_prefetchQueue);
+        }
+
+        template<typename T>
+        const VectorIndex* Index<T>::GetPostingDistanceIndex(const std::shared_ptr<VectorIndex>& p_headIndex) const
+        {
+            // The extra searcher scores posting vectors with the index it is given, which must work on T,
+            // so a quantized head index is replaced by this index. Callers keep p_headIndex alive for the search.
+            if (m_headQuantizer == nullptr) return p_headIndex.get();
+            return this;
+        }
+
+        template<typename T>
+        ErrorCode Index<T>::SearchHeadIndex(QueryResult& p_query) const
         {
             if (!m_bReady) return ErrorCode::EmptyIndex;
 
-            m_index->SearchIndex(p_query);
+            return SearchHeadIndex(std::atomic_load(&m_index), p_query, nullptr);
+        }
+
+        template<typename T>
+        std::shared_ptr<VectorIndex> Index<T>::LoadHeadIndex(std::shared_ptr<std::uint64_t>& p_translateMap) const
+        {
+            // A search takes both once, so that the head ids it found are translated with the map of the same numbering.
+            std::lock_guard<std::mutex> lock(m_headPublishLock);
+            p_translateMap = m_vectorTranslateMap;
+            return std::atomic_load(&m_index);
+        }
+
+        template<typename T>
+        void Index<T>::PublishHeadIndex(const std::shared_ptr<VectorIndex>& p_index, const std::shared_ptr<std::uint64_t>& p_translateMap, SizeType p_translateMapSize)
+        {
+            std::lock_guard<std::mutex> lock(m_headPublishLock);
+            if (p_translateMap != nullptr)
+            {
+                m_vectorTranslateMap = p_translateMap;
+                m_vectorTranslateMapSize = p_translateMapSize;
+            }
+            std::atomic_store(&m_index, p_index);
+        }
+
+        template<typename T>
+        void Index<T>::PrepareExtraSearch(ExtraWorkSpace* p_exWorkSpace, QueryResult& p_query, const std::uint64_t* p_translateMap) const
+        {
+            auto* p_queryResults = (COMMON::QueryResultSet<T>*) & p_query;
+            p_exWorkSpace->m_postingIDs.clear();
+            p_exWorkSpace->m_postingDists.clear();
+
+            float limitDist = p_queryResults->GetResult(0)->Dist * m_options.m_maxDistRatio;
+            for (int i = 0; i < m_options.m_searchInternalResultNum; ++i)
+            {
+                auto res = p_queryResults->GetResult(i);
+                if (res->VID == -1 || (limitDist > 0.1 && res->Dist > limitDist)) break;
+                p_exWorkSpace->m_postingIDs.emplace_back(res->VID);
+                p_exWorkSpace->m_postingDists.emplace_back(res->Dist);
+            }
+
+            for (int i = 0; i < p_queryResults->GetResultNum(); ++i)
+            {
+                auto res = p_queryResults->GetResult(i);
+                if (res->VID == -1) break;
+                res->VID = static_cast<SizeType>(p_translateMap[res->VID]);
+            }
+
+            p_queryResults->Reverse();
+        }
+
+        template<typename T>
+        void Index<T>::SearchPostings(ExtraWorkSpace* p_exWorkSpace, QueryResult& p_query, const std::shared_ptr<VectorIndex>& p_headIndex,
+            SearchStats* p_stats, std::chrono::steady_clock::time_point p_searchBegin) const
+        {
+            auto postingIndex = GetPostingDistanceIndex(p_headIndex);
+            int batch = m_options.m_searchPostingBatch;
+            if (batch <= 0 || (int)p_exWorkSpace->m_postingIDs.size() <= batch)
+            {
+                m_extraSearcher->SearchIndex(p_exWorkSpace, p_query, postingIndex, p_stats, m_versionMap);
+                return;
+            }
 
+            // The postings are read nearest head first, a batch per round. Before each further round the
+            // search stops if a budget is spent, or if the ResultNum-th result is already within
+            // SearchConvergeRatio of the next head, so that the remaining postings are unlikely to improve it.
             auto* p_queryResults = (COMMON::QueryResultSet<T>*) & p_query;
-            std::shared_ptr<ExtraWorkSpace> workSpace = nullptr;
-            if (m_extraSearcher != nullptr) {
-                workSpace = m_workSpacePool->Rent();
-                workSpace->m_postingIDs.clear();
+            int K = min(m_options.m_resultNum, p_queryResults->GetResultNum());
+            std::vector<int>& queue = p_exWorkSpace->m_postingQueue;
+            queue.swap(p_exWorkSpace->m_postingIDs);
 
-                float limitDist = p_queryResults->GetResult(0)->Dist * m_options.m_maxDistRatio;
-                for (int i = 0; i < m_options.m_searchInternalResultNum; ++i)
+            int pages = 0;
+            for (int next = 0; next < (int)queue.size(); next += batch)
+            {
+                if (next > 0)
                 {
-                    auto res = p_queryResults->GetResult(i);
-                    if (res->VID == -1 || (limitDist > 0.1 && res->Dist > limitDist)) break;
-                    workSpace->m_postingIDs.emplace_back(res->VID);
+                    if (m_options.m_searchPageBudget > 0 && pages >= m_options.m_searchPageBudget) break;
+                    if (m_options.m_searchLatencyBudget > 0 &&
+                        std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - p_searchBegin).count() >= m_options.m_searchLatencyBudget) break;
+                    if (m_options.m_searchConvergeRatio > 0 && K > 0)
+                    {
+                        float kthDist = p_queryResults->worstDist();
+                        if (K < p_queryResults->GetResultNum())
+                        {
+                            std::vector<float>& dists = p_exWorkSpace->m_resultDists;
+                            dists.clear();
+                            for (int i = 0; i < p_queryResults->GetResultNum(); i++) dists.push_back(p_queryResults->GetResult(i)->Dist);
+                            std::nth_element(dists.begin(), dists.begin() + K - 1, dists.end());
+                            kthDist = dists[K - 1];
+                        }
+                        if (kthDist <= m_options.m_searchConvergeRatio * p_exWorkSpace->m_postingDists[next]) break;
+                    }
                 }
 
-                for (int i = 0; i < p_queryResults->GetResultNum(); ++i)
+                p_exWorkSpace->m_postingIDs.assign(queue.begin() + next, queue.begin() + min(next + batch, (int)queue.size()));
+                p_exWorkSpace->m_resumeSearch = (next > 0);
+
+                SearchStats round;
+                if (p_stats) round.m_totalLatency = p_stats->m_totalLatency;
+                m_extraSearcher->SearchIndex(p_exWorkSpace, p_query, postingIndex, &round, m_versionMap);
+                pages += round.m_diskAccessCount;
+                if (p_stats)
                 {
-                    auto res = p_queryResults->GetResult(i);
-                    if (res->VID == -1) break;
-                    res->VID = static_cast<SizeType>((m_vectorTranslateMap.get())[res->VID]);
+                    p_stats->m_totalListElementsCount += round.m_totalListElementsCount;
+                    p_stats->m_diskIOCount += round.m_diskIOCount;
+                    p_stats->m_diskAccessCount += round.m_diskAccessCount;
+                    p_stats->m_compLatency += round.m_compLatency;
+                    p_stats->m_diskReadLatency += round.m_diskReadLatency;
+                    p_stats->m_exSetUpLatency += round.m_exSetUpLatency;
                 }
-
-                p_queryResults->Reverse();
-                m_extraSearcher->SearchIndex(workSpace.get(), *p_queryResults, m_index, nullptr, m_versionMap);
-                p_queryResults->SortResult();
-                m_workSpacePool->Return(workSpace);
             }
 
+            p_exWorkSpace->m_resumeSearch = false;
+            p_exWorkSpace->m_postingIDs.swap(queue);
+        }
+
+        template<typename T>
+        void Index<T>::InitWorkSpacePools(int p_searchThreads)
+        {
+            // Both pools go before either is refilled: dropping a pool restarts the workspace channel ids, and the
+            // async workspaces take the ids after those of the search ones.
+            m_asyncWorkSpacePool.reset();
+            m_workSpacePool.reset(new COMMON::WorkSpacePool<ExtraWorkSpace>());
+            int maxPages = min(m_options.m_postingPageLimit, m_options.m_searchPostingPageLimit + 1) << PageSizeEx;
+            m_workSpacePool->Init(p_searchThreads, m_options.m_maxCheck, m_options.m_hashExp, m_options.m_searchInternalResultNum, maxPages);
+            m_asyncWorkSpacePool.reset(new COMMON::WorkSpacePool<ExtraWorkSpace>());
+            m_asyncWorkSpacePool->Init(m_options.GetAsyncSearchWorkSpaces(), m_options.m_maxCheck, m_options.m_hashExp, m_options.m_searchInternalResultNum, maxPages);
+        }
+
+        template<typename T>
+        void Index<T>::FillMetadata(QueryResult& p_query) const
+        {
             if (p_query.WithMeta() && nullptr != m_pMetadata)
             {
                 for (int i = 0; i < p_query.GetResultNum(); ++i)
@@ -197,24 +416,254 @@ namespace SPTAG
                     p_query.SetMetadata(i, (result < 0) ? ByteArray::c_empty : m_pMetadata->GetMetadataCopy(result));
                 }
             }
+        }
+
+        template<typename T>
+        void Index<T>::StartRecallMonitor()
+        {
+            if (m_options.m_recallMonitorSampleRate <= 0 || m_extraSearcher == nullptr)
+            {
+                m_recallMonitor.reset();
+                return;
+            }
+
+            m_recallMonitor.reset(new RecallMonitor(m_options.m_recallMonitorSampleRate, m_options.m_recallMonitorK, m_options.m_recallMonitorWindow, m_options.m_recallMonitorMaxPending));
+            LOG(Helper::LogLevel::LL_Info, "Recall monitor: sampling %.4f of the queries for recall@%d\n", m_options.m_recallMonitorSampleRate, m_options.m_recallMonitorK);
+        }
+
+        template<typename T>
+        void Index<T>::MonitorRecall(QueryResult& p_query) const
+        {
+            if (m_recallMonitor == nullptr || !m_recallMonitor->ShouldSample()) return;
+
+            int K = min(m_recallMonitor->GetK(), p_query.GetResultNum());
+            ByteArray target = ByteArray::Alloc(sizeof(T) * m_options.m_dim);
+            memcpy(target.Data(), p_query.GetTarget(), sizeof(T) * m_options.m_dim);
+
+            std::vector<BasicResult> served;
+            for (int i = 0; i < K; i++)
+            {
+                auto res = p_query.GetResult(i);
+                if (res->VID != -1) served.emplace_back(res->VID, res->Dist);
+            }
+
+            m_recallMonitor->Submit([this, target, served, K]()
+            {
+                std::vector<BasicResult> reference(served);
+                if (!ReferenceSearch((const T*)target.Data(), K, reference))
+                {
+                    m_recallMonitor->Drop();
+                    return;
+                }
+
+                // The reference holds the served results too, so a served result is a hit when it is
+                // within the reference K-th distance; ties count whichever tied vector was returned.
+                int hits = 0;
+                for (auto& res : served)
+                {
+                    if (res.Dist <= reference.back().Dist) hits++;
+                }
+                m_recallMonitor->Record(min(hits, (int)reference.size()), (int)reference.size());
+            });
+        }
+
+        template<typename T>
+        bool Index<T>::ReferenceSearch(const T* p_target, int p_K, std::vector<BasicResult>& p_results) const
+        {
+            // The reference search only borrows an idle search workspace so that it never competes
+            // with live queries for one; the sample is dropped if none frees up in time.
+            std::shared_ptr<ExtraWorkSpace> workSpace;
+            for (int retry = 0; !m_workSpacePool->TryRent(workSpace); retry++)
+            {
+                if (retry >= 100) return false;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            int internalResultNum = (m_options.m_recallMonitorInternalResultNum > 0) ? m_options.m_recallMonitorInternalResultNum : 4 * m_options.m_searchInternalResultNum;
+            COMMON::QueryResultSet<T> heads(p_target, internalResultNum);
+            BeginPostingSearch();
+            std::shared_ptr<std::uint64_t> translateMap;
+            auto headIndex = LoadHeadIndex(translateMap);
+            if (SearchHeadIndex(headIndex, heads, workSpace.get()) != ErrorCode::Success)
+            {
+                EndPostingSearch();
+                m_workSpacePool->Return(workSpace);
+                return false;
+            }
+
+            for (int i = 0; i < internalResultNum; i++)
+            {
+                auto res = heads.GetResult(i);
+                if (res->VID == -1) break;
+                p_results.emplace_back(static_cast<SizeType>(translateMap.get()[res->VID]), res->Dist);
+            }
+
+            // Postings are scanned in groups that fit a search workspace, without the MaxDistRatio cut.
+            for (int begin = 0; begin < internalResultNum; begin += m_options.m_searchInternalResultNum)
+            {
+                workSpace->m_postingIDs.clear();
+                for (int i = begin; i < min(begin + m_options.m_searchInternalResultNum, internalResultNum); i++)
+                {
+                    auto res = heads.GetResult(i);
+                    if (res->VID == -1) break;
+                    workSpace->m_postingIDs.emplace_back(res->VID);
+                }
+                if (workSpace->m_postingIDs.empty()) break;
+
+                COMMON::QueryResultSet<T> postingResults(p_target, p_K);
+                m_extraSearcher->SearchIndex(workSpace.get(), postingResults, GetPostingDistanceIndex(headIndex), nullptr, m_versionMap);
+                for (int i = 0; i < p_K; i++)
+                {
+                    auto res = postingResults.GetResult(i);
+                    if (res->VID != -1) p_results.emplace_back(res->VID, res->Dist);
+                }
+            }
+            EndPostingSearch();
+            m_workSpacePool->Return(workSpace);
+
+            std::sort(p_results.begin(), p_results.end(), [](const BasicResult& a, const BasicResult& b) { return a.VID < b.VID || (a.VID == b.VID && a.Dist < b.Dist); });
+            p_results.erase(std::unique(p_results.begin(), p_results.end(), [](const BasicResult& a, const BasicResult& b) { return a.VID == b.VID; }), p_results.end());
+            std::sort(p_results.begin(), p_results.end(), [](const BasicResult& a, const BasicResult& b) { return a.Dist < b.Dist || (a.Dist == b.Dist && a.VID < b.VID); });
+            if ((int)p_results.size() > p_K) p_results.resize(p_K);
+            return !p_results.empty();
+        }
+
+        template<typename T>
+        ErrorCode Index<T>::SearchIndex(QueryResult &p_query, bool p_searchDeleted) const
+        {
+            if (!m_bReady) return ErrorCode::EmptyIndex;
+
+            auto searchBegin = std::chrono::steady_clock::now();
+            BeginPostingSearch();
+            std::shared_ptr<std::uint64_t> translateMap;
+            auto headIndex = LoadHeadIndex(translateMap);
+            std::shared_ptr<ExtraWorkSpace> workSpace = nullptr;
+            if (m_extraSearcher != nullptr) workSpace = m_workSpacePool->Rent();
+            ErrorCode ret = SearchHeadIndex(headIndex, p_query, workSpace.get(), true);
+            m_metrics->m_headSearch.RecordSince(searchBegin);
+            if (ret != ErrorCode::Success)
+            {
+                if (workSpace != nullptr)
+                {
+                    // the head search may have started reading postings ahead before it failed
+                    m_extraSearcher->DropPrefetch(workSpace.get());
+                    m_workSpacePool->Return(workSpace);
+                }
+                EndPostingSearch();
+                return ret;
+            }
+
+            auto* p_queryResults = (COMMON::QueryResultSet<T>*) & p_query;
+            if (m_extraSearcher != nullptr) {
+                SearchStats stats;
+                PrepareExtraSearch(workSpace.get(), p_query, translateMap.get());
+                SearchPostings(workSpace.get(), p_query, headIndex, &stats, searchBegin);
+                m_extraSearcher->DropPrefetch(workSpace.get());
+                p_queryResults->SortResult();
+                m_workSpacePool->Return(workSpace);
+
+                m_metrics->m_postingSubmit.Record((std::uint64_t)(stats.m_exSetUpLatency * 1000));
+                m_metrics->m_postingRead.Record((std::uint64_t)(stats.m_diskReadLatency * 1000));
+                m_metrics->m_postingScan.Record((std::uint64_t)(stats.m_compLatency * 1000));
+            }
+            EndPostingSearch();
+
+            FillMetadata(p_query);
+            m_metrics->m_search.RecordSince(searchBegin);
+            MonitorRecall(p_query);
+            return ErrorCode::Success;
+        }
+
+        template<typename T>
+        ErrorCode Index<T>::SearchIndexAsync(QueryResult& p_query, std::function<void(ErrorCode)> p_callback, bool p_searchDeleted) const
+        {
+            if (!m_bReady) return ErrorCode::EmptyIndex;
+            if (m_extraSearcher == nullptr) return VectorIndex::SearchIndexAsync(p_query, std::move(p_callback), p_searchDeleted);
+
+            // A search in flight holds its workspace until its last read completes, so the caller is turned
+            // away rather than blocked while all of them are taken.
+            std::shared_ptr<ExtraWorkSpace> workSpace;
+            if (!m_asyncWorkSpacePool->TryRent(workSpace)) return ErrorCode::Busy;
+
+            // The head search runs on the calling thread; the posting scan runs as the reads complete.
+            auto searchBegin = std::chrono::steady_clock::now();
+            BeginPostingSearch();
+            std::shared_ptr<std::uint64_t> translateMap;
+            auto headIndex = LoadHeadIndex(translateMap);
+            ErrorCode ret = SearchHeadIndex(headIndex, p_query, workSpace.get());
+            m_metrics->m_headSearch.RecordSince(searchBegin);
+            if (ret != ErrorCode::Success)
+            {
+                m_asyncWorkSpacePool->Return(workSpace);
+                EndPostingSearch();
+                return ret;
+            }
+
+            PrepareExtraSearch(workSpace.get(), p_query, translateMap.get());
+            m_extraSearcher->SearchIndexAsync(workSpace.get(), p_query, GetPostingDistanceIndex(headIndex), m_versionMap,
+                [this, workSpace, headIndex, &p_query, p_callback, searchBegin](ErrorCode p_ret)
+                {
+                    ((COMMON::QueryResultSet<T>*) & p_query)->SortResult();
+                    m_asyncWorkSpacePool->Return(workSpace);
+                    EndPostingSearch();
+
+                    FillMetadata(p_query);
+                    m_metrics->m_search.RecordSince(searchBegin);
+                    if (p_ret == ErrorCode::Success) MonitorRecall(p_query);
+                    if (p_callback) p_callback(p_ret);
+                });
             return ErrorCode::Success;
         }
 
+        template <typename T>
+        void Index<T>::CollectMetrics(Helper::MetricsWriter& p_writer) const
+        {
+            m_metrics->Write(p_writer);
+
+            p_writer.WriteGauge("sptag_spann_vectors", "Number of vectors in the index.", (double)m_vectorNum.load());
+            if (m_splitThreadPool != nullptr)
+            {
+                p_writer.WriteGauge("sptag_spann_split_queue_depth", "Append and split jobs waiting to run.", (double)m_splitThreadPool->jobsize());
+                p_writer.WriteGauge("sptag_spann_split_running_jobs", "Append and split jobs running.", (double)m_splitThreadPool->runningJobs());
+            }
+            if (m_reassignThreadPool != nullptr)
+            {
+                p_writer.WriteGauge("sptag_spann_reassign_queue_depth", "Reassign jobs waiting to run.", (double)m_reassignThreadPool->jobsize());
+                p_writer.WriteGauge("sptag_spann_reassign_running_jobs", "Reassign jobs running.", (double)m_reassignThreadPool->runningJobs());
+            }
+            p_writer.WriteCounter("sptag_spann_splits_total", "Posting splits since the index was loaded.", (double)m_metrics->m_splits.load());
+            p_writer.WriteCounter("sptag_spann_reassigns_total", "Vector reassigns since the index was loaded.", (double)m_metrics->m_reassigns.load());
+            p_writer.WriteCounter("sptag_spann_head_misses_total", "Appends whose head was gone since the index was loaded.", (double)m_metrics->m_headMisses.load());
+
+            if (m_recallMonitor != nullptr)
+            {
+                std::uint64_t recorded = 0, dropped = 0;
+                double recall = m_recallMonitor->GetRollingRecall(&recorded, &dropped);
+                if (recall >= 0) p_writer.WriteGauge("sptag_spann_rolling_recall", "Recall of sampled queries against the reference search.", recall);
+                p_writer.WriteCounter("sptag_spann_recall_samples_total", "Sampled queries checked by the recall monitor.", (double)recorded);
+                p_writer.WriteCounter("sptag_spann_recall_samples_dropped_total", "Sampled queries the recall monitor had to drop.", (double)dropped);
+            }
+        }
+
         template <typename T>
         ErrorCode Index<T>::DebugSearchDiskIndex(QueryResult& p_query, int p_subInternalResultNum, int p_internalResultNum,
                                                  SearchStats* p_stats, std::set<int>* truth, std::map<int, std::set<int>>* found)
         {
             auto exStart = std::chrono::high_resolution_clock::now();
+            auto searchBegin = std::chrono::steady_clock::now();
 
             if (nullptr == m_extraSearcher) return ErrorCode::EmptyIndex;
 
+            BeginPostingSearch();
+            std::shared_ptr<std::uint64_t> translateMap;
+            auto headIndex = LoadHeadIndex(translateMap);
             COMMON::QueryResultSet<T> newResults(*((COMMON::QueryResultSet<T>*)&p_query));
             for (int i = 0; i < newResults.GetResultNum() && !m_options.m_useKV; ++i)
             {
                 auto res = newResults.GetResult(i);
                 if (res->VID == -1) break;
 
-                auto global_VID = static_cast<SizeType>((m_vectorTranslateMap.get())[res->VID]);
+                auto global_VID = static_cast<SizeType>(translateMap.get()[res->VID]);
                 if (truth && truth->count(global_VID)) (*found)[res->VID].insert(global_VID);
                 res->VID = global_VID;
             }
@@ -229,12 +678,14 @@ namespace SPTAG
                 int subInternalResultNum = min(p_subInternalResultNum, p_internalResultNum - p_subInternalResultNum * p);
 
                 auto_ws->m_postingIDs.clear();
+                auto_ws->m_postingDists.clear();
 
                 for (int i = p * p_subInternalResultNum; i < p * p_subInternalResultNum + subInternalResultNum; i++)
                 {
                     auto res = p_query.GetResult(i);
                     if (res->VID == -1 || (limitDist > 0.1 && res->Dist > limitDist)) break;
                     auto_ws->m_postingIDs.emplace_back(res->VID);
+                    auto_ws->m_postingDists.emplace_back(res->Dist);
                 }
 
                 auto exEnd = std::chrono::high_resolution_clock::now();
@@ -242,10 +693,13 @@ namespace SPTAG
                 p_stats->m_totalLatency += ((double)std::chrono::duration_cast<std::chrono::milliseconds>(exEnd - exStart).count());
 
 
-                m_extraSearcher->SearchIndex(auto_ws.get(), newResults, m_index, p_stats, m_versionMap, truth, found);
+                // The recall analysis needs every posting it asks for, so only plain searches read in rounds.
+                if (truth == nullptr) SearchPostings(auto_ws.get(), newResults, headIndex, p_stats, searchBegin);
+                else m_extraSearcher->SearchIndex(auto_ws.get(), newResults, GetPostingDistanceIndex(headIndex), p_stats, m_versionMap, truth, found);
             }
 
             m_workSpacePool->Return(auto_ws);
+            EndPostingSearch();
 
             newResults.SortResult();
             std::copy(newResults.GetResults(), newResults.GetResults() + newResults.GetResultNum(), p_query.GetResults());
@@ -424,7 +878,27 @@ namespace SPTAG
 
         template <typename T>
         bool Index<T>::SelectHead(std::shared_ptr<Helper::VectorSetReader>& p_reader) {
-            std::shared_ptr<VectorSet> vectorset = p_reader->GetVectorSet();
+            std::shared_ptr<VectorSet> vectorset;
+            std::vector<SizeType> sampleIDs;
+            SizeType totalCount = p_reader->GetVectorCount();
+            if (m_options.m_selectHeadSampleNumber > 0 && m_options.m_selectHeadSampleNumber < totalCount) {
+                // Selection sampling keeps the ids ascending so the reader can fetch them in file order.
+                std::mt19937 rng(0);
+                std::uniform_real_distribution<double> uniform(0.0, 1.0);
+                SizeType needed = m_options.m_selectHeadSampleNumber;
+                sampleIDs.reserve(needed);
+                for (SizeType i = 0; i < totalCount && needed > 0; i++) {
+                    if (uniform(rng) * (totalCount - i) < needed) {
+                        sampleIDs.push_back(i);
+                        needed--;
+                    }
+                }
+                LOG(Helper::LogLevel::LL_Info, "Select heads from %d sampled vectors out of %d.\n", (int)sampleIDs.size(), totalCount);
+                vectorset = p_reader->GetVectorSubset(sampleIDs);
+            }
+            else {
+                vectorset = p_reader->GetVectorSet();
+            }
             if (m_options.m_distCalcMethod == DistCalcMethod::Cosine && !p_reader->IsNormalized())
                 vectorset->Normalize(m_options.m_iSelectHeadNumberOfThreads);
             COMMON::Dataset<T> data(vectorset->Count(), vectorset->Dimension(), vectorset->Count(), vectorset->Count() + 1, (T*)vectorset->GetData());
@@ -511,13 +985,13 @@ namespace SPTAG
 
                 for (int i = 0; i < selected.size(); i++)
                 {
-                    uint64_t vid = static_cast<uint64_t>(selected[i]);
+                    uint64_t vid = static_cast<uint64_t>(sampleIDs.empty() ? selected[i] : sampleIDs[selected[i]]);
                     if (outputIDs->WriteBinary(sizeof(vid), reinterpret_cast<char*>(&vid)) != sizeof(vid)) {
                         LOG(Helper::LogLevel::LL_Error, "Failed to write output file!\n");
                         return false;
                     }
 
-                    if (output->WriteBinary(sizeof(T) * data.C(), (char*)(data[vid])) != sizeof(T) * data.C()) {
+                    if (output->WriteBinary(sizeof(T) * data.C(), (char*)(data[selected[i]])) != sizeof(T) * data.C()) {
                         LOG(Helper::LogLevel::LL_Error, "Failed to write output file!\n");
                         return false;
                     }
@@ -529,8 +1003,119 @@ namespace SPTAG
             return true;
         }
 
+        // Renumbers the freshly built head index in the order of its BKTree, so that heads linked to each
+        // other mostly sit next to each other in memory, and rewrites the head vector and head ID files to match.
+        // This runs before any posting is keyed by a head ID.
+        template <typename T>
+        ErrorCode Index<T>::ReorderHeads()
+        {
+            std::shared_ptr<VectorIndex> newIndex;
+            std::vector<SizeType> newToOld;
+            ErrorCode ret;
+            if ((ret = m_index->ReorderIndex(newIndex, newToOld)) != ErrorCode::Success) {
+                LOG(Helper::LogLevel::LL_Error, "Failed to reorder head index.\n");
+                return ret;
+            }
+            SizeType num = (SizeType)newToOld.size();
+
+            std::string idFile = m_options.m_indexDirectory + FolderSep + m_options.m_headIDFile;
+            std::vector<std::uint64_t> ids(num);
+            {
+                auto ptr = SPTAG::f_createIO();
+                if (ptr == nullptr || !ptr->Initialize(idFile.c_str(), std::ios::binary | std::ios::in)) {
+                    LOG(Helper::LogLevel::LL_Error, "Failed to open headIDFile file:%s\n", idFile.c_str());
+                    return ErrorCode::FailedOpenFile;
+                }
+                IOBINARY(ptr, ReadBinary, sizeof(std::uint64_t) * num, (char*)ids.data());
+            }
+
+            std::string vectorFile = m_options.m_indexDirectory + FolderSep + m_options.m_headVectorFile;
+            auto output = SPTAG::f_createIO(), outputIDs = SPTAG::f_createIO();
+            if (output == nullptr || outputIDs == nullptr ||
+                !output->Initialize(vectorFile.c_str(), std::ios::binary | std::ios::out) ||
+                !outputIDs->Initialize(idFile.c_str(), std::ios::binary | std::ios::out)) {
+                LOG(Helper::LogLevel::LL_Error, "Failed to create output file:%s %s\n", vectorFile.c_str(), idFile.c_str());
+                return ErrorCode::FailedCreateFile;
+            }
+
+            DimensionType dim = newIndex->GetFeatureDim();
+            std::size_t vectorSize = GetValueTypeSize(newIndex->GetVectorValueType()) * dim;
+            IOBINARY(output, WriteBinary, sizeof(num), (char*)&num);
+            IOBINARY(output, WriteBinary, sizeof(dim), (char*)&dim);
+            for (SizeType i = 0; i < num; i++)
+            {
+                IOBINARY(outputIDs, WriteBinary, sizeof(std::uint64_t), (char*)&(ids[newToOld[i]]));
+                IOBINARY(output, WriteBinary, vectorSize, (char*)newIndex->GetSample(i));
+            }
+
+            m_index = newIndex;
+            return ErrorCode::Success;
+        }
+
+        // Replaces the head index by a copy holding int8 codes and saves it over the head index folder.
+        // The full precision vectors stay in the head vector file for re-scoring the candidate heads.
+        template <typename T>
+        ErrorCode Index<T>::QuantizeHeads()
+        {
+            COMMON::ScalarQuantizer quantizer;
+            auto headIndex = m_index;
+            quantizer.Train<T>([&headIndex](SizeType i) { return (const T*)headIndex->GetSample(i); },
+                headIndex->GetNumSamples(), headIndex->GetFeatureDim(), m_options.m_distCalcMethod);
+
+            std::string quantizerFile = m_options.m_indexDirectory + FolderSep + m_options.m_headQuantizerFile;
+            {
+                auto ptr = SPTAG::f_createIO();
+                if (ptr == nullptr || !ptr->Initialize(quantizerFile.c_str(), std::ios::binary | std::ios::out) || quantizer.Save(ptr) != ErrorCode::Success) {
+                    LOG(Helper::LogLevel::LL_Error, "Failed to write head quantizer file:%s\n", quantizerFile.c_str());
+                    return ErrorCode::FailedCreateFile;
+                }
+            }
+
+            std::shared_ptr<VectorIndex> newIndex;
+            ErrorCode ret;
+            if ((ret = headIndex->QuantizeIndex(newIndex, [&quantizer](const void* p_vector, std::int8_t* p_code) { quantizer.Quantize((const T*)p_vector, p_code); })) != ErrorCode::Success ||
+                (ret = newIndex->SaveIndex(m_options.m_indexDirectory + FolderSep + m_options.m_headIndexFolder)) != ErrorCode::Success) {
+                LOG(Helper::LogLevel::LL_Error, "Failed to quantize head index.\n");
+                return ret;
+            }
+
+            m_index = newIndex;
+            return LoadHeadQuantizer();
+        }
+
+        template <typename T>
+        ErrorCode Index<T>::LoadHeadQuantizer()
+        {
+            std::string quantizerFile = m_options.m_indexDirectory + FolderSep + m_options.m_headQuantizerFile;
+            std::unique_ptr<COMMON::ScalarQuantizer> quantizer(new COMMON::ScalarQuantizer());
+            auto ptr = SPTAG::f_createIO();
+            if (ptr == nullptr || !ptr->Initialize(quantizerFile.c_str(), std::ios::binary | std::ios::in) ||
+                quantizer->Load(ptr) != ErrorCode::Success || quantizer->GetDim() != m_options.m_dim) {
+                LOG(Helper::LogLevel::LL_Error, "Failed to load head quantizer file:%s\n", quantizerFile.c_str());
+                return ErrorCode::FailedOpenFile;
+            }
+
+            int candidateNum = (m_options.m_headRerankNum > 0) ? m_options.m_headRerankNum : 2 * m_options.m_searchInternalResultNum;
+            std::unique_ptr<HeadVectorStore> store(new HeadVectorStore());
+            if (!store->Load(m_options.m_indexDirectory + FolderSep + m_options.m_headVectorFile, m_options.m_dim, sizeof(T),
+                candidateNum, m_options.GetSearchChannels()) || store->GetCount() != m_index->GetNumSamples()) {
+                LOG(Helper::LogLevel::LL_Error, "Head vector file doesn't match the quantized head index.\n");
+                return ErrorCode::FailedOpenFile;
+            }
+
+            m_headQuantizer = std::move(quantizer);
+            m_headVectorStore = std::move(store);
+            LOG(Helper::LogLevel::LL_Info, "Quantized head index: re-scoring up to %d heads per query at full precision.\n", candidateNum);
+            return ErrorCode::Success;
+        }
+
         template <typename T>
         ErrorCode Index<T>::BuildIndexInternal(std::shared_ptr<Helper::VectorSetReader>& p_reader) {
+            if (m_options.m_quantizeHead && (sizeof(T) == 1 || m_options.m_useKV || m_options.m_update || SPTAG::COMMON::DistanceUtils::Quantizer)) {
+                LOG(Helper::LogLevel::LL_Error, "QuantizeHead needs a static index of Float or Int16 vectors without a quantizer.\n");
+                return ErrorCode::Fail;
+            }
+
             if (!m_options.m_indexDirectory.empty()) {
                 if (!direxists(m_options.m_indexDirectory.c_str()))
                 {
@@ -567,6 +1152,7 @@ namespace SPTAG
                     return ErrorCode::Fail;
                 }
                 if (m_index->BuildIndex(vectorReader->GetVectorSet(), nullptr, false, true) != ErrorCode::Success ||
+                    (m_options.m_reorderHeads && ReorderHeads() != ErrorCode::Success) ||
                     m_index->SaveIndex(m_options.m_indexDirectory + FolderSep + m_options.m_headIndexFolder) != ErrorCode::Success) {
                     LOG(Helper::LogLevel::LL_Error, "Failed to build head index.\n");
                     return ErrorCode::Fail;
@@ -620,6 +1206,13 @@ namespace SPTAG
                         return ErrorCode::Fail;
                     }
                     IOBINARY(ptr, ReadBinary, sizeof(std::uint64_t) * m_index->GetNumSamples(), (char*)(m_vectorTranslateMap.get()));
+                    m_vectorTranslateMapSize = m_index->GetNumSamples();
+
+                    // an index built before keeps its quantized heads, a new one is quantized after its postings
+                    if (m_options.m_quantizeHead) {
+                        ErrorCode ret = (m_index->GetVectorValueType() == GetEnumValueType<T>()) ? QuantizeHeads() : LoadHeadQuantizer();
+                        if (ret != ErrorCode::Success) return ret;
+                    }
                 } else {
                     //data structrue initialization
                     LOG(Helper::LogLevel::LL_Info, "DataBlockSize: %d, Capacity: %d\n", m_index->m_iDataBlockSize, m_index->m_iDataCapacity);
@@ -670,7 +1263,10 @@ namespace SPTAG
             double buildSSDTime = std::chrono::duration_cast<std::chrono::seconds>(t4 - t3).count();
             LOG(Helper::LogLevel::LL_Info, "select head time: %.2lfs build head time: %.2lfs build ssd time: %.2lfs\n", selectHeadTime, buildHeadTime, buildSSDTime);
 
-            if (m_options.m_deleteHeadVectors) {
+            if (m_options.m_deleteHeadVectors && m_headVectorStore != nullptr) {
+                LOG(Helper::LogLevel::LL_Warning, "Head vector file is kept for the quantized head index.\n");
+            }
+            else if (m_options.m_deleteHeadVectors) {
                 if (fileexists((m_options.m_indexDirectory + FolderSep + m_options.m_headVectorFile).c_str()) &&
                     remove((m_options.m_indexDirectory + FolderSep + m_options.m_headVectorFile).c_str()) != 0) {
                     LOG(Helper::LogLevel::LL_Warning, "Head vector file can't be removed.\n");
@@ -682,8 +1278,8 @@ namespace SPTAG
             m_index->SetParameter("HashTableExponent", std::to_string(m_options.m_hashExp));
             m_index->UpdateIndex();
 
-            m_workSpacePool.reset(new COMMON::WorkSpacePool<ExtraWorkSpace>());
-            m_workSpacePool->Init(m_options.m_searchThreadNum, m_options.m_maxCheck, m_options.m_hashExp, m_options.m_searchInternalResultNum, min(m_options.m_postingPageLimit, m_options.m_searchPostingPageLimit + 1) << PageSizeEx);
+            InitWorkSpacePools(m_options.m_searchThreadNum);
+            StartRecallMonitor();
             m_bReady = true;
             return ErrorCode::Success;
         }
@@ -704,7 +1300,7 @@ namespace SPTAG
                     LOG(Helper::LogLevel::LL_Error, "Failed to read vector file.\n");
                     return ErrorCode::Fail;
                 }
-                m_options.m_vectorSize = vectorReader->GetVectorSet()->Count();
+                m_options.m_vectorSize = vectorReader->GetVectorCount();
             }
 
             return BuildIndexInternal(vectorReader);
@@ -733,8 +1329,7 @@ namespace SPTAG
         {
             omp_set_num_threads(m_options.m_iSSDNumberOfThreads);
             m_index->UpdateIndex();
-            m_workSpacePool.reset(new COMMON::WorkSpacePool<ExtraWorkSpace>());
-            m_workSpacePool->Init(m_options.m_iSSDNumberOfThreads, m_options.m_maxCheck, m_options.m_hashExp, m_options.m_searchInternalResultNum, min(m_options.m_postingPageLimit, m_options.m_searchPostingPageLimit + 1) << PageSizeEx);
+            InitWorkSpacePools(m_options.m_iSSDNumberOfThreads);
             return ErrorCode::Success;
         }
 
@@ -782,7 +1377,9 @@ namespace SPTAG
                 return ErrorCode::Fail;
             }
 
+            std::shared_lock<std::shared_timed_mutex> compactLock(m_headCompactLock);
             std::vector<QueryResult> p_queryResults(p_vectorNum, QueryResult(nullptr, m_options.m_internalResultNum, false));
+            COMMON::ReplicaSelector selector(m_options.m_rngPairCacheSize);
 
             for (int k = 0; k < p_vectorNum; k++)
             {
@@ -792,43 +1389,16 @@ namespace SPTAG
                 {
                     std::lock_guard<std::mutex> lock(m_dataAddLock);
                     auto ret = m_versionMap.AddBatch(1);
-                    if (ret == ErrorCode::MemoryOverFlow) {
-                        LOG(Helper::LogLevel::LL_Info, "MemoryOverFlow: VID: %d, Map Size:%d\n", VID, m_versionMap.BufferSize());
-                        exit(1);
+                    if (ret != ErrorCode::Success) {
+                        LOG(Helper::LogLevel::LL_Error, "MemoryOverFlow: VID: %d, Map Size:%d\n", VID, m_versionMap.BufferSize());
+                        return ret;
                     }
                     //m_reassignedID.AddBatch(1);
                 }
 
                 m_index->SearchIndex(p_queryResults[k]);
 
-                int replicaCount = 0;
-                BasicResult* queryResults = p_queryResults[k].GetResults();
-                std::vector<EdgeInsert> selections(static_cast<size_t>(m_options.m_replicaCount));
-                for (int i = 0; i < p_queryResults[k].GetResultNum() && replicaCount < m_options.m_replicaCount; ++i)
-                {
-                    if (queryResults[i].VID == -1) {
-                        break;
-                    }
-                    // RNG Check.
-                    bool rngAccpeted = true;
-                    for (int j = 0; j < replicaCount; ++j)
-                    {
-                        float nnDist = m_index->ComputeDistance(m_index->GetSample(queryResults[i].VID),
-                                                                m_index->GetSample(selections[j].headID));
-                        if (nnDist <= queryResults[i].Dist)
-                        {
-                            rngAccpeted = false;
-                            break;
-                        }
-                    }
-                    if (!rngAccpeted)
-                        continue;
-                    selections[replicaCount].headID = queryResults[i].VID;
-                    selections[replicaCount].fullID = VID;
-                    selections[replicaCount].distance = queryResults[i].Dist;
-                    selections[replicaCount].order = (char)replicaCount;
-                    ++replicaCount;
-                }
+                int replicaCount = selector.Select(m_index.get(), p_queryResults[k].GetResults(), p_queryResults[k].GetResultNum(), m_options.m_replicaCount, 1.0f);
 
                 char insertCode = 0;
                 uint8_t version = 0;
@@ -841,7 +1411,7 @@ namespace SPTAG
                 for (int i = 0; i < replicaCount; i++)
                 {
                     // AppendAsync(selections[i].headID, 1, appendPosting_ptr);
-                    Append(selections[i].headID, 1, appendPosting);
+                    Append(selector[i].VID, 1, appendPosting);
                 }
 
                 // std::string assignment;
@@ -875,6 +1445,279 @@ namespace SPTAG
             return ErrorCode::Success;
         }
 
+        // Takes m_headCompactLock exclusively once the split and reassign queues are empty. Queued jobs
+        // carry head ids, so they have to run on the numbering they were queued with.
+        template <typename T>
+        void Index<T>::LockForHeadRenumbering(std::unique_lock<std::shared_timed_mutex>& p_lock)
+        {
+            while (true) {
+                while (m_splitThreadPool != nullptr && !AllFinished()) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                p_lock.lock();
+                if (m_splitThreadPool == nullptr || AllFinished()) return;
+                p_lock.unlock();
+            }
+        }
+
+        // Builds the head id translation for the renumbered heads, leaves p_translateMap empty without one.
+        template <typename T>
+        ErrorCode Index<T>::RemapHeadIDs(const std::vector<SizeType>& p_newToOld, std::shared_ptr<std::uint64_t>& p_translateMap)
+        {
+            p_translateMap.reset();
+            if (m_vectorTranslateMap == nullptr) return ErrorCode::Success;
+
+            SizeType num = (SizeType)p_newToOld.size();
+            std::shared_ptr<std::uint64_t> translateMap(new std::uint64_t[num], std::default_delete<std::uint64_t[]>());
+            for (SizeType i = 0; i < num; i++) {
+                if (p_newToOld[i] >= m_vectorTranslateMapSize) {
+                    LOG(Helper::LogLevel::LL_Error, "Head %d has no vector id to translate.\n", p_newToOld[i]);
+                    return ErrorCode::Fail;
+                }
+                translateMap.get()[i] = m_vectorTranslateMap.get()[p_newToOld[i]];
+            }
+            p_translateMap = translateMap;
+            return ErrorCode::Success;
+        }
+
+        // Writes the head id translation to the head ID file; renumbering calls it once every posting has moved.
+        template <typename T>
+        ErrorCode Index<T>::SaveHeadIDs(const std::shared_ptr<std::uint64_t>& p_translateMap, SizeType p_num)
+        {
+            if (p_translateMap == nullptr) return ErrorCode::Success;
+
+            std::string idFile = m_options.m_indexDirectory + FolderSep + m_options.m_headIDFile;
+            auto ptr = SPTAG::f_createIO();
+            if (ptr == nullptr || !ptr->Initialize(idFile.c_str(), std::ios::binary | std::ios::out)) {
+                LOG(Helper::LogLevel::LL_Error, "Failed to create headIDFile file:%s\n", idFile.c_str());
+                return ErrorCode::FailedCreateFile;
+            }
+            IOBINARY(ptr, WriteBinary, sizeof(std::uint64_t) * p_num, (char*)p_translateMap.get());
+            return ErrorCode::Success;
+        }
+
+        // Drops the postings of the head ids a compaction cut off, once no search holds a head index that had them.
+        // Heads created since then took the lowest of those ids over, so only the ids above the head count go.
+        // Callers hold m_headRenumberLock and m_headCompactLock exclusively.
+        template <typename T>
+        void Index<T>::DropRetiredHeadPostings()
+        {
+            if (m_retiredHeadIndexes.empty()) return;
+            for (const auto& retired : m_retiredHeadIndexes) {
+                if (!retired.expired()) return;
+            }
+            for (SizeType i = m_index->GetNumSamples(); i < m_retiredHeadEnd; i++) {
+                m_extraSearcher->DeleteIndex(i);
+            }
+            m_retiredHeadIndexes.clear();
+            m_retiredHeadEnd = 0;
+        }
+
+        // Drops the deleted heads of a live KV index by moving heads from the tail onto the deleted slots.
+        // The tail postings are dropped once searches let go of the old head index. If it is still held after
+        // HeadCompactWaitMs, they are left to a later compaction or reorder.
+        template <typename T>
+        ErrorCode Index<T>::CompactHeadIndex()
+        {
+            if (!m_options.m_useKV || m_extraSearcher == nullptr) {
+                LOG(Helper::LogLevel::LL_Error, "Head compaction only supports KV postings\n");
+                return ErrorCode::Fail;
+            }
+
+            auto compactBegin = std::chrono::high_resolution_clock::now();
+            std::lock_guard<std::mutex> renumberLock(m_headRenumberLock);
+            std::unique_lock<std::shared_timed_mutex> compactLock(m_headCompactLock, std::defer_lock);
+            LockForHeadRenumbering(compactLock);
+            DropRetiredHeadPostings();
+
+            std::shared_ptr<VectorIndex> oldIndex = m_index;
+            std::shared_ptr<VectorIndex> newIndex;
+            std::vector<SizeType> indices;
+            ErrorCode ret;
+            if ((ret = oldIndex->CompactIndex(newIndex, indices)) != ErrorCode::Success) {
+                LOG(Helper::LogLevel::LL_Error, "Compact head index failed!\n");
+                return ret;
+            }
+            SizeType oldNum = oldIndex->GetNumSamples();
+            SizeType newNum = (SizeType)indices.size();
+
+            std::shared_ptr<std::uint64_t> translateMap;
+            if ((ret = RemapHeadIDs(indices, translateMap)) != ErrorCode::Success) return ret;
+
+            // Heads from the tail are only moved onto deleted slots, so the postings
+            // of live heads are never overwritten while searches are still running.
+            std::atomic<SizeType> failed(0);
+#pragma omp parallel for num_threads(m_options.m_iSSDNumberOfThreads) schedule(dynamic)
+            for (SizeType i = 0; i < newNum; i++) {
+                if (indices[i] == i) continue;
+                std::string postingList;
+                if (m_extraSearcher->SearchIndex(indices[i], postingList) != ErrorCode::Success ||
+                    m_extraSearcher->OverrideIndex(i, postingList) != ErrorCode::Success) {
+                    LOG(Helper::LogLevel::LL_Error, "Fail to move posting %d to %d\n", indices[i], i);
+                    ++failed;
+                }
+            }
+            // only deleted slots were written, the old numbering is still complete
+            if (failed.load() > 0) {
+                LOG(Helper::LogLevel::LL_Error, "Compact head index aborted, %d postings failed to move.\n", failed.load());
+                return ErrorCode::Fail;
+            }
+            if ((ret = SaveHeadIDs(translateMap, newNum)) != ErrorCode::Success) {
+                if (SaveHeadIDs(m_vectorTranslateMap, m_vectorTranslateMapSize) != ErrorCode::Success) {
+                    LOG(Helper::LogLevel::LL_Error, "Fail to restore the head ID file\n");
+                }
+                LOG(Helper::LogLevel::LL_Error, "Compact head index aborted, the head ID file could not be written.\n");
+                return ret;
+            }
+
+            for (SizeType i = 0; i < newNum; i++) {
+                if (indices[i] != i) m_postingSizes.UpdateSize(i, m_postingSizes.GetSize(indices[i]));
+            }
+            m_postingSizes.SetR(newNum);
+            PublishHeadIndex(newIndex, translateMap, newNum);
+
+            // Searches may still read the tail postings through the old head index. Updates go on meanwhile;
+            // heads they create take the tail ids over, so only the ids above them are dropped afterwards.
+            m_retiredHeadIndexes.emplace_back(oldIndex);
+            m_retiredHeadEnd = max(m_retiredHeadEnd, oldNum);
+            oldIndex.reset();
+            compactLock.unlock();
+            auto waitBegin = std::chrono::steady_clock::now();
+            while (!m_retiredHeadIndexes.back().expired() &&
+                std::chrono::steady_clock::now() - waitBegin < std::chrono::milliseconds(m_options.m_headCompactWaitMs)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            compactLock.lock();
+            DropRetiredHeadPostings();
+            if (!m_retiredHeadIndexes.empty()) {
+                LOG(Helper::LogLevel::LL_Warning, "The old head index is still held after %d ms, postings of heads %d to %d are dropped later.\n",
+                    m_options.m_headCompactWaitMs, m_index->GetNumSamples(), m_retiredHeadEnd);
+            }
+            compactLock.unlock();
+
+            auto compactEnd = std::chrono::high_resolution_clock::now();
+            LOG(Helper::LogLevel::LL_Info, "Compact head index from %d to %d heads, cost: %.3lf s\n", oldNum, newNum,
+                ((double)std::chrono::duration_cast<std::chrono::milliseconds>(compactEnd - compactBegin).count()) / 1000);
+            return ErrorCode::Success;
+        }
+
+        // Moves the postings of one cycle of a head permutation: cycle[k] takes the posting of cycle[k + p_shift].
+        // The whole cycle is read first, so a failed write puts the postings read back and leaves the cycle as it was.
+        template <typename T>
+        bool Index<T>::ShiftPostingCycle(const std::vector<SizeType>& p_cycle, size_t p_shift)
+        {
+            size_t len = p_cycle.size();
+            std::vector<std::string> postings(len);
+            // deleted heads may have no posting at all
+            for (size_t k = 0; k < len; k++) {
+                if (m_extraSearcher->SearchIndex(p_cycle[k], postings[k]) != ErrorCode::Success) postings[k].clear();
+            }
+
+            auto write = [this](SizeType p_head, const std::string& p_posting) {
+                return p_posting.empty() ? m_extraSearcher->DeleteIndex(p_head) : m_extraSearcher->OverrideIndex(p_head, p_posting);
+            };
+            for (size_t k = 0; k < len; k++) {
+                size_t from = (k + p_shift) % len;
+                if (write(p_cycle[k], postings[from]) != ErrorCode::Success) {
+                    LOG(Helper::LogLevel::LL_Error, "Fail to move posting %d to %d\n", p_cycle[from], p_cycle[k]);
+                    for (size_t r = 0; r <= k; r++) {
+                        if (write(p_cycle[r], postings[r]) != ErrorCode::Success) {
+                            LOG(Helper::LogLevel::LL_Error, "Fail to restore posting %d\n", p_cycle[r]);
+                        }
+                    }
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Renumbers the heads of a live KV index in the order of the head BKTree. Postings are moved along
+        // the cycles of the permutation, and the new numbering is only published once every cycle moved;
+        // otherwise the moved cycles are moved back. Postings move in place, so the call is refused while
+        // a search is in flight, and searches and updates that start meanwhile wait until it is done.
+        template <typename T>
+        ErrorCode Index<T>::ReorderHeadIndex()
+        {
+            if (!m_options.m_useKV || m_extraSearcher == nullptr) {
+                LOG(Helper::LogLevel::LL_Error, "Online head reordering only supports KV postings\n");
+                return ErrorCode::Fail;
+            }
+
+            auto reorderBegin = std::chrono::high_resolution_clock::now();
+            std::lock_guard<std::mutex> renumberLock(m_headRenumberLock);
+            std::unique_lock<std::shared_timed_mutex> compactLock(m_headCompactLock, std::defer_lock);
+            LockForHeadRenumbering(compactLock);
+            std::unique_lock<std::shared_timed_mutex> searchGate(m_searchGateLock);
+            if (m_searchesInFlight.load() > 0) {
+                LOG(Helper::LogLevel::LL_Error, "Reorder head index refused, %d searches are in flight.\n", m_searchesInFlight.load());
+                return ErrorCode::Fail;
+            }
+            DropRetiredHeadPostings();
+
+            std::shared_ptr<VectorIndex> newIndex;
+            std::vector<SizeType> indices;
+            ErrorCode ret;
+            if ((ret = m_index->ReorderIndex(newIndex, indices)) != ErrorCode::Success) {
+                LOG(Helper::LogLevel::LL_Error, "Reorder head index failed!\n");
+                return ret;
+            }
+            SizeType num = (SizeType)indices.size();
+
+            // the new head i is the old head indices[i], so walking j = indices[j] lists a cycle in move order
+            std::vector<std::vector<SizeType>> cycles;
+            std::vector<bool> visited(num, false);
+            for (SizeType i = 0; i < num; i++) {
+                if (visited[i] || indices[i] == i) continue;
+                cycles.emplace_back();
+                for (SizeType j = i; !visited[j]; j = indices[j]) {
+                    visited[j] = true;
+                    cycles.back().push_back(j);
+                }
+            }
+
+            std::vector<char> moved(cycles.size(), 0);
+            std::atomic<SizeType> failed(0);
+#pragma omp parallel for num_threads(m_options.m_iSSDNumberOfThreads) schedule(dynamic)
+            for (int c = 0; c < (int)cycles.size(); c++) {
+                if (failed.load() > 0) continue;
+                if (ShiftPostingCycle(cycles[c], 1)) moved[c] = 1;
+                else ++failed;
+            }
+
+            std::shared_ptr<std::uint64_t> translateMap;
+            if (failed.load() == 0 && (ret = RemapHeadIDs(indices, translateMap)) != ErrorCode::Success) ++failed;
+            if (failed.load() == 0 && (ret = SaveHeadIDs(translateMap, num)) != ErrorCode::Success) {
+                if (SaveHeadIDs(m_vectorTranslateMap, m_vectorTranslateMapSize) != ErrorCode::Success) {
+                    LOG(Helper::LogLevel::LL_Error, "Fail to restore the head ID file\n");
+                }
+                ++failed;
+            }
+            if (failed.load() > 0) {
+#pragma omp parallel for num_threads(m_options.m_iSSDNumberOfThreads) schedule(dynamic)
+                for (int c = 0; c < (int)cycles.size(); c++) {
+                    if (moved[c] && !ShiftPostingCycle(cycles[c], cycles[c].size() - 1)) {
+                        LOG(Helper::LogLevel::LL_Error, "Fail to move the postings of head %d back\n", cycles[c][0]);
+                    }
+                }
+                LOG(Helper::LogLevel::LL_Error, "Reorder head index aborted, postings failed to move.\n");
+                return ErrorCode::Fail;
+            }
+
+            // posting sizes are only read by updates, which the compact lock keeps out
+            std::vector<int> sizes(num);
+            for (SizeType i = 0; i < num; i++) sizes[i] = m_postingSizes.GetSize(indices[i]);
+            for (SizeType i = 0; i < num; i++) m_postingSizes.UpdateSize(i, sizes[i]);
+
+            PublishHeadIndex(newIndex, translateMap, num);
+            m_reorderedHeadNum = num;
+
+            auto reorderEnd = std::chrono::high_resolution_clock::now();
+            size_t movedNum = 0;
+            for (const auto& cycle : cycles) movedNum += cycle.size();
+            LOG(Helper::LogLevel::LL_Info, "Reorder %d heads, %zu postings moved, cost: %.3lf s\n", num, movedNum,
+                ((double)std::chrono::duration_cast<std::chrono::milliseconds>(reorderEnd - reorderBegin).count()) / 1000);
+            return ErrorCode::Success;
+        }
+
         template <typename T>
         void SPTAG::SPANN::Index<T>::Dispatcher::dispatch()
         {
@@ -952,7 +1795,12 @@ namespace SPTAG
         ErrorCode SPTAG::SPANN::Index<ValueType>::Split(const SizeType headID)
         {
             auto splitBegin = std::chrono::high_resolution_clock::now();
+            std::shared_lock<std::shared_timed_mutex> compactLock(m_headCompactLock);
             std::unique_lock<std::shared_timed_mutex> lock(m_rwLocks[headID]);
+            // the job may have been queued before a head compaction moved this id
+            if (!m_index->ContainSample(headID)) {
+                return ErrorCode::FailSplit;
+            }
             // if (m_postingSizes.GetSize(headID) + appendNum < m_extraSearcher->GetPostingSizeLimit()) {
             //     return ErrorCode::FailSplit;
             // }
@@ -1015,7 +1863,7 @@ namespace SPTAG
                 m_garbageNum++;
                 auto GCEnd = std::chrono::high_resolution_clock::now();
                 double elapsedMSeconds = std::chrono::duration_cast<std::chrono::microseconds>(GCEnd - splitBegin).count();
-                m_garbageCost += elapsedMSeconds;
+                m_metrics->m_garbageCollect.Record((std::uint64_t)elapsedMSeconds);
                 return ErrorCode::Success;
             }
             //LOG(Helper::LogLevel::LL_Info, "Resize\n");
@@ -1032,7 +1880,7 @@ namespace SPTAG
 
             auto clusterEnd = std::chrono::high_resolution_clock::now();
             double elapsedMSeconds = std::chrono::duration_cast<std::chrono::microseconds>(clusterEnd - clusterBegin).count();
-            m_clusteringCost += elapsedMSeconds;
+            m_metrics->m_splitClustering.Record((std::uint64_t)elapsedMSeconds);
             // int numClusters = ClusteringSPFresh(smallSample, localIndices, 0, localIndices.size(), args, 10, false, m_options.m_virtualHead);
             // exit(0);
             if (numClusters <= 1)
@@ -1058,14 +1906,50 @@ namespace SPTAG
             int first = 0;
             std::vector<SizeType> newHeadsID;
             std::vector<std::string> newPostingLists;
-            bool theSameHead = false;
+            std::vector<SizeType> pendingHeads;
+
+            // Settle which centers become new heads and reserve their ids before any posting is written,
+            // so a failure leaves the head index and the postings as they were.
+            int sameHeadK = -1;
+            for (int k = 0; k < 2; k++) {
+                if (args.counts[k] == 0) continue;
+                if (m_index->ComputeDistance(args.centers + k * args._D, m_index->GetSample(headID)) < Epsilon) {
+                    sameHeadK = k;
+                    break;
+                }
+            }
+            bool theSameHead = (sameHeadK >= 0);
+            SizeType newHeadIDs[2] = { -1, -1 };
+            {
+                int newHeads = 0;
+                for (int k = 0; k < 2; k++) if (args.counts[k] > 0 && k != sameHeadK) newHeads++;
+                std::lock_guard<std::mutex> lock(m_dataAddLock);
+                auto ret = m_postingSizes.AddBatch(newHeads);
+                if (ret != ErrorCode::Success) {
+                    LOG(Helper::LogLevel::LL_Error, "MemoryOverFlow: split head %d, Map Size:%d\n", headID, m_postingSizes.BufferSize());
+                    return ret;
+                }
+            }
+            for (int k = 0; k < 2; k++) {
+                if (args.counts[k] == 0 || k == sameHeadK) continue;
+                int begin = 0, end = 0;
+                ErrorCode ret = m_index->AddIndexId(args.centers + k * args._D, 1, m_options.m_dim, begin, end);
+                if (ret != ErrorCode::Success) {
+                    LOG(Helper::LogLevel::LL_Error, "Split fail to add new head for %d\n", headID);
+                    for (int j = 0; j < k; j++) {
+                        if (newHeadIDs[j] >= 0) m_index->DeleteIndex(newHeadIDs[j]);
+                    }
+                    return ret;
+                }
+                newHeadIDs[k] = begin;
+            }
+
             for (int k = 0; k < 2; k++) {
                 std::string postingList;
                 if (args.counts[k] == 0)	continue;
-                if (!theSameHead && m_index->ComputeDistance(args.centers + k * args._D, m_index->GetSample(headID)) < Epsilon) {
+                if (k == sameHeadK) {
                     newHeadsID.push_back(headID);
                     newHeadVID = headID;
-                    theSameHead = true;
                     for (int j = 0; j < args.counts[k]; j++)
                     {
 
@@ -1081,10 +1965,8 @@ namespace SPTAG
                     m_theSameHeadNum++;
                 }
                 else {
-                    int begin, end = 0;
-                    m_index->AddIndexId(args.centers + k * args._D, 1, m_options.m_dim, begin, end);
-                    newHeadVID = begin;
-                    newHeadsID.push_back(begin);
+                    newHeadVID = newHeadIDs[k];
+                    newHeadsID.push_back(newHeadIDs[k]);
                     for (int j = 0; j < args.counts[k]; j++)
                     {
                         // float dist = m_index->ComputeDistance(smallSample[args.clusterIdx[k]], smallSample[localIndices[first + j]]);
@@ -1097,32 +1979,29 @@ namespace SPTAG
                         LOG(Helper::LogLevel::LL_Info, "Fail to add new postings\n");
                         exit(0);
                     }
-
-                    auto updateHeadBegin = std::chrono::high_resolution_clock::now();
-                    m_index->AddIndexIdx(begin, end);
-                    auto updateHeadEnd = std::chrono::high_resolution_clock::now();
-                    elapsedMSeconds = std::chrono::duration_cast<std::chrono::milliseconds>(updateHeadEnd - updateHeadBegin).count();
-                    m_updateHeadCost += elapsedMSeconds;
+                    pendingHeads.push_back(newHeadIDs[k]);
                 }
                 newPostingLists.push_back(postingList);
                 // LOG(Helper::LogLevel::LL_Info, "Head id: %d split into : %d, length: %d\n", headID, newHeadVID, args.counts[k]);
                 first += args.counts[k];
-                {
-                    std::lock_guard<std::mutex> lock(m_dataAddLock);
-                    auto ret = m_postingSizes.AddBatch(1);
-                    if (ret == ErrorCode::MemoryOverFlow) {
-                        LOG(Helper::LogLevel::LL_Info, "MemoryOverFlow: NnewHeadVID: %d, Map Size:%d\n", newHeadVID, m_postingSizes.BufferSize());
-                        exit(1);
-                    }
-                }
                 m_postingSizes.UpdateSize(newHeadVID, args.counts[k]);
             }
+            if (!pendingHeads.empty()) {
+                auto updateHeadBegin = std::chrono::high_resolution_clock::now();
+                if (m_index->AddIndexIdxBatch(pendingHeads) != ErrorCode::Success) {
+                    LOG(Helper::LogLevel::LL_Error, "Split fail to link new heads of %d\n", headID);
+                }
+                auto updateHeadEnd = std::chrono::high_resolution_clock::now();
+                elapsedMSeconds = std::chrono::duration_cast<std::chrono::microseconds>(updateHeadEnd - updateHeadBegin).count();
+                m_metrics->m_splitUpdateHead.Record((std::uint64_t)elapsedMSeconds);
+            }
             if (!theSameHead) {
                 m_index->DeleteIndex(headID);
                 m_postingSizes.UpdateSize(headID, 0);
             }
             lock.unlock();
             int split_order = ++m_splitNum;
+            m_metrics->m_splits++;
             // if (theSameHead) LOG(Helper::LogLevel::LL_Info, "The Same Head\n");
             // LOG(Helper::LogLevel::LL_Info, "head1:%d, head2:%d\n", newHeadsID[0], newHeadsID[1]);
 
@@ -1133,9 +2012,9 @@ namespace SPTAG
             if (!m_options.m_disableReassign) ReAssign(headID, newPostingLists, newHeadsID);
 
             auto reassignScanEnd = std::chrono::high_resolution_clock::now();
-            elapsedMSeconds = std::chrono::duration_cast<std::chrono::milliseconds>(reassignScanEnd - reassignScanBegin).count();
+            elapsedMSeconds = std::chrono::duration_cast<std::chrono::microseconds>(reassignScanEnd - reassignScanBegin).count();
 
-            m_reassignScanCost += elapsedMSeconds;
+            m_metrics->m_splitReassignScan.Record((std::uint64_t)elapsedMSeconds);
             
             // while (!ReassignFinished())
             // {
@@ -1147,8 +2026,8 @@ namespace SPTAG
 
             // QuantifySplit(headID, newPostingLists, newHeadsID, headID, split_order);
             auto splitEnd = std::chrono::high_resolution_clock::now();
-            elapsedMSeconds = std::chrono::duration_cast<std::chrono::milliseconds>(splitEnd - splitBegin).count();
-            m_splitCost += elapsedMSeconds;
+            elapsedMSeconds = std::chrono::duration_cast<std::chrono::microseconds>(splitEnd - splitBegin).count();
+            m_metrics->m_split.Record((std::uint64_t)elapsedMSeconds);
             return ErrorCode::Success;
         }
 
@@ -1184,9 +2063,9 @@ namespace SPTAG
                     exit(0);
                 }
                 auto reassignScanIOEnd = std::chrono::high_resolution_clock::now();
-                auto elapsedMSeconds = std::chrono::duration_cast<std::chrono::milliseconds>(reassignScanIOEnd - reassignScanIOBegin).count();
+                auto elapsedMSeconds = std::chrono::duration_cast<std::chrono::microseconds>(reassignScanIOEnd - reassignScanIOBegin).count();
 
-                m_reassignScanIOCost += elapsedMSeconds;
+                m_metrics->m_splitReassignScanIO.Record((std::uint64_t)elapsedMSeconds);
                 for (int i = 0; i < HeadPrevTopK.size(); i++) {
                     postingLists.push_back(tempPostingLists[i]);
                 }
@@ -1267,6 +2146,7 @@ namespace SPTAG
                 (const std::shared_ptr<std::string>& vectorContain, SizeType VID, SizeType HeadPrev, uint8_t version)
         {
             m_reAssignNum++;
+            m_metrics->m_reassigns++;
 
             bool isNeedReassign = true;
             auto selectBegin = std::chrono::high_resolution_clock::now();
@@ -1275,43 +2155,17 @@ namespace SPTAG
             p_queryResults.Reset();
             m_index->SearchIndex(p_queryResults);
 
-            int replicaCount = 0;
-            BasicResult* queryResults = p_queryResults.GetResults();
-            std::vector<EdgeInsert> selections(static_cast<size_t>(m_options.m_replicaCount));
-
-            int i;
-            for (i = 0; i < p_queryResults.GetResultNum() && replicaCount < m_options.m_replicaCount; ++i) {
-                if (queryResults[i].VID == -1) {
-                    break;
-                }
-                // RNG Check.
-                bool rngAccpeted = true;
-                for (int j = 0; j < replicaCount; ++j) {
-                    float nnDist = m_index->ComputeDistance(
-                            m_index->GetSample(queryResults[i].VID),
-                            m_index->GetSample(selections[j].headID));
-                    if (m_options.m_rngFactor * nnDist <= queryResults[i].Dist) {
-                        rngAccpeted = false;
-                        break;
-                    }
-                }
-                if (!rngAccpeted)
-                    continue;
-
-                selections[replicaCount].headID = queryResults[i].VID;
-
-                selections[replicaCount].fullID = VID;
-                selections[replicaCount].distance = queryResults[i].Dist;
-                selections[replicaCount].order = (char)replicaCount;
-                if (selections[replicaCount].headID == HeadPrev) {
+            COMMON::ReplicaSelector selector;
+            int replicaCount = selector.Select(m_index.get(), p_queryResults.GetResults(), p_queryResults.GetResultNum(), m_options.m_replicaCount, m_options.m_rngFactor);
+            for (int i = 0; i < replicaCount; ++i) {
+                if (selector[i].VID == HeadPrev) {
                     isNeedReassign = false;
                     break;
                 }
-                ++replicaCount;
             }
             auto selectEnd = std::chrono::high_resolution_clock::now();
             auto elapsedMSeconds = std::chrono::duration_cast<std::chrono::microseconds>(selectEnd - selectBegin).count();
-            m_selectCost += elapsedMSeconds;
+            m_metrics->m_reassignSelect.Record((std::uint64_t)elapsedMSeconds);
 
             if (isNeedReassign && CheckVersionValid(VID, version)) {
                 // LOG(Helper::LogLevel::LL_Info, "Update Version: VID: %d, version: %d, current version: %d\n", VID, version, m_versionMap.GetVersion(VID));
@@ -1322,13 +2176,13 @@ namespace SPTAG
 
             //LOG(Helper::LogLevel::LL_Info, "Reassign: oldVID:%d, replicaCount:%d, candidateNum:%d, dist0:%f\n", oldVID, replicaCount, i, selections[0].distance);
             auto reassignAppendBegin = std::chrono::high_resolution_clock::now();
-            for (i = 0; isNeedReassign && i < replicaCount && CheckVersionValid(VID, version); i++) {
+            for (int i = 0; isNeedReassign && i < replicaCount && CheckVersionValid(VID, version); i++) {
                 std::string newPart;
                 newPart += Helper::Convert::Serialize<int>(&VID, 1);
                 newPart += Helper::Convert::Serialize<uint8_t>(&version, 1);
                 // newPart += Helper::Convert::Serialize<float>(&selections[i].distance, 1);
                 newPart += Helper::Convert::Serialize<ValueType>(p_queryResults.GetTarget(), m_options.m_dim);
-                auto headID = selections[i].headID;
+                auto headID = selector[i].VID;
                 //LOG(Helper::LogLevel::LL_Info, "Reassign: headID :%d, oldVID:%d, newVID:%d, posting length: %d, dist: %f, string size: %d\n", headID, oldVID, VID, m_postingSizes[headID].load(), selections[i].distance, newPart.size());
                 if (ErrorCode::Undefined == Append(headID, -1, newPart)) {
                     // LOG(Helper::LogLevel::LL_Info, "Head Miss: VID: %d, current version: %d, another re-assign\n", VID, version);
@@ -1337,7 +2191,7 @@ namespace SPTAG
             }
             auto reassignAppendEnd = std::chrono::high_resolution_clock::now();
             elapsedMSeconds = std::chrono::duration_cast<std::chrono::microseconds>(reassignAppendEnd - reassignAppendBegin).count();
-            m_reAssignAppendCost += elapsedMSeconds;
+            m_metrics->m_reassignAppend.Record((std::uint64_t)elapsedMSeconds);
 
             return isNeedReassign;
         }
@@ -1370,6 +2224,7 @@ namespace SPTAG
                     if (CheckVersionValid(*(int*)(&appendPosting[idx]), version)) {
                         // LOG(Helper::LogLevel::LL_Info, "Head Miss To ReAssign: VID: %d, current version: %d\n", *(int*)(&appendPosting[idx]), version);
                         m_headMiss++;
+                        m_metrics->m_headMisses++;
                         ReassignAsync(vectorContain, *(int*)(&appendPosting[idx]), headID, version);
                     }
                     // LOG(Helper::LogLevel::LL_Info, "Head Miss Do Not To ReAssign: VID: %d, version: %d, current version: %d\n", *(int*)(&appendPosting[idx]), m_versionMap.GetVersion(*(int*)(&appendPosting[idx])), version);
@@ -1406,7 +2261,7 @@ namespace SPTAG
                 }
                 auto appendIOEnd = std::chrono::high_resolution_clock::now();
                 double elapsedMSeconds = std::chrono::duration_cast<std::chrono::microseconds>(appendIOEnd - appendIOBegin).count();
-                if (!reassignThreshold) m_appendIOCost += elapsedMSeconds;
+                if (!reassignThreshold) m_metrics->m_appendIO.Record((std::uint64_t)elapsedMSeconds);
                 m_postingSizes.IncSize(headID, appendNum);
             }
             if (m_postingSizes.GetSize(headID) + appendNum > (m_extraSearcher->GetPostingSizeLimit() + reassignThreshold)) {
@@ -1415,7 +2270,7 @@ namespace SPTAG
             // }
             auto appendEnd = std::chrono::high_resolution_clock::now();
             double elapsedMSeconds = std::chrono::duration_cast<std::chrono::microseconds>(appendEnd - appendBegin).count();
-            if (!reassignThreshold) m_appendCost += elapsedMSeconds;
+            if (!reassignThreshold) m_metrics->m_append.Record((std::uint64_t)elapsedMSeconds);
             return ErrorCode::Success;
         }
 
@@ -1423,6 +2278,7 @@ namespace SPTAG
         void SPTAG::SPANN::Index<T>::ProcessAsyncReassign(std::shared_ptr<std::string> vectorContain, SizeType VID, SizeType HeadPrev, uint8_t version, std::function<void()> p_callback)
         {
             // return;
+            std::shared_lock<std::shared_timed_mutex> compactLock(m_headCompactLock);
             if (m_versionMap.Contains(VID) || !CheckVersionValid(VID, version)) {
                 // LOG(Helper::LogLevel::LL_Info, "ReassignID: %d, version: %d, current version: %d\n", VID, version, m_versionMap.GetVersion(VID));
                 return;
@@ -1441,7 +2297,7 @@ namespace SPTAG
 
             auto reassignEnd = std::chrono::high_resolution_clock::now();
             double elapsedMSeconds = std::chrono::duration_cast<std::chrono::microseconds>(reassignEnd - reassignBegin).count();
-            m_reAssignCost += elapsedMSeconds;
+            m_metrics->m_reassign.Record((std::uint64_t)elapsedMSeconds);
             //     m_reassignMap.erase(VID);
 
             if (p_callback != nullptr) {
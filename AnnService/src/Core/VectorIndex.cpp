@@ -6,6 +6,7 @@
 #include "inc/Helper/StringConvert.h"
 #include "inc/Helper/SimpleIniReader.h"
 #include "inc/Helper/ConcurrentSet.h"
+#include "inc/Core/Common/ReplicaSelector.h"
 
 #include "inc/Core/BKT/Index.h"
 #include "inc/Core/KDT/Index.h"
@@ -430,6 +431,20 @@ VectorIndex::SearchIndex(const void* p_vector, int p_vectorCount, int p_neighbor
 }
 
 
+ErrorCode
+VectorIndex::SearchIndexAsync(QueryResult& p_results, std::function<void(ErrorCode)> p_callback, bool p_searchDeleted) const {
+    ErrorCode ret = SearchIndex(p_results, p_searchDeleted);
+    if (p_callback) p_callback(ret);
+    return ErrorCode::Success;
+}
+
+
+ErrorCode
+VectorIndex::SearchIndexWithProgress(QueryResult& p_results, int p_interval, const std::function<void(QueryResult&)>& p_progress, bool p_searchDeleted) const {
+    return SearchIndex(p_results, p_searchDeleted);
+}
+
+
 ErrorCode 
 VectorIndex::AddIndex(std::shared_ptr<VectorSet> p_vectorSet, std::shared_ptr<MetadataSet> p_metadataSet, bool p_withMetaIndex, bool p_normalized) {
     if (nullptr == p_vectorSet || p_vectorSet->GetValueType() != GetVectorValueType())
@@ -807,7 +822,7 @@ void VectorIndex::SortSelections(std::vector<Edge>* selections) {
 
 
 
-void VectorIndex::ApproximateRNG(std::shared_ptr<VectorSet>& fullVectors, std::unordered_set<SizeType>& exceptIDS, int candidateNum, Edge* selections, int replicaCount, int numThreads, int numTrees, int leafSize, float RNGFactor, int numGPUs)
+void VectorIndex::ApproximateRNG(std::shared_ptr<VectorSet>& fullVectors, std::unordered_set<SizeType>& exceptIDS, int candidateNum, Edge* selections, int replicaCount, int numThreads, int numTrees, int leafSize, float RNGFactor, int numGPUs, int pairCacheSize)
 {
 
     LOG(Helper::LogLevel::LL_Info, "Starting GPU SSD Index build stage...\n");
@@ -856,10 +871,28 @@ void VectorIndex::ApproximateRNG(std::shared_ptr<VectorSet>& fullVectors, std::u
 
 void VectorIndex::SortSelections(std::vector<Edge>* selections) {
     EdgeCompare edgeComparer;
-    std::sort(selections->begin(), selections->end(), edgeComparer);
+    size_t total = selections->size();
+    int chunks = omp_get_max_threads();
+    if (chunks <= 1 || total < ((size_t)chunks << 16)) {
+        std::sort(selections->begin(), selections->end(), edgeComparer);
+        return;
+    }
+
+    std::vector<size_t> bounds(chunks + 1);
+    for (int i = 0; i <= chunks; i++) bounds[i] = total * i / chunks;
+    auto base = selections->begin();
+#pragma omp parallel for schedule(static,1)
+    for (int i = 0; i < chunks; i++) std::sort(base + bounds[i], base + bounds[i + 1], edgeComparer);
+
+    for (int step = 1; step < chunks; step <<= 1) {
+#pragma omp parallel for schedule(dynamic,1)
+        for (int i = 0; i < chunks - step; i += (step << 1)) {
+            std::inplace_merge(base + bounds[i], base + bounds[i + step], base + bounds[min(i + (step << 1), chunks)], edgeComparer);
+        }
+    }
 }
 
-void VectorIndex::ApproximateRNG(std::shared_ptr<VectorSet>& fullVectors, std::unordered_set<SizeType>& exceptIDS, int candidateNum, Edge* selections, int replicaCount, int numThreads, int numTrees, int leafSize, float RNGFactor, int numGPUs)
+void VectorIndex::ApproximateRNG(std::shared_ptr<VectorSet>& fullVectors, std::unordered_set<SizeType>& exceptIDS, int candidateNum, Edge* selections, int replicaCount, int numThreads, int numTrees, int leafSize, float RNGFactor, int numGPUs, int pairCacheSize)
 {
     std::vector<std::thread> threads;
     threads.reserve(numThreads);
@@ -872,8 +905,7 @@ void VectorIndex::ApproximateRNG(std::shared_ptr<VectorSet>& fullVectors, std::u
         threads.emplace_back([&, tid]()
             {
                 QueryResult resultSet(NULL, candidateNum, false);
-
-                size_t rngFailedCount = 0;
+                COMMON::ReplicaSelector selector(pairCacheSize);
 
                 while (true)
                 {
@@ -905,37 +937,11 @@ void VectorIndex::ApproximateRNG(std::shared_ptr<VectorSet>& fullVectors, std::u
 
                     size_t selectionOffset = static_cast<size_t>(fullID)* replicaCount;
 
-                    BasicResult* queryResults = resultSet.GetResults();
-                    int currReplicaCount = 0;
-                    for (int i = 0; i < candidateNum && currReplicaCount < replicaCount; ++i)
+                    int currReplicaCount = selector.Select(this, resultSet.GetResults(), candidateNum, replicaCount, RNGFactor);
+                    for (int i = 0; i < currReplicaCount; ++i)
                     {
-                        if (queryResults[i].VID == -1)
-                        {
-                            break;
-                        }
-
-                        // RNG Check.
-                        bool rngAccpeted = true;
-                        for (int j = 0; j < currReplicaCount; ++j)
-                        {
-                            float nnDist = ComputeDistance(GetSample(queryResults[i].VID), GetSample(selections[selectionOffset+j].node));
-
-                            if (RNGFactor * nnDist <= queryResults[i].Dist)
-                            {
-                                rngAccpeted = false;
-                                break;
-                            }
-                        }
-
-                        if (!rngAccpeted)
-                        {
-                            ++rngFailedCount;
-                            continue;
-                        }
-
-                        selections[selectionOffset + currReplicaCount].node = queryResults[i].VID;
-                        selections[selectionOffset + currReplicaCount].distance = queryResults[i].Dist;
-                        ++currReplicaCount;
+                        selections[selectionOffset + i].node = selector[i].VID;
+                        selections[selectionOffset + i].distance = selector[i].Dist;
                     }
 
                     if (reconstructed_vector)
@@ -943,7 +949,7 @@ void VectorIndex::ApproximateRNG(std::shared_ptr<VectorSet>& fullVectors, std::u
                         _mm_free(reconstructed_vector);
                     }
                 }
-                rngFailedCountTotal += rngFailedCount;
+                rngFailedCountTotal += selector.Rejected();
             });
     }
 
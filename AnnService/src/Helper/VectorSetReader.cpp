@@ -54,3 +54,89 @@ VectorSetReader::CreateInstance(std::shared_ptr<ReaderOptions> p_options)
 }
 
 
+
+
+SizeType
+VectorSetReader::GetVectorCount() const
+{
+    return GetVectorSet()->Count();
+}
+
+
+std::shared_ptr<VectorSet>
+VectorSetReader::GetVectorSubset(const std::vector<SizeType>& p_ids) const
+{
+    if (p_ids.empty()) return std::shared_ptr<VectorSet>(new BasicVectorSet(ByteArray(), m_options->m_inputValueType, m_options->m_dimension, 0));
+
+    auto span = GetVectorSet(p_ids.front(), p_ids.back() + 1);
+    std::uint64_t vectorSize = span->PerVectorDataSize();
+    ByteArray vectorSet = ByteArray::Alloc(vectorSize * p_ids.size());
+    for (size_t i = 0; i < p_ids.size(); i++) {
+        std::memcpy(vectorSet.Data() + vectorSize * i, span->GetVector(p_ids[i] - p_ids.front()), vectorSize);
+    }
+    return std::shared_ptr<VectorSet>(new BasicVectorSet(vectorSet, m_options->m_inputValueType, span->Dimension(), (SizeType)p_ids.size()));
+}
+
+
+SizeType
+VectorSetReader::ReadVectorCount(const std::string& p_vectorFile)
+{
+    auto ptr = f_createIO();
+    SizeType row;
+    if (ptr == nullptr || !ptr->Initialize(p_vectorFile.c_str(), std::ios::binary | std::ios::in) ||
+        ptr->ReadBinary(sizeof(SizeType), (char*)&row) != sizeof(SizeType)) {
+        LOG(Helper::LogLevel::LL_Error, "Failed to read file %s.\n", p_vectorFile.c_str());
+        exit(1);
+    }
+    return row;
+}
+
+
+std::shared_ptr<VectorSet>
+VectorSetReader::ReadVectorSubset(const std::string& p_vectorFile, const std::vector<SizeType>& p_ids) const
+{
+    auto ptr = f_createIO();
+    if (ptr == nullptr || !ptr->Initialize(p_vectorFile.c_str(), std::ios::binary | std::ios::in)) {
+        LOG(Helper::LogLevel::LL_Error, "Failed to read file %s.\n", p_vectorFile.c_str());
+        exit(1);
+    }
+
+    SizeType row;
+    DimensionType col;
+    if (ptr->ReadBinary(sizeof(SizeType), (char*)&row) != sizeof(SizeType) ||
+        ptr->ReadBinary(sizeof(DimensionType), (char*)&col) != sizeof(DimensionType)) {
+        LOG(Helper::LogLevel::LL_Error, "Failed to read VectorSet!\n");
+        exit(1);
+    }
+
+    std::uint64_t vectorSize = ((std::uint64_t)GetValueTypeSize(m_options->m_inputValueType)) * col;
+    std::uint64_t headerSize = sizeof(SizeType) + sizeof(DimensionType);
+    ByteArray vectorSet;
+    if (!p_ids.empty() && vectorSize > 0) vectorSet = ByteArray::Alloc(vectorSize * p_ids.size());
+
+    // Neighbouring ids are read in one request: gaps under 64KB are cheaper to read through than to seek over.
+    const std::uint64_t maxGap = max((std::uint64_t)1, (std::uint64_t)(1 << 16) / max(vectorSize, (std::uint64_t)1));
+    const std::uint64_t maxSpan = max((std::uint64_t)1, (std::uint64_t)(1 << 24) / max(vectorSize, (std::uint64_t)1));
+    std::vector<char> buffer;
+    for (size_t i = 0; i < p_ids.size() && vectorSize > 0;) {
+        if (p_ids[i] < 0 || p_ids[i] >= row) {
+            LOG(Helper::LogLevel::LL_Error, "Vector id %d out of range %d in %s!\n", p_ids[i], row, p_vectorFile.c_str());
+            exit(1);
+        }
+
+        size_t j = i + 1;
+        while (j < p_ids.size() && p_ids[j] < row && (std::uint64_t)(p_ids[j] - p_ids[j - 1]) <= maxGap && (std::uint64_t)(p_ids[j] - p_ids[i]) < maxSpan) j++;
+
+        std::uint64_t readBytes = vectorSize * (p_ids[j - 1] - p_ids[i] + 1);
+        buffer.resize(readBytes);
+        if (ptr->ReadBinary(readBytes, buffer.data(), headerSize + vectorSize * p_ids[i]) != readBytes) {
+            LOG(Helper::LogLevel::LL_Error, "Failed to read VectorSet!\n");
+            exit(1);
+        }
+        for (size_t k = i; k < j; k++) {
+            std::memcpy(vectorSet.Data() + vectorSize * k, buffer.data() + vectorSize * (p_ids[k] - p_ids[i]), vectorSize);
+        }
+        i = j;
+    }
+    return std::shared_ptr<VectorSet>(new BasicVectorSet(vectorSet, m_options->m_inputValueType, col, (SizeType)p_ids.size()));
+}
@@ -81,3 +81,17 @@ DefaultVectorReader::GetMetadataSet() const
         return std::shared_ptr<MetadataSet>(new FileMetadataSet(m_metadataConentOutput, m_metadataIndexOutput));
     return nullptr;
 }
+
+
+SizeType
+DefaultVectorReader::GetVectorCount() const
+{
+    return ReadVectorCount(m_vectorOutput);
+}
+
+
+std::shared_ptr<VectorSet>
+DefaultVectorReader::GetVectorSubset(const std::vector<SizeType>& p_ids) const
+{
+    return ReadVectorSubset(m_vectorOutput, p_ids);
+}
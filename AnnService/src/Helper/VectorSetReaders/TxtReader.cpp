@@ -6,13 +6,14 @@
 #include "inc/Helper/CommonHelper.h"
 
 #include <omp.h>
+#include <atomic>
 
 using namespace SPTAG;
 using namespace SPTAG::Helper;
 
 TxtVectorReader::TxtVectorReader(std::shared_ptr<ReaderOptions> p_options)
     : VectorSetReader(std::move(p_options)),
-    m_subTaskBlocksize(0)
+    m_subTaskBlocksize(1 << 24)
 {
     omp_set_num_threads(m_options->m_threadNum);
 
@@ -54,58 +55,82 @@ ErrorCode
 TxtVectorReader::LoadFile(const std::string& p_filePaths)
 {
     const auto& files = GetFileSizes(p_filePaths);
-    std::vector<std::function<void()>> subWorks;
-    subWorks.reserve(files.size() * m_options->m_threadNum);
-
-    m_subTaskCount = 0;
-    for (const auto& fileInfo : files)
+    std::vector<std::pair<std::size_t, std::size_t>> blocks;
+    for (std::size_t i = 0; i < files.size(); ++i)
     {
-        if (fileInfo.second == (std::numeric_limits<std::size_t>::max)())
+        if (files[i].second == (std::numeric_limits<std::size_t>::max)())
         {
-            LOG(Helper::LogLevel::LL_Error, "File %s not exists or can't access.\n", fileInfo.first.c_str());
+            LOG(Helper::LogLevel::LL_Error, "File %s not exists or can't access.\n", files[i].first.c_str());
             exit(1);
         }
 
-        std::uint32_t fileTaskCount = 0;
-        std::size_t blockSize = m_subTaskBlocksize;
-        if (0 == blockSize)
-        {
-            fileTaskCount = m_options->m_threadNum;
-            blockSize = (fileInfo.second + fileTaskCount - 1) / fileTaskCount;
-        }
-        else
+        for (std::size_t offset = 0; offset < files[i].second; offset += m_subTaskBlocksize)
         {
-            fileTaskCount = static_cast<std::uint32_t>((fileInfo.second + blockSize - 1) / blockSize);
+            blocks.emplace_back(i, offset);
         }
+    }
 
-        for (std::uint32_t i = 0; i < fileTaskCount; ++i)
-        {
-            subWorks.emplace_back(std::bind(&TxtVectorReader::LoadFileInternal,
-                                            this,
-                                            fileInfo.first,
-                                            m_subTaskCount++,
-                                            i,
-                                            blockSize));
-        }
+    std::shared_ptr<Helper::DiskPriorityIO> output = f_createIO(), meta = f_createIO(), metaIndex = f_createIO();
+    if (output == nullptr || !output->Initialize(m_vectorOutput.c_str(), std::ios::binary | std::ios::out) ||
+        meta == nullptr || !meta->Initialize(m_metadataConentOutput.c_str(), std::ios::binary | std::ios::out) ||
+        metaIndex == nullptr || !metaIndex->Initialize(m_metadataIndexOutput.c_str(), std::ios::binary | std::ios::out))
+    {
+        LOG(Helper::LogLevel::LL_Error, "Unable to create files: %s %s %s\n", m_vectorOutput.c_str(), m_metadataConentOutput.c_str(), m_metadataIndexOutput.c_str());
+        exit(1);
     }
 
-    m_totalRecordCount = 0;
-    m_totalRecordVectorBytes = 0;
-    m_subTaskRecordCount.clear();
-    m_subTaskRecordCount.resize(m_subTaskCount, 0);
+    // The record count is patched in once all blocks are parsed.
+    SizeType totalRecordCount = 0;
+    if (output->WriteBinary(sizeof(totalRecordCount), (char*)(&totalRecordCount)) != sizeof(totalRecordCount) ||
+        output->WriteBinary(sizeof(m_options->m_dimension), (char*)&(m_options->m_dimension)) != sizeof(m_options->m_dimension) ||
+        metaIndex->WriteBinary(sizeof(totalRecordCount), (char*)(&totalRecordCount)) != sizeof(totalRecordCount)) {
+        LOG(Helper::LogLevel::LL_Error, "Unable to write file: %s %s\n", m_vectorOutput.c_str(), m_metadataIndexOutput.c_str());
+        exit(1);
+    }
 
-    m_waitSignal.Reset(m_subTaskCount);
+    // Each round parses one block per thread into memory, then appends the blocks in file order,
+    // so the output is written once with no per-thread temp files to merge.
+    std::uint64_t totalOffset = 0;
+    std::vector<ParsedBlock> parsedBlocks(max(m_options->m_threadNum, (std::uint32_t)1));
+    for (std::size_t roundBegin = 0; roundBegin < blocks.size(); roundBegin += parsedBlocks.size())
+    {
+        std::size_t roundSize = min(parsedBlocks.size(), blocks.size() - roundBegin);
+        std::atomic_bool failed(false);
 
 #pragma omp parallel for schedule(dynamic)
-    for (int64_t i = 0; i < (int64_t)subWorks.size(); i++)
-    {
-        subWorks[i]();
-    }
+        for (int64_t i = 0; i < (int64_t)roundSize; i++)
+        {
+            const auto& block = blocks[roundBegin + i];
+            if (!ParseBlock(files[block.first].first, files[block.first].second, block.second, parsedBlocks[i])) failed = true;
+        }
 
-    m_waitSignal.Wait();
+        if (failed) return ErrorCode::Fail;
 
-    MergeData();
+        for (std::size_t i = 0; i < roundSize; i++)
+        {
+            ParsedBlock& parsed = parsedBlocks[i];
+            for (auto& offset : parsed.m_metadataOffsets) offset += totalOffset;
+
+            std::uint64_t offsetBytes = sizeof(std::uint64_t) * parsed.m_metadataOffsets.size();
+            if (output->WriteBinary(parsed.m_vectors.size(), (const char*)parsed.m_vectors.data()) != parsed.m_vectors.size() ||
+                meta->WriteBinary(parsed.m_metadata.size(), parsed.m_metadata.data()) != parsed.m_metadata.size() ||
+                metaIndex->WriteBinary(offsetBytes, (const char*)parsed.m_metadataOffsets.data()) != offsetBytes) {
+                LOG(Helper::LogLevel::LL_Error, "Unable to write file: %s %s %s\n", m_vectorOutput.c_str(), m_metadataConentOutput.c_str(), m_metadataIndexOutput.c_str());
+                exit(1);
+            }
+            totalOffset += parsed.m_metadata.size();
+            totalRecordCount += parsed.m_recordCount;
+        }
+    }
+
+    if (metaIndex->WriteBinary(sizeof(totalOffset), (char*)&totalOffset) != sizeof(totalOffset) ||
+        metaIndex->WriteBinary(sizeof(totalRecordCount), (char*)(&totalRecordCount), 0) != sizeof(totalRecordCount) ||
+        output->WriteBinary(sizeof(totalRecordCount), (char*)(&totalRecordCount), 0) != sizeof(totalRecordCount)) {
+        LOG(Helper::LogLevel::LL_Error, "Unable to write file: %s %s\n", m_vectorOutput.c_str(), m_metadataIndexOutput.c_str());
+        exit(1);
+    }
 
+    LOG(Helper::LogLevel::LL_Info, "Loaded %d vectors from %zu blocks.\n", totalRecordCount, blocks.size());
     return ErrorCode::Success;
 }
 
@@ -159,74 +184,103 @@ TxtVectorReader::GetMetadataSet() const
 }
 
 
-void
-TxtVectorReader::LoadFileInternal(const std::string& p_filePath,
-                                std::uint32_t p_subTaskID,
-                                std::uint32_t p_fileBlockID,
-                                std::size_t p_fileBlockSize)
+SizeType
+TxtVectorReader::GetVectorCount() const
 {
-    std::uint64_t lineBufferSize = 1 << 16;
-    std::unique_ptr<char[]> currentLine(new char[lineBufferSize]);
+    return ReadVectorCount(m_vectorOutput);
+}
 
-    SizeType recordCount = 0;
-    std::uint64_t metaOffset = 0;
-    std::size_t totalRead = 0;
-    std::streamoff startpos = p_fileBlockID * p_fileBlockSize;
 
-    std::shared_ptr<Helper::DiskPriorityIO> input = f_createIO(), output = f_createIO(), meta = f_createIO(), metaIndex = f_createIO();
+std::shared_ptr<VectorSet>
+TxtVectorReader::GetVectorSubset(const std::vector<SizeType>& p_ids) const
+{
+    return ReadVectorSubset(m_vectorOutput, p_ids);
+}
+
+
+bool
+TxtVectorReader::ParseBlock(const std::string& p_filePath,
+                            std::size_t p_fileSize,
+                            std::size_t p_blockBegin,
+                            ParsedBlock& p_block) const
+{
+    p_block.m_recordCount = 0;
+    p_block.m_vectors.clear();
+    p_block.m_metadata.clear();
+    p_block.m_metadataOffsets.clear();
+
+    std::shared_ptr<Helper::DiskPriorityIO> input = f_createIO();
     if (input == nullptr || !input->Initialize(p_filePath.c_str(), std::ios::in | std::ios::binary))
     {
-        LOG(Helper::LogLevel::LL_Error, "Unable to open file: %s\n",p_filePath.c_str());
-        exit(1);
+        LOG(Helper::LogLevel::LL_Error, "Unable to open file: %s\n", p_filePath.c_str());
+        return false;
     }
 
-    LOG(Helper::LogLevel::LL_Info, "Begin Subtask: %u, start offset position: %lld\n", p_subTaskID, startpos);
-
-    std::string subFileSuffix("_");
-    subFileSuffix += std::to_string(p_subTaskID);
-    subFileSuffix += ".tmp";
-
-    if (output == nullptr || !output->Initialize((m_vectorOutput + subFileSuffix).c_str(), std::ios::binary | std::ios::out) ||
-        meta == nullptr || !meta->Initialize((m_metadataConentOutput + subFileSuffix).c_str(), std::ios::binary | std::ios::out) ||
-        metaIndex == nullptr || !metaIndex->Initialize((m_metadataIndexOutput + subFileSuffix).c_str(), std::ios::binary | std::ios::out))
+    // Start one byte early to see whether the block begins on a line boundary, and keep reading
+    // past the block end until the last line that starts inside the block is complete.
+    std::size_t readBegin = (p_blockBegin == 0) ? 0 : p_blockBegin - 1;
+    std::size_t blockEnd = min(p_blockBegin + m_subTaskBlocksize, p_fileSize);
+    std::size_t readEnd = blockEnd;
+    std::vector<char> buffer;
+    while (true)
     {
-        LOG(Helper::LogLevel::LL_Error, "Unable to create files: %s %s %s\n", (m_vectorOutput + subFileSuffix).c_str(), (m_metadataConentOutput + subFileSuffix).c_str(), (m_metadataIndexOutput + subFileSuffix).c_str());
-        exit(1);
+        std::size_t length = buffer.size();
+        std::size_t readSize = readEnd - readBegin - length;
+        buffer.resize(length + readSize);
+        if (input->ReadBinary(readSize, buffer.data() + length, readBegin + length) != readSize)
+        {
+            LOG(Helper::LogLevel::LL_Error, "Unable to read file: %s\n", p_filePath.c_str());
+            return false;
+        }
+
+        std::size_t searchBegin = max(length, blockEnd - 1 - readBegin);
+        if (readEnd == p_fileSize || std::memchr(buffer.data() + searchBegin, '\n', buffer.size() - searchBegin) != nullptr) break;
+        readEnd = min(readEnd + ((std::size_t)1 << 16), p_fileSize);
     }
 
-    if (p_fileBlockID != 0)
+    const char* data = buffer.data();
+    const char* dataEnd = data + buffer.size();
+    const char* ownedEnd = data + (blockEnd - readBegin);
+    const char* line = data;
+    if (p_blockBegin != 0)
     {
-        totalRead += input->ReadString(lineBufferSize, currentLine, '\n', startpos);
+        line = static_cast<const char*>(std::memchr(data, '\n', buffer.size()));
+        line = (line == nullptr) ? dataEnd : line + 1;
     }
 
     std::size_t vectorByteSize = GetValueTypeSize(m_options->m_inputValueType) * m_options->m_dimension;
-    std::unique_ptr<std::uint8_t[]> vector;
-    vector.reset(new std::uint8_t[vectorByteSize]);
-
-    while (totalRead <= p_fileBlockSize)
+    while (line < ownedEnd)
     {
-        std::uint64_t lineLength = input->ReadString(lineBufferSize, currentLine);
-        if (lineLength == 0) break;
-        totalRead += lineLength;
+        const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', dataEnd - line));
+        if (lineEnd == nullptr) lineEnd = dataEnd;
+        const char* next = lineEnd + 1;
+        if (lineEnd > line && *(lineEnd - 1) == '\r') --lineEnd;
+        if (lineEnd == line)
+        {
+            line = next;
+            continue;
+        }
 
-        std::size_t tabIndex = lineLength - 1;
-        while (tabIndex > 0 && currentLine[tabIndex] != '\t')
+        const char* tab = lineEnd - 1;
+        while (tab > line && *tab != '\t')
         {
-            --tabIndex;
+            --tab;
         }
 
-        if (0 == tabIndex && currentLine[tabIndex] != '\t')
+        if (*tab != '\t')
         {
-            LOG(Helper::LogLevel::LL_Error, "Subtask: %u cannot parsing line:%s\n", p_subTaskID, currentLine.get());
-            exit(1);
+            LOG(Helper::LogLevel::LL_Error, "Cannot parsing line:%s\n", std::string(line, lineEnd).c_str());
+            return false;
         }
 
+        p_block.m_vectors.resize(p_block.m_vectors.size() + vectorByteSize);
+        std::uint8_t* vector = p_block.m_vectors.data() + p_block.m_vectors.size() - vectorByteSize;
         bool parseSuccess = false;
         switch (m_options->m_inputValueType)
         {
 #define DefineVectorValueType(Name, Type) \
         case VectorValueType::Name: \
-            parseSuccess = TranslateVector(currentLine.get() + tabIndex + 1, reinterpret_cast<Type*>(vector.get())); \
+            parseSuccess = TranslateVector(tab + 1, lineEnd, reinterpret_cast<Type*>(vector)); \
             break; \
 
 #include "inc/Core/DefinitionList.h"
@@ -239,161 +293,16 @@ TxtVectorReader::LoadFileInternal(const std::string& p_filePath,
 
         if (!parseSuccess)
         {
-            LOG(Helper::LogLevel::LL_Error, "Subtask: %u cannot parsing vector:%s\n", p_subTaskID, currentLine.get());
-            exit(1);
-        }
-
-        ++recordCount;
-        if (output->WriteBinary(vectorByteSize, (char*)vector.get()) != vectorByteSize ||
-            meta->WriteBinary(tabIndex, currentLine.get()) != tabIndex ||
-            metaIndex->WriteBinary(sizeof(metaOffset), (const char*)&metaOffset) != sizeof(metaOffset)) {
-            LOG(Helper::LogLevel::LL_Error, "Subtask: %u cannot write line:%s\n", p_subTaskID, currentLine.get());
-            exit(1);
-        }
-        metaOffset += tabIndex;
-    }
-    if (metaIndex->WriteBinary(sizeof(metaOffset), (const char*)&metaOffset) != sizeof(metaOffset)) {
-        LOG(Helper::LogLevel::LL_Error, "Subtask: %u cannot write final offset!\n", p_subTaskID);
-        exit(1);
-    }
-
-    m_totalRecordCount += recordCount;
-    m_subTaskRecordCount[p_subTaskID] = recordCount;
-    m_totalRecordVectorBytes += recordCount * vectorByteSize;
-
-    m_waitSignal.FinishOne();
-}
-
-
-void
-TxtVectorReader::MergeData()
-{
-    const std::size_t bufferSize = 1 << 30;
-    const std::size_t bufferSizeTrim64 = (bufferSize / sizeof(std::uint64_t)) * sizeof(std::uint64_t);
-
-    std::shared_ptr<Helper::DiskPriorityIO> input = f_createIO(), output = f_createIO(), meta = f_createIO(), metaIndex = f_createIO();
-
-    if (output == nullptr || !output->Initialize(m_vectorOutput.c_str(), std::ios::binary | std::ios::out) ||
-        meta == nullptr || !meta->Initialize(m_metadataConentOutput.c_str(), std::ios::binary | std::ios::out) ||
-        metaIndex == nullptr || !metaIndex->Initialize(m_metadataIndexOutput.c_str(), std::ios::binary | std::ios::out))
-    {
-        LOG(Helper::LogLevel::LL_Error, "Unable to create files: %s %s %s\n", m_vectorOutput.c_str(), m_metadataConentOutput.c_str(), m_metadataIndexOutput.c_str());
-        exit(1);
-    }
-
-    std::unique_ptr<char[]> bufferHolder(new char[bufferSize]);
-    char* buf = bufferHolder.get();
-
-    SizeType totalRecordCount = m_totalRecordCount;
-    if (output->WriteBinary(sizeof(totalRecordCount), (char*)(&totalRecordCount)) != sizeof(totalRecordCount)) {
-        LOG(Helper::LogLevel::LL_Error, "Unable to write file: %s\n", m_vectorOutput.c_str());
-        exit(1);
-    }
-    if (output->WriteBinary(sizeof(m_options->m_dimension), (char*)&(m_options->m_dimension)) != sizeof(m_options->m_dimension)) {
-        LOG(Helper::LogLevel::LL_Error, "Unable to write file: %s\n", m_vectorOutput.c_str());
-        exit(1);
-    }
-
-    for (std::uint32_t i = 0; i < m_subTaskCount; ++i)
-    {
-        std::string file = m_vectorOutput;
-        file += "_";
-        file += std::to_string(i);
-        file += ".tmp";
-
-        if (input == nullptr || !input->Initialize(file.c_str(), std::ios::binary | std::ios::in))
-        {
-            LOG(Helper::LogLevel::LL_Error, "Unable to open file: %s\n", file.c_str());
-            exit(1);
+            LOG(Helper::LogLevel::LL_Error, "Cannot parsing vector:%s\n", std::string(line, lineEnd).c_str());
+            return false;
         }
 
-        std::uint64_t readSize;
-        while ((readSize = input->ReadBinary(bufferSize, bufferHolder.get()))) {
-            if (output->WriteBinary(readSize, bufferHolder.get()) != readSize) {
-                LOG(Helper::LogLevel::LL_Error, "Unable to write file: %s\n", m_vectorOutput.c_str());
-                exit(1);
-            }
-        }
-        input->ShutDown();
-        remove(file.c_str());
-    }
-
-    for (std::uint32_t i = 0; i < m_subTaskCount; ++i)
-    {
-        std::string file = m_metadataConentOutput;
-        file += "_";
-        file += std::to_string(i);
-        file += ".tmp";
-
-        if (input == nullptr || !input->Initialize(file.c_str(), std::ios::binary | std::ios::in))
-        {
-            LOG(Helper::LogLevel::LL_Error, "Unable to open file: %s\n", file.c_str());
-            exit(1);
-        }
-
-        std::uint64_t readSize;
-        while ((readSize = input->ReadBinary(bufferSize, bufferHolder.get()))) {
-            if (meta->WriteBinary(readSize, bufferHolder.get()) != readSize) {
-                LOG(Helper::LogLevel::LL_Error, "Unable to write file: %s\n", m_metadataConentOutput.c_str());
-                exit(1);
-            }
-        }
-        input->ShutDown();
-        remove(file.c_str());
-    }
-
-    if (metaIndex->WriteBinary(sizeof(totalRecordCount), (char*)(&totalRecordCount)) != sizeof(totalRecordCount)) {
-        LOG(Helper::LogLevel::LL_Error, "Unable to write file: %s\n", m_metadataIndexOutput.c_str());
-        exit(1);
-    }
-
-    std::uint64_t totalOffset = 0;
-    for (std::uint32_t i = 0; i < m_subTaskCount; ++i)
-    {
-        std::string file = m_metadataIndexOutput;
-        file += "_";
-        file += std::to_string(i);
-        file += ".tmp";
-
-        if (input == nullptr || !input->Initialize(file.c_str(), std::ios::binary | std::ios::in))
-        {
-            LOG(Helper::LogLevel::LL_Error, "Unable to open file: %s\n", file.c_str());
-            exit(1);
-        }
-
-        for (SizeType remains = m_subTaskRecordCount[i]; remains > 0;)
-        {
-            std::size_t readBytesCount = min(remains * sizeof(std::uint64_t), bufferSizeTrim64);
-            if (input->ReadBinary(readBytesCount, buf) != readBytesCount) {
-                LOG(Helper::LogLevel::LL_Error, "Unable to read file: %s\n", file.c_str());
-                exit(1);
-            }
-            std::uint64_t* offset = reinterpret_cast<std::uint64_t*>(buf);
-            for (std::uint64_t i = 0; i < readBytesCount / sizeof(std::uint64_t); ++i)
-            {
-                offset[i] += totalOffset;
-            }
-
-            if (metaIndex->WriteBinary(readBytesCount, buf) != readBytesCount) {
-                LOG(Helper::LogLevel::LL_Error, "Unable to write file: %s\n", m_metadataIndexOutput.c_str());
-                exit(1);
-            }
-            remains -= static_cast<SizeType>(readBytesCount / sizeof(std::uint64_t));
-        }
-        if (input->ReadBinary(sizeof(std::uint64_t), buf) != sizeof(std::uint64_t)) {
-            LOG(Helper::LogLevel::LL_Error, "Unable to read file: %s\n", file.c_str());
-            exit(1);
-        }
-        totalOffset += *(reinterpret_cast<std::uint64_t*>(buf));
-
-        input->ShutDown();
-        remove(file.c_str());
-    }
-
-    if (metaIndex->WriteBinary(sizeof(totalOffset), (char*)&totalOffset) != sizeof(totalOffset)) {
-        LOG(Helper::LogLevel::LL_Error, "Unable to write file: %s\n", m_metadataIndexOutput.c_str());
-        exit(1);
+        p_block.m_metadataOffsets.push_back(p_block.m_metadata.size());
+        p_block.m_metadata.append(line, tab - line);
+        ++p_block.m_recordCount;
+        line = next;
     }
+    return true;
 }
 
 
@@ -117,3 +117,17 @@ XvecVectorReader::GetMetadataSet() const
 {
     return nullptr;
 }
+
+
+SizeType
+XvecVectorReader::GetVectorCount() const
+{
+    return ReadVectorCount(m_vectorOutput);
+}
+
+
+std::shared_ptr<VectorSet>
+XvecVectorReader::GetVectorSubset(const std::vector<SizeType>& p_ids) const
+{
+    return ReadVectorSubset(m_vectorOutput, p_ids);
+}
@@ -13,6 +13,7 @@ SearchExecutionContext::SearchExecutionContext(const std::shared_ptr<const Servi
       m_vectorDimension(0),
       m_inputValueType(VectorValueType::Undefined),
       m_extractMetadata(false),
+      m_mergeResults(false),
       m_resultNum(p_serviceSettings->m_defaultMaxResultNumber)
 {
 }
@@ -67,6 +68,10 @@ SearchExecutionContext::ExtractOption()
         {
             Helper::Convert::ConvertStringTo<bool>(optionPair.second, m_extractMetadata);
         }
+        else if (Helper::StrUtils::StrEqualIgnoreCase(optionPair.first, "mergeresults"))
+        {
+            Helper::Convert::ConvertStringTo<bool>(optionPair.second, m_mergeResults);
+        }
         else if (Helper::StrUtils::StrEqualIgnoreCase(optionPair.first, "resultnum"))
         {
             Helper::Convert::ConvertStringTo<SizeType>(optionPair.second, m_resultNum);
@@ -185,3 +190,10 @@ SearchExecutionContext::GetExtractMetadata() const
 {
     return m_extractMetadata;
 }
+
+
+const bool
+SearchExecutionContext::GetMergeResults() const
+{
+    return m_mergeResults;
+}
@@ -3,16 +3,24 @@
 
 #include "inc/Server/SearchExecutor.h"
 
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
 using namespace SPTAG;
 using namespace SPTAG::Service;
 
 
 SearchExecutor::SearchExecutor(std::string p_queryString,
                                std::shared_ptr<ServiceContext> p_serviceContext,
-                               const CallBack& p_callback)
+                               const CallBack& p_callback,
+                               const TaskPoster& p_taskPoster)
     : m_callback(p_callback),
+      m_taskPoster(p_taskPoster),
       c_serviceContext(std::move(p_serviceContext)),
-      m_queryString(std::move(p_queryString))
+      m_queryString(std::move(p_queryString)),
+      m_pendingSearches(0)
 {
 }
 
@@ -33,14 +41,79 @@ SearchExecutor::Execute()
 }
 
 
+void
+SearchExecutor::ExecuteAsync()
+{
+    if (!PrepareSearch())
+    {
+        if (bool(m_callback))
+        {
+            m_callback(std::move(m_executionContext));
+        }
+        return;
+    }
+
+    // The extra count is released after the loop so a search finishing inline cannot complete the query early.
+    auto self = shared_from_this();
+    m_pendingSearches = m_indexes.size() + 1;
+    for (std::size_t i = 0; i < m_indexes.size(); ++i)
+    {
+        m_results[i].Reset();
+        ErrorCode ret = m_indexes[i]->SearchIndexAsync(m_results[i], [self, i](ErrorCode p_ret)
+        {
+            self->m_errors[i] = p_ret;
+            if (--(self->m_pendingSearches) == 0) self->FinishAsyncSearch();
+        });
+
+        if (ErrorCode::Busy == ret)
+        {
+            // The index runs no more asynchronous searches at once, so this one is served on the calling thread.
+            m_errors[i] = m_indexes[i]->SearchIndex(m_results[i]);
+            --m_pendingSearches;
+        }
+        else if (ErrorCode::Success != ret)
+        {
+            m_errors[i] = ret;
+            --m_pendingSearches;
+        }
+    }
+
+    if (--m_pendingSearches == 0) FinishAsyncSearch();
+}
+
+
+void
+SearchExecutor::FinishAsyncSearch()
+{
+    FinishSearch();
+    if (bool(m_callback))
+    {
+        m_callback(std::move(m_executionContext));
+    }
+}
+
+
 void
 SearchExecutor::ExecuteInternal()
+{
+    if (!PrepareSearch())
+    {
+        return;
+    }
+
+    SearchSelectedIndexes();
+    FinishSearch();
+}
+
+
+bool
+SearchExecutor::PrepareSearch()
 {
     m_executionContext.reset(new SearchExecutionContext(c_serviceContext->GetServiceSettings()));
 
     if (m_executionContext->ParseQuery(m_queryString) != ErrorCode::Success) {
         LOG(Helper::LogLevel::LL_Error, "Failed to parse query:%s!\n", m_queryString.c_str());
-        return;
+        return false;
     }
 
     m_executionContext->ExtractOption();
@@ -50,7 +123,7 @@ SearchExecutor::ExecuteInternal()
     if (m_selectedIndex.empty())
     {
         LOG(Helper::LogLevel::LL_Error, "Empty selected index!\n");
-        return;
+        return false;
     }
 
     const auto& firstIndex = m_selectedIndex.front();
@@ -58,19 +131,15 @@ SearchExecutor::ExecuteInternal()
     if (ErrorCode::Success != m_executionContext->ExtractVector(firstIndex->GetVectorValueType()))
     {
         LOG(Helper::LogLevel::LL_Error, "Failed to extract vector!\n");
-        return;
+        return false;
     }
 
     if (m_executionContext->GetVectorDimension() != firstIndex->GetFeatureDim())
     {
         LOG(Helper::LogLevel::LL_Error, "Failed to match vector dimension!\n");
-        return;
+        return false;
     } 
 
-    QueryResult query(m_executionContext->GetVector().Data(),
-                      m_executionContext->GetResultNum(),
-                      m_executionContext->GetExtractMetadata());
-
     for (const auto& vectorIndex : m_selectedIndex)
     {
         if (vectorIndex->GetVectorValueType() != firstIndex->GetVectorValueType()
@@ -79,10 +148,32 @@ SearchExecutor::ExecuteInternal()
             continue;
         }
 
-        query.Reset();
-        if (ErrorCode::Success == vectorIndex->SearchIndex(query))
+        m_indexes.push_back(vectorIndex);
+    }
+
+    m_results.assign(m_indexes.size(),
+                     QueryResult(m_executionContext->GetVector().Data(),
+                                 m_executionContext->GetResultNum(),
+                                 m_executionContext->GetExtractMetadata()));
+    m_errors.assign(m_indexes.size(), ErrorCode::Fail);
+    return true;
+}
+
+
+void
+SearchExecutor::FinishSearch()
+{
+    if (m_executionContext->GetMergeResults() && m_indexes.size() > 1)
+    {
+        MergeResults();
+        return;
+    }
+
+    for (std::size_t i = 0; i < m_indexes.size(); ++i)
+    {
+        if (ErrorCode::Success == m_errors[i])
         {
-            m_executionContext->AddResults(vectorIndex->GetIndexName(), query);
+            m_executionContext->AddResults(m_indexes[i]->GetIndexName(), m_results[i]);
         }
         else {
             LOG(Helper::LogLevel::LL_Error, "Failed to execute SearchIndex!\n");
@@ -91,11 +182,106 @@ SearchExecutor::ExecuteInternal()
 }
 
 
+void
+SearchExecutor::SearchSelectedIndexes()
+{
+    auto searchOne = [this](std::size_t i)
+    {
+        m_results[i].Reset();
+        m_errors[i] = m_indexes[i]->SearchIndex(m_results[i]);
+    };
+
+    if (m_indexes.size() <= 1 || !bool(m_taskPoster))
+    {
+        for (std::size_t i = 0; i < m_indexes.size(); ++i) searchOne(i);
+        return;
+    }
+
+    // Every participant, including this thread, claims indexes from a shared counter. Tasks that the
+    // pool starts late find nothing left and return at once, so waiting here can never starve the pool.
+    struct FanOutState
+    {
+        std::atomic<std::size_t> m_next{ 0 };
+        std::size_t m_done = 0;
+        std::mutex m_lock;
+        std::condition_variable m_finished;
+    };
+
+    auto state = std::make_shared<FanOutState>();
+    std::size_t total = m_indexes.size();
+    std::function<void()> drain = [state, total, &searchOne]()
+    {
+        std::size_t i;
+        while ((i = state->m_next.fetch_add(1)) < total)
+        {
+            searchOne(i);
+            std::lock_guard<std::mutex> guard(state->m_lock);
+            if (++state->m_done == total) state->m_finished.notify_all();
+        }
+    };
+
+    for (std::size_t i = 1; i < total; ++i)
+    {
+        m_taskPoster(drain);
+    }
+    drain();
+
+    std::unique_lock<std::mutex> lock(state->m_lock);
+    state->m_finished.wait(lock, [&state, total]() { return state->m_done == total; });
+}
+
+
+// VIDs are only meaningful within their own index, so the global top results are handed back
+// under the name of the index each one came from, in distance order within every index.
+void
+SearchExecutor::MergeResults()
+{
+    std::vector<std::pair<BasicResult, std::size_t>> merged;
+    std::vector<std::size_t> succeeded;
+    for (std::size_t i = 0; i < m_indexes.size(); ++i)
+    {
+        if (ErrorCode::Success != m_errors[i])
+        {
+            LOG(Helper::LogLevel::LL_Error, "Failed to execute SearchIndex!\n");
+            continue;
+        }
+
+        succeeded.push_back(i);
+        for (const auto& res : m_results[i])
+        {
+            if (res.VID >= 0) merged.emplace_back(res, i);
+        }
+    }
+
+    int resultNum = m_executionContext->GetResultNum();
+    std::size_t topK = min(merged.size(), static_cast<std::size_t>(resultNum));
+    std::partial_sort(merged.begin(), merged.begin() + topK, merged.end(),
+                      [](const std::pair<BasicResult, std::size_t>& p_left, const std::pair<BasicResult, std::size_t>& p_right)
+                      {
+                          return p_left.first.Dist < p_right.first.Dist;
+                      });
+
+    for (std::size_t i : succeeded)
+    {
+        QueryResult indexResult(m_executionContext->GetVector().Data(), resultNum, m_executionContext->GetExtractMetadata());
+        indexResult.Reset();
+        int count = 0;
+        for (std::size_t k = 0; k < topK; ++k)
+        {
+            if (merged[k].second == i) *indexResult.GetResult(count++) = merged[k].first;
+        }
+
+        m_executionContext->AddResults(m_indexes[i]->GetIndexName(), indexResult);
+    }
+}
+
+
 void
 SearchExecutor::SelectIndex()
 {
     const auto& indexNames = m_executionContext->GetSelectedIndexNames();
-    const auto& indexMap = c_serviceContext->GetIndexMap();
+    auto indexMapSnapshot = c_serviceContext->GetIndexMap();
+    const auto& indexMap = *indexMapSnapshot;
     if (indexMap.empty())
     {
         return;
@@ -6,6 +6,7 @@
 #include "inc/Socket/RemoteSearchQuery.h"
 #include "inc/Helper/CommonHelper.h"
 #include "inc/Helper/ArgumentsParser.h"
+#include "inc/Helper/MetricsWriter.h"
 
 #include <iostream>
 
@@ -42,6 +43,9 @@ public:
     std::string m_logFile;
 };
 
+// A metrics client that does not finish its request in time is disconnected, so idle connections cannot pile up.
+const long c_metricsReadTimeoutMs = 5000;
+
 }
 
 } // namespace
@@ -131,6 +135,21 @@ SearchService::RunSocketMode()
                         {
                             boost::asio::post(*m_threadPool, std::bind(&SearchService::SearchHanlder, this, p_srcID, std::move(p_packet)));
                         });
+    handlerMap->emplace(Socket::PacketType::BatchSearchRequest,
+                        [this](Socket::ConnectionID p_srcID, Socket::Packet p_packet)
+                        {
+                            boost::asio::post(*m_threadPool, std::bind(&SearchService::BatchSearchHandler, this, p_srcID, std::move(p_packet)));
+                        });
+
+    if (m_serviceContext->GetServiceSettings()->m_enableIndexReload)
+    {
+        m_reloadPool.reset(new boost::asio::thread_pool(1));
+        handlerMap->emplace(Socket::PacketType::ReloadIndexRequest,
+                            [this](Socket::ConnectionID p_srcID, Socket::Packet p_packet)
+                            {
+                                boost::asio::post(*m_reloadPool, std::bind(&SearchService::ReloadIndexHandler, this, p_srcID, std::move(p_packet)));
+                            });
+    }
 
     m_socketServer.reset(new Socket::Server(m_serviceContext->GetServiceSettings()->m_listenAddr,
                                             m_serviceContext->GetServiceSettings()->m_listenPort,
@@ -148,20 +167,160 @@ SearchService::RunSocketMode()
     m_shutdownSignals.add(SIGQUIT);
 #endif
 
+    StartMetricsEndpoint();
+
     m_shutdownSignals.async_wait([this](boost::system::error_code p_ec, int p_signal)
                                  {
                                      LOG(Helper::LogLevel::LL_Info, "Received shutdown signals.\n");
+                                     if (nullptr != m_metricsAcceptor)
+                                     {
+                                         boost::system::error_code ignored;
+                                         m_metricsAcceptor->close(ignored);
+                                     }
+                                     m_ioContext.stop();
                                  });
 
     m_ioContext.run();
     LOG(Helper::LogLevel::LL_Info, "Start shutdown procedure.\n");
 
+    if (nullptr != m_reloadPool)
+    {
+        m_reloadPool->stop();
+        m_reloadPool->join();
+    }
+
     m_socketServer.reset();
     m_threadPool->stop();
     m_threadPool->join();
 }
 
 
+void
+SearchService::StartMetricsEndpoint()
+{
+    const auto& settings = m_serviceContext->GetServiceSettings();
+    if (settings->m_metricsPort.empty())
+    {
+        return;
+    }
+
+    boost::asio::ip::tcp::resolver resolver(m_ioContext);
+    boost::system::error_code errCode;
+    auto endPoints = resolver.resolve(settings->m_listenAddr, settings->m_metricsPort, errCode);
+    if (!errCode)
+    {
+        boost::asio::ip::tcp::endpoint endpoint = *(endPoints.begin());
+        m_metricsAcceptor.reset(new boost::asio::ip::tcp::acceptor(m_ioContext));
+        m_metricsAcceptor->open(endpoint.protocol(), errCode);
+        if (!errCode) m_metricsAcceptor->bind(endpoint, errCode);
+        if (!errCode) m_metricsAcceptor->listen(boost::asio::socket_base::max_listen_connections, errCode);
+    }
+
+    if (errCode)
+    {
+        LOG(Helper::LogLevel::LL_Error,
+                "Failed to serve metrics on %s:%s, error: %s\n",
+                settings->m_listenAddr.c_str(),
+                settings->m_metricsPort.c_str(),
+                errCode.message().c_str());
+        m_metricsAcceptor.reset();
+        return;
+    }
+
+    LOG(Helper::LogLevel::LL_Info,
+            "Serving metrics on %s:%s ...\n",
+            settings->m_listenAddr.c_str(),
+            settings->m_metricsPort.c_str());
+    AcceptMetricsConnection();
+}
+
+
+void
+SearchService::AcceptMetricsConnection()
+{
+    m_metricsAcceptor->async_accept([this](boost::system::error_code p_ec,
+                                           boost::asio::ip::tcp::socket p_socket)
+                                    {
+                                        if (!m_metricsAcceptor->is_open())
+                                        {
+                                            return;
+                                        }
+
+                                        if (!p_ec)
+                                        {
+                                            auto socket = std::make_shared<boost::asio::ip::tcp::socket>(std::move(p_socket));
+                                            auto request = std::make_shared<boost::asio::streambuf>(1 << 16);
+                                            auto timer = std::make_shared<boost::asio::deadline_timer>(m_ioContext,
+                                                boost::posix_time::milliseconds(Local::c_metricsReadTimeoutMs));
+                                            timer->async_wait([socket](const boost::system::error_code& p_ec)
+                                                {
+                                                    if (boost::asio::error::operation_aborted != p_ec)
+                                                    {
+                                                        boost::system::error_code ignored;
+                                                        socket->close(ignored);
+                                                    }
+                                                });
+
+                                            boost::asio::async_read_until(*socket, *request, "\r\n\r\n",
+                                                [this, socket, request, timer](boost::system::error_code p_ec, std::size_t)
+                                                {
+                                                    timer->cancel();
+                                                    if (p_ec)
+                                                    {
+                                                        return;
+                                                    }
+
+                                                    std::string method, path;
+                                                    std::istream requestStream(request.get());
+                                                    requestStream >> method >> path;
+
+                                                    std::string status("200 OK"), body;
+                                                    if (method != "GET")
+                                                    {
+                                                        status = "405 Method Not Allowed";
+                                                    }
+                                                    else if (path != "/" && path != "/metrics")
+                                                    {
+                                                        status = "404 Not Found";
+                                                    }
+                                                    else
+                                                    {
+                                                        body = CollectMetrics();
+                                                    }
+
+                                                    auto response = std::make_shared<std::string>("HTTP/1.0 " + status + "\r\n"
+                                                        "Content-Type: text/plain; version=0.0.4\r\n"
+                                                        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                                                        "Connection: close\r\n\r\n" + body);
+                                                    boost::asio::async_write(*socket, boost::asio::buffer(*response),
+                                                        [socket, response](boost::system::error_code, std::size_t)
+                                                        {
+                                                            boost::system::error_code ignored;
+                                                            socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+                                                        });
+                                                });
+                                        }
+
+                                        AcceptMetricsConnection();
+                                    });
+}
+
+
+std::string
+SearchService::CollectMetrics() const
+{
+    Helper::MetricsWriter writer;
+    auto indexMap = m_serviceContext->GetIndexMap();
+    writer.WriteGauge("sptag_service_indexes", "Number of indexes being served.", (double)indexMap->size());
+    for (const auto& index : *indexMap)
+    {
+        writer.SetLabels({ { "index", index.first } });
+        index.second->CollectMetrics(writer);
+    }
+    return writer.GetText();
+}
+
+
 void
 SearchService::RunInteractiveMode()
 {
@@ -235,9 +394,24 @@ SearchService::SearchHanlder(Socket::ConnectionID p_localConnectionID, Socket::P
                               std::placeholders::_1,
                               std::move(p_packet));
 
+    auto taskPoster = [this](std::function<void()> p_task)
+    {
+        boost::asio::post(*m_threadPool, std::move(p_task));
+    };
+
+    if (m_serviceContext->GetServiceSettings()->m_enableAsyncSearch)
+    {
+        std::make_shared<SearchExecutor>(std::move(remoteQuery.m_queryString),
+                                         m_serviceContext,
+                                         callback,
+                                         taskPoster)->ExecuteAsync();
+        return;
+    }
+
     SearchExecutor executor(std::move(remoteQuery.m_queryString),
                             m_serviceContext,
-                            callback);
+                            callback,
+                            taskPoster);
     executor.Execute();
 }
 
@@ -272,3 +446,144 @@ SearchService::SearchHanlderCallback(std::shared_ptr<SearchExecutionContext> p_e
 
     m_socketServer->SendPacket(p_srcPacket.Header().m_connectionID, std::move(ret), nullptr);
 }
+
+
+void
+SearchService::BatchSearchHandler(Socket::ConnectionID p_localConnectionID, Socket::Packet p_packet)
+{
+    if (p_packet.Header().m_bodyLength == 0)
+    {
+        LOG(Helper::LogLevel::LL_Error, "Empty package with body length equals 0!\n");
+        return;
+    }
+
+    if (Socket::c_invalidConnectionID == p_packet.Header().m_connectionID)
+    {
+        p_packet.Header().m_connectionID = p_localConnectionID;
+    }
+
+    Socket::RemoteBatchSearchResult remoteResult;
+    remoteResult.m_status = Socket::RemoteSearchResult::ResultStatus::FailedExecute;
+
+    // The vectors stay in the packet body, which lives until this handler returns.
+    Socket::RemoteBatchQuery remoteQuery;
+    std::shared_ptr<VectorIndex> index;
+    if (remoteQuery.Read(p_packet.Body(), p_packet.Header().m_bodyLength) == nullptr)
+    {
+        LOG(Helper::LogLevel::LL_Error, "Failed to read batch query!\n");
+    }
+    else
+    {
+        // The result block is allocated from the request, so its size is bounded before searching.
+        const auto& settings = m_serviceContext->GetServiceSettings();
+        std::uint32_t maxResultNum = static_cast<std::uint32_t>(settings->m_defaultMaxResultNumber);
+        if (remoteQuery.m_resultNum == 0 || remoteQuery.m_resultNum > maxResultNum)
+        {
+            remoteQuery.m_resultNum = maxResultNum;
+        }
+
+        auto indexMapSnapshot = m_serviceContext->GetIndexMap();
+        const auto& indexMap = *indexMapSnapshot;
+        if (remoteQuery.m_indexName.empty())
+        {
+            if (indexMap.size() == 1) index = indexMap.begin()->second;
+        }
+        else
+        {
+            auto iter = indexMap.find(remoteQuery.m_indexName);
+            if (iter != indexMap.cend()) index = iter->second;
+        }
+
+        if (nullptr == index)
+        {
+            LOG(Helper::LogLevel::LL_Error, "Empty selected index!\n");
+        }
+        else if (index->GetVectorValueType() != remoteQuery.m_valueType
+                 || index->GetFeatureDim() != static_cast<DimensionType>(remoteQuery.m_dimension))
+        {
+            LOG(Helper::LogLevel::LL_Error, "Failed to match vector type or dimension!\n");
+        }
+        else if (static_cast<std::uint64_t>(remoteQuery.m_vectorCount) * remoteQuery.m_dimension * remoteQuery.m_resultNum
+                 > settings->m_maxBatchSearchSize)
+        {
+            LOG(Helper::LogLevel::LL_Error, "Batch query of %u vectors exceeds MaxBatchSearchSize!\n", remoteQuery.m_vectorCount);
+        }
+        else
+        {
+            remoteResult.m_vectorCount = remoteQuery.m_vectorCount;
+            remoteResult.m_resultNum = remoteQuery.m_resultNum;
+            remoteResult.m_withMeta = remoteQuery.m_extractMetadata;
+            remoteResult.m_results.resize(static_cast<std::size_t>(remoteQuery.m_vectorCount) * remoteQuery.m_resultNum);
+
+            std::size_t vectorSize = static_cast<std::size_t>(remoteQuery.m_dimension) * GetValueTypeSize(remoteQuery.m_valueType);
+            remoteResult.m_status = Socket::RemoteSearchResult::ResultStatus::Success;
+            for (std::uint32_t i = 0; i < remoteQuery.m_vectorCount; ++i)
+            {
+                QueryResult query(remoteQuery.m_vectors + i * vectorSize,
+                                  remoteQuery.m_resultNum,
+                                  remoteQuery.m_extractMetadata,
+                                  remoteResult.m_results.data() + static_cast<std::size_t>(i) * remoteQuery.m_resultNum);
+                if (ErrorCode::Success != index->SearchIndex(query))
+                {
+                    LOG(Helper::LogLevel::LL_Error, "Failed to execute SearchIndex!\n");
+                    remoteResult.m_status = Socket::RemoteSearchResult::ResultStatus::FailedExecute;
+                    break;
+                }
+            }
+        }
+    }
+
+    Socket::Packet ret;
+    ret.Header().m_packetType = Socket::PacketType::BatchSearchResponse;
+    ret.Header().m_processStatus = Socket::PacketProcessStatus::Ok;
+    ret.Header().m_connectionID = p_packet.Header().m_connectionID;
+    ret.Header().m_resourceID = p_packet.Header().m_resourceID;
+
+    if (remoteResult.m_status != Socket::RemoteSearchResult::ResultStatus::Success)
+    {
+        ret.Header().m_processStatus = Socket::PacketProcessStatus::Failed;
+        ret.AllocateBuffer(0);
+        ret.Header().WriteBuffer(ret.HeaderBuffer());
+    }
+    else
+    {
+        ret.AllocateBuffer(static_cast<std::uint32_t>(remoteResult.EstimateBufferSize()));
+        auto bodyEnd = remoteResult.Write(ret.Body());
+
+        ret.Header().m_bodyLength = static_cast<std::uint32_t>(bodyEnd - ret.Body());
+        ret.Header().WriteBuffer(ret.HeaderBuffer());
+    }
+
+    m_socketServer->SendPacket(p_packet.Header().m_connectionID, std::move(ret), nullptr);
+}
+
+
+void
+SearchService::ReloadIndexHandler(Socket::ConnectionID p_localConnectionID, Socket::Packet p_packet)
+{
+    if (Socket::c_invalidConnectionID == p_packet.Header().m_connectionID)
+    {
+        p_packet.Header().m_connectionID = p_localConnectionID;
+    }
+
+    Socket::Packet ret;
+    ret.Header().m_packetType = Socket::PacketType::ReloadIndexResponse;
+    ret.Header().m_processStatus = Socket::PacketProcessStatus::Failed;
+    ret.Header().m_connectionID = p_packet.Header().m_connectionID;
+    ret.Header().m_resourceID = p_packet.Header().m_resourceID;
+
+    Socket::RemoteIndexReload request;
+    if (p_packet.Header().m_bodyLength == 0 || request.Read(p_packet.Body(), p_packet.Header().m_bodyLength) == nullptr)
+    {
+        LOG(Helper::LogLevel::LL_Error, "Failed to read index reload request!\n");
+    }
+    else if (ErrorCode::Success == m_serviceContext->ReloadIndex(request.m_indexName, request.m_indexFolder))
+    {
+        ret.Header().m_processStatus = Socket::PacketProcessStatus::Ok;
+    }
+
+    ret.AllocateBuffer(0);
+    ret.Header().WriteBuffer(ret.HeaderBuffer());
+
+    m_socketServer->SendPacket(p_packet.Header().m_connectionID, std::move(ret), nullptr);
+}
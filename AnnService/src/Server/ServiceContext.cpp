@@ -5,6 +5,7 @@
 #include "inc/Helper/SimpleIniReader.h"
 #include "inc/Helper/CommonHelper.h"
 #include "inc/Helper/StringConvert.h"
+#include "inc/Helper/VectorSetReader.h"
 
 using namespace SPTAG;
 using namespace SPTAG::Service;
@@ -25,8 +26,12 @@ ServiceContext::ServiceContext(const std::string& p_configFilePath)
     m_settings->m_listenPort = iniReader.GetParameter("Service", "ListenPort", std::string("8000"));
     m_settings->m_threadNum = iniReader.GetParameter("Service", "ThreadNumber", static_cast<std::uint32_t>(8));
     m_settings->m_socketThreadNum = iniReader.GetParameter("Service", "SocketThreadNumber", static_cast<std::uint32_t>(8));
+    m_settings->m_enableIndexReload = iniReader.GetParameter("Service", "EnableIndexReload", false);
+    m_settings->m_enableAsyncSearch = iniReader.GetParameter("Service", "EnableAsyncSearch", false);
+    m_settings->m_metricsPort = iniReader.GetParameter("Service", "MetricsPort", std::string(""));
 
     m_settings->m_defaultMaxResultNumber = iniReader.GetParameter("QueryConfig", "DefaultMaxResultNumber", static_cast<SizeType>(10));
+    m_settings->m_maxBatchSearchSize = iniReader.GetParameter("QueryConfig", "MaxBatchSearchSize", static_cast<std::uint64_t>(1ULL << 28));
     m_settings->m_vectorSeparator = iniReader.GetParameter("QueryConfig", "DefaultSeparator", std::string("|"));
 
     const std::string emptyStr;
@@ -34,6 +39,7 @@ ServiceContext::ServiceContext(const std::string& p_configFilePath)
     std::string indexListStr = iniReader.GetParameter("Index", "List", emptyStr);
     const auto& indexList = Helper::StrUtils::SplitString(indexListStr, ",");
 
+    std::shared_ptr<IndexMap> indexMap(new IndexMap);
     for (const auto& indexName : indexList)
     {
         std::string sectionName("Index_");
@@ -43,19 +49,22 @@ ServiceContext::ServiceContext(const std::string& p_configFilePath)
             continue;
         }
 
-        std::string indexFolder = iniReader.GetParameter(sectionName, "IndexFolder", emptyStr);
+        IndexConfig& config = m_indexConfigs[indexName];
+        config.m_indexFolder = iniReader.GetParameter(sectionName, "IndexFolder", emptyStr);
+        config.m_warmupFile = iniReader.GetParameter(sectionName, "WarmupFile", emptyStr);
+        config.m_warmupFileType = iniReader.GetParameter(sectionName, "WarmupFileType", VectorFileType::DEFAULT);
 
         std::shared_ptr<VectorIndex> vectorIndex;
-        if (ErrorCode::Success == VectorIndex::LoadIndex(indexFolder, vectorIndex))
+        if (ErrorCode::Success == LoadIndex(indexName, config.m_indexFolder, vectorIndex))
         {
-            vectorIndex->SetIndexName(indexName);
-            m_fullIndexList.emplace(indexName, vectorIndex);
+            indexMap->emplace(indexName, vectorIndex);
         }
         else
         {
             LOG(Helper::LogLevel::LL_Error, "Failed loading index: %s\n", indexName.c_str());
         }
     }
+    m_fullIndexList = indexMap;
 
     m_initialized = true;
 }
@@ -67,10 +76,10 @@ ServiceContext::~ServiceContext()
 }
 
 
-const std::map<std::string, std::shared_ptr<VectorIndex>>&
+std::shared_ptr<const ServiceContext::IndexMap>
 ServiceContext::GetIndexMap() const
 {
-    return m_fullIndexList;
+    return std::atomic_load(&m_fullIndexList);
 }
 
 
@@ -86,3 +95,84 @@ ServiceContext::IsInitialized() const
 {
     return m_initialized;
 }
+
+
+ErrorCode
+ServiceContext::LoadIndex(const std::string& p_indexName, const std::string& p_indexFolder, std::shared_ptr<VectorIndex>& p_index) const
+{
+    ErrorCode ret = VectorIndex::LoadIndex(p_indexFolder, p_index);
+    if (ErrorCode::Success != ret)
+    {
+        return ret;
+    }
+
+    p_index->SetIndexName(p_indexName);
+    return ErrorCode::Success;
+}
+
+
+void
+ServiceContext::WarmupIndex(const std::string& p_indexName, const std::shared_ptr<VectorIndex>& p_index) const
+{
+    auto iter = m_indexConfigs.find(p_indexName);
+    if (iter == m_indexConfigs.end() || iter->second.m_warmupFile.empty())
+    {
+        return;
+    }
+
+    std::shared_ptr<Helper::ReaderOptions> options(new Helper::ReaderOptions(p_index->GetVectorValueType(),
+                                                                             p_index->GetFeatureDim(),
+                                                                             iter->second.m_warmupFileType,
+                                                                             m_settings->m_vectorSeparator));
+    auto reader = Helper::VectorSetReader::CreateInstance(options);
+    if (ErrorCode::Success != reader->LoadFile(iter->second.m_warmupFile))
+    {
+        LOG(Helper::LogLevel::LL_Error, "Failed to read warmup file %s for index %s\n", iter->second.m_warmupFile.c_str(), p_indexName.c_str());
+        return;
+    }
+
+    auto queries = reader->GetVectorSet();
+    QueryResult query(nullptr, m_settings->m_defaultMaxResultNumber, false);
+    for (SizeType i = 0; i < queries->Count(); ++i)
+    {
+        query.SetTarget(queries->GetVector(i));
+        query.Reset();
+        p_index->SearchIndex(query);
+    }
+    LOG(Helper::LogLevel::LL_Info, "Warmed up index %s with %d queries\n", p_indexName.c_str(), queries->Count());
+}
+
+
+ErrorCode
+ServiceContext::ReloadIndex(const std::string& p_indexName, const std::string& p_indexFolder)
+{
+    std::lock_guard<std::mutex> guard(m_reloadLock);
+
+    auto iter = m_indexConfigs.find(p_indexName);
+    if (iter == m_indexConfigs.end())
+    {
+        LOG(Helper::LogLevel::LL_Error, "Index %s is not configured\n", p_indexName.c_str());
+        return ErrorCode::Fail;
+    }
+
+    std::string indexFolder = p_indexFolder.empty() ? iter->second.m_indexFolder : p_indexFolder;
+    LOG(Helper::LogLevel::LL_Info, "Reloading index %s from %s\n", p_indexName.c_str(), indexFolder.c_str());
+
+    std::shared_ptr<VectorIndex> vectorIndex;
+    ErrorCode ret = LoadIndex(p_indexName, indexFolder, vectorIndex);
+    if (ErrorCode::Success != ret)
+    {
+        LOG(Helper::LogLevel::LL_Error, "Failed loading index: %s\n", p_indexName.c_str());
+        return ret;
+    }
+
+    WarmupIndex(p_indexName, vectorIndex);
+
+    std::shared_ptr<IndexMap> indexMap(new IndexMap(*std::atomic_load(&m_fullIndexList)));
+    (*indexMap)[p_indexName] = vectorIndex;
+    std::atomic_store(&m_fullIndexList, std::shared_ptr<const IndexMap>(indexMap));
+    iter->second.m_indexFolder = indexFolder;
+
+    LOG(Helper::LogLevel::LL_Info, "Published new version of index %s\n", p_indexName.c_str());
+    return ErrorCode::Success;
+}
@@ -9,6 +9,9 @@ using namespace SPTAG::Service;
 
 ServiceSettings::ServiceSettings()
     : m_defaultMaxResultNumber(10),
-      m_threadNum(12)
+      m_maxBatchSearchSize(1ULL << 28),
+      m_threadNum(12),
+      m_enableIndexReload(false),
+      m_enableAsyncSearch(false)
 {
 }
@@ -208,3 +208,307 @@ RemoteSearchResult::Read(const std::uint8_t* p_buffer)
 
     return p_buffer;
 }
+
+
+RemoteBatchQuery::RemoteBatchQuery()
+    : m_valueType(VectorValueType::Undefined),
+      m_dimension(0),
+      m_vectorCount(0),
+      m_resultNum(0),
+      m_extractMetadata(false),
+      m_vectors(nullptr)
+{
+}
+
+
+std::size_t
+RemoteBatchQuery::VectorBytes() const
+{
+    return static_cast<std::size_t>(m_vectorCount) * m_dimension * GetValueTypeSize(m_valueType);
+}
+
+
+std::size_t
+RemoteBatchQuery::EstimateBufferSize() const
+{
+    std::size_t sum = 0;
+    sum += SimpleSerialization::EstimateBufferSize(MajorVersion());
+    sum += SimpleSerialization::EstimateBufferSize(MirrorVersion());
+    sum += SimpleSerialization::EstimateBufferSize(m_indexName);
+    sum += SimpleSerialization::EstimateBufferSize(m_valueType);
+    sum += SimpleSerialization::EstimateBufferSize(m_dimension);
+    sum += SimpleSerialization::EstimateBufferSize(m_vectorCount);
+    sum += SimpleSerialization::EstimateBufferSize(m_resultNum);
+    sum += SimpleSerialization::EstimateBufferSize(m_extractMetadata);
+
+    return sum + c_vectorAlignment + VectorBytes();
+}
+
+
+std::uint8_t*
+RemoteBatchQuery::Write(std::uint8_t* p_buffer) const
+{
+    std::uint8_t* begin = p_buffer;
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(MajorVersion(), p_buffer);
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(MirrorVersion(), p_buffer);
+
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(m_indexName, p_buffer);
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(m_valueType, p_buffer);
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(m_dimension, p_buffer);
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(m_vectorCount, p_buffer);
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(m_resultNum, p_buffer);
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(m_extractMetadata, p_buffer);
+
+    std::size_t padding = (c_vectorAlignment - (p_buffer - begin) % c_vectorAlignment) % c_vectorAlignment;
+    std::memset(p_buffer, 0, padding);
+    p_buffer += padding;
+
+    std::size_t bytes = VectorBytes();
+    if (bytes > 0)
+    {
+        std::memcpy(p_buffer, m_vectors, bytes);
+    }
+
+    return p_buffer + bytes;
+}
+
+
+const std::uint8_t*
+RemoteBatchQuery::Read(const std::uint8_t* p_buffer, std::size_t p_length)
+{
+    const std::uint8_t* begin = p_buffer;
+    const std::uint8_t* end = p_buffer + p_length;
+
+    decltype(MajorVersion()) majorVer = 0;
+    decltype(MirrorVersion()) mirrorVer = 0;
+    std::uint32_t nameLen = 0;
+    if (p_length < sizeof(majorVer) + sizeof(mirrorVer) + sizeof(nameLen))
+    {
+        return nullptr;
+    }
+
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, majorVer);
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, mirrorVer);
+    if (majorVer != MajorVersion())
+    {
+        return nullptr;
+    }
+
+    SimpleSerialization::SimpleReadBuffer(p_buffer, nameLen);
+    std::size_t headerLen = (p_buffer - begin) + sizeof(nameLen) + nameLen
+        + sizeof(m_valueType) + sizeof(m_dimension) + sizeof(m_vectorCount) + sizeof(m_resultNum) + sizeof(m_extractMetadata);
+    if (headerLen > p_length)
+    {
+        return nullptr;
+    }
+
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, m_indexName);
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, m_valueType);
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, m_dimension);
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, m_vectorCount);
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, m_resultNum);
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, m_extractMetadata);
+
+    p_buffer += (c_vectorAlignment - (p_buffer - begin) % c_vectorAlignment) % c_vectorAlignment;
+    if (p_buffer > end || static_cast<std::size_t>(end - p_buffer) < VectorBytes())
+    {
+        return nullptr;
+    }
+
+    m_vectors = p_buffer;
+    return p_buffer + VectorBytes();
+}
+
+
+RemoteBatchSearchResult::RemoteBatchSearchResult()
+    : m_status(RemoteSearchResult::ResultStatus::Timeout),
+      m_vectorCount(0),
+      m_resultNum(0),
+      m_withMeta(false)
+{
+}
+
+
+std::size_t
+RemoteBatchSearchResult::EstimateBufferSize() const
+{
+    std::size_t sum = 0;
+    sum += SimpleSerialization::EstimateBufferSize(MajorVersion());
+    sum += SimpleSerialization::EstimateBufferSize(MirrorVersion());
+
+    sum += SimpleSerialization::EstimateBufferSize(m_status);
+    sum += SimpleSerialization::EstimateBufferSize(m_vectorCount);
+    sum += SimpleSerialization::EstimateBufferSize(m_resultNum);
+    sum += SimpleSerialization::EstimateBufferSize(m_withMeta);
+
+    sum += m_results.size() * (sizeof(SizeType) + sizeof(float));
+    if (m_withMeta)
+    {
+        for (const auto& res : m_results)
+        {
+            sum += SimpleSerialization::EstimateBufferSize(res.Meta);
+        }
+    }
+
+    return sum;
+}
+
+
+std::uint8_t*
+RemoteBatchSearchResult::Write(std::uint8_t* p_buffer) const
+{
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(MajorVersion(), p_buffer);
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(MirrorVersion(), p_buffer);
+
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(m_status, p_buffer);
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(m_vectorCount, p_buffer);
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(m_resultNum, p_buffer);
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(m_withMeta, p_buffer);
+
+    for (const auto& res : m_results)
+    {
+        p_buffer = SimpleSerialization::SimpleWriteBuffer(res.VID, p_buffer);
+        p_buffer = SimpleSerialization::SimpleWriteBuffer(res.Dist, p_buffer);
+    }
+
+    if (m_withMeta)
+    {
+        for (const auto& res : m_results)
+        {
+            p_buffer = SimpleSerialization::SimpleWriteBuffer(res.Meta, p_buffer);
+        }
+    }
+
+    return p_buffer;
+}
+
+
+const std::uint8_t*
+RemoteBatchSearchResult::Read(const std::uint8_t* p_buffer, std::size_t p_length)
+{
+    const std::uint8_t* end = p_buffer + p_length;
+    decltype(MajorVersion()) majorVer = 0;
+    decltype(MirrorVersion()) mirrorVer = 0;
+    if (p_length < sizeof(majorVer) + sizeof(mirrorVer) + sizeof(m_status) + sizeof(m_vectorCount) + sizeof(m_resultNum) + sizeof(m_withMeta))
+    {
+        return nullptr;
+    }
+
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, majorVer);
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, mirrorVer);
+    if (majorVer != MajorVersion())
+    {
+        return nullptr;
+    }
+
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, m_status);
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, m_vectorCount);
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, m_resultNum);
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, m_withMeta);
+
+    std::size_t resultNum = static_cast<std::size_t>(m_vectorCount) * m_resultNum;
+    if (static_cast<std::size_t>(end - p_buffer) / (sizeof(SizeType) + sizeof(float)) < resultNum)
+    {
+        return nullptr;
+    }
+
+    m_results.resize(resultNum);
+    for (auto& res : m_results)
+    {
+        p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, res.VID);
+        p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, res.Dist);
+    }
+
+    if (m_withMeta)
+    {
+        for (auto& res : m_results)
+        {
+            std::uint32_t metaLen = 0;
+            if (static_cast<std::size_t>(end - p_buffer) < sizeof(metaLen))
+            {
+                return nullptr;
+            }
+
+            SimpleSerialization::SimpleReadBuffer(p_buffer, metaLen);
+            if (static_cast<std::size_t>(end - p_buffer) - sizeof(metaLen) < metaLen)
+            {
+                return nullptr;
+            }
+
+            p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, res.Meta);
+        }
+    }
+
+    return p_buffer;
+}
+
+
+RemoteIndexReload::RemoteIndexReload()
+{
+}
+
+
+std::size_t
+RemoteIndexReload::EstimateBufferSize() const
+{
+    std::size_t sum = 0;
+    sum += SimpleSerialization::EstimateBufferSize(MajorVersion());
+    sum += SimpleSerialization::EstimateBufferSize(MirrorVersion());
+    sum += SimpleSerialization::EstimateBufferSize(m_indexName);
+    sum += SimpleSerialization::EstimateBufferSize(m_indexFolder);
+
+    return sum;
+}
+
+
+std::uint8_t*
+RemoteIndexReload::Write(std::uint8_t* p_buffer) const
+{
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(MajorVersion(), p_buffer);
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(MirrorVersion(), p_buffer);
+
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(m_indexName, p_buffer);
+    p_buffer = SimpleSerialization::SimpleWriteBuffer(m_indexFolder, p_buffer);
+
+    return p_buffer;
+}
+
+
+const std::uint8_t*
+RemoteIndexReload::Read(const std::uint8_t* p_buffer, std::size_t p_length)
+{
+    const std::uint8_t* end = p_buffer + p_length;
+
+    decltype(MajorVersion()) majorVer = 0;
+    decltype(MirrorVersion()) mirrorVer = 0;
+    if (p_length < sizeof(majorVer) + sizeof(mirrorVer))
+    {
+        return nullptr;
+    }
+
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, majorVer);
+    p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, mirrorVer);
+    if (majorVer != MajorVersion())
+    {
+        return nullptr;
+    }
+
+    for (std::string* field : { &m_indexName, &m_indexFolder })
+    {
+        std::uint32_t len = 0;
+        if (static_cast<std::size_t>(end - p_buffer) < sizeof(len))
+        {
+            return nullptr;
+        }
+
+        SimpleSerialization::SimpleReadBuffer(p_buffer, len);
+        if (static_cast<std::size_t>(end - p_buffer) - sizeof(len) < len)
+        {
+            return nullptr;
+        }
+
+        p_buffer = SimpleSerialization::SimpleReadBuffer(p_buffer, *field);
+    }
+
+    return p_buffer;
+}
@@ -0,0 +1,93 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "inc/Helper/VectorSetReader.h"
+#include "inc/Core/Common.h"
+#include "inc/Core/Common/TruthSet.h"
+
+#include <memory>
+#include <chrono>
+#include <omp.h>
+
+using namespace SPTAG;
+
+class TruthOptions : public Helper::ReaderOptions
+{
+public:
+    TruthOptions() : Helper::ReaderOptions(VectorValueType::Float, 0, VectorFileType::DEFAULT, "|", 32)
+    {
+        AddRequiredOption(m_inputFiles, "-i", "--input", "Input base vectors.");
+        AddRequiredOption(m_queryFiles, "-q", "--query", "Input query vectors.");
+        AddRequiredOption(m_truthFile, "-o", "--output", "Output truth file.");
+        AddOptionalOption(m_queryFileType, "-qf", "--queryfiletype", "Query file type (DEFAULT, TXT, XVEC). Default is DEFAULT.");
+        AddOptionalOption(m_truthFileType, "-tf", "--truthfiletype", "Truth file type (TXT, XVEC, DEFAULT). Default is DEFAULT.");
+        AddOptionalOption(m_distCalcMethod, "-m", "--dist", "Distance method (L2, Cosine). Default is L2.");
+        AddOptionalOption(m_K, "-k", "--KNN", "Number of nearest neighbors per query.");
+    }
+
+    ~TruthOptions() {}
+
+    std::string m_inputFiles;
+
+    std::string m_queryFiles;
+
+    std::string m_truthFile;
+
+    VectorFileType m_queryFileType = VectorFileType::DEFAULT;
+
+    TruthFileType m_truthFileType = TruthFileType::DEFAULT;
+
+    DistCalcMethod m_distCalcMethod = DistCalcMethod::L2;
+
+    int m_K = 100;
+};
+
+int main(int argc, char* argv[])
+{
+    std::shared_ptr<TruthOptions> options(new TruthOptions);
+    if (!options->Parse(argc - 1, argv + 1))
+    {
+        exit(1);
+    }
+
+    auto vectorReader = Helper::VectorSetReader::CreateInstance(options);
+    if (ErrorCode::Success != vectorReader->LoadFile(options->m_inputFiles))
+    {
+        LOG(Helper::LogLevel::LL_Error, "Failed to read vector file.\n");
+        exit(1);
+    }
+
+    std::shared_ptr<Helper::ReaderOptions> queryOptions(new Helper::ReaderOptions(options->m_inputValueType, options->m_dimension, options->m_queryFileType, options->m_vectorDelimiter, options->m_threadNum, options->m_normalized));
+    auto queryReader = Helper::VectorSetReader::CreateInstance(queryOptions);
+    if (ErrorCode::Success != queryReader->LoadFile(options->m_queryFiles))
+    {
+        LOG(Helper::LogLevel::LL_Error, "Failed to read query file.\n");
+        exit(1);
+    }
+
+    auto vectorSet = vectorReader->GetVectorSet();
+    auto querySet = queryReader->GetVectorSet();
+    if (options->m_distCalcMethod == DistCalcMethod::Cosine && !options->m_normalized)
+    {
+        vectorSet->Normalize(options->m_threadNum);
+        querySet->Normalize(options->m_threadNum);
+    }
+
+    omp_set_num_threads(options->m_threadNum);
+    LOG(Helper::LogLevel::LL_Info, "Start generating truth: %d queries, %d vectors, K=%d.\n", querySet->Count(), vectorSet->Count(), options->m_K);
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+#define DefineVectorValueType(Name, Type) \
+    if (options->m_inputValueType == VectorValueType::Name) { \
+        COMMON::TruthSet::GenerateTruth<Type>(querySet, vectorSet, options->m_truthFile, \
+            options->m_distCalcMethod, options->m_K, options->m_truthFileType); \
+    } \
+
+#include "inc/Core/DefinitionList.h"
+#undef DefineVectorValueType
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    double elapsedSeconds = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() / 1000.0;
+    LOG(Helper::LogLevel::LL_Info, "End generating truth: %.2lf seconds.\n", elapsedSeconds);
+    return 0;
+}
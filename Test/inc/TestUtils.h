@@ -0,0 +1,91 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "inc/Test.h"
+#include "inc/Core/VectorIndex.h"
+#include "inc/Helper/StringConvert.h"
+
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+
+// Data and index builders shared by the test suites.
+namespace SPTAG
+{
+    namespace TestUtils
+    {
+        // Parameters by section and name. SPANN reads the Base, SelectHead, BuildHead and BuildSSDIndex
+        // sections, the other indexes the Index section.
+        typedef std::map<std::string, std::map<std::string, std::string>> IndexConfig;
+
+        // Search internal result number of BuildSPANNIndex; queries on those indexes must hold at least
+        // this many results since the head search fills all of them.
+        const int c_spannInternalResultNum = 32;
+
+        // p_count vectors of p_dim values drawn uniformly from [p_min, p_max) by a generator seeded with p_seed.
+        template <typename T>
+        std::shared_ptr<VectorSet> RandomVectors(SizeType p_count, DimensionType p_dim, unsigned p_seed, float p_min = 0, float p_max = 100)
+        {
+            std::mt19937 rng(p_seed);
+            std::uniform_real_distribution<float> dist(p_min, p_max);
+            ByteArray data = ByteArray::Alloc(sizeof(T) * p_count * p_dim);
+            T* vec = (T*)data.Data();
+            for (SizeType i = 0; i < p_count * p_dim; i++) vec[i] = (T)dist(rng);
+            return std::make_shared<BasicVectorSet>(data, GetEnumValueType<T>(), p_dim, p_count);
+        }
+
+        // Vector i lies at (p_step * i + p_offset, 0, ...), so sets with the same step and different offsets
+        // interleave along one axis.
+        inline std::shared_ptr<VectorSet> LineVectors(SizeType p_count, DimensionType p_dim, float p_step, float p_offset)
+        {
+            ByteArray data = ByteArray::Alloc(sizeof(float) * p_count * p_dim);
+            float* vec = (float*)data.Data();
+            std::fill(vec, vec + (size_t)p_count * p_dim, 0.0f);
+            for (SizeType i = 0; i < p_count; i++) vec[(size_t)i * p_dim] = p_step * i + p_offset;
+            return std::make_shared<BasicVectorSet>(data, VectorValueType::Float, p_dim, p_count);
+        }
+
+        inline std::shared_ptr<VectorIndex> BuildIndex(IndexAlgoType p_algo, const std::shared_ptr<VectorSet>& p_vectors, const IndexConfig& p_config)
+        {
+            std::shared_ptr<VectorIndex> index = VectorIndex::CreateInstance(p_algo, p_vectors->GetValueType());
+            for (auto& sectionKV : p_config) {
+                for (auto& KV : sectionKV.second) {
+                    index->SetParameter(KV.first, KV.second, sectionKV.first);
+                }
+            }
+            BOOST_REQUIRE(ErrorCode::Success == index->BuildIndex(p_vectors->GetData(), p_vectors->Count(), p_vectors->Dimension()));
+            return index;
+        }
+
+        // A static L2 SPANN index with its postings in one file under p_dir; p_config overrides or adds parameters.
+        inline std::shared_ptr<VectorIndex> BuildSPANNIndex(const std::string& p_dir, const std::shared_ptr<VectorSet>& p_vectors, const IndexConfig& p_config = {})
+        {
+            boost::filesystem::remove_all(p_dir);
+            IndexConfig config = {
+                { "Base", { { "ValueType", Helper::Convert::ConvertToString(p_vectors->GetValueType()) }, { "DistCalcMethod", "L2" }, { "IndexAlgoType", "BKT" },
+                    { "Dim", std::to_string(p_vectors->Dimension()) }, { "IndexDirectory", p_dir } } },
+                { "SelectHead", { { "isExecute", "true" }, { "Ratio", "0.1" }, { "NumberOfThreads", "2" } } },
+                { "BuildHead", { { "isExecute", "true" }, { "NumberOfThreads", "2" } } },
+                { "BuildSSDIndex", { { "isExecute", "true" }, { "BuildSsdIndex", "true" }, { "NumberOfThreads", "2" },
+                    { "TmpDir", p_dir }, { "PostingPageLimit", "4" }, { "SearchPostingPageLimit", "4" }, { "InternalResultNum", "32" },
+                    { "SearchInternalResultNum", std::to_string(c_spannInternalResultNum) }, { "ResultNum", "10" }, { "SearchThreadNum", "2" } } }
+            };
+            for (auto& sectionKV : p_config) {
+                for (auto& KV : sectionKV.second) config[sectionKV.first][KV.first] = KV.second;
+            }
+            return BuildIndex(IndexAlgoType::SPANN, p_vectors, config);
+        }
+
+        // A BKT index over p_vectors saved to p_folder, for the suites that load indexes through a service config.
+        inline void SaveBKTIndex(const std::string& p_folder, const std::shared_ptr<VectorSet>& p_vectors)
+        {
+            auto index = BuildIndex(IndexAlgoType::BKT, p_vectors, { { "Index", { { "DistCalcMethod", "L2" } } } });
+            BOOST_REQUIRE(ErrorCode::Success == index->SaveIndex(p_folder));
+        }
+    }
+}
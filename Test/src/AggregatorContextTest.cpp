@@ -0,0 +1,127 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "inc/Test.h"
+#include "inc/Aggregator/AggregatorContext.h"
+#include "inc/Aggregator/AggregatorExecutionContext.h"
+
+#include <fstream>
+#include <vector>
+
+namespace
+{
+    namespace Local
+    {
+        // Five servers in three shards; group 7 is listed first but sorts last.
+        std::shared_ptr<SPTAG::Aggregator::AggregatorContext> CreateContext(const std::string& p_extra)
+        {
+            std::ofstream config("aggregator_test.ini");
+            config << "[Service]\nHedgeMinDelay=4\nLatencyDecay=0.5\n" << p_extra << "\n";
+            config << "[Servers]\nNumber=6\n\n";
+            config << "[Server_0]\nAddress=127.0.0.1\nPort=9000\nGroup=7\n\n";
+            config << "[Server_1]\nAddress=127.0.0.1\nPort=9001\nGroup=1\n\n";
+            config << "[Server_2]\nAddress=127.0.0.1\nPort=9002\nGroup=1\n\n";
+            config << "[Server_3]\nAddress=127.0.0.1\nPort=9003\nGroup=1\n\n";
+            config << "[Server_4]\nAddress=127.0.0.1\nPort=9004\nGroup=2\n\n";
+            // a server without an address is skipped
+            config << "[Server_5]\nPort=9005\nGroup=2\n";
+            config.close();
+
+            std::shared_ptr<SPTAG::Aggregator::AggregatorContext> context(new SPTAG::Aggregator::AggregatorContext("aggregator_test.ini"));
+            BOOST_REQUIRE(context->IsInitialized());
+            return context;
+        }
+
+        void Connect(const std::vector<std::shared_ptr<SPTAG::Aggregator::RemoteMachine>>& p_servers)
+        {
+            for (const auto& server : p_servers) server->m_status = SPTAG::Aggregator::RemoteMachineStatus::Connected;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(AggregatorContextTest)
+
+BOOST_AUTO_TEST_CASE(GroupsServersIntoShards)
+{
+    auto context = Local::CreateContext("");
+    BOOST_CHECK_EQUAL(context->GetRemoteServers().size(), 5);
+
+    const auto& shards = context->GetShards();
+    BOOST_REQUIRE_EQUAL(shards.size(), 3);
+    BOOST_REQUIRE_EQUAL(shards[0].size(), 3);
+    BOOST_REQUIRE_EQUAL(shards[1].size(), 1);
+    BOOST_REQUIRE_EQUAL(shards[2].size(), 1);
+    for (const auto& server : shards[0]) BOOST_CHECK_EQUAL(server->m_group, 1);
+    BOOST_CHECK_EQUAL(shards[1][0]->m_port, "9004");
+    BOOST_CHECK_EQUAL(shards[2][0]->m_port, "9000");
+}
+
+BOOST_AUTO_TEST_CASE(PickReplicaByLoad)
+{
+    auto context = Local::CreateContext("");
+    const auto& replicas = context->GetShards()[0];
+
+    // nothing is connected yet
+    BOOST_CHECK(context->PickReplica(0, {}) == nullptr);
+
+    Local::Connect(replicas);
+    replicas[0]->RecordLatency(10, 0.5f);
+    replicas[1]->RecordLatency(2, 0.5f);
+    replicas[2]->RecordLatency(6, 0.5f);
+    BOOST_CHECK(context->PickReplica(0, {}) == replicas[1]);
+
+    // requests already waiting on a replica make it look slower
+    replicas[1]->m_outstanding = 3;
+    BOOST_CHECK(context->PickReplica(0, {}) == replicas[2]);
+    replicas[1]->m_outstanding = 0;
+
+    // replicas already tried are excluded, and a disconnected one is never picked
+    BOOST_CHECK(context->PickReplica(0, { replicas[1] }) == replicas[2]);
+    replicas[2]->m_status = SPTAG::Aggregator::RemoteMachineStatus::Disconnected;
+    BOOST_CHECK(context->PickReplica(0, { replicas[1] }) == replicas[0]);
+    BOOST_CHECK(context->PickReplica(0, { replicas[1], replicas[0] }) == nullptr);
+
+    // the smoothed latency follows recent samples
+    replicas[1]->RecordLatency(30, 0.5f);
+    BOOST_CHECK_CLOSE(replicas[1]->m_latencyEWMA.load(), 16.0f, 1e-3);
+    replicas[2]->m_status = SPTAG::Aggregator::RemoteMachineStatus::Connected;
+    BOOST_CHECK(context->PickReplica(0, {}) == replicas[2]);
+}
+
+BOOST_AUTO_TEST_CASE(HedgeDelayFromShardLatency)
+{
+    auto context = Local::CreateContext("HedgePercentile=90\n");
+    const auto& replicas = context->GetShards()[0];
+
+    // no samples yet: wait the minimum delay
+    BOOST_CHECK_EQUAL(context->GetHedgeDelay(0), 4);
+
+    // samples from all replicas of the shard are pooled
+    for (int i = 1; i <= 100; i++) replicas[i % 3]->RecordLatency((float)i, 0.5f);
+    BOOST_CHECK_EQUAL(context->GetHedgeDelay(0), 91);
+
+    // a fast shard still waits at least the minimum delay
+    context->GetShards()[1][0]->RecordLatency(1, 0.5f);
+    BOOST_CHECK_EQUAL(context->GetHedgeDelay(1), 4);
+
+    // only the most recent samples of a replica are kept
+    for (int i = 0; i < 1000; i++) context->GetShards()[2][0]->RecordLatency(i < 500 ? 1000.0f : 20.0f, 0.5f);
+    BOOST_CHECK_EQUAL(context->GetHedgeDelay(2), 20);
+}
+
+BOOST_AUTO_TEST_CASE(ShardRequestsCompleteOnce)
+{
+    SPTAG::Aggregator::AggregatorExecutionContext context(3, SPTAG::Socket::PacketHeader(), SPTAG::Socket::Packet());
+    BOOST_CHECK_EQUAL(context.GetServerNumber(), 3);
+    for (std::size_t i = 0; i < 3; i++)
+    {
+        BOOST_CHECK(!context.GetShardRequest(i).m_finished);
+        BOOST_CHECK(context.GetResult(i) == nullptr);
+    }
+
+    BOOST_CHECK(!context.IsCompletedAfterFinsh(1));
+    BOOST_CHECK(!context.IsCompletedAfterFinsh(1));
+    BOOST_CHECK(context.IsCompletedAfterFinsh(1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
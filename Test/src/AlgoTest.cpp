@@ -2,12 +2,20 @@
 // Licensed under the MIT License.
 
 #include "inc/Test.h"
+#include "inc/TestUtils.h"
 #include "inc/Helper/SimpleIniReader.h"
 #include "inc/Core/VectorIndex.h"
 #include "inc/Core/Common/CommonUtils.h"
+#include "inc/Core/Common/BKTree.h"
+#include "inc/Core/Common/RelativeNeighborhoodGraph.h"
+#include "inc/Helper/WorkStealingPool.h"
 
+#include <atomic>
+#include <stdexcept>
 #include <unordered_set>
 #include <chrono>
+#include <random>
+#include <algorithm>
 
 template <typename T>
 void Build(SPTAG::IndexAlgoType algo, std::string distCalcMethod, std::shared_ptr<SPTAG::VectorSet>& vec, std::shared_ptr<SPTAG::MetadataSet>& meta, const std::string out)
@@ -113,6 +121,164 @@ void Delete(const std::string folder, T* vec, SPTAG::SizeType n, const std::stri
     vecIndex.reset();
 }
 
+// Fraction of the exact k nearest samples of every query that the index returns.
+template <typename T>
+float Recall(std::shared_ptr<SPTAG::VectorIndex>& vecIndex, std::shared_ptr<SPTAG::VectorSet>& queries, int k)
+{
+    SPTAG::SizeType n = vecIndex->GetNumSamples();
+    int hits = 0;
+    for (SPTAG::SizeType i = 0; i < queries->Count(); i++)
+    {
+        std::vector<std::pair<float, SPTAG::SizeType>> truth(n);
+        for (SPTAG::SizeType j = 0; j < n; j++) truth[j] = std::make_pair(vecIndex->ComputeDistance(queries->GetVector(i), vecIndex->GetSample(j)), j);
+        std::partial_sort(truth.begin(), truth.begin() + k, truth.end());
+        std::unordered_set<SPTAG::SizeType> truthSet;
+        for (int j = 0; j < k; j++) truthSet.insert(truth[j].second);
+
+        SPTAG::QueryResult res(queries->GetVector(i), k, false);
+        vecIndex->SearchIndex(res);
+        for (int j = 0; j < k; j++) hits += (int)truthSet.count(res.GetResult(j)->VID);
+    }
+    return (float)hits / (queries->Count() * k);
+}
+
+// Counts how often every sample is reached below p_node and returns the largest node index visited.
+SPTAG::SizeType CollectTree(const SPTAG::COMMON::BKTree& tree, SPTAG::SizeType p_node, bool p_root, std::vector<int>& seen)
+{
+    const SPTAG::COMMON::BKTNode& node = tree[p_node];
+    // a root holds the sample count unless its samples could not be clustered
+    if (!p_root || node.childStart < 0)
+    {
+        BOOST_REQUIRE(node.centerid >= 0 && node.centerid < (SPTAG::SizeType)seen.size());
+        seen[node.centerid]++;
+    }
+
+    SPTAG::SizeType last = p_node;
+    if (node.childEnd == -1) return last;
+    for (SPTAG::SizeType child = std::abs(node.childStart); child < node.childEnd; child++)
+    {
+        last = std::max(last, CollectTree(tree, child, false, seen));
+    }
+    return last;
+}
+
+// Checks the blocked center ranking against every exact distance plus the count penalty.
+template <typename T>
+void KmeansNearestCentersTest(SPTAG::DistCalcMethod distMethod, int K, SPTAG::DimensionType m, float lambda)
+{
+    SPTAG::SizeType n = 203, first = 3;
+    std::shared_ptr<SPTAG::VectorSet> vectors = SPTAG::TestUtils::RandomVectors<T>(n, m, 4);
+    std::shared_ptr<SPTAG::VectorSet> centers = SPTAG::TestUtils::RandomVectors<T>(K, m, 5);
+    SPTAG::COMMON::Dataset<T> data(n, m, 64, n, (T*)vectors->GetData(), false);
+    std::vector<SPTAG::SizeType> indices(n);
+    for (SPTAG::SizeType i = 0; i < n; i++) indices[i] = n - 1 - i;
+
+    SPTAG::COMMON::KmeansArgs<T> args(K, m, n, 1, distMethod);
+    std::memcpy(args.centers, centers->GetData(), sizeof(T) * K * m);
+    std::mt19937 rng(6);
+    for (int k = 0; k < K; k++) args.counts[k] = rng() % 50;
+    SPTAG::COMMON::GemmKernel::PackPanels<T>([&](SPTAG::SizeType k) { return (const T*)(args.centers + k * m); }, K, m, args.centerPanels, args.centerNorms);
+
+    // labels and distances are written in whole row blocks
+    std::vector<float> rows((size_t)SPTAG::COMMON::GemmKernel::c_rowBlock * m);
+    std::vector<int> labels(n + SPTAG::COMMON::GemmKernel::c_rowBlock);
+    std::vector<float> dists(n + SPTAG::COMMON::GemmKernel::c_rowBlock);
+    SPTAG::COMMON::KmeansNearestCenters(data, indices, first, n, args, lambda, rows.data(), labels.data(), dists.data());
+
+    float maxCenterNorm = 0;
+    for (int k = 0; k < K; k++) maxCenterNorm = std::max(maxCenterNorm, args.centerNorms[k]);
+    for (SPTAG::SizeType i = first; i < n; i++)
+    {
+        const T* v = (const T*)data[indices[i]];
+        float best = SPTAG::MaxDist, norm = 0;
+        for (SPTAG::DimensionType j = 0; j < m; j++) norm += (float)v[j] * (float)v[j];
+        for (int k = 0; k < K; k++) best = std::min(best, args.fComputeDistance(v, args.centers + k * m, m) + lambda * args.counts[k]);
+
+        int label = labels[i - first];
+        BOOST_REQUIRE(label >= 0 && label < K);
+        float chosen = args.fComputeDistance(v, args.centers + label * m, m) + lambda * args.counts[label];
+        BOOST_CHECK_EQUAL(dists[i - first], chosen);
+        // integer data is ranked exactly; float ranking may only differ by rounding of the expanded form
+        BOOST_CHECK_LE(chosen, best + (std::is_same<T, float>::value ? 1e-5f * (norm + maxCenterNorm) : 0.0f));
+    }
+}
+
+// A small RNG graph whose KNN lists can be set up without building the whole graph.
+class TestGraph : public SPTAG::COMMON::RelativeNeighborhoodGraph
+{
+public:
+    TestGraph()
+    {
+        m_iTPTNumber = 4;
+        m_iTPTLeafSize = 200;
+        m_iCEF = 200;
+    }
+
+    void InitLists(SPTAG::SizeType n, SPTAG::DimensionType k)
+    {
+        m_iGraphSize = n;
+        m_iNeighborhoodSize = k;
+        m_pNeighborhoodGraph.Initialize(n, k, 1024, n);
+    }
+};
+
+// Fraction of the exact p_k nearest neighbors of the first p_nodes nodes found in their lists.
+float KNNRecall(std::shared_ptr<SPTAG::VectorIndex>& vecIndex, const TestGraph& graph, SPTAG::SizeType p_nodes, int p_k)
+{
+    SPTAG::SizeType n = vecIndex->GetNumSamples();
+    int hits = 0;
+    for (SPTAG::SizeType i = 0; i < p_nodes; i++)
+    {
+        std::vector<std::pair<float, SPTAG::SizeType>> truth;
+        for (SPTAG::SizeType j = 0; j < n; j++) if (j != i) truth.emplace_back(vecIndex->ComputeDistance(vecIndex->GetSample(i), vecIndex->GetSample(j)), j);
+        std::partial_sort(truth.begin(), truth.begin() + p_k, truth.end());
+        for (int j = 0; j < p_k; j++)
+        {
+            const SPTAG::SizeType* row = graph[i];
+            hits += (int)(std::find(row, row + p_k, truth[j].second) != row + p_k);
+        }
+    }
+    return (float)hits / (p_nodes * p_k);
+}
+
+template <typename T>
+void BatchInsertTest(SPTAG::IndexAlgoType algo, std::string distCalcMethod)
+{
+    SPTAG::SizeType n = 2000, added = 500;
+    SPTAG::DimensionType m = 16;
+    int k = 10;
+    std::shared_ptr<SPTAG::VectorSet> base = SPTAG::TestUtils::RandomVectors<T>(n, m, 1);
+    std::shared_ptr<SPTAG::VectorSet> extra = SPTAG::TestUtils::RandomVectors<T>(added, m, 2);
+
+    std::shared_ptr<SPTAG::VectorIndex> vecIndex = SPTAG::VectorIndex::CreateInstance(algo, SPTAG::GetEnumValueType<T>());
+    vecIndex->SetParameter("DistCalcMethod", distCalcMethod);
+    vecIndex->SetParameter("NumberOfThreads", "4");
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == vecIndex->BuildIndex(base, nullptr));
+
+    int begin = 0, end = 0;
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == vecIndex->AddIndexId(extra->GetData(), added, m, begin, end));
+    BOOST_CHECK_EQUAL(begin, n);
+    BOOST_CHECK_EQUAL(end, n + added);
+
+    std::vector<SPTAG::SizeType> ids;
+    for (SPTAG::SizeType i = begin; i < end; i++) ids.push_back(i);
+    BOOST_CHECK(SPTAG::ErrorCode::Fail == vecIndex->AddIndexIdxBatch(std::vector<SPTAG::SizeType>(1, end)));
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == vecIndex->AddIndexIdxBatch(ids));
+
+    // every new node is linked in and reachable
+    for (SPTAG::SizeType i = 0; i < added; i++)
+    {
+        SPTAG::QueryResult res(extra->GetVector(i), 1, false);
+        vecIndex->SearchIndex(res);
+        BOOST_CHECK_EQUAL(res.GetResult(0)->VID, n + i);
+    }
+
+    std::shared_ptr<SPTAG::VectorSet> queries = SPTAG::TestUtils::RandomVectors<T>(100, m, 3);
+    float recall = Recall<T>(vecIndex, queries, k);
+    std::cout << "Recall@" << k << " after batched insertion: " << recall << std::endl;
+    BOOST_CHECK_GE(recall, 0.9f);
+}
+
 template <typename T>
 void Test(SPTAG::IndexAlgoType algo, std::string distCalcMethod)
 {
@@ -189,4 +355,159 @@ BOOST_AUTO_TEST_CASE(BKTTest)
     Test<float>(SPTAG::IndexAlgoType::BKT, "L2");
 }
 
+BOOST_AUTO_TEST_CASE(BKTBatchInsertTest)
+{
+    BatchInsertTest<float>(SPTAG::IndexAlgoType::BKT, "L2");
+}
+
+BOOST_AUTO_TEST_CASE(KmeansNearestCentersMatchesScan)
+{
+    // center counts around the panel width and odd dimensions leave partial panels and blocks
+    for (auto distMethod : { SPTAG::DistCalcMethod::L2, SPTAG::DistCalcMethod::Cosine })
+    {
+        for (int K : { 5, 16, 33 })
+        {
+            for (float lambda : { 0.0f, 10.0f })
+            {
+                KmeansNearestCentersTest<float>(distMethod, K, 37, lambda);
+                KmeansNearestCentersTest<std::int8_t>(distMethod, K, 37, lambda);
+                KmeansNearestCentersTest<std::uint8_t>(distMethod, K, 16, lambda);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(GraphBuildPaths)
+{
+    SPTAG::SizeType n = 3000;
+    SPTAG::DimensionType m = 16;
+    int k = 32;
+    std::shared_ptr<SPTAG::VectorSet> vectors = SPTAG::TestUtils::RandomVectors<float>(n, m, 7);
+    std::shared_ptr<SPTAG::VectorIndex> vecIndex = SPTAG::VectorIndex::CreateInstance(SPTAG::IndexAlgoType::BKT, SPTAG::VectorValueType::Float);
+    vecIndex->SetParameter("DistCalcMethod", "L2");
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == vecIndex->BuildIndex(vectors, nullptr));
+
+    // The blocked leaf join gives the same KNN lists as the pairwise loop, over leaves of two shuffled trees.
+    TestGraph blocked, pairwise;
+    SPTAG::COMMON::Dataset<float> blockedDists(n, k, 1024, n), pairwiseDists(n, k, 1024, n);
+    blocked.InitLists(n, k);
+    pairwise.InitLists(n, k);
+    for (SPTAG::SizeType i = 0; i < n; i++)
+    {
+        for (int j = 0; j < k; j++) blockedDists[i][j] = pairwiseDists[i][j] = SPTAG::MaxDist;
+    }
+
+    std::vector<SPTAG::SizeType> ids(n);
+    std::vector<float> rows, panels, norms;
+    std::mt19937 rng(8);
+    for (int tree = 0; tree < 2; tree++)
+    {
+        for (SPTAG::SizeType i = 0; i < n; i++) ids[i] = i;
+        std::shuffle(ids.begin(), ids.end(), rng);
+        SPTAG::SizeType first = 0;
+        for (SPTAG::SizeType leaf = 1; first < n; leaf = leaf * 3 + tree)
+        {
+            SPTAG::SizeType count = std::min(leaf, n - first);
+            blocked.AddLeafNeighbors<float>(vecIndex.get(), ids.data() + first, count, blockedDists, nullptr, rows, panels, norms);
+            for (SPTAG::SizeType x = first; x < first + count; x++)
+            {
+                for (SPTAG::SizeType y = x + 1; y < first + count; y++)
+                {
+                    float dist = vecIndex->ComputeDistance(vecIndex->GetSample(ids[x]), vecIndex->GetSample(ids[y]));
+                    SPTAG::COMMON::Utils::AddNeighbor(ids[y], dist, pairwise[ids[x]], pairwiseDists[ids[x]], k);
+                    SPTAG::COMMON::Utils::AddNeighbor(ids[x], dist, pairwise[ids[y]], pairwiseDists[ids[y]], k);
+                }
+            }
+            first += count;
+        }
+    }
+    int mismatches = 0;
+    for (SPTAG::SizeType i = 0; i < n; i++)
+    {
+        for (int j = 0; j < k; j++)
+        {
+            if (blocked[i][j] != pairwise[i][j] || blockedDists[i][j] != pairwiseDists[i][j]) mismatches++;
+        }
+    }
+    BOOST_CHECK_EQUAL(mismatches, 0);
+
+    // The parallel TP-tree partition finds most of the true neighbors, and NN-descent refinement
+    // ends up about as close to the exact RNG as refining by graph search.
+    TestGraph initial;
+    initial.InitLists(n, k);
+    initial.BuildInitKNNGraph<float>(vecIndex.get(), nullptr);
+    float knnRecall = KNNRecall(vecIndex, initial, 100, 10);
+
+    TestGraph searched, descended;
+    descended.m_iNNDescentIter = 8;
+    searched.BuildGraph<float>(vecIndex.get());
+    descended.BuildGraph<float>(vecIndex.get());
+    float searchedAcc = searched.GraphAccuracyEstimation(vecIndex.get(), 200);
+    float descendedAcc = descended.GraphAccuracyEstimation(vecIndex.get(), 200);
+    BOOST_TEST_MESSAGE("TP-tree KNN recall " << knnRecall << ", graph accuracy refined by search " << searchedAcc << ", by NN-descent " << descendedAcc);
+    BOOST_CHECK_GE(knnRecall, 0.5f);
+    BOOST_CHECK_GE(searchedAcc, 0.8f);
+    BOOST_CHECK_GE(descendedAcc, searchedAcc - 0.1f);
+}
+
+BOOST_AUTO_TEST_CASE(WorkStealingPoolTest)
+{
+    // every task spawns two children until depth 10, so 2^11 - 1 tasks run across the workers
+    SPTAG::Helper::WorkStealingPool pool(4);
+    std::atomic<int> ran(0);
+    std::function<void(int, int)> spawnTree = [&](int p_worker, int p_depth)
+    {
+        ran++;
+        if (p_depth == 10) return;
+        for (int i = 0; i < 2; i++) pool.Spawn(p_worker, [&, p_depth](int p_next) { spawnTree(p_next, p_depth + 1); });
+    };
+    pool.Spawn(0, [&](int p_worker) { spawnTree(p_worker, 0); });
+    pool.Run();
+    BOOST_CHECK_EQUAL(ran.load(), (1 << 11) - 1);
+
+    // the first exception comes out of Run, and the pool can be run again afterwards
+    ran = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        pool.Spawn(i, [&, i](int) { ran++; if (i == 3) throw std::runtime_error("task failed"); });
+    }
+    BOOST_CHECK_THROW(pool.Run(), std::runtime_error);
+    BOOST_CHECK_GE(ran.load(), 1);
+
+    ran = 0;
+    pool.Spawn(0, [&](int) { ran++; });
+    pool.Run();
+    BOOST_CHECK_EQUAL(ran.load(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(BKTreeCoversSamples)
+{
+    SPTAG::SizeType n = 20000;
+    SPTAG::DimensionType m = 16;
+    std::shared_ptr<SPTAG::VectorSet> vectors = SPTAG::TestUtils::RandomVectors<float>(n, m, 3);
+    SPTAG::COMMON::Dataset<float> data(n, m, 1024, n, (float*)vectors->GetData(), false);
+
+    for (int threads : { 1, 4 })
+    {
+        SPTAG::COMMON::BKTree tree;
+        tree.m_iTreeNumber = 2;
+        tree.m_iBKTKmeansK = 8;
+        tree.m_iSamples = 500;
+        tree.BuildTrees<float>(data, SPTAG::DistCalcMethod::L2, threads);
+
+        // every sample is reached exactly once in each tree, and the trees follow each other with a -1 node in between
+        SPTAG::SizeType root = 0;
+        for (int t = 0; t < tree.m_iTreeNumber; t++)
+        {
+            std::vector<int> seen(n, 0);
+            SPTAG::SizeType last = CollectTree(tree, root, true, seen);
+            BOOST_CHECK(std::all_of(seen.begin(), seen.end(), [](int p_count) { return p_count == 1; }));
+            BOOST_REQUIRE_LT(last + 1, tree.size());
+            BOOST_CHECK_EQUAL(tree[last + 1].centerid, -1);
+            root = last + 2;
+        }
+        BOOST_CHECK_EQUAL(root, tree.size());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,92 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "inc/Test.h"
+#include "inc/TestUtils.h"
+#include "inc/Core/Common/BruteForceKNN.h"
+
+#include <omp.h>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    namespace Local
+    {
+        // Compares against a plain scan of the base set. Integer data has many equal distances, so the
+        // distances are compared rank by rank and every id is checked to be distinct and at that distance.
+        template <typename T>
+        void CheckSearch(SPTAG::SizeType p_queryCount, SPTAG::SizeType p_vectorCount, SPTAG::DimensionType p_dim, SPTAG::DistCalcMethod p_distMethod, int p_K)
+        {
+            // values span the range of the type, or [-1, 1) for floats
+            float low = std::is_same<T, float>::value ? -1.0f : (std::is_same<T, std::uint8_t>::value ? 0.0f : -127.0f);
+            float high = std::is_same<T, float>::value ? 1.0f : (std::is_same<T, std::uint8_t>::value ? 255.0f : 127.0f);
+            auto queries = SPTAG::TestUtils::RandomVectors<T>(p_queryCount, p_dim, 1, low, high);
+            auto vectors = SPTAG::TestUtils::RandomVectors<T>(p_vectorCount, p_dim, 2, low, high);
+
+            std::vector<std::vector<SPTAG::SizeType>> ids;
+            std::vector<std::vector<float>> dists;
+            SPTAG::COMMON::BruteForceKNN::Search<T>(queries, vectors, p_distMethod, p_K, ids, dists);
+            BOOST_REQUIRE_EQUAL(ids.size(), (size_t)p_queryCount);
+            BOOST_REQUIRE_EQUAL(dists.size(), (size_t)p_queryCount);
+
+            int expectedNum = std::min(p_K, (int)p_vectorCount);
+            for (SPTAG::SizeType i = 0; i < p_queryCount; i++)
+            {
+                const T* query = (const T*)queries->GetVector(i);
+                std::vector<float> all(p_vectorCount);
+                for (SPTAG::SizeType j = 0; j < p_vectorCount; j++)
+                {
+                    all[j] = SPTAG::COMMON::DistanceUtils::ComputeDistance(query, (const T*)vectors->GetVector(j), p_dim, p_distMethod);
+                }
+                std::sort(all.begin(), all.end());
+
+                BOOST_REQUIRE_EQUAL(ids[i].size(), (size_t)p_K);
+                std::vector<SPTAG::SizeType> seen;
+                for (int k = 0; k < expectedNum; k++)
+                {
+                    SPTAG::SizeType vid = ids[i][k];
+                    BOOST_REQUIRE(vid >= 0 && vid < p_vectorCount);
+                    seen.push_back(vid);
+                    float dist = SPTAG::COMMON::DistanceUtils::ComputeDistance(query, (const T*)vectors->GetVector(vid), p_dim, p_distMethod);
+                    BOOST_CHECK_EQUAL(dists[i][k], dist);
+                    BOOST_CHECK_EQUAL(dists[i][k], all[k]);
+                }
+                std::sort(seen.begin(), seen.end());
+                BOOST_CHECK(std::adjacent_find(seen.begin(), seen.end()) == seen.end());
+                for (int k = expectedNum; k < p_K; k++) BOOST_CHECK_EQUAL(ids[i][k], -1);
+            }
+        }
+
+        template <typename T>
+        void CheckShapes(SPTAG::DistCalcMethod p_distMethod)
+        {
+            // below two query blocks the pairwise scan is used
+            CheckSearch<T>(5, 300, 24, p_distMethod, 10);
+            // one partial query tile, so the base set is split into segments; base counts off the panel and tile sizes
+            CheckSearch<T>(9, 4100, 24, p_distMethod, 10);
+            // several query tiles with a remainder, odd dimension, a K above the spare candidates
+            CheckSearch<T>(133, 2061, 37, p_distMethod, 40);
+            // fewer base vectors than K
+            CheckSearch<T>(16, 7, 8, p_distMethod, 10);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(BruteForceKNNTest)
+
+BOOST_AUTO_TEST_CASE(BlockedSearchMatchesScan)
+{
+    int threads = omp_get_max_threads();
+    // more threads than query tiles makes the search split the base set
+    omp_set_num_threads(4);
+    for (auto distMethod : { SPTAG::DistCalcMethod::L2, SPTAG::DistCalcMethod::Cosine })
+    {
+        Local::CheckShapes<float>(distMethod);
+        Local::CheckShapes<std::int8_t>(distMethod);
+        Local::CheckShapes<std::uint8_t>(distMethod);
+    }
+    omp_set_num_threads(threads);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
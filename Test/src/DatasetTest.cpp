@@ -0,0 +1,138 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "inc/Test.h"
+#include "inc/Core/Common.h"
+#include "inc/Core/Common/Dataset.h"
+
+#include <thread>
+#include <atomic>
+#include <vector>
+
+namespace
+{
+    namespace Local
+    {
+        const SPTAG::DimensionType c_cols = 4;
+
+        void FillRows(std::vector<int>& p_rows, int p_first, int p_count)
+        {
+            p_rows.resize((size_t)p_count * c_cols);
+            for (int i = 0; i < p_count; i++)
+            {
+                for (SPTAG::DimensionType j = 0; j < c_cols; j++) p_rows[(size_t)i * c_cols + j] = (p_first + i) * c_cols + j;
+            }
+        }
+
+        bool CheckRow(const SPTAG::COMMON::Dataset<int>& p_data, SPTAG::SizeType p_row)
+        {
+            const int* row = p_data[p_row];
+            for (SPTAG::DimensionType j = 0; j < c_cols; j++)
+            {
+                if (row[j] != p_row * c_cols + j) return false;
+            }
+            return true;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(DatasetTest)
+
+BOOST_AUTO_TEST_CASE(GrowAcrossBlocks)
+{
+    std::vector<int> rows;
+    Local::FillRows(rows, 0, 100);
+    SPTAG::COMMON::Dataset<int> data(100, Local::c_cols, 16, 10000, rows.data(), false);
+
+    // batches that start and end in the middle of blocks
+    SPTAG::SizeType total = 100;
+    for (int num : { 1, 15, 16, 17, 100, 3, 500 })
+    {
+        Local::FillRows(rows, total, num);
+        BOOST_REQUIRE(SPTAG::ErrorCode::Success == data.AddBatch(rows.data(), num));
+        total += num;
+        BOOST_CHECK_EQUAL(data.R(), total);
+    }
+    for (SPTAG::SizeType i = 0; i < total; i++) BOOST_CHECK(Local::CheckRow(data, i));
+
+    // rows reserved without data read as -1
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == data.AddBatch(40));
+    for (SPTAG::SizeType i = total; i < total + 40; i++) BOOST_CHECK_EQUAL(data[i][0], -1);
+    for (SPTAG::SizeType i = 0; i < total; i++) BOOST_CHECK(Local::CheckRow(data, i));
+
+    // including rows dropped by SetR in a block that is reused
+    data.SetR(total - 5);
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == data.AddBatch(10));
+    for (SPTAG::SizeType i = total - 5; i < total + 5; i++) BOOST_CHECK_EQUAL(data[i][0], -1);
+}
+
+BOOST_AUTO_TEST_CASE(CapacityLimit)
+{
+    std::vector<int> rows;
+    Local::FillRows(rows, 0, 10);
+    SPTAG::COMMON::Dataset<int> data(10, Local::c_cols, 8, 50, rows.data(), false);
+
+    Local::FillRows(rows, 10, 40);
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == data.AddBatch(rows.data(), 40));
+    BOOST_CHECK(SPTAG::ErrorCode::MemoryOverFlow == data.AddBatch(1));
+    BOOST_CHECK(SPTAG::ErrorCode::MemoryOverFlow == data.AddBatch(rows.data(), 1));
+    BOOST_CHECK_EQUAL(data.R(), 50);
+
+    // shrinking into the incremental blocks and growing again reuses them
+    data.SetR(30);
+    BOOST_CHECK_EQUAL(data.R(), 30);
+    Local::FillRows(rows, 30, 20);
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == data.AddBatch(rows.data(), 20));
+    for (SPTAG::SizeType i = 0; i < 50; i++) BOOST_CHECK(Local::CheckRow(data, i));
+}
+
+BOOST_AUTO_TEST_CASE(SaveAndLoad)
+{
+    std::vector<int> rows;
+    Local::FillRows(rows, 0, 20);
+    SPTAG::COMMON::Dataset<int> data(20, Local::c_cols, 16, 1000, rows.data(), false);
+    Local::FillRows(rows, 20, 70);
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == data.AddBatch(rows.data(), 70));
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == data.Save("dataset_test.bin"));
+
+    SPTAG::COMMON::Dataset<int> loaded;
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == loaded.Load(std::string("dataset_test.bin"), 16, 1000));
+    BOOST_CHECK_EQUAL(loaded.R(), 90);
+    BOOST_CHECK_EQUAL(loaded.C(), Local::c_cols);
+    for (SPTAG::SizeType i = 0; i < 90; i++) BOOST_CHECK(Local::CheckRow(loaded, i));
+}
+
+BOOST_AUTO_TEST_CASE(ReadWhileGrowing)
+{
+    SPTAG::COMMON::Dataset<int> data(0, Local::c_cols, 4, 100000);
+    std::atomic<bool> done(false);
+    std::atomic<int> bad(0);
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 2; t++)
+    {
+        readers.emplace_back([&]()
+        {
+            while (!done.load())
+            {
+                SPTAG::SizeType r = data.R();
+                for (SPTAG::SizeType i = 0; i < r; i++)
+                {
+                    if (!Local::CheckRow(data, i)) bad++;
+                }
+            }
+        });
+    }
+
+    std::vector<int> rows;
+    for (SPTAG::SizeType total = 0; total < 20000; total += 7)
+    {
+        Local::FillRows(rows, total, 7);
+        BOOST_REQUIRE(SPTAG::ErrorCode::Success == data.AddBatch(rows.data(), 7));
+    }
+    done = true;
+    for (auto& reader : readers) reader.join();
+    BOOST_CHECK_EQUAL(bad.load(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,151 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "inc/Test.h"
+#include "inc/Core/Common.h"
+#include "inc/Core/Common/Labelset.h"
+#include "inc/Core/Common/VersionLabel.h"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace
+{
+    namespace Local
+    {
+        // Posting entry layout: int vector id, uint8 version, then the vector.
+        const int c_stride = sizeof(int) + sizeof(std::uint8_t) + 3 * sizeof(float);
+
+        void WriteEntry(std::vector<char>& p_entries, int p_pos, int p_vid, std::uint8_t p_version)
+        {
+            char* entry = p_entries.data() + (size_t)p_pos * c_stride;
+            memcpy(entry, &p_vid, sizeof(int));
+            memcpy(entry + sizeof(int), &p_version, sizeof(std::uint8_t));
+            memset(entry + sizeof(int) + sizeof(std::uint8_t), 0x7f, 3 * sizeof(float));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(LabelsetTest)
+
+BOOST_AUTO_TEST_CASE(InsertAndContains)
+{
+    SPTAG::COMMON::Labelset labels;
+    labels.Initialize(100, 16, 1000);
+    for (SPTAG::SizeType i = 0; i < 100; i++) BOOST_CHECK(!labels.Contains(i));
+
+    for (SPTAG::SizeType i = 0; i < 100; i += 3) BOOST_CHECK(labels.Insert(i));
+    BOOST_CHECK(!labels.Insert(0));
+    BOOST_CHECK(!labels.Insert(99));
+    BOOST_CHECK_EQUAL(labels.Count(), 34);
+    for (SPTAG::SizeType i = 0; i < 100; i++) BOOST_CHECK_EQUAL(labels.Contains(i), i % 3 == 0);
+}
+
+BOOST_AUTO_TEST_CASE(GrowAndShrink)
+{
+    SPTAG::COMMON::Labelset labels;
+    labels.Initialize(5, 16, 1000);
+    BOOST_CHECK(labels.Insert(4));
+
+    // batches that end inside a byte
+    SPTAG::SizeType size = 5;
+    for (int num : { 1, 2, 7, 9, 64, 3 })
+    {
+        BOOST_REQUIRE(SPTAG::ErrorCode::Success == labels.AddBatch(num));
+        for (SPTAG::SizeType i = size; i < size + num; i++) BOOST_CHECK(!labels.Contains(i));
+        BOOST_CHECK(labels.Insert(size + num - 1));
+        size += num;
+    }
+    BOOST_CHECK(labels.Contains(4));
+    BOOST_CHECK(labels.Contains(size - 1));
+
+    // ids dropped by SetR come back unlabeled
+    labels.SetR(size - 2);
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == labels.AddBatch(2));
+    BOOST_CHECK(!labels.Contains(size - 1));
+    BOOST_CHECK(!labels.Contains(size - 2));
+
+    BOOST_CHECK(SPTAG::ErrorCode::MemoryOverFlow == labels.AddBatch(1000));
+}
+
+BOOST_AUTO_TEST_CASE(SaveByteFormat)
+{
+    SPTAG::COMMON::Labelset labels;
+    labels.Initialize(21, 8, 100);
+    std::vector<SPTAG::SizeType> inserted = { 0, 7, 8, 13, 20 };
+    for (SPTAG::SizeType id : inserted) labels.Insert(id);
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == labels.Save(std::string("labelset_test.bin")));
+
+    // one byte per id so older readers still load the file
+    std::ifstream in("labelset_test.bin", std::ios::binary);
+    SPTAG::SizeType deleted, rows;
+    SPTAG::DimensionType cols;
+    in.read((char*)&deleted, sizeof(deleted));
+    in.read((char*)&rows, sizeof(rows));
+    in.read((char*)&cols, sizeof(cols));
+    BOOST_CHECK_EQUAL(deleted, 5);
+    BOOST_CHECK_EQUAL(rows, 21);
+    BOOST_CHECK_EQUAL(cols, 1);
+    std::vector<std::int8_t> bytes(rows);
+    in.read((char*)bytes.data(), rows);
+    BOOST_REQUIRE(in.good());
+    for (SPTAG::SizeType i = 0; i < rows; i++)
+    {
+        bool expected = std::find(inserted.begin(), inserted.end(), i) != inserted.end();
+        BOOST_CHECK_EQUAL(bytes[i], expected ? 1 : -1);
+    }
+    in.close();
+
+    SPTAG::COMMON::Labelset loaded;
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == loaded.Load(std::string("labelset_test.bin"), 8, 100));
+    BOOST_CHECK_EQUAL(loaded.Count(), 5);
+    for (SPTAG::SizeType i = 0; i < rows; i++) BOOST_CHECK_EQUAL(loaded.Contains(i), labels.Contains(i));
+
+    std::vector<char> memFile(sizeof(SPTAG::SizeType) * 2 + sizeof(SPTAG::DimensionType) + rows);
+    std::ifstream raw("labelset_test.bin", std::ios::binary);
+    raw.read(memFile.data(), memFile.size());
+    SPTAG::COMMON::Labelset mapped;
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == mapped.Load(memFile.data(), 8, 100));
+    for (SPTAG::SizeType i = 0; i < rows; i++) BOOST_CHECK_EQUAL(mapped.Contains(i), labels.Contains(i));
+}
+
+BOOST_AUTO_TEST_CASE(FilterValidMatchesScalar)
+{
+    const SPTAG::SizeType vectors = 200;
+    SPTAG::COMMON::VersionLabel versions;
+    versions.Initialize(vectors, 64, 1000);
+
+    std::mt19937 rg(7);
+    for (SPTAG::SizeType i = 0; i < vectors; i++)
+    {
+        std::uint8_t version = 0;
+        int bumps = rg() % 140;
+        for (int j = 0; j < bumps; j++) versions.IncVersion(i, &version);
+        if (rg() % 5 == 0) versions.Delete(i);
+    }
+
+    // odd counts exercise the scalar tail after the 8-wide batches
+    for (int num : { 0, 1, 7, 8, 9, 37, 255 })
+    {
+        std::vector<char> entries((size_t)num * Local::c_stride);
+        std::vector<int> expected;
+        for (int i = 0; i < num; i++)
+        {
+            int vid = rg() % vectors;
+            std::uint8_t version = versions.GetVersion(vid);
+            // some entries carry a stale version
+            if (rg() % 3 == 0) version = (std::uint8_t)(version + 1 + rg() % 126);
+            Local::WriteEntry(entries, i, vid, version);
+            if (!versions.Contains(vid) && (version & 0x7f) == versions.GetVersion(vid)) expected.push_back(i);
+        }
+
+        std::vector<int> valid(num + 1);
+        int count = versions.FilterValid(entries.data(), num, Local::c_stride, valid.data());
+        valid.resize(count);
+        BOOST_CHECK_EQUAL_COLLECTIONS(valid.begin(), valid.end(), expected.begin(), expected.end());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
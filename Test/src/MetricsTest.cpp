@@ -0,0 +1,101 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "inc/Test.h"
+#include "inc/Helper/LatencyHistogram.h"
+#include "inc/Helper/MetricsWriter.h"
+
+#include <thread>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(MetricsTest)
+
+BOOST_AUTO_TEST_CASE(HistogramBuckets)
+{
+    using SPTAG::Helper::LatencyHistogram;
+
+    // every value lands in a bucket whose upper bound is at most 1/16 above it, and buckets grow with the value
+    const int bucketCount = LatencyHistogram::c_bucketCount, subBucketCount = LatencyHistogram::c_subBucketCount;
+    int last = -1;
+    for (std::uint64_t value = 0; value < (1ULL << 36); value = value * 9 / 8 + 1)
+    {
+        int bucket = LatencyHistogram::BucketIndex(value);
+        BOOST_REQUIRE_GE(bucket, last);
+        BOOST_REQUIRE_LT(bucket, bucketCount);
+        std::uint64_t upper = LatencyHistogram::BucketUpperBound(bucket);
+        BOOST_REQUIRE_GE(upper, value);
+        BOOST_REQUIRE_LE(upper - value, value / subBucketCount);
+        if (bucket > 0) BOOST_REQUIRE_LT(LatencyHistogram::BucketUpperBound(bucket - 1), value);
+        last = bucket;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(HistogramPercentiles)
+{
+    SPTAG::Helper::LatencyHistogram histogram;
+    BOOST_CHECK_EQUAL(histogram.GetSnapshot().Percentile(99), 0);
+
+    // writers on several threads land on different shards, and the snapshot adds them up
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; t++)
+    {
+        writers.emplace_back([&histogram, t]()
+        {
+            for (std::uint64_t value = t + 1; value <= 1000; value += 4) histogram.Record(value);
+        });
+    }
+    for (auto& writer : writers) writer.join();
+
+    auto snapshot = histogram.GetSnapshot();
+    BOOST_CHECK_EQUAL(snapshot.m_count, 1000);
+    BOOST_CHECK_EQUAL(snapshot.m_sum, 500500);
+    BOOST_CHECK_EQUAL(snapshot.m_max, 1000);
+    BOOST_CHECK_CLOSE(snapshot.Mean(), 500.5, 1e-6);
+    BOOST_CHECK_GE(snapshot.Percentile(50), 500);
+    BOOST_CHECK_LE(snapshot.Percentile(50), 500 * 17 / 16);
+    BOOST_CHECK_GE(snapshot.Percentile(99), 990);
+    BOOST_CHECK_LE(snapshot.Percentile(99), 1000);
+    BOOST_CHECK_EQUAL(snapshot.Percentile(100), 1000);
+
+    histogram.Reset();
+    snapshot = histogram.GetSnapshot();
+    BOOST_CHECK_EQUAL(snapshot.m_count, 0);
+    BOOST_CHECK_EQUAL(snapshot.m_sum, 0);
+    BOOST_CHECK_EQUAL(snapshot.m_max, 0);
+}
+
+BOOST_AUTO_TEST_CASE(WriterGroupsSamplesByName)
+{
+    SPTAG::Helper::MetricsWriter writer;
+    writer.WriteGauge("sptag_service_indexes", "Number of indexes being served.", 2);
+
+    SPTAG::Helper::LatencyHistogram histogram;
+    histogram.Record(1023);
+    histogram.Record(3071);
+
+    writer.SetLabels({ { "index", "A" } });
+    writer.WriteCounter("sptag_splits_total", "Splits.", 3);
+    writer.WriteLatency("sptag_search_seconds", "Search latency.", histogram);
+    writer.SetLabels({ { "index", "B\"\\\n" } });
+    writer.WriteCounter("sptag_splits_total", "Splits.", 1.5);
+
+    std::string expected =
+        "# HELP sptag_service_indexes Number of indexes being served.\n"
+        "# TYPE sptag_service_indexes gauge\n"
+        "sptag_service_indexes 2\n"
+        "# HELP sptag_splits_total Splits.\n"
+        "# TYPE sptag_splits_total counter\n"
+        "sptag_splits_total{index=\"A\"} 3\n"
+        "sptag_splits_total{index=\"B\\\"\\\\\\n\"} 1.5\n"
+        "# HELP sptag_search_seconds Search latency.\n"
+        "# TYPE sptag_search_seconds summary\n"
+        "sptag_search_seconds{index=\"A\",quantile=\"0.5\"} 0.001023\n"
+        "sptag_search_seconds{index=\"A\",quantile=\"0.9\"} 0.003071\n"
+        "sptag_search_seconds{index=\"A\",quantile=\"0.99\"} 0.003071\n"
+        "sptag_search_seconds{index=\"A\",quantile=\"0.999\"} 0.003071\n"
+        "sptag_search_seconds_sum{index=\"A\"} 0.004094\n"
+        "sptag_search_seconds_count{index=\"A\"} 2\n";
+    BOOST_CHECK_EQUAL(writer.GetText(), expected);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,137 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "inc/Test.h"
+#include "inc/Socket/RemoteSearchQuery.h"
+
+#include <cstring>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(RemoteSearchQueryTest)
+
+BOOST_AUTO_TEST_CASE(BatchQueryRoundTrip)
+{
+    std::vector<float> vectors(3 * 5);
+    for (size_t i = 0; i < vectors.size(); i++) vectors[i] = (float)i * 0.5f;
+
+    SPTAG::Socket::RemoteBatchQuery query;
+    query.m_indexName = "idx";
+    query.m_valueType = SPTAG::VectorValueType::Float;
+    query.m_dimension = 5;
+    query.m_vectorCount = 3;
+    query.m_resultNum = 7;
+    query.m_extractMetadata = true;
+    query.m_vectors = reinterpret_cast<const std::uint8_t*>(vectors.data());
+
+    std::vector<std::uint8_t> buffer(query.EstimateBufferSize());
+    std::size_t length = query.Write(buffer.data()) - buffer.data();
+    BOOST_REQUIRE(length <= buffer.size());
+
+    SPTAG::Socket::RemoteBatchQuery read;
+    BOOST_REQUIRE(read.Read(buffer.data(), length) == buffer.data() + length);
+    BOOST_CHECK_EQUAL(read.m_indexName, "idx");
+    BOOST_CHECK(read.m_valueType == SPTAG::VectorValueType::Float);
+    BOOST_CHECK_EQUAL(read.m_dimension, 5);
+    BOOST_CHECK_EQUAL(read.m_vectorCount, 3);
+    BOOST_CHECK_EQUAL(read.m_resultNum, 7);
+    BOOST_CHECK(read.m_extractMetadata);
+    BOOST_CHECK_EQUAL((read.m_vectors - buffer.data()) % SPTAG::Socket::RemoteBatchQuery::c_vectorAlignment, 0);
+    BOOST_CHECK(std::memcmp(read.m_vectors, vectors.data(), vectors.size() * sizeof(float)) == 0);
+
+    // a body cut anywhere fails to read
+    for (std::size_t cut : { (std::size_t)0, (std::size_t)3, length / 2, length - 1 })
+    {
+        SPTAG::Socket::RemoteBatchQuery truncated;
+        BOOST_CHECK(truncated.Read(buffer.data(), cut) == nullptr);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BatchResultRoundTrip)
+{
+    SPTAG::Socket::RemoteBatchSearchResult result;
+    result.m_status = SPTAG::Socket::RemoteSearchResult::ResultStatus::Success;
+    result.m_vectorCount = 2;
+    result.m_resultNum = 3;
+    result.m_withMeta = true;
+    result.m_results.resize(6);
+    for (int i = 0; i < 6; i++)
+    {
+        result.m_results[i].VID = i * 10;
+        result.m_results[i].Dist = i * 1.5f;
+        std::string meta(i, (char)('a' + i));
+        result.m_results[i].Meta = SPTAG::ByteArray::Alloc(meta.size());
+        if (!meta.empty()) std::memcpy(result.m_results[i].Meta.Data(), meta.data(), meta.size());
+    }
+
+    std::vector<std::uint8_t> buffer(result.EstimateBufferSize());
+    std::size_t length = result.Write(buffer.data()) - buffer.data();
+    BOOST_REQUIRE_EQUAL(length, buffer.size());
+
+    SPTAG::Socket::RemoteBatchSearchResult read;
+    BOOST_REQUIRE(read.Read(buffer.data(), length) == buffer.data() + length);
+    BOOST_CHECK(read.m_status == SPTAG::Socket::RemoteSearchResult::ResultStatus::Success);
+    BOOST_CHECK_EQUAL(read.m_vectorCount, 2);
+    BOOST_CHECK_EQUAL(read.m_resultNum, 3);
+    BOOST_REQUIRE_EQUAL(read.m_results.size(), 6);
+    for (int i = 0; i < 6; i++)
+    {
+        BOOST_CHECK_EQUAL(read.m_results[i].VID, i * 10);
+        BOOST_CHECK_EQUAL(read.m_results[i].Dist, i * 1.5f);
+        BOOST_CHECK_EQUAL(read.m_results[i].Meta.Length(), (SPTAG::SizeType)i);
+        for (int j = 0; j < i; j++) BOOST_CHECK_EQUAL(read.m_results[i].Meta.Data()[j], (std::uint8_t)('a' + i));
+    }
+
+    for (std::size_t cut : { (std::size_t)0, (std::size_t)5, length / 2, length - 1 })
+    {
+        SPTAG::Socket::RemoteBatchSearchResult truncated;
+        BOOST_CHECK(truncated.Read(buffer.data(), cut) == nullptr);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BatchResultRejectsOversizedHeader)
+{
+    // a header claiming far more results than the body holds must not be allocated
+    SPTAG::Socket::RemoteBatchSearchResult result;
+    result.m_status = SPTAG::Socket::RemoteSearchResult::ResultStatus::Success;
+    result.m_vectorCount = 1u << 30;
+    result.m_resultNum = 1u << 30;
+    result.m_withMeta = false;
+
+    std::vector<std::uint8_t> buffer(result.EstimateBufferSize());
+    std::size_t length = result.Write(buffer.data()) - buffer.data();
+
+    SPTAG::Socket::RemoteBatchSearchResult read;
+    BOOST_CHECK(read.Read(buffer.data(), length) == nullptr);
+    BOOST_CHECK(read.m_results.empty());
+}
+
+BOOST_AUTO_TEST_CASE(IndexReloadRoundTrip)
+{
+    SPTAG::Socket::RemoteIndexReload request;
+    request.m_indexName = "product";
+    request.m_indexFolder = "/data/product_v2";
+
+    std::vector<std::uint8_t> buffer(request.EstimateBufferSize());
+    std::size_t length = request.Write(buffer.data()) - buffer.data();
+    BOOST_CHECK_EQUAL(length, buffer.size());
+
+    SPTAG::Socket::RemoteIndexReload read;
+    BOOST_CHECK(read.Read(buffer.data(), length) == buffer.data() + length);
+    BOOST_CHECK_EQUAL(read.m_indexName, request.m_indexName);
+    BOOST_CHECK_EQUAL(read.m_indexFolder, request.m_indexFolder);
+
+    // every truncation is rejected
+    for (std::size_t cut = 0; cut < length; ++cut)
+    {
+        SPTAG::Socket::RemoteIndexReload truncated;
+        BOOST_CHECK(truncated.Read(buffer.data(), cut) == nullptr);
+    }
+
+    // a folder length running past the body is rejected rather than read
+    std::uint32_t folderLen = 1u << 30;
+    std::memcpy(buffer.data() + length - request.m_indexFolder.size() - sizeof(folderLen), &folderLen, sizeof(folderLen));
+    SPTAG::Socket::RemoteIndexReload oversized;
+    BOOST_CHECK(oversized.Read(buffer.data(), length) == nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
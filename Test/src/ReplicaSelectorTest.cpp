@@ -0,0 +1,122 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "inc/Test.h"
+#include "inc/TestUtils.h"
+#include "inc/Core/Common/ReplicaSelector.h"
+
+#include <vector>
+
+namespace
+{
+    namespace Local
+    {
+        const SPTAG::DimensionType c_dim = 16;
+
+        // The RNG rule written out: a candidate is kept unless a kept head is within candidate.Dist / p_rngFactor of it.
+        std::vector<SPTAG::BasicResult> Reference(const SPTAG::VectorIndex* p_index, const SPTAG::BasicResult* p_candidates, int p_candidateNum,
+            int p_replicaCount, float p_rngFactor, std::size_t& p_rejected)
+        {
+            std::vector<SPTAG::BasicResult> selected;
+            for (int i = 0; i < p_candidateNum && p_candidates[i].VID >= 0 && (int)selected.size() < p_replicaCount; i++)
+            {
+                bool accepted = true;
+                for (const auto& kept : selected)
+                {
+                    if (p_rngFactor * p_index->ComputeDistance(p_index->GetSample(p_candidates[i].VID), p_index->GetSample(kept.VID)) <= p_candidates[i].Dist)
+                    {
+                        accepted = false;
+                        break;
+                    }
+                }
+                if (accepted) selected.push_back(p_candidates[i]);
+                else p_rejected++;
+            }
+            return selected;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(ReplicaSelectorTest)
+
+BOOST_AUTO_TEST_CASE(SelectionMatchesRNGRule)
+{
+    const SPTAG::SizeType headCount = 2000, vectorCount = 300;
+    const int candidateNum = 32;
+    auto heads = SPTAG::TestUtils::RandomVectors<float>(headCount, Local::c_dim, 1);
+    auto vectors = SPTAG::TestUtils::RandomVectors<float>(vectorCount, Local::c_dim, 2);
+    auto index = SPTAG::TestUtils::BuildIndex(SPTAG::IndexAlgoType::BKT, heads, { { "Index", { { "DistCalcMethod", "L2" } } } });
+
+    std::vector<SPTAG::QueryResult> candidates;
+    for (SPTAG::SizeType i = 0; i < vectorCount; i++)
+    {
+        candidates.emplace_back(vectors->GetVector(i), candidateNum, false);
+        BOOST_REQUIRE(SPTAG::ErrorCode::Success == index->SearchIndex(candidates.back()));
+    }
+    // a short candidate list ends at the first empty slot
+    candidates[0].GetResult(5)->VID = -1;
+
+    // without a cache, with one that keeps every pair, and with one so small that pairs keep evicting each other
+    for (int cacheSize : { 0, 1 << 16, 4 })
+    {
+        for (float rngFactor : { 1.0f, 1.5f })
+        {
+            for (int replicaCount : { 1, 8 })
+            {
+                SPTAG::COMMON::ReplicaSelector selector(cacheSize);
+                std::size_t rejected = 0;
+                // twice over the vectors, so the second pass reads the cached pairs
+                for (int pass = 0; pass < 2; pass++)
+                {
+                    for (SPTAG::SizeType i = 0; i < vectorCount; i++)
+                    {
+                        auto expected = Local::Reference(index.get(), candidates[i].GetResults(), candidateNum, replicaCount, rngFactor, rejected);
+                        int count = selector.Select(index.get(), candidates[i].GetResults(), candidateNum, replicaCount, rngFactor);
+                        BOOST_REQUIRE_EQUAL(count, (int)expected.size());
+                        BOOST_REQUIRE_EQUAL(selector.Count(), count);
+                        for (int j = 0; j < count; j++)
+                        {
+                            BOOST_CHECK_EQUAL(selector[j].VID, expected[j].VID);
+                            BOOST_CHECK_EQUAL(selector[j].Dist, expected[j].Dist);
+                        }
+                    }
+                }
+                BOOST_CHECK_EQUAL(selector.Rejected(), rejected);
+                if (replicaCount > 1) BOOST_CHECK_GT(rejected, 0);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ClearDropsCachedPairs)
+{
+    // the cache is keyed on head ids, so heads that get other vectors under the same ids need a Clear
+    std::vector<float> before = { 0, 0, 10, 0, 1, 0 }, after = { 0, 0, 10, 0, -50, 0 };
+    auto oldIndex = SPTAG::VectorIndex::CreateInstance(SPTAG::IndexAlgoType::BKT, SPTAG::VectorValueType::Float);
+    auto newIndex = SPTAG::VectorIndex::CreateInstance(SPTAG::IndexAlgoType::BKT, SPTAG::VectorValueType::Float);
+    oldIndex->SetParameter("DistCalcMethod", "L2");
+    newIndex->SetParameter("DistCalcMethod", "L2");
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == oldIndex->BuildIndex(before.data(), 3, 2));
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == newIndex->BuildIndex(after.data(), 3, 2));
+
+    // head 2 is within 1 of head 0 at first and rejected; head 1 is 100 away and kept
+    std::vector<SPTAG::BasicResult> candidates = { SPTAG::BasicResult(0, 1), SPTAG::BasicResult(2, 1), SPTAG::BasicResult(1, 50) };
+    SPTAG::COMMON::ReplicaSelector selector(16);
+    BOOST_REQUIRE_EQUAL(selector.Select(oldIndex.get(), candidates.data(), 3, 3, 1.0f), 2);
+    BOOST_CHECK_EQUAL(selector[0].VID, 0);
+    BOOST_CHECK_EQUAL(selector[1].VID, 1);
+    BOOST_CHECK_EQUAL(selector.Rejected(), 1);
+
+    // head 2 moved away, but the cached pair still says it is close until the cache is cleared
+    BOOST_CHECK_EQUAL(selector.Select(newIndex.get(), candidates.data(), 3, 3, 1.0f), 2);
+    selector.Clear();
+    BOOST_CHECK_EQUAL(selector.Select(newIndex.get(), candidates.data(), 3, 3, 1.0f), 3);
+    BOOST_CHECK_EQUAL(selector.Rejected(), 2);
+
+    // without a cache the distances always come from the index
+    SPTAG::COMMON::ReplicaSelector uncached;
+    BOOST_CHECK_EQUAL(uncached.Select(oldIndex.get(), candidates.data(), 3, 3, 1.0f), 2);
+    BOOST_CHECK_EQUAL(uncached.Select(newIndex.get(), candidates.data(), 3, 3, 1.0f), 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
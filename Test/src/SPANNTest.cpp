@@ -0,0 +1,538 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "inc/Test.h"
+#include "inc/TestUtils.h"
+#include "inc/Core/SPANN/Index.h"
+#include "inc/Core/Common/TruthSet.h"
+#include "inc/Helper/VectorSetReader.h"
+#include "inc/SSDServing/SSDIndex.h"
+
+#include <boost/filesystem.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    namespace Local
+    {
+        const SPTAG::DimensionType c_dim = 16;
+
+        const int c_internalResultNum = SPTAG::TestUtils::c_spannInternalResultNum;
+
+        std::vector<std::vector<SPTAG::BasicResult>> Search(const std::shared_ptr<SPTAG::VectorIndex>& p_index, std::shared_ptr<SPTAG::VectorSet> p_queries, int p_k)
+        {
+            std::vector<std::vector<SPTAG::BasicResult>> results(p_queries->Count());
+            for (SPTAG::SizeType i = 0; i < p_queries->Count(); i++)
+            {
+                SPTAG::QueryResult result(p_queries->GetVector(i), c_internalResultNum, false);
+                BOOST_REQUIRE(SPTAG::ErrorCode::Success == p_index->SearchIndex(result));
+                results[i].assign(result.GetResults(), result.GetResults() + p_k);
+            }
+            return results;
+        }
+
+        // Checks that every result carries the true distance of its VID and returns recall@p_k against brute force.
+        float CheckResults(std::shared_ptr<SPTAG::VectorSet> p_queries, std::shared_ptr<SPTAG::VectorSet> p_vectors, int p_k,
+            const std::vector<std::vector<SPTAG::BasicResult>>& p_results)
+        {
+            int hits = 0;
+            for (SPTAG::SizeType i = 0; i < p_queries->Count(); i++)
+            {
+                std::vector<float> dists(p_vectors->Count());
+                for (SPTAG::SizeType j = 0; j < p_vectors->Count(); j++)
+                {
+                    dists[j] = SPTAG::COMMON::DistanceUtils::ComputeDistance((const float*)p_queries->GetVector(i), (const float*)p_vectors->GetVector(j), c_dim, SPTAG::DistCalcMethod::L2);
+                }
+                std::vector<float> sorted(dists);
+                std::nth_element(sorted.begin(), sorted.begin() + p_k - 1, sorted.end());
+
+                for (const auto& res : p_results[i])
+                {
+                    BOOST_REQUIRE(res.VID >= 0 && res.VID < p_vectors->Count());
+                    BOOST_CHECK_CLOSE(res.Dist, dists[res.VID], 1e-3);
+                    if (dists[res.VID] <= sorted[p_k - 1]) hits++;
+                }
+            }
+            return (float)hits / (p_queries->Count() * p_k);
+        }
+
+        // Mean pages read per query by the SSDServing search.
+        double SearchPages(SPTAG::SPANN::Index<float>* p_index, std::shared_ptr<SPTAG::VectorSet> p_queries)
+        {
+            std::vector<SPTAG::QueryResult> results(p_queries->Count(), SPTAG::QueryResult(NULL, c_internalResultNum, false));
+            std::vector<SPTAG::SPANN::SearchStats> stats(p_queries->Count());
+            for (SPTAG::SizeType i = 0; i < p_queries->Count(); i++) results[i].SetTarget(p_queries->GetVector(i));
+            SPTAG::SSDServing::SSDIndex::SearchSequential(p_index, 2, results, stats, p_queries->Count(), c_internalResultNum);
+
+            double pages = 0;
+            for (auto& ss : stats) pages += ss.m_diskAccessCount;
+            return pages / p_queries->Count();
+        }
+
+        void CheckSame(const std::vector<SPTAG::BasicResult>& p_a, const std::vector<SPTAG::BasicResult>& p_b)
+        {
+            BOOST_REQUIRE_EQUAL(p_a.size(), p_b.size());
+            for (size_t j = 0; j < p_a.size(); j++)
+            {
+                BOOST_CHECK_EQUAL(p_a[j].VID, p_b[j].VID);
+                BOOST_CHECK_CLOSE(p_a[j].Dist, p_b[j].Dist, 1e-3);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(SPANNTest)
+
+BOOST_AUTO_TEST_CASE(AsyncSearchMatchesSearch)
+{
+    const int k = 10;
+    auto vectors = SPTAG::TestUtils::RandomVectors<float>(2000, Local::c_dim, 1);
+    auto queries = SPTAG::TestUtils::RandomVectors<float>(64, Local::c_dim, 2);
+    auto index = SPTAG::TestUtils::BuildSPANNIndex("spann_async", vectors);
+    auto expected = Local::Search(index, queries, k);
+
+    // more callers than the two async workspaces; a caller turned away searches synchronously, as the server does
+    std::vector<std::unique_ptr<SPTAG::QueryResult>> results(queries->Count());
+    std::atomic<int> done(0), failed(0);
+    std::mutex lock;
+    std::condition_variable cv;
+    std::vector<std::thread> callers;
+    for (int t = 0; t < 4; t++)
+    {
+        callers.emplace_back([&, t]()
+        {
+            for (SPTAG::SizeType i = t; i < queries->Count(); i += 4)
+            {
+                results[i].reset(new SPTAG::QueryResult(queries->GetVector(i), Local::c_internalResultNum, false));
+                SPTAG::ErrorCode ret = index->SearchIndexAsync(*results[i], [&](SPTAG::ErrorCode p_ret)
+                {
+                    if (p_ret != SPTAG::ErrorCode::Success) failed++;
+                    std::lock_guard<std::mutex> guard(lock);
+                    done++;
+                    cv.notify_all();
+                });
+                if (ret == SPTAG::ErrorCode::Busy)
+                {
+                    ret = index->SearchIndex(*results[i]);
+                    done++;
+                }
+                if (ret != SPTAG::ErrorCode::Success) failed++;
+            }
+        });
+    }
+    for (auto& caller : callers) caller.join();
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        BOOST_REQUIRE(cv.wait_for(guard, std::chrono::seconds(60), [&]() { return done.load() == queries->Count(); }));
+    }
+    BOOST_CHECK_EQUAL(failed.load(), 0);
+
+    for (SPTAG::SizeType i = 0; i < queries->Count(); i++)
+    {
+        Local::CheckSame(std::vector<SPTAG::BasicResult>(results[i]->GetResults(), results[i]->GetResults() + k), expected[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(AsyncSearchTurnsAwayWhenBusy)
+{
+    const int k = 10;
+    auto vectors = SPTAG::TestUtils::RandomVectors<float>(2000, Local::c_dim, 1);
+    auto queries = SPTAG::TestUtils::RandomVectors<float>(3, Local::c_dim, 2);
+    auto index = SPTAG::TestUtils::BuildSPANNIndex("spann_asyncbusy", vectors, { { "BuildSSDIndex", { { "AsyncSearchThreads", "1" }, { "AsyncSearchMaxInFlight", "1" } } } });
+    auto expected = Local::Search(index, queries, k);
+
+    // the first callback holds the only completion thread, so the second search keeps the only workspace
+    auto caller = std::this_thread::get_id();
+    std::mutex lock;
+    std::condition_variable cv;
+    // the last read or the caller itself finishes a search, so the first one is retried until a read does
+    bool release = false, firstDone = false, secondDone = false, firstInline = true;
+    SPTAG::QueryResult first(queries->GetVector(0), Local::c_internalResultNum, false);
+    for (int retry = 0; firstInline && retry < 1000; retry++)
+    {
+        first.Reset();
+        firstDone = false;
+        BOOST_REQUIRE(SPTAG::ErrorCode::Success == index->SearchIndexAsync(first, [&](SPTAG::ErrorCode p_ret)
+        {
+            BOOST_CHECK(SPTAG::ErrorCode::Success == p_ret);
+            std::unique_lock<std::mutex> guard(lock);
+            firstInline = (std::this_thread::get_id() == caller);
+            firstDone = true;
+            cv.notify_all();
+            if (!firstInline) cv.wait(guard, [&]() { return release; });
+        }));
+        std::unique_lock<std::mutex> guard(lock);
+        BOOST_REQUIRE(cv.wait_for(guard, std::chrono::seconds(60), [&]() { return firstDone; }));
+    }
+    BOOST_REQUIRE(!firstInline);
+
+    SPTAG::QueryResult second(queries->GetVector(1), Local::c_internalResultNum, false);
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == index->SearchIndexAsync(second, [&](SPTAG::ErrorCode p_ret)
+    {
+        BOOST_CHECK(SPTAG::ErrorCode::Success == p_ret);
+        std::lock_guard<std::mutex> guard(lock);
+        secondDone = true;
+        cv.notify_all();
+    }));
+
+    // a third caller is turned away at once instead of waiting, and can still search synchronously
+    SPTAG::QueryResult third(queries->GetVector(2), Local::c_internalResultNum, false);
+    BOOST_CHECK(SPTAG::ErrorCode::Busy == index->SearchIndexAsync(third, [](SPTAG::ErrorCode) { BOOST_ERROR("a busy search called back"); }));
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == index->SearchIndex(third));
+
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        release = true;
+        cv.notify_all();
+        BOOST_REQUIRE(cv.wait_for(guard, std::chrono::seconds(60), [&]() { return secondDone; }));
+    }
+    Local::CheckSame(std::vector<SPTAG::BasicResult>(first.GetResults(), first.GetResults() + k), expected[0]);
+    Local::CheckSame(std::vector<SPTAG::BasicResult>(second.GetResults(), second.GetResults() + k), expected[1]);
+    Local::CheckSame(std::vector<SPTAG::BasicResult>(third.GetResults(), third.GetResults() + k), expected[2]);
+
+    // once the completions run again the workspace is back
+    SPTAG::QueryResult again(queries->GetVector(0), Local::c_internalResultNum, false);
+    std::atomic<bool> againDone(false);
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == index->SearchIndexAsync(again, [&](SPTAG::ErrorCode p_ret)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        againDone = true;
+        cv.notify_all();
+    }));
+    std::unique_lock<std::mutex> guard(lock);
+    BOOST_REQUIRE(cv.wait_for(guard, std::chrono::seconds(60), [&]() { return againDone.load(); }));
+}
+
+BOOST_AUTO_TEST_CASE(QuantizedHeadMatchesFullHead)
+{
+    const int k = 10;
+    auto vectors = SPTAG::TestUtils::RandomVectors<float>(3000, Local::c_dim, 1);
+    auto queries = SPTAG::TestUtils::RandomVectors<float>(50, Local::c_dim, 2);
+    std::vector<std::vector<SPTAG::BasicResult>> expected;
+    {
+        // only one SPANN index may hold the async I/O channels at a time
+        auto index = SPTAG::TestUtils::BuildSPANNIndex("spann_fullhead", vectors);
+        expected = Local::Search(index, queries, k);
+    }
+
+    auto index = SPTAG::TestUtils::BuildSPANNIndex("spann_quantizedhead", vectors, { { "Base", { { "QuantizeHead", "true" } } } });
+    auto* spann = (SPTAG::SPANN::Index<float>*)index.get();
+    BOOST_REQUIRE_EQUAL((int)spann->GetMemoryIndex()->GetVectorValueType(), (int)SPTAG::VectorValueType::Int8);
+
+    // re-scored heads carry their full precision distances, so the same postings are scanned
+    auto results = Local::Search(index, queries, k);
+    int same = 0;
+    for (SPTAG::SizeType i = 0; i < queries->Count(); i++)
+    {
+        for (int j = 0; j < k; j++) if (results[i][j].VID == expected[i][j].VID) same++;
+    }
+    float recall = Local::CheckResults(queries, vectors, k, results);
+    BOOST_TEST_MESSAGE("quantized head: " << same << " of " << queries->Count() * k << " results unchanged, recall " << recall);
+    BOOST_CHECK_GE(same, queries->Count() * k * 95 / 100);
+    BOOST_CHECK_GE(recall, Local::CheckResults(queries, vectors, k, expected) - 0.02f);
+
+    // asking for more heads than the head vector store reads at once keeps the re-scored candidates
+    const int wide = 4 * Local::c_internalResultNum;
+    SPTAG::QueryResult heads(queries->GetVector(0), wide, false);
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == spann->SearchHeadIndex(heads));
+    int found = 0;
+    for (int i = 0; i < wide; i++)
+    {
+        auto res = heads.GetResult(i);
+        if (res->VID == -1) continue;
+        found++;
+        if (i > 0 && heads.GetResult(i - 1)->VID != -1) BOOST_CHECK_LE(heads.GetResult(i - 1)->Dist, res->Dist);
+    }
+    BOOST_CHECK_EQUAL(found, 2 * Local::c_internalResultNum);
+}
+
+BOOST_AUTO_TEST_CASE(RoundedPostingSearch)
+{
+    const int k = 10;
+    auto vectors = SPTAG::TestUtils::RandomVectors<float>(3000, Local::c_dim, 1);
+    auto queries = SPTAG::TestUtils::RandomVectors<float>(200, Local::c_dim, 2);
+    auto index = SPTAG::TestUtils::BuildSPANNIndex("spann_rounds", vectors);
+    auto* spann = (SPTAG::SPANN::Index<float>*)index.get();
+    auto expected = Local::Search(index, queries, k);
+    double fullPages = Local::SearchPages(spann, queries);
+
+    // rounds without a stop read the same postings as one call
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == index->SetParameter("SearchPostingBatch", "4", "BuildSSDIndex"));
+    auto results = Local::Search(index, queries, k);
+    for (SPTAG::SizeType i = 0; i < queries->Count(); i++) Local::CheckSame(results[i], expected[i]);
+    BOOST_CHECK_EQUAL(Local::SearchPages(spann, queries), fullPages);
+
+    // a page budget stops after the first round that spends it
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == index->SetParameter("SearchPageBudget", "1", "BuildSSDIndex"));
+    double budgetPages = Local::SearchPages(spann, queries);
+    BOOST_TEST_MESSAGE("pages per query: " << fullPages << " in one call, " << budgetPages << " with a budget of one page");
+    BOOST_CHECK_LT(budgetPages, fullPages);
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == index->SetParameter("SearchPageBudget", "0", "BuildSSDIndex"));
+
+    // the ratio is tuned on a held-out prefix of the queries and scored on the rest; recall of a full search is about 0.8 here
+    std::vector<std::vector<SPTAG::SizeType>> truthIDs(queries->Count(), std::vector<SPTAG::SizeType>(k));
+    std::vector<std::vector<float>> truthDists(queries->Count(), std::vector<float>(k));
+    for (SPTAG::SizeType i = 0; i < queries->Count(); i++)
+    {
+        std::vector<SPTAG::BasicResult> all;
+        for (SPTAG::SizeType j = 0; j < vectors->Count(); j++)
+        {
+            all.emplace_back(j, SPTAG::COMMON::DistanceUtils::ComputeDistance((const float*)queries->GetVector(i), (const float*)vectors->GetVector(j), Local::c_dim, SPTAG::DistCalcMethod::L2));
+        }
+        std::partial_sort(all.begin(), all.begin() + k, all.end(), SPTAG::COMMON::Compare);
+        for (int j = 0; j < k; j++)
+        {
+            truthIDs[i][j] = all[j].VID;
+            truthDists[i][j] = all[j].Dist;
+        }
+    }
+    SPTAG::COMMON::TruthSet::writeTruthFile("spann_rounds_truth.bin", queries->Count(), k, truthIDs, truthDists, SPTAG::TruthFileType::DEFAULT);
+
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == index->SetParameter("TruthPath", "spann_rounds_truth.bin", "Base"));
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == index->SetParameter("TruthType", "DEFAULT", "Base"));
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == index->SetParameter("SearchBudgetTargetRecall", "0.75", "BuildSSDIndex"));
+    auto& opts = *spann->GetOptions();
+    std::shared_ptr<SPTAG::VectorSet> heldIn = queries;
+    std::string tuneTruth;
+    int heldOut = 0;
+    auto tuneSet = SPTAG::SSDServing::SSDIndex::SplitTuneQueries<float>(opts, heldIn, tuneTruth, heldOut);
+    BOOST_REQUIRE(tuneSet != nullptr);
+    BOOST_CHECK_EQUAL(heldOut, 20);
+    BOOST_CHECK_EQUAL(tuneTruth, "spann_rounds_truth.bin");
+    BOOST_REQUIRE_EQUAL(tuneSet->Count(), 20);
+    BOOST_REQUIRE_EQUAL(heldIn->Count(), 180);
+    BOOST_CHECK(tuneSet->GetVector(0) == queries->GetVector(0));
+    BOOST_CHECK(heldIn->GetVector(0) == queries->GetVector(20));
+
+    SPTAG::SSDServing::SSDIndex::TuneSearchConvergeRatio(spann, tuneSet, tuneTruth, 2, k, k, Local::c_internalResultNum);
+    BOOST_REQUIRE_GT(opts.m_searchConvergeRatio, 0);
+
+    std::vector<std::vector<SPTAG::BasicResult>> tuned = Local::Search(index, heldIn, k);
+    float recall = Local::CheckResults(heldIn, vectors, k, tuned);
+    double tunedPages = Local::SearchPages(spann, heldIn);
+    BOOST_TEST_MESSAGE("SearchConvergeRatio " << opts.m_searchConvergeRatio << ": held-out recall " << recall << ", " << tunedPages << " pages per query");
+    BOOST_CHECK_GE(recall, 0.65f);
+    BOOST_CHECK_LT(tunedPages, fullPages);
+}
+
+BOOST_AUTO_TEST_CASE(SpeculativePrefetchMatchesSearch)
+{
+    const int k = 10;
+    auto vectors = SPTAG::TestUtils::RandomVectors<float>(3000, Local::c_dim, 1);
+    auto queries = SPTAG::TestUtils::RandomVectors<float>(64, Local::c_dim, 2);
+
+    // the BKT search reports its partial results along the way and still ends with the plain results
+    auto bkt = SPTAG::VectorIndex::CreateInstance(SPTAG::IndexAlgoType::BKT, SPTAG::VectorValueType::Float);
+    bkt->SetParameter("DistCalcMethod", "L2");
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == bkt->BuildIndex(vectors->GetData(), vectors->Count(), vectors->Dimension()));
+    int calls = 0;
+    for (SPTAG::SizeType i = 0; i < queries->Count(); i++)
+    {
+        SPTAG::QueryResult expected(queries->GetVector(i), Local::c_internalResultNum, false);
+        BOOST_REQUIRE(SPTAG::ErrorCode::Success == bkt->SearchIndex(expected));
+
+        SPTAG::QueryResult result(queries->GetVector(i), Local::c_internalResultNum, false);
+        BOOST_REQUIRE(SPTAG::ErrorCode::Success == bkt->SearchIndexWithProgress(result, 64, [&](SPTAG::QueryResult& p_partial)
+        {
+            calls++;
+            for (int j = 0; j < p_partial.GetResultNum(); j++)
+            {
+                auto res = p_partial.GetResult(j);
+                if (res->VID == -1) continue;
+                BOOST_REQUIRE(res->VID >= 0 && res->VID < vectors->Count());
+                BOOST_CHECK_CLOSE(res->Dist, bkt->ComputeDistance(queries->GetVector(i), vectors->GetVector(res->VID)), 1e-3);
+            }
+        }));
+        Local::CheckSame(std::vector<SPTAG::BasicResult>(result.GetResults(), result.GetResults() + k),
+            std::vector<SPTAG::BasicResult>(expected.GetResults(), expected.GetResults() + k));
+    }
+    BOOST_CHECK_GE(calls, queries->Count());
+    bkt.reset();
+
+    // read-ahead postings that drop out of the final heads are ignored, so the SPANN results do not change;
+    // an interval of 1 reads ahead after every head checked
+    auto index = SPTAG::TestUtils::BuildSPANNIndex("spann_prefetch", vectors);
+    auto expected = Local::Search(index, queries, k);
+    for (const char* interval : { "1", "16", "128" })
+    {
+        BOOST_REQUIRE(SPTAG::ErrorCode::Success == index->SetParameter("SpeculativePrefetchInterval", interval, "BuildSSDIndex"));
+        auto results = Local::Search(index, queries, k);
+        for (SPTAG::SizeType i = 0; i < queries->Count(); i++) Local::CheckSame(results[i], expected[i]);
+    }
+
+    // a plain search on the same workspaces afterwards does not call back any more
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == index->SetParameter("SpeculativePrefetchInterval", "0", "BuildSSDIndex"));
+    auto results = Local::Search(index, queries, k);
+    for (SPTAG::SizeType i = 0; i < queries->Count(); i++) Local::CheckSame(results[i], expected[i]);
+}
+
+BOOST_AUTO_TEST_CASE(DroppedPrefetchLeavesNoReads)
+{
+    const int k = 10;
+    auto vectors = SPTAG::TestUtils::RandomVectors<float>(3000, Local::c_dim, 1);
+    auto queries = SPTAG::TestUtils::RandomVectors<float>(32, Local::c_dim, 2);
+    auto index = SPTAG::TestUtils::BuildSPANNIndex("spann_prefetchdrop", vectors);
+    auto* spann = (SPTAG::SPANN::Index<float>*)index.get();
+    auto& opts = *spann->GetOptions();
+    auto expected = Local::Search(index, queries, k);
+
+    // a workspace on the first channel, as the pool hands out to a query whose head search fails after reading ahead
+    SPTAG::SPANN::ExtraWorkSpace workSpace;
+    workSpace.Initialize(opts.m_maxCheck, opts.m_hashExp, Local::c_internalResultNum, opts.m_searchPostingPageLimit << SPTAG::PageSizeEx);
+    workSpace.m_spaceID = 0;
+    std::vector<int> postings;
+    for (int i = 0; i < 16; i++) postings.push_back(i);
+    auto searcher = spann->GetDiskIndex();
+    searcher->PrefetchPostings(&workSpace, postings);
+    BOOST_REQUIRE(!workSpace.m_prefetchIDs.empty());
+
+    // dropping waits for every read, so none of them completes into a later query on the channel
+    searcher->DropPrefetch(&workSpace);
+    BOOST_CHECK(workSpace.m_prefetchIDs.empty());
+    for (int inFlight : workSpace.m_prefetchInFlight) BOOST_CHECK_EQUAL(inFlight, 0);
+    auto results = Local::Search(index, queries, k);
+    for (SPTAG::SizeType i = 0; i < queries->Count(); i++) Local::CheckSame(results[i], expected[i]);
+}
+
+BOOST_AUTO_TEST_CASE(VectorReaderReadsSubsets)
+{
+    auto vectors = SPTAG::TestUtils::RandomVectors<float>(5000, Local::c_dim, 3);
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == vectors->Save("spann_reader_vectors.bin"));
+
+    std::shared_ptr<SPTAG::Helper::ReaderOptions> options(new SPTAG::Helper::ReaderOptions(SPTAG::VectorValueType::Float, Local::c_dim, SPTAG::VectorFileType::DEFAULT));
+    auto reader = SPTAG::Helper::VectorSetReader::CreateInstance(options);
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == reader->LoadFile("spann_reader_vectors.bin"));
+    BOOST_CHECK_EQUAL(reader->GetVectorCount(), 5000);
+
+    // runs of neighbours, gaps that are read through and gaps too wide to read through
+    std::vector<SPTAG::SizeType> ids = { 0, 1, 2, 5, 40, 41, 1500, 1501, 3999, 4999 };
+    auto subset = reader->GetVectorSubset(ids);
+    BOOST_REQUIRE_EQUAL(subset->Count(), (SPTAG::SizeType)ids.size());
+    BOOST_REQUIRE_EQUAL(subset->Dimension(), Local::c_dim);
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        BOOST_CHECK(std::memcmp(subset->GetVector((SPTAG::SizeType)i), vectors->GetVector(ids[i]), vectors->PerVectorDataSize()) == 0);
+    }
+    BOOST_CHECK_EQUAL(reader->GetVectorSubset({})->Count(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(StreamedBuildWritesPostingVectors)
+{
+    const int k = 10;
+    auto vectors = SPTAG::TestUtils::RandomVectors<float>(2000, Local::c_dim, 4);
+    auto queries = SPTAG::TestUtils::RandomVectors<float>(32, Local::c_dim, 5);
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == vectors->Save("spann_stream_vectors.bin"));
+
+    // heads are picked from a sample and postings are written in several windows read from the file
+    boost::filesystem::remove_all("spann_stream");
+    std::shared_ptr<SPTAG::VectorIndex> streamed = SPTAG::VectorIndex::CreateInstance(SPTAG::IndexAlgoType::SPANN, SPTAG::VectorValueType::Float);
+    std::map<std::string, std::map<std::string, std::string>> config = {
+        { "Base", { { "ValueType", "Float" }, { "DistCalcMethod", "L2" }, { "IndexAlgoType", "BKT" }, { "Dim", std::to_string(Local::c_dim) },
+            { "VectorPath", "spann_stream_vectors.bin" }, { "VectorType", "DEFAULT" }, { "IndexDirectory", "spann_stream" } } },
+        { "SelectHead", { { "isExecute", "true" }, { "Ratio", "0.1" }, { "NumberOfThreads", "2" }, { "SelectHeadSampleNumber", "800" } } },
+        { "BuildHead", { { "isExecute", "true" }, { "NumberOfThreads", "2" } } },
+        { "BuildSSDIndex", { { "isExecute", "true" }, { "BuildSsdIndex", "true" }, { "NumberOfThreads", "2" }, { "Batches", "4" },
+            { "TmpDir", "spann_stream" }, { "PostingPageLimit", "4" }, { "SearchPostingPageLimit", "4" }, { "InternalResultNum", "32" },
+            { "SearchInternalResultNum", std::to_string(Local::c_internalResultNum) }, { "ResultNum", "10" }, { "SearchThreadNum", "2" } } }
+    };
+    for (auto& sectionKV : config) {
+        for (auto& KV : sectionKV.second) {
+            streamed->SetParameter(KV.first, KV.second, sectionKV.first);
+        }
+    }
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == streamed->BuildIndex());
+    float streamedRecall = Local::CheckResults(queries, vectors, k, Local::Search(streamed, queries, k));
+
+    // workspaces number their aio channels process-wide, so only one SPANN index is searched at a time
+    streamed.reset();
+    auto inMemory = SPTAG::TestUtils::BuildSPANNIndex("spann_stream_memory", vectors);
+    float inMemoryRecall = Local::CheckResults(queries, vectors, k, Local::Search(inMemory, queries, k));
+    BOOST_TEST_MESSAGE("Streamed build recall " << streamedRecall << ", in-memory build recall " << inMemoryRecall);
+    BOOST_CHECK_GE(streamedRecall, inMemoryRecall - 0.1f);
+}
+
+BOOST_AUTO_TEST_CASE(RecallMonitorKeepsWindow)
+{
+    SPTAG::SPANN::RecallMonitor monitor(0.25f, 10, 4, 8);
+    BOOST_CHECK_EQUAL(monitor.GetRollingRecall(), -1);
+
+    int sampled = 0;
+    for (int i = 0; i < 100; i++) if (monitor.ShouldSample()) sampled++;
+    BOOST_CHECK_EQUAL(sampled, 25);
+
+    // the window holds the last four samples
+    monitor.Record(10, 10);
+    monitor.Record(5, 10);
+    BOOST_CHECK_CLOSE(monitor.GetRollingRecall(), 0.75, 1e-6);
+    monitor.Record(0, 0);
+    monitor.Record(0, 10);
+    monitor.Record(0, 10);
+    monitor.Record(0, 10);
+    std::uint64_t recorded = 0, dropped = 0;
+    BOOST_CHECK_CLOSE(monitor.GetRollingRecall(&recorded, &dropped), 5 / 40.0, 1e-6);
+    BOOST_CHECK_EQUAL(recorded, 5);
+    BOOST_CHECK_EQUAL(dropped, 0);
+
+    monitor.Drop();
+    monitor.GetRollingRecall(&recorded, &dropped);
+    BOOST_CHECK_EQUAL(dropped, 1);
+
+    // jobs queued beyond the pending limit are dropped rather than run
+    std::mutex lock;
+    std::condition_variable cv;
+    bool release = false;
+    std::atomic<int> ran(0);
+    for (int i = 0; i < 20; i++)
+    {
+        monitor.Submit([&]()
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            cv.wait(guard, [&]() { return release; });
+            ran++;
+        });
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        release = true;
+    }
+    cv.notify_all();
+    monitor.GetRollingRecall(&recorded, &dropped);
+    BOOST_CHECK_GE(dropped, 1 + 20 - 8 - 1);
+    for (int i = 0; i < 1000 && ran.load() + (int)dropped < 21; i++) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    BOOST_CHECK_EQUAL(ran.load() + (int)dropped, 21);
+}
+
+BOOST_AUTO_TEST_CASE(RecallMonitorSamplesSearches)
+{
+    const int k = 10;
+    auto vectors = SPTAG::TestUtils::RandomVectors<float>(2000, Local::c_dim, 6);
+    auto queries = SPTAG::TestUtils::RandomVectors<float>(48, Local::c_dim, 7);
+    auto index = SPTAG::TestUtils::BuildSPANNIndex("spann_recall_monitor", vectors, { { "BuildSSDIndex",
+        { { "RecallMonitorSampleRate", "1" }, { "RecallMonitorK", std::to_string(k) }, { "RecallMonitorWindow", "64" }, { "RecallMonitorMaxPending", "64" } } } });
+    auto spann = (SPTAG::SPANN::Index<float>*)index.get();
+    BOOST_CHECK_EQUAL(spann->GetRollingRecall(), -1);
+
+    float recall = Local::CheckResults(queries, vectors, k, Local::Search(index, queries, k));
+
+    std::uint64_t recorded = 0, dropped = 0;
+    double monitored = -1;
+    for (int i = 0; i < 1000; i++)
+    {
+        monitored = spann->GetRollingRecall(&recorded, &dropped);
+        if (recorded + dropped == (std::uint64_t)queries->Count()) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    BOOST_REQUIRE_EQUAL(recorded + dropped, (std::uint64_t)queries->Count());
+    BOOST_REQUIRE_GT(recorded, 0);
+
+    // the reference search probes four times the heads, so it should land close to the true recall
+    BOOST_TEST_MESSAGE("Monitored recall " << monitored << ", true recall " << recall);
+    BOOST_CHECK_LE(monitored, 1.0);
+    BOOST_CHECK_GE(monitored, recall - 0.05);
+    BOOST_CHECK_LE(monitored, recall + 0.1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,7 @@
 // Licensed under the MIT License.
 
 #include "inc/Test.h"
+#include "inc/TestUtils.h"
 
 #include "inc/Core/Common.h"
 #include "inc/Core/Common/TruthSet.h"
@@ -11,6 +12,8 @@
 #include "inc/Helper/StringConvert.h"
 #include "inc/Helper/VectorSetReader.h"
 #include <future>
+#include <random>
+#include <boost/filesystem.hpp>
 
 #include <iomanip>
 #include <iostream>
@@ -744,6 +747,8 @@ namespace SPTAG {
                     //     }
                     // }
                     p_index->CalculatePostingDistribution();
+                    if (p_index->NeedHeadCompaction()) p_index->CompactHeadIndex();
+                    if (p_index->NeedHeadReorder()) p_index->ReorderHeadIndex();
                     // p_index->ForceCompaction();
 
                     p_opts.m_calTruth = calTruthOrigin;
@@ -820,6 +825,301 @@ namespace SPTAG {
                 StableSearch(p_index, numThreads, querySet, vectorSet, searchTimes, p_opts.m_queryCountLimit, internalResultNum, vectorSet->Count(), p_opts);
             }
 
+            // A small updatable KV index built from vectors in memory. Postings hold one page, so inserts split heads soon.
+            template <typename ValueType>
+            std::shared_ptr<VectorIndex> BuildUpdatableIndex(const std::string& p_dir, std::shared_ptr<VectorSet> p_vectors, SizeType p_count)
+            {
+                boost::filesystem::remove_all(p_dir);
+                std::shared_ptr<VectorIndex> index = VectorIndex::CreateInstance(IndexAlgoType::SPANN, GetEnumValueType<ValueType>());
+                std::map<std::string, std::map<std::string, std::string>> config = {
+                    { "Base", { { "ValueType", Helper::Convert::ConvertToString(GetEnumValueType<ValueType>()) }, { "DistCalcMethod", "L2" },
+                        { "IndexAlgoType", "BKT" }, { "Dim", std::to_string(p_vectors->Dimension()) }, { "IndexDirectory", p_dir } } },
+                    { "SelectHead", { { "isExecute", "true" }, { "Ratio", "0.1" }, { "NumberOfThreads", "2" } } },
+                    { "BuildHead", { { "isExecute", "true" }, { "NumberOfThreads", "2" } } },
+                    { "BuildSSDIndex", { { "isExecute", "true" }, { "BuildSsdIndex", "true" }, { "UseKV", "true" }, { "NumberOfThreads", "2" },
+                        { "KVPath", p_dir + FolderSep + "KVDatabase" }, { "SsdInfoFile", p_dir + FolderSep + "SsdInfoFile" },
+                        { "FullDeletedIDFile", p_dir + FolderSep + "FullDeletedIDFile" }, { "PersistentBufferPath", p_dir + FolderSep + "PersistentBuffer" },
+                        { "TmpDir", p_dir }, { "PostingPageLimit", "1" }, { "InternalResultNum", "32" }, { "SearchInternalResultNum", "32" },
+                        { "ResultNum", "10" }, { "SearchThreadNum", "2" }, { "Update", "true" }, { "InsertThreadNum", "1" },
+                        { "AppendThreadNum", "2" }, { "ReassignThreadNum", "2" } } }
+                };
+                for (auto& sectionKV : config) {
+                    for (auto& KV : sectionKV.second) {
+                        index->SetParameter(KV.first, KV.second, sectionKV.first);
+                    }
+                }
+                BOOST_REQUIRE(ErrorCode::Success == index->BuildIndex(p_vectors->GetData(), p_count, p_vectors->Dimension()));
+                return index;
+            }
+
+            template <typename ValueType>
+            void InsertAndWait(SPANN::Index<ValueType>* p_index, std::shared_ptr<VectorSet> p_vectors, SizeType p_begin, SizeType p_end)
+            {
+                for (SizeType i = p_begin; i < p_end; i++) {
+                    BOOST_REQUIRE(ErrorCode::Success == p_index->AddIndex(p_vectors->GetVector(i), 1, p_vectors->Dimension(), nullptr));
+                }
+                while (!p_index->AllFinished()) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+
+            // Head search followed by the posting search, keeping the top p_k global VIDs of every query.
+            template <typename ValueType>
+            void SearchUpdatable(SPANN::Index<ValueType>* p_index, std::shared_ptr<VectorSet> p_queries, int p_k, std::vector<std::vector<BasicResult>>& p_results)
+            {
+                int internalResultNum = p_index->GetOptions()->m_searchInternalResultNum;
+                p_results.resize(p_queries->Count());
+                for (SizeType i = 0; i < p_queries->Count(); i++) {
+                    QueryResult result(p_queries->GetVector(i), internalResultNum, false);
+                    SPANN::SearchStats stats;
+                    p_index->GetMemoryIndex()->SearchIndex(result);
+                    p_index->DebugSearchDiskIndex(result, internalResultNum, internalResultNum, &stats);
+                    p_results[i].assign(result.GetResults(), result.GetResults() + p_k);
+                }
+            }
+
+            // Checks that every result is a vector inserted so far at the reported distance, and returns recall@p_k.
+            template <typename ValueType>
+            float CheckResults(std::shared_ptr<VectorSet> p_queries, std::shared_ptr<VectorSet> p_vectors, SizeType p_count, int p_k,
+                const std::vector<std::vector<BasicResult>>& p_results)
+            {
+                int hits = 0;
+                for (SizeType i = 0; i < p_queries->Count(); i++) {
+                    const ValueType* query = (const ValueType*)p_queries->GetVector(i);
+                    std::vector<float> dists(p_count);
+                    for (SizeType j = 0; j < p_count; j++) {
+                        dists[j] = COMMON::DistanceUtils::ComputeDistance(query, (const ValueType*)p_vectors->GetVector(j), p_vectors->Dimension(), DistCalcMethod::L2);
+                    }
+                    std::vector<float> sorted(dists);
+                    std::nth_element(sorted.begin(), sorted.begin() + p_k - 1, sorted.end());
+                    float kth = sorted[p_k - 1];
+
+                    for (const BasicResult& res : p_results[i]) {
+                        BOOST_REQUIRE(res.VID >= 0 && res.VID < p_count);
+                        BOOST_CHECK_CLOSE(res.Dist, dists[res.VID], 1e-3);
+                        if (dists[res.VID] <= kth) hits++;
+                    }
+                }
+                return (float)hits / (p_queries->Count() * p_k);
+            }
+
+            template <typename ValueType>
+            void CompactHeadTest()
+            {
+                SizeType buildCount = 1000, insertCount = 3000, total = buildCount + insertCount + 500;
+                int k = 10;
+                std::shared_ptr<VectorSet> vectors = TestUtils::RandomVectors<ValueType>(total, 16, 1);
+                std::shared_ptr<VectorSet> queries = TestUtils::RandomVectors<ValueType>(50, 16, 2);
+                std::shared_ptr<VectorIndex> index = BuildUpdatableIndex<ValueType>("spfresh_compact", vectors, buildCount);
+                auto* p_index = (SPANN::Index<ValueType>*)index.get();
+
+                InsertAndWait(p_index, vectors, buildCount, buildCount + insertCount);
+                SizeType oldHeads = p_index->GetMemoryIndex()->GetNumSamples();
+                SizeType deletedHeads = p_index->GetMemoryIndex()->GetNumDeleted();
+                BOOST_REQUIRE_GT(deletedHeads, 0);
+
+                std::vector<std::vector<BasicResult>> before, after;
+                SearchUpdatable(p_index, queries, k, before);
+                float recallBefore = CheckResults<ValueType>(queries, vectors, buildCount + insertCount, k, before);
+
+                BOOST_REQUIRE(ErrorCode::Success == p_index->CompactHeadIndex());
+                BOOST_CHECK_EQUAL(p_index->GetMemoryIndex()->GetNumSamples(), oldHeads - deletedHeads);
+                BOOST_CHECK_EQUAL(p_index->GetMemoryIndex()->GetNumDeleted(), 0);
+                std::string posting;
+                for (SizeType i = oldHeads - deletedHeads; i < oldHeads; i++) {
+                    BOOST_CHECK(ErrorCode::Success != p_index->GetDiskIndex()->SearchIndex(i, posting));
+                }
+
+                SearchUpdatable(p_index, queries, k, after);
+                float recallAfter = CheckResults<ValueType>(queries, vectors, buildCount + insertCount, k, after);
+                LOG(Helper::LogLevel::LL_Info, "Compacted %d deleted heads, recall %.3f -> %.3f\n", deletedHeads, recallBefore, recallAfter);
+                BOOST_CHECK_GE(recallAfter, recallBefore - 0.05f);
+
+                // new heads take the freed ids over
+                InsertAndWait(p_index, vectors, buildCount + insertCount, total);
+                SearchUpdatable(p_index, queries, k, after);
+                BOOST_CHECK_GE(CheckResults<ValueType>(queries, vectors, total, k, after), recallBefore - 0.05f);
+            }
+
+            // A caller that keeps the head index across a compaction does not block it; the tail postings it may
+            // still read stay until the next renumbering after it lets go.
+            template <typename ValueType>
+            void CompactHeldHeadTest()
+            {
+                SizeType buildCount = 1000, insertCount = 3000;
+                std::shared_ptr<VectorSet> vectors = TestUtils::RandomVectors<ValueType>(buildCount + insertCount, 16, 1);
+                std::shared_ptr<VectorIndex> index = BuildUpdatableIndex<ValueType>("spfresh_compact_held", vectors, buildCount);
+                auto* p_index = (SPANN::Index<ValueType>*)index.get();
+                BOOST_REQUIRE(ErrorCode::Success == index->SetParameter("HeadCompactWaitMs", "50", "BuildSSDIndex"));
+
+                InsertAndWait(p_index, vectors, buildCount, buildCount + insertCount);
+                auto held = p_index->GetMemoryIndex();
+                SizeType oldHeads = held->GetNumSamples();
+                SizeType newHeads = oldHeads - held->GetNumDeleted();
+                BOOST_REQUIRE_LT(newHeads, oldHeads);
+
+                BOOST_REQUIRE(ErrorCode::Success == p_index->CompactHeadIndex());
+                BOOST_CHECK_EQUAL(p_index->GetMemoryIndex()->GetNumSamples(), newHeads);
+                std::string posting;
+                for (SizeType i = newHeads; i < oldHeads; i++) {
+                    if (held->ContainSample(i)) BOOST_CHECK(ErrorCode::Success == p_index->GetDiskIndex()->SearchIndex(i, posting));
+                }
+
+                held.reset();
+                BOOST_REQUIRE(ErrorCode::Success == p_index->ReorderHeadIndex());
+                for (SizeType i = newHeads; i < oldHeads; i++) {
+                    BOOST_CHECK(ErrorCode::Success != p_index->GetDiskIndex()->SearchIndex(i, posting));
+                }
+            }
+
+            // Postings of the live heads keyed by the head vector, which stays with the posting when heads are renumbered.
+            template <typename ValueType>
+            std::map<std::string, std::string> HeadPostings(SPANN::Index<ValueType>* p_index)
+            {
+                std::map<std::string, std::string> postings;
+                auto headIndex = p_index->GetMemoryIndex();
+                for (SizeType i = 0; i < headIndex->GetNumSamples(); i++) {
+                    if (!headIndex->ContainSample(i)) continue;
+                    std::string key((const char*)headIndex->GetSample(i), sizeof(ValueType) * headIndex->GetFeatureDim());
+                    BOOST_REQUIRE(ErrorCode::Success == p_index->GetDiskIndex()->SearchIndex(i, postings[key]));
+                }
+                return postings;
+            }
+
+            template <typename ValueType>
+            void ReorderHeadTest()
+            {
+                SizeType buildCount = 1000, insertCount = 3000, total = buildCount + insertCount + 500;
+                int k = 10;
+                std::shared_ptr<VectorSet> vectors = TestUtils::RandomVectors<ValueType>(total, 16, 1);
+                std::shared_ptr<VectorSet> queries = TestUtils::RandomVectors<ValueType>(50, 16, 2);
+                std::shared_ptr<VectorIndex> index = BuildUpdatableIndex<ValueType>("spfresh_reorder", vectors, buildCount);
+                auto* p_index = (SPANN::Index<ValueType>*)index.get();
+
+                // the first check only records the head count, splits then append heads out of tree order
+                BOOST_REQUIRE(ErrorCode::Success == index->SetParameter("HeadReorderRatio", "0.5", "BuildSSDIndex"));
+                BOOST_CHECK(!p_index->NeedHeadReorder());
+                InsertAndWait(p_index, vectors, buildCount, buildCount + insertCount);
+                BOOST_REQUIRE(p_index->NeedHeadReorder());
+
+                SizeType heads = p_index->GetMemoryIndex()->GetNumSamples();
+                auto postingsBefore = HeadPostings(p_index);
+                std::vector<std::vector<BasicResult>> before, after;
+                SearchUpdatable(p_index, queries, k, before);
+
+                BOOST_REQUIRE(ErrorCode::Success == p_index->ReorderHeadIndex());
+                BOOST_CHECK(!p_index->NeedHeadReorder());
+                BOOST_CHECK_EQUAL(p_index->GetMemoryIndex()->GetNumSamples(), heads);
+                BOOST_CHECK(HeadPostings(p_index) == postingsBefore);
+
+                // the same heads hold the same postings, so the same vectors are found
+                SearchUpdatable(p_index, queries, k, after);
+                int same = 0;
+                for (SizeType i = 0; i < queries->Count(); i++) {
+                    for (int j = 0; j < k; j++) {
+                        if (before[i][j].VID == after[i][j].VID) same++;
+                    }
+                }
+                float recallBefore = CheckResults<ValueType>(queries, vectors, buildCount + insertCount, k, before);
+                float recallAfter = CheckResults<ValueType>(queries, vectors, buildCount + insertCount, k, after);
+                LOG(Helper::LogLevel::LL_Info, "Reordered %d heads, %d of %d results unchanged, recall %.3f -> %.3f\n",
+                    heads, same, queries->Count() * k, recallBefore, recallAfter);
+                BOOST_CHECK_GE(same, queries->Count() * k * 95 / 100);
+                BOOST_CHECK_GE(recallAfter, recallBefore - 0.02f);
+
+                // updates keep working on the new numbering; the further splits alone move recall by a few points
+                InsertAndWait(p_index, vectors, buildCount + insertCount, total);
+                SearchUpdatable(p_index, queries, k, after);
+                BOOST_CHECK_GE(CheckResults<ValueType>(queries, vectors, total, k, after), recallBefore - 0.1f);
+
+                // with searches running, a reorder is refused while one reads postings and goes through between them
+                postingsBefore = HeadPostings(p_index);
+                std::atomic<bool> searching(true);
+                std::vector<std::thread> searchers;
+                for (int t = 0; t < 2; t++) {
+                    searchers.emplace_back([&, t]() {
+                        std::vector<std::vector<BasicResult>> results;
+                        auto query = std::make_shared<BasicVectorSet>(ByteArray((std::uint8_t*)queries->GetVector(t), sizeof(ValueType) * queries->Dimension(), false),
+                            GetEnumValueType<ValueType>(), queries->Dimension(), 1);
+                        while (searching) {
+                            SearchUpdatable(p_index, query, k, results);
+                            std::this_thread::sleep_for(std::chrono::microseconds(200));
+                        }
+                    });
+                }
+                int refused = 0;
+                ErrorCode reordered = ErrorCode::Fail;
+                for (int retry = 0; retry < 10000 && reordered != ErrorCode::Success; retry++) {
+                    reordered = p_index->ReorderHeadIndex();
+                    if (reordered != ErrorCode::Success) refused++;
+                }
+                searching = false;
+                for (auto& searcher : searchers) searcher.join();
+                LOG(Helper::LogLevel::LL_Info, "Reorder went through after %d refusals\n", refused);
+                BOOST_CHECK(reordered == ErrorCode::Success);
+                BOOST_CHECK(HeadPostings(p_index) == postingsBefore);
+                SearchUpdatable(p_index, queries, k, after);
+                BOOST_CHECK_GE(CheckResults<ValueType>(queries, vectors, total, k, after), recallBefore - 0.1f);
+            }
+
+            // Like SearchUpdatable, and also records how many posting vectors each query scanned.
+            template <typename ValueType>
+            void SearchScanned(SPANN::Index<ValueType>* p_index, std::shared_ptr<VectorSet> p_queries, int p_k, std::vector<std::vector<BasicResult>>& p_results, std::vector<int>& p_scanned)
+            {
+                int internalResultNum = p_index->GetOptions()->m_searchInternalResultNum;
+                p_results.resize(p_queries->Count());
+                p_scanned.resize(p_queries->Count());
+                for (SizeType i = 0; i < p_queries->Count(); i++) {
+                    QueryResult result(p_queries->GetVector(i), internalResultNum, false);
+                    SPANN::SearchStats stats;
+                    p_index->GetMemoryIndex()->SearchIndex(result);
+                    p_index->DebugSearchDiskIndex(result, internalResultNum, internalResultNum, &stats);
+                    p_results[i].assign(result.GetResults(), result.GetResults() + p_k);
+                    p_scanned[i] = stats.m_totalListElementsCount;
+                }
+            }
+
+            template <typename ValueType>
+            void ParallelScanTest()
+            {
+                SizeType count = 3000;
+                int k = 10;
+                std::shared_ptr<VectorSet> vectors = TestUtils::RandomVectors<ValueType>(count, 16, 1);
+                std::shared_ptr<VectorSet> queries = TestUtils::RandomVectors<ValueType>(50, 16, 2);
+                std::shared_ptr<VectorIndex> index = BuildUpdatableIndex<ValueType>("spfresh_parallel_scan", vectors, count);
+                auto* p_index = (SPANN::Index<ValueType>*)index.get();
+                auto scan = [&](const char* p_threads, const char* p_latencyLimit, std::vector<std::vector<BasicResult>>& p_results, std::vector<int>& p_scanned)
+                {
+                    BOOST_REQUIRE(ErrorCode::Success == index->SetParameter("SearchScanThreads", p_threads, "BuildSSDIndex"));
+                    BOOST_REQUIRE(ErrorCode::Success == index->SetParameter("LatencyLimit", p_latencyLimit, "BuildSSDIndex"));
+                    BOOST_REQUIRE(p_index->GetDiskIndex()->LoadIndex(*p_index->GetOptions()));
+                    SearchScanned(p_index, queries, k, p_results, p_scanned);
+                };
+
+                // with a limit no query reaches, parallel and serial scans see the same vectors and return the same results
+                std::vector<std::vector<BasicResult>> serial, parallel;
+                std::vector<int> serialScanned, parallelScanned;
+                scan("1", "100000", serial, serialScanned);
+                scan("4", "100000", parallel, parallelScanned);
+                for (SizeType i = 0; i < queries->Count(); i++) {
+                    BOOST_CHECK_EQUAL(parallelScanned[i], serialScanned[i]);
+                    for (int j = 0; j < k; j++) {
+                        BOOST_CHECK_EQUAL(parallel[i][j].VID, serial[i][j].VID);
+                        BOOST_CHECK_EQUAL(parallel[i][j].Dist, serial[i][j].Dist);
+                    }
+                }
+
+                // with a limit every posting reaches, the serial scan stops after one posting and each scan thread after at most one
+                std::vector<std::vector<BasicResult>> limited;
+                std::vector<int> limitedScanned;
+                for (const char* threads : { "1", "4" }) {
+                    scan(threads, "0", limited, limitedScanned);
+                    for (SizeType i = 0; i < queries->Count(); i++) {
+                        BOOST_CHECK_GT(limitedScanned[i], 0);
+                        BOOST_CHECK_LT(limitedScanned[i], serialScanned[i]);
+                        BOOST_CHECK_NE(limited[i][0].VID, -1);
+                    }
+                }
+            }
+
             int UpdateTest(std::map<std::string, std::map<std::string, std::string>>* config_map, 
                 const char* configurationPath) {
 
@@ -939,4 +1239,24 @@ BOOST_AUTO_TEST_CASE(SPFreshUpdate)
 	SSDServing::SPFresh::UpdateTest(&my_map, configPath.data());
 }
 
+BOOST_AUTO_TEST_CASE(SPFreshCompactHead)
+{
+    SSDServing::SPFresh::CompactHeadTest<float>();
+}
+
+BOOST_AUTO_TEST_CASE(SPFreshCompactHeldHead)
+{
+    SSDServing::SPFresh::CompactHeldHeadTest<float>();
+}
+
+BOOST_AUTO_TEST_CASE(SPFreshReorderHead)
+{
+    SSDServing::SPFresh::ReorderHeadTest<float>();
+}
+
+BOOST_AUTO_TEST_CASE(SPFreshParallelScan)
+{
+    SSDServing::SPFresh::ParallelScanTest<float>();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
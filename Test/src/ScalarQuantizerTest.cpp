@@ -0,0 +1,127 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "inc/Test.h"
+#include "inc/Core/Common/ScalarQuantizer.h"
+#include "inc/Core/Common/DistanceUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+    namespace Local
+    {
+        const SPTAG::DimensionType c_dim = 24;
+
+        // Every dimension has its own range, so a shared scale only fills the code range in the widest one.
+        std::vector<float> RandomVectors(SPTAG::SizeType p_count, unsigned p_seed)
+        {
+            std::mt19937 rng(p_seed);
+            std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+            std::vector<float> data((size_t)p_count * c_dim);
+            for (SPTAG::SizeType i = 0; i < p_count; i++)
+            {
+                for (SPTAG::DimensionType d = 0; d < c_dim; d++) data[(size_t)i * c_dim + d] = 10.0f * d + (d + 1) * dist(rng);
+            }
+            return data;
+        }
+
+        std::vector<std::int8_t> Quantize(const SPTAG::COMMON::ScalarQuantizer& p_quantizer, const std::vector<float>& p_data)
+        {
+            std::vector<std::int8_t> codes(p_data.size());
+            for (size_t i = 0; i < p_data.size(); i += c_dim) p_quantizer.Quantize(p_data.data() + i, codes.data() + i);
+            return codes;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(ScalarQuantizerTest)
+
+BOOST_AUTO_TEST_CASE(L2CodesKeepDistances)
+{
+    const SPTAG::SizeType count = 500;
+    auto data = Local::RandomVectors(count, 1);
+    SPTAG::COMMON::ScalarQuantizer quantizer;
+    quantizer.Train<float>([&data](SPTAG::SizeType i) { return data.data() + (size_t)i * Local::c_dim; }, count, Local::c_dim, SPTAG::DistCalcMethod::L2);
+    BOOST_REQUIRE_EQUAL(quantizer.GetDim(), Local::c_dim);
+
+    // the widest dimension spans the whole code range, the others stay centered within it
+    auto codes = Local::Quantize(quantizer, data);
+    int low = 127, high = -127;
+    for (SPTAG::SizeType i = 0; i < count; i++)
+    {
+        std::int8_t code = codes[(size_t)i * Local::c_dim + Local::c_dim - 1];
+        low = std::min(low, (int)code);
+        high = std::max(high, (int)code);
+    }
+    BOOST_CHECK_EQUAL(low, -127);
+    BOOST_CHECK_EQUAL(high, 127);
+    for (std::int8_t code : codes) BOOST_CHECK_NE((int)code, -128);
+
+    // one shared scale keeps code distances proportional to the original ones
+    float ratio = 0;
+    for (SPTAG::SizeType i = 1; i < count; i++)
+    {
+        float dist = SPTAG::COMMON::DistanceUtils::ComputeDistance(data.data(), data.data() + (size_t)i * Local::c_dim, Local::c_dim, SPTAG::DistCalcMethod::L2);
+        float codeDist = SPTAG::COMMON::DistanceUtils::ComputeDistance(codes.data(), codes.data() + (size_t)i * Local::c_dim, Local::c_dim, SPTAG::DistCalcMethod::L2);
+        if (ratio == 0) ratio = codeDist / dist;
+        else BOOST_CHECK_CLOSE(codeDist / dist, ratio, 5.0);
+    }
+
+    // values outside the trained range are clamped
+    std::vector<float> outside(Local::c_dim, 1e6f);
+    std::vector<std::int8_t> code(Local::c_dim);
+    quantizer.Quantize(outside.data(), code.data());
+    for (std::int8_t c : code) BOOST_CHECK_EQUAL((int)c, 127);
+}
+
+BOOST_AUTO_TEST_CASE(CosineCodesAreNormalized)
+{
+    const SPTAG::SizeType count = 100;
+    auto data = Local::RandomVectors(count, 2);
+    for (SPTAG::SizeType i = 0; i < count; i++) SPTAG::COMMON::Utils::Normalize(data.data() + (size_t)i * Local::c_dim, Local::c_dim, SPTAG::COMMON::Utils::GetBase<float>());
+
+    SPTAG::COMMON::ScalarQuantizer quantizer;
+    quantizer.Train<float>([&data](SPTAG::SizeType i) { return data.data() + (size_t)i * Local::c_dim; }, count, Local::c_dim, SPTAG::DistCalcMethod::Cosine);
+    auto codes = Local::Quantize(quantizer, data);
+    const float base = (float)SPTAG::COMMON::Utils::GetBase<std::int8_t>();
+    for (SPTAG::SizeType i = 0; i < count; i++)
+    {
+        float norm = 0;
+        for (SPTAG::DimensionType d = 0; d < Local::c_dim; d++)
+        {
+            float c = codes[(size_t)i * Local::c_dim + d];
+            BOOST_CHECK_LE(std::abs(c - data[(size_t)i * Local::c_dim + d] * base), 0.5f);
+            norm += c * c;
+        }
+        BOOST_CHECK_CLOSE(std::sqrt(norm), base, 2.0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SaveAndLoad)
+{
+    const SPTAG::SizeType count = 200;
+    auto data = Local::RandomVectors(count, 3);
+    SPTAG::COMMON::ScalarQuantizer quantizer;
+    quantizer.Train<float>([&data](SPTAG::SizeType i) { return data.data() + (size_t)i * Local::c_dim; }, count, Local::c_dim, SPTAG::DistCalcMethod::L2);
+    {
+        auto out = SPTAG::f_createIO();
+        BOOST_REQUIRE(out != nullptr && out->Initialize("scalar_quantizer.bin", std::ios::binary | std::ios::out));
+        BOOST_REQUIRE(SPTAG::ErrorCode::Success == quantizer.Save(out));
+    }
+
+    SPTAG::COMMON::ScalarQuantizer loaded;
+    auto in = SPTAG::f_createIO();
+    BOOST_REQUIRE(in != nullptr && in->Initialize("scalar_quantizer.bin", std::ios::binary | std::ios::in));
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == loaded.Load(in));
+    BOOST_CHECK_EQUAL(loaded.GetDim(), Local::c_dim);
+
+    auto expected = Local::Quantize(quantizer, data);
+    auto actual = Local::Quantize(loaded, data);
+    BOOST_CHECK(expected == actual);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,173 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "inc/Test.h"
+#include "inc/TestUtils.h"
+#include "inc/Core/VectorIndex.h"
+#include "inc/Server/SearchExecutor.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    namespace Local
+    {
+        const SPTAG::DimensionType c_dim = 4;
+        const SPTAG::SizeType c_count = 64;
+
+        std::shared_ptr<SPTAG::Service::ServiceContext> CreateContext()
+        {
+            // the two indexes interleave along one axis, A on the even and B on the odd positions
+            SPTAG::TestUtils::SaveBKTIndex("executor_index_a", SPTAG::TestUtils::LineVectors(c_count, c_dim, 2, 0));
+            SPTAG::TestUtils::SaveBKTIndex("executor_index_b", SPTAG::TestUtils::LineVectors(c_count, c_dim, 2, 1));
+
+            std::ofstream config("executor_service.ini");
+            config << "[QueryConfig]\nDefaultMaxResultNumber=10\nDefaultSeparator=|\n\n";
+            config << "[Index]\nList=A,B\n\n";
+            config << "[Index_A]\nIndexFolder=executor_index_a\n\n";
+            config << "[Index_B]\nIndexFolder=executor_index_b\n";
+            config.close();
+
+            std::shared_ptr<SPTAG::Service::ServiceContext> context(new SPTAG::Service::ServiceContext("executor_service.ini"));
+            BOOST_REQUIRE(context->IsInitialized());
+            BOOST_REQUIRE_EQUAL(context->GetIndexMap()->size(), 2);
+            return context;
+        }
+
+        std::map<std::string, std::vector<SPTAG::BasicResult>> Execute(const std::shared_ptr<SPTAG::Service::ServiceContext>& p_context, const std::string& p_query,
+            const SPTAG::Service::SearchExecutor::TaskPoster& p_taskPoster = SPTAG::Service::SearchExecutor::TaskPoster())
+        {
+            std::map<std::string, std::vector<SPTAG::BasicResult>> results;
+            SPTAG::Service::SearchExecutor executor(p_query, p_context,
+                [&results](std::shared_ptr<SPTAG::Service::SearchExecutionContext> p_exeContext)
+                {
+                    for (const auto& result : p_exeContext->GetResults())
+                    {
+                        auto& list = results[result.m_indexName];
+                        for (const auto& res : result.m_results) list.push_back(res);
+                    }
+                },
+                p_taskPoster);
+            executor.Execute();
+            return results;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(SearchExecutorTest)
+
+BOOST_AUTO_TEST_CASE(MergedResultsKeepTheirIndex)
+{
+    auto context = Local::CreateContext();
+
+    // the query sits at 0.1, so the nearest vectors alternate between A (0, 2, 4) and B (1, 3)
+    auto results = Local::Execute(context, "0.1|0|0|0 $indexname:A,B $mergeresults:true $resultnum:5");
+    BOOST_REQUIRE_EQUAL(results.size(), 2);
+    BOOST_REQUIRE(results.count("A") == 1 && results.count("B") == 1);
+
+    std::vector<SPTAG::SizeType> expectedA = { 0, 1, 2 }, expectedB = { 0, 1 };
+    for (auto& expected : { std::make_pair(std::string("A"), expectedA), std::make_pair(std::string("B"), expectedB) })
+    {
+        const auto& list = results[expected.first];
+        BOOST_REQUIRE_EQUAL(list.size(), 5);
+        int offset = expected.first == "A" ? 0 : 1;
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            if (i < expected.second.size())
+            {
+                // every VID is a row of the index it is reported under
+                BOOST_CHECK_EQUAL(list[i].VID, expected.second[i]);
+                float x = (float)(2 * expected.second[i] + offset) - 0.1f;
+                BOOST_CHECK_CLOSE(list[i].Dist, x * x, 1e-3);
+            }
+            else
+            {
+                BOOST_CHECK_EQUAL(list[i].VID, -1);
+            }
+        }
+    }
+
+    // without merging every index returns its own top results
+    results = Local::Execute(context, "0.1|0|0|0 $indexname:A,B $resultnum:3");
+    BOOST_REQUIRE_EQUAL(results.size(), 2);
+    for (const auto& entry : results)
+    {
+        for (SPTAG::SizeType i = 0; i < 3; i++) BOOST_CHECK_EQUAL(entry.second[i].VID, i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ParallelFanOutKeepsOrderAndSource)
+{
+    // four indexes interleaved with stride 4: position p along the axis is vector p / 4 of index p % 4
+    const int indexNum = 4;
+    std::ofstream config("executor_fanout_service.ini");
+    config << "[QueryConfig]\nDefaultMaxResultNumber=10\nDefaultSeparator=|\n\n";
+    config << "[Index]\nList=I0,I1,I2,I3\n\n";
+    for (int k = 0; k < indexNum; k++)
+    {
+        std::string folder = "executor_fanout_" + std::to_string(k);
+        SPTAG::TestUtils::SaveBKTIndex(folder, SPTAG::TestUtils::LineVectors(Local::c_count, Local::c_dim, (float)indexNum, (float)k));
+        config << "[Index_I" << k << "]\nIndexFolder=" << folder << "\n\n";
+    }
+    config.close();
+    std::shared_ptr<SPTAG::Service::ServiceContext> context(new SPTAG::Service::ServiceContext("executor_fanout_service.ini"));
+    BOOST_REQUIRE(context->IsInitialized());
+    BOOST_REQUIRE_EQUAL(context->GetIndexMap()->size(), indexNum);
+
+    // every posted task runs on a thread of its own
+    std::mutex lock;
+    std::vector<std::thread> threads;
+    SPTAG::Service::SearchExecutor::TaskPoster poster = [&](std::function<void()> p_task)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        threads.emplace_back(std::move(p_task));
+    };
+
+    const int resultNum = 7;
+    for (int round = 0; round < 20; round++)
+    {
+        auto results = Local::Execute(context, "0.1|0|0|0 $indexname:I0,I1,I2,I3 $mergeresults:true $resultnum:" + std::to_string(resultNum), poster);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            BOOST_CHECK_EQUAL(threads.size(), indexNum - 1);
+            for (auto& thread : threads) thread.join();
+            threads.clear();
+        }
+        BOOST_REQUIRE_EQUAL(results.size(), indexNum);
+
+        // the results of all indexes in distance order are positions 0 to resultNum - 1, each under the index it lies in
+        std::vector<std::pair<SPTAG::BasicResult, int>> merged;
+        for (int k = 0; k < indexNum; k++)
+        {
+            auto it = results.find("I" + std::to_string(k));
+            BOOST_REQUIRE(it != results.end());
+            float last = -1;
+            for (const auto& res : it->second)
+            {
+                if (res.VID == -1) continue;
+                BOOST_CHECK_GE(res.Dist, last);
+                last = res.Dist;
+                merged.emplace_back(res, k);
+            }
+        }
+        BOOST_REQUIRE_EQUAL(merged.size(), resultNum);
+        std::sort(merged.begin(), merged.end(), [](const std::pair<SPTAG::BasicResult, int>& p_left, const std::pair<SPTAG::BasicResult, int>& p_right)
+        {
+            return p_left.first.Dist < p_right.first.Dist;
+        });
+        for (int p = 0; p < resultNum; p++)
+        {
+            BOOST_CHECK_EQUAL(merged[p].second, p % indexNum);
+            BOOST_CHECK_EQUAL(merged[p].first.VID, p / indexNum);
+            float x = (float)p - 0.1f;
+            BOOST_CHECK_CLOSE(merged[p].first.Dist, x * x, 1e-3);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,99 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "inc/Test.h"
+#include "inc/Core/SPANN/Index.h"
+#include "inc/Core/SPANN/ExtraFullGraphSearcher.h"
+
+#include <omp.h>
+#include <random>
+#include <vector>
+
+namespace
+{
+    namespace Local
+    {
+        // Few distinct heads and distances so that the tie-breaking of EdgeCompare is exercised.
+        std::vector<SPTAG::Edge> RandomEdges(size_t p_num, SPTAG::SizeType p_heads, unsigned p_seed)
+        {
+            std::mt19937 rg(p_seed);
+            std::vector<SPTAG::Edge> edges(p_num);
+            for (size_t i = 0; i < p_num; i++)
+            {
+                edges[i].node = rg() % p_heads;
+                edges[i].distance = (float)(rg() % 16);
+                edges[i].tonode = rg() % 100000;
+            }
+            return edges;
+        }
+
+        bool SameEdges(const std::vector<SPTAG::Edge>& p_a, const std::vector<SPTAG::Edge>& p_b)
+        {
+            if (p_a.size() != p_b.size()) return false;
+            for (size_t i = 0; i < p_a.size(); i++)
+            {
+                if (p_a[i].node != p_b[i].node || p_a[i].distance != p_b[i].distance || p_a[i].tonode != p_b[i].tonode) return false;
+            }
+            return true;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(SelectionTest)
+
+BOOST_AUTO_TEST_CASE(SortSelectionsMatchesSerialSort)
+{
+    int threads = omp_get_max_threads();
+    // odd chunk counts leave one run out of a merge round
+    for (int chunks : { 1, 3, 4 })
+    {
+        omp_set_num_threads(chunks);
+        std::vector<SPTAG::Edge> edges = Local::RandomEdges(((size_t)chunks << 16) + 12345, 5000, chunks);
+        std::vector<SPTAG::Edge> expected(edges);
+        std::sort(expected.begin(), expected.end(), SPTAG::EdgeCompare());
+
+        SPTAG::VectorIndex::SortSelections(&edges);
+        BOOST_CHECK(Local::SameEdges(edges, expected));
+    }
+    omp_set_num_threads(threads);
+}
+
+BOOST_AUTO_TEST_CASE(SortedRunsLoadHeads)
+{
+    const SPTAG::SizeType heads = 300;
+    const size_t total = 50000;
+    std::vector<SPTAG::Edge> all = Local::RandomEdges(total, heads, 11);
+
+    SPTAG::SPANN::Selection selections(total, ".");
+    selections.SaveBatch();
+    // uneven batches as the build spills them
+    std::vector<size_t> bounds = { 0, 1, 7000, 7001, 31000, total };
+    for (size_t b = 0; b + 1 < bounds.size(); b++)
+    {
+        selections.LoadBatch(bounds[b], bounds[b + 1]);
+        std::copy(all.begin() + bounds[b], all.begin() + bounds[b + 1], selections.m_selections.begin());
+        selections.SaveSortedBatch();
+    }
+    BOOST_REQUIRE(selections.HasRuns());
+
+    std::sort(all.begin(), all.end(), SPTAG::EdgeCompare());
+    std::vector<std::pair<SPTAG::SizeType, SPTAG::SizeType>> ranges = { { 0, heads }, { 0, 1 }, { 17, 18 }, { 100, 257 }, { 299, 300 }, { 300, 400 } };
+    for (auto& range : ranges)
+    {
+        selections.LoadHeads(range.first, range.second);
+        auto first = std::lower_bound(all.begin(), all.end(), range.first, SPTAG::EdgeCompare());
+        auto last = std::lower_bound(all.begin(), all.end(), range.second, SPTAG::EdgeCompare());
+        BOOST_CHECK(Local::SameEdges(selections.m_selections, std::vector<SPTAG::Edge>(first, last)));
+
+        // lower_bound and indexing work on the loaded range
+        if (first != last)
+        {
+            size_t offset = selections.lower_bound(range.first);
+            BOOST_CHECK_EQUAL(offset, 0);
+            BOOST_CHECK_EQUAL(selections[offset].node, range.first);
+        }
+    }
+    remove(selections.m_tmpfile.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,120 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "inc/Test.h"
+#include "inc/TestUtils.h"
+#include "inc/Core/VectorIndex.h"
+#include "inc/Server/ServiceContext.h"
+#include "inc/Server/SearchExecutor.h"
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    namespace Local
+    {
+        const SPTAG::DimensionType c_dim = 4;
+        const SPTAG::SizeType c_count = 64;
+
+        float NearestDist(const std::shared_ptr<SPTAG::VectorIndex>& p_index)
+        {
+            std::vector<float> query(c_dim, 0);
+            SPTAG::QueryResult result(query.data(), 1, false);
+            BOOST_REQUIRE(SPTAG::ErrorCode::Success == p_index->SearchIndex(result));
+            return result.GetResult(0)->Dist;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(ServiceContextTest)
+
+BOOST_AUTO_TEST_CASE(ReloadPublishesNewSnapshot)
+{
+    // vector i of the two versions lies at i and i + 10 along one axis, so they differ in their nearest distance
+    SPTAG::TestUtils::SaveBKTIndex("reload_index_v1", SPTAG::TestUtils::LineVectors(Local::c_count, Local::c_dim, 1, 0));
+    SPTAG::TestUtils::SaveBKTIndex("reload_index_v2", SPTAG::TestUtils::LineVectors(Local::c_count, Local::c_dim, 1, 10));
+
+    std::ofstream config("reload_service.ini");
+    config << "[Index]\nList=A\n\n[Index_A]\nIndexFolder=reload_index_v1\n";
+    config.close();
+
+    SPTAG::Service::ServiceContext context("reload_service.ini");
+    BOOST_REQUIRE(context.IsInitialized());
+
+    auto oldMap = context.GetIndexMap();
+    BOOST_REQUIRE_EQUAL(oldMap->count("A"), 1);
+    auto oldIndex = oldMap->at("A");
+    BOOST_CHECK_EQUAL(Local::NearestDist(oldIndex), 0);
+
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == context.ReloadIndex("A", "reload_index_v2"));
+    auto newMap = context.GetIndexMap();
+    BOOST_CHECK(newMap != oldMap);
+    BOOST_CHECK_EQUAL(newMap->at("A")->GetIndexName(), "A");
+    BOOST_CHECK_CLOSE(Local::NearestDist(newMap->at("A")), 100.0f, 1e-3);
+
+    // readers holding the old snapshot keep the old version
+    BOOST_CHECK(oldMap->at("A") == oldIndex);
+    BOOST_CHECK_EQUAL(Local::NearestDist(oldIndex), 0);
+
+    // failed reloads leave the published map alone
+    BOOST_CHECK(SPTAG::ErrorCode::Success != context.ReloadIndex("B", "reload_index_v1"));
+    BOOST_CHECK(SPTAG::ErrorCode::Success != context.ReloadIndex("A", "reload_index_missing"));
+    BOOST_CHECK(context.GetIndexMap() == newMap);
+
+    // an empty folder reloads from the folder of the last successful load
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == context.ReloadIndex("A", ""));
+    BOOST_CHECK_CLOSE(Local::NearestDist(context.GetIndexMap()->at("A")), 100.0f, 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(SearchDuringReload)
+{
+    SPTAG::TestUtils::SaveBKTIndex("reload_index_v1", SPTAG::TestUtils::LineVectors(Local::c_count, Local::c_dim, 1, 0));
+    SPTAG::TestUtils::SaveBKTIndex("reload_index_v2", SPTAG::TestUtils::LineVectors(Local::c_count, Local::c_dim, 1, 10));
+
+    std::ofstream config("reload_service.ini");
+    config << "[Index]\nList=A\n\n[Index_A]\nIndexFolder=reload_index_v1\n";
+    config.close();
+
+    std::shared_ptr<SPTAG::Service::ServiceContext> context(new SPTAG::Service::ServiceContext("reload_service.ini"));
+    BOOST_REQUIRE(context->IsInitialized());
+
+    std::atomic<bool> done(false);
+    std::atomic<int> searches(0), bad(0);
+    std::vector<std::thread> searchers;
+    for (int t = 0; t < 2; t++)
+    {
+        searchers.emplace_back([&]()
+        {
+            while (!done.load())
+            {
+                SPTAG::Service::SearchExecutor executor("0|0|0|0 $resultnum:1", context,
+                    [&](std::shared_ptr<SPTAG::Service::SearchExecutionContext> p_exeContext)
+                    {
+                        const auto& results = p_exeContext->GetResults();
+                        if (results.size() != 1 || results[0].m_results.GetResult(0)->VID != 0) bad++;
+                        else
+                        {
+                            float dist = results[0].m_results.GetResult(0)->Dist;
+                            if (dist != 0 && std::abs(dist - 100.0f) > 1e-3) bad++;
+                        }
+                        searches++;
+                    });
+                executor.Execute();
+            }
+        });
+    }
+
+    for (int i = 0; i < 6; i++)
+    {
+        BOOST_CHECK(SPTAG::ErrorCode::Success == context->ReloadIndex("A", (i % 2 == 0) ? "reload_index_v2" : "reload_index_v1"));
+    }
+    while (searches.load() == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    done = true;
+    for (auto& searcher : searchers) searcher.join();
+    BOOST_CHECK_EQUAL(bad.load(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
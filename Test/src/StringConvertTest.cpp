@@ -3,6 +3,11 @@
 
 #include "inc/Test.h"
 #include "inc/Helper/StringConvert.h"
+#include "inc/Helper/VectorSetReaders/TxtReader.h"
+
+#include <cstring>
+#include <fstream>
+#include <random>
 
 namespace
 {
@@ -25,6 +30,40 @@ namespace
             BOOST_CHECK(val == p_val);
         }
 
+        template <typename ValueType>
+        bool Parse(const std::string& p_str, ValueType& p_value)
+        {
+            return SPTAG::Helper::Convert::ParseNumber(p_str.data(), p_str.data() + p_str.size(), p_value);
+        }
+
+        template <typename ValueType>
+        void TestParseSuccCase(const std::string& p_str, ValueType p_expected)
+        {
+            ValueType val = 0;
+            BOOST_CHECK_MESSAGE(Parse(p_str, val), p_str);
+            BOOST_CHECK_MESSAGE(val == p_expected, p_str);
+        }
+
+        template <typename ValueType>
+        void TestParseFailCase(const std::string& p_str)
+        {
+            ValueType val = 0;
+            BOOST_CHECK_MESSAGE(!Parse(p_str, val), p_str);
+        }
+
+        // The parsed value must match strtof/strtod bit for bit wherever those accept the token.
+        template <typename ValueType>
+        void CheckAgainstStrto(const std::string& p_str)
+        {
+            char* end = nullptr;
+            errno = 0;
+            ValueType expected = std::is_same<ValueType, float>::value ? (ValueType)std::strtof(p_str.c_str(), &end) : (ValueType)std::strtod(p_str.c_str(), &end);
+            if (errno == ERANGE || *end != '\0') return;
+
+            ValueType val = 0;
+            BOOST_REQUIRE_MESSAGE(Parse(p_str, val), p_str);
+            BOOST_REQUIRE_MESSAGE(std::memcmp(&val, &expected, sizeof(ValueType)) == 0, p_str);
+        }
     }
 }
 
@@ -125,4 +164,104 @@ BOOST_AUTO_TEST_CASE(ConvertDistCalcMethod)
     Local::TestConvertSuccCase<SPTAG::DistCalcMethod>(SPTAG::DistCalcMethod::L2, "L2");
 }
 
+BOOST_AUTO_TEST_CASE(ParseIntegerRange)
+{
+    Local::TestParseSuccCase<int8_t>("-128", -128);
+    Local::TestParseSuccCase<int8_t>("127", 127);
+    Local::TestParseSuccCase<int8_t>("+5", 5);
+    Local::TestParseSuccCase<int8_t>("-0", 0);
+    Local::TestParseFailCase<int8_t>("128");
+    Local::TestParseFailCase<int8_t>("-129");
+    Local::TestParseSuccCase<uint8_t>("255", 255);
+    Local::TestParseFailCase<uint8_t>("256");
+    Local::TestParseFailCase<uint8_t>("-1");
+
+    Local::TestParseSuccCase<int64_t>("9223372036854775807", (std::numeric_limits<int64_t>::max)());
+    Local::TestParseSuccCase<int64_t>("-9223372036854775808", (std::numeric_limits<int64_t>::min)());
+    Local::TestParseFailCase<int64_t>("9223372036854775808");
+    Local::TestParseFailCase<int64_t>("-9223372036854775809");
+    Local::TestParseSuccCase<uint64_t>("18446744073709551615", (std::numeric_limits<uint64_t>::max)());
+    Local::TestParseFailCase<uint64_t>("18446744073709551616");
+
+    // more than 19 digits leave the fast path but still parse
+    int32_t val = 0;
+    std::string padded = "000000000000000000000042";
+    BOOST_CHECK(!SPTAG::Helper::Convert::ParseIntegerFast(padded.data(), padded.data() + padded.size(), val));
+    Local::TestParseSuccCase<int32_t>(padded, 42);
+
+    for (const char* bad : { "", "-", "+", "1x", "x1", "1 2", "0x10", "1.5" }) Local::TestParseFailCase<int32_t>(bad);
+}
+
+BOOST_AUTO_TEST_CASE(ParseFloatForms)
+{
+    Local::TestParseSuccCase<float>("1e10", 1e10f);
+    Local::TestParseSuccCase<float>("1.5E-3", 1.5e-3f);
+    Local::TestParseSuccCase<float>("-2.5e+2", -250.0f);
+    Local::TestParseSuccCase<float>(".5", 0.5f);
+    Local::TestParseSuccCase<float>("5.", 5.0f);
+    Local::TestParseSuccCase<double>("-.5e1", -5.0);
+    Local::TestParseSuccCase<float>("3.4028235e38", 3.4028235e38f);
+    Local::TestParseFailCase<float>("1e39");
+    for (const char* bad : { "", "-", ".", "e5", "1e", "1e+", "1.2.3", "1,5", "1f" }) Local::TestParseFailCase<float>(bad);
+
+    // mantissas beyond 2^24 and wide exponents are left to strtof
+    float val = 0;
+    for (const char* slow : { "16777217", "0.1234567891", "1e11", "1e-11", "0.123456789012345678901" })
+    {
+        std::string str(slow);
+        BOOST_CHECK_MESSAGE(!SPTAG::Helper::Convert::ParseFloatFast(str.data(), str.data() + str.size(), val), str);
+        Local::CheckAgainstStrto<float>(str);
+    }
+    Local::TestParseSuccCase<float>("16777217", 16777216.0f);
+
+    // a '\0' inside a token is not a terminator
+    Local::TestParseFailCase<float>(std::string("2\0", 2));
+    Local::TestParseFailCase<int32_t>(std::string("2\0", 2));
+    Local::TestParseFailCase<float>(std::string("1\0" "5", 3));
+}
+
+BOOST_AUTO_TEST_CASE(ParseFloatMatchesStrtof)
+{
+    std::mt19937 rng(7);
+    for (int i = 0; i < 200000; i++)
+    {
+        std::string str;
+        if (rng() % 4 == 0) str += (rng() % 2) ? '-' : '+';
+        int digits = 1 + rng() % 12;
+        int point = rng() % (digits + 1);
+        for (int d = 0; d < digits; d++)
+        {
+            if (d == point) str += '.';
+            str += (char)('0' + rng() % 10);
+        }
+        if (rng() % 3 == 0) str += "e" + std::to_string((int)(rng() % 31) - 15);
+
+        Local::CheckAgainstStrto<float>(str);
+        Local::CheckAgainstStrto<double>(str);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TextReaderRejectsNul)
+{
+    std::shared_ptr<SPTAG::Helper::ReaderOptions> options(new SPTAG::Helper::ReaderOptions(SPTAG::VectorValueType::Float, 3, SPTAG::VectorFileType::TXT, "|", 2));
+
+    {
+        std::ofstream file("string_convert_vectors.txt", std::ios::binary);
+        file << "a\t1|2.5|-3e1\nb\t4|5|6\n";
+    }
+    auto reader = SPTAG::Helper::VectorSetReader::CreateInstance(options);
+    BOOST_REQUIRE(SPTAG::ErrorCode::Success == reader->LoadFile("string_convert_vectors.txt"));
+    auto vectors = reader->GetVectorSet();
+    BOOST_REQUIRE_EQUAL(vectors->Count(), 2);
+    const float* row = (const float*)vectors->GetVector(0);
+    BOOST_CHECK(row[0] == 1.0f && row[1] == 2.5f && row[2] == -30.0f);
+
+    {
+        std::ofstream file("string_convert_vectors.txt", std::ios::binary);
+        file << "a\t1|2" << '\0' << "|3\n";
+    }
+    reader = SPTAG::Helper::VectorSetReader::CreateInstance(options);
+    BOOST_CHECK(SPTAG::ErrorCode::Success != reader->LoadFile("string_convert_vectors.txt"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
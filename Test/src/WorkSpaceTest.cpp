@@ -0,0 +1,127 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "inc/Test.h"
+#include "inc/Core/Common/WorkSpace.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+    namespace Local
+    {
+        // Lets a test move the generation counter up to where it wraps.
+        class HashPosVector : public SPTAG::COMMON::OptHashPosVector
+        {
+        public:
+            void SetGeneration(std::uint32_t p_generation) { m_generation = p_generation; }
+        };
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(WorkSpaceTest)
+
+BOOST_AUTO_TEST_CASE(HashPosVectorMatchesSet)
+{
+    SPTAG::COMMON::OptHashPosVector hash;
+    hash.Init(64, 1);
+    const int exp = hash.HashTableExponent();
+
+    // searches of random sizes over random id ranges, so the table keeps growing and old ids keep being left behind
+    std::mt19937 rng(1);
+    int largest = 0;
+    for (int q = 0; q < 500; q++)
+    {
+        hash.clear();
+        std::unordered_set<SPTAG::SizeType> seen;
+        int count = rng() % 5000, range = 1 + rng() % 20000;
+        for (int i = 0; i < count; i++)
+        {
+            SPTAG::SizeType id = rng() % range;
+            BOOST_REQUIRE_EQUAL(hash.CheckAndSet(id), seen.count(id) > 0);
+            seen.insert(id);
+        }
+        largest = std::max(largest, (int)seen.size());
+    }
+    BOOST_CHECK_GT(largest, 64);
+    BOOST_CHECK_GT(hash.HashTableExponent(), exp);
+
+    // ids from before a clear are gone
+    hash.clear();
+    BOOST_CHECK(!hash.CheckAndSet(0));
+    BOOST_CHECK(hash.CheckAndSet(0));
+}
+
+BOOST_AUTO_TEST_CASE(HashPosVectorConcurrent)
+{
+    SPTAG::COMMON::OptHashPosVector hash;
+    hash.Init(64, 1);
+    const int threadNum = 4, perThread = 3000, range = 5000;
+
+    for (int round = 0; round < 3; round++)
+    {
+        // ids added before the threads run are seen by them, and the buckets left from the last round are wiped
+        hash.clear();
+        for (SPTAG::SizeType id = 0; id < 100; id++) BOOST_REQUIRE(!hash.CheckAndSet(id));
+        hash.PrepareConcurrent(threadNum * perThread);
+        int exp = hash.HashTableExponent();
+
+        // every thread adds overlapping ids, and each id is reported unseen exactly once
+        std::vector<std::atomic_int> unseen(range);
+        for (auto& count : unseen) count = 0;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadNum; t++)
+        {
+            threads.emplace_back([&hash, &unseen, t, round]()
+            {
+                std::mt19937 rng(round * threadNum + t);
+                for (int i = 0; i < perThread; i++)
+                {
+                    SPTAG::SizeType id = rng() % range;
+                    if (!hash.CheckAndSetConcurrent(id)) unseen[id]++;
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        BOOST_CHECK_EQUAL(hash.HashTableExponent(), exp);
+
+        // the serial calls after the threads agree with what they added
+        for (SPTAG::SizeType id = 0; id < range; id++)
+        {
+            if (id < 100) BOOST_REQUIRE_EQUAL(unseen[id].load(), 0);
+            else BOOST_REQUIRE_LE(unseen[id].load(), 1);
+            BOOST_REQUIRE_EQUAL(hash.CheckAndSet(id), id < 100 || unseen[id] == 1);
+        }
+        BOOST_CHECK(!hash.CheckAndSet(range));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(HashPosVectorGenerationWrap)
+{
+    Local::HashPosVector hash;
+    hash.Init(64, 1);
+
+    // buckets stamped with generation 1 would look current again once the counter wraps back to it
+    for (SPTAG::SizeType id = 1000; id < 1040; id++) BOOST_REQUIRE(!hash.CheckAndSet(id));
+    hash.SetGeneration(0xffffffffu);
+    hash.clear();
+    for (SPTAG::SizeType id = 1000; id < 1040; id++) BOOST_REQUIRE(!hash.CheckAndSet(id));
+
+    // clears on both sides of the wrap
+    hash.SetGeneration(0xfffffffeu);
+    for (int round = 0; round < 4; round++)
+    {
+        hash.clear();
+        for (SPTAG::SizeType id = 0; id < 100; id++)
+        {
+            BOOST_REQUIRE(!hash.CheckAndSet(id));
+            BOOST_REQUIRE(hash.CheckAndSet(id));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()